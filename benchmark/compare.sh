@@ -10,7 +10,7 @@ export ZIG_GLOBAL_CACHE_DIR
 
 mkdir -p "$ZIG_GLOBAL_CACHE_DIR" "$ZIG_LOCAL_CACHE_DIR"
 
-echo "[1/8] Building Luna with Aggressive Optimizations..."
+echo "[1/9] Building Luna with Aggressive Optimizations..."
 ${MAKE:-make} clean > /dev/null
 ${MAKE:-make} > /dev/null
 echo "  -> Compiler Flags: -O3 -march=native -flto=auto"
@@ -18,28 +18,33 @@ echo "  -> Build Complete!"
 
 echo ""
 echo "--- 300x300 MATRIX MULTIPLICATION ---"
-echo "[2/8] Zig Benchmark (Native Matrix Mul)..."
+echo "[2/9] Zig Benchmark (Native Matrix Mul)..."
 "$ZIG_BIN" run --cache-dir "$ZIG_LOCAL_CACHE_DIR" -O ReleaseFast benchmark/matrix_native.zig -lc
-echo "[3/8] Zig Benchmark (Contiguous Matrix Mul)..."
+echo "[3/9] Zig Benchmark (Contiguous Matrix Mul)..."
 "$ZIG_BIN" run --cache-dir "$ZIG_LOCAL_CACHE_DIR" -O ReleaseFast benchmark/matrix_contiguous.zig -lc
-echo "[4/8] Luna Benchmark (Native Matrix Bridge)..."
+echo "[4/9] Luna Benchmark (Native Matrix Bridge)..."
 ./bin/luna benchmark/luna_bench.lu
 
 echo ""
 echo "--- 1M VECTOR MULTIPLICATION ---"
-echo "[5/8] Zig Benchmark (Native Vector Math)..."
+echo "[5/9] Zig Benchmark (Native Vector Math)..."
 "$ZIG_BIN" run --cache-dir "$ZIG_LOCAL_CACHE_DIR" -O ReleaseFast benchmark/vector_native.zig -lc
-echo "[6/8] Zig Benchmark (Contiguous Vector Math)..."
+echo "[6/9] Zig Benchmark (Contiguous Vector Math)..."
 "$ZIG_BIN" run --cache-dir "$ZIG_LOCAL_CACHE_DIR" -O ReleaseFast benchmark/vector_contiguous.zig -lc
-echo "[7/8] Luna Benchmark (Native Vector Bridge)..."
+echo "[7/9] Luna Benchmark (Native Vector Bridge)..."
 ./bin/luna benchmark/vector_luna.lu
 
 echo ""
 echo "--- 1M ENVIRONMENT LOOKUPS ---"
-echo "[8/8] Zig vs Luna..."
+echo "[8/9] Zig vs Luna..."
 "$ZIG_BIN" run --cache-dir "$ZIG_LOCAL_CACHE_DIR" -O ReleaseFast benchmark/env_native.zig -lc
 ./bin/luna benchmark/env_luna.lu
 
+echo ""
+echo "--- 1M-ELEMENT CALLBACKS (map/filter/reduce) ---"
+echo "[9/9] Luna Benchmark (Callback VM Pool)..."
+./bin/luna benchmark/callback_luna.lu
+
 echo ""
 echo "=================================================="
 echo "               BENCHMARK COMPLETE                 "
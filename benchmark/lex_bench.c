@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Lexer throughput in MB/s: tokenizes a source buffer (a generated ~9 MB
+// program, or the .lu file given as argument) and reports the best of seven
+// passes. Built and run by `make lex-bench`.
+
+#define _POSIX_C_SOURCE 199309L  // clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lexer.h"
+
+#define PASSES 7
+#define COPIES 25000
+
+// Comments, indented blocks, keywords, a few recurring names, numbers, and
+// strings with and without escapes
+static const char *block =
+    "# accumulate a weighted total over the two inputs, then clamp it\n"
+    "func weigh(alpha, beta) {\n"
+    "    let total = alpha * 1024 + beta * 3.25\n"
+    "    let label = \"a plain label that needs no unescaping at all\"\n"
+    "    let path = \"C:\\\\data\\\\records\\\\input.txt\\n\"\n"
+    "    if (total >= 100000 && beta != 0) {\n"
+    "        total = total - 1   // clamp to the limit\n"
+    "    }\n"
+    "    return total\n"
+    "}\n"
+    "\n";
+
+static char *generate_source(size_t *out_len) {
+    size_t block_len = strlen(block);
+    size_t len = block_len * COPIES;
+    char *src = malloc(len + 1);
+    if (!src) abort();
+    for (size_t i = 0; i < COPIES; i++) {
+        memcpy(src + i * block_len, block, block_len);
+    }
+    src[len] = '\0';
+    *out_len = len;
+    return src;
+}
+
+static char *read_source(const char *path, size_t *out_len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    char *src = malloc((size_t)size + 1);
+    if (!src) abort();
+    size_t got = fread(src, 1, (size_t)size, f);
+    fclose(f);
+    src[got] = '\0';
+    *out_len = got;
+    return src;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    size_t len = 0;
+    char *src = argc > 1 ? read_source(argv[1], &len) : generate_source(&len);
+    if (!src) {
+        fprintf(stderr, "Could not read file: %s\n", argv[1]);
+        return 1;
+    }
+
+    double best = 1e30;
+    long tokens = 0;
+    for (int pass = 0; pass < PASSES; pass++) {
+        double start = now_seconds();
+        Lexer lexer = lexer_create(src);
+        tokens = 0;
+        while (1) {
+            Token t = lexer_next(&lexer);
+            int done = t.type == T_EOF;
+            free_token(&t);
+            tokens++;
+            if (done) break;
+        }
+        double elapsed = now_seconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+
+    printf("Lexer: %.1f MB, %ld tokens, %.4f s (%.1f MB/s)\n",
+           (double)len / 1e6, tokens, best, (double)len / 1e6 / best);
+    free(src);
+    return 0;
+}
@@ -51,20 +51,20 @@ static int image_count = 0;
 // Internal Helpers
 
 static double val_to_double(Value v) {
-    if (v.type == VAL_INT) return (double)v.i;
-    if (v.type == VAL_FLOAT) return v.f;
+    if (VALUE_TYPE(v) == VAL_INT) return (double)VALUE_AS_INT(v);
+    if (VALUE_TYPE(v) == VAL_FLOAT) return VALUE_AS_FLOAT(v);
     return 0.0;
 }
 
 
 // Extract GColor from Luna List [r, g, b, a]
 static GColor val_to_color(Value v) {
-    if (v.type != VAL_LIST || v.list->count < 3) return GCOLOR_WHITE;
+    if (VALUE_TYPE(v) != VAL_LIST || VALUE_AS_LIST(v)->count < 3) return GCOLOR_WHITE;
     GColor c;
-    c.r = (unsigned char)v.list->items[0].i;
-    c.g = (unsigned char)v.list->items[1].i;
-    c.b = (unsigned char)v.list->items[2].i;
-    c.a = (v.list->count > 3) ? (unsigned char)v.list->items[3].i : 255;
+    c.r = (unsigned char)VALUE_AS_INT(VALUE_AS_LIST(v)->items[0]);
+    c.g = (unsigned char)VALUE_AS_INT(VALUE_AS_LIST(v)->items[1]);
+    c.b = (unsigned char)VALUE_AS_INT(VALUE_AS_LIST(v)->items[2]);
+    c.a = (VALUE_AS_LIST(v)->count > 3) ? (unsigned char)VALUE_AS_INT(VALUE_AS_LIST(v)->items[3]) : 255;
     return c;
 }
 
@@ -83,7 +83,7 @@ Value lib_gui_create_particle_pool(int argc, Value *argv, struct Env *env);
 
 Value lib_gui_init(int argc, Value *argv, Env *env) {
     if (argc < 3) return value_null();
-    gl_init_window((int)argv[0].i, (int)argv[1].i, argv[2].string->chars);
+    gl_init_window((int)VALUE_AS_INT(argv[0]), (int)VALUE_AS_INT(argv[1]), VALUE_AS_STRING(argv[2])->chars);
 
     // Register predefined colors
     register_color(env, "RED", (GColor){230, 41, 55, 255});
@@ -257,7 +257,7 @@ Value lib_gui_draw_rect(int argc, Value *argv, Env *env) {
                   (float)val_to_double(argv[2]), (float)val_to_double(argv[3]) };
     
     // Check for overloaded signature: (x, y, w, h, Color)
-    if (argc == 5 && argv[4].type == VAL_LIST) {
+    if (argc == 5 && VALUE_TYPE(argv[4]) == VAL_LIST) {
         gl_draw_rect(rec, val_to_color(argv[4]));
         return value_null();
     }
@@ -304,7 +304,7 @@ Value lib_gui_draw_line(int argc, Value *argv, Env *env) {
     GVec2 end   = { (float)val_to_double(argv[2]), (float)val_to_double(argv[3]) };
 
     // Overload: (x1, y1, x2, y2, color) — 5 args, 5th is list → default thickness 1
-    if (argc == 5 && argv[4].type == VAL_LIST) {
+    if (argc == 5 && VALUE_TYPE(argv[4]) == VAL_LIST) {
         gl_draw_line(start, end, 1.0f, val_to_color(argv[4]));
         return value_null();
     }
@@ -326,12 +326,12 @@ Value lib_gui_draw_gradient_v(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_draw_rectangle_rec(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_null();
-    if (argv[0].type != VAL_LIST || argv[0].list->count < 4) return value_null();
+    if (VALUE_TYPE(argv[0]) != VAL_LIST || VALUE_AS_LIST(argv[0])->count < 4) return value_null();
     GRect rec = { 
-        (float)val_to_double(argv[0].list->items[0]), 
-        (float)val_to_double(argv[0].list->items[1]), 
-        (float)val_to_double(argv[0].list->items[2]), 
-        (float)val_to_double(argv[0].list->items[3]) 
+        (float)val_to_double(VALUE_AS_LIST(argv[0])->items[0]), 
+        (float)val_to_double(VALUE_AS_LIST(argv[0])->items[1]), 
+        (float)val_to_double(VALUE_AS_LIST(argv[0])->items[2]), 
+        (float)val_to_double(VALUE_AS_LIST(argv[0])->items[3]) 
     };
     GColor col = val_to_color(argv[1]);
     gl_draw_rect(rec, col);
@@ -354,7 +354,7 @@ Value lib_gui_draw_rectangle_lines(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_label(int argc, Value *argv, Env *env) {
     if (argc < 1) return value_null();
-    gl_draw_text(argv[0].string->chars, (int)margin_x, (int)layout_cursor_y, 20, GCOLOR_DARKGRAY);
+    gl_draw_text(VALUE_AS_STRING(argv[0])->chars, (int)margin_x, (int)layout_cursor_y, 20, GCOLOR_DARKGRAY);
     layout_cursor_y += widget_height + padding;
     return value_null();
 }
@@ -366,14 +366,14 @@ Value lib_gui_button(int argc, Value *argv, Env *env) {
     int hover = gl_check_collision_point_rect(mouse, bounds);
     int clicked = hover && gl_is_mouse_button_pressed(GMOUSE_LEFT);
     gl_draw_rect(bounds, hover ? GCOLOR_LIGHTGRAY : GCOLOR_GRAY);
-    gl_draw_text(argv[0].string->chars, (int)bounds.x + 10, (int)bounds.y + 5, 20, GCOLOR_BLACK);
+    gl_draw_text(VALUE_AS_STRING(argv[0])->chars, (int)bounds.x + 10, (int)bounds.y + 5, 20, GCOLOR_BLACK);
     layout_cursor_y += widget_height + padding;
     return value_bool(clicked);
 }
 
 Value lib_gui_slider(int argc, Value *argv, Env *env) {
     if (argc < 4) return value_null();
-    const char* var_name = argv[0].string->chars;
+    const char* var_name = VALUE_AS_STRING(argv[0])->chars;
     float min = (float)val_to_double(argv[1]);
     float max = (float)val_to_double(argv[2]);
     Value *val = env_get(env, var_name); 
@@ -386,13 +386,13 @@ Value lib_gui_slider(int argc, Value *argv, Env *env) {
         if (pct < 0) pct = 0; 
         if (pct > 1) pct = 1;
         current_f = min + (max - min) * pct;
-        if (val->type == VAL_INT) val->i = (long long)current_f;
-        else val->f = (double)current_f;
+        if (VALUE_TYPE(*val) == VAL_INT) *val = value_int((long long)current_f);
+        else *val = value_float((double)current_f);
     }
     gl_draw_rect(bounds, GCOLOR_LIGHTGRAY);
     float fill_w = ((current_f - min) / (max - min)) * 200;
     gl_draw_rect_at((int)bounds.x, (int)bounds.y, (int)fill_w, (int)bounds.h, GCOLOR_BLUE);
-    gl_draw_text(argv[3].string->chars, (int)(bounds.x + 210), (int)bounds.y + 5, 20, GCOLOR_BLACK);
+    gl_draw_text(VALUE_AS_STRING(argv[3])->chars, (int)(bounds.x + 210), (int)bounds.y + 5, 20, GCOLOR_BLACK);
     layout_cursor_y += widget_height + padding;
     return value_null();
 }
@@ -433,15 +433,15 @@ Value lib_gui_is_mouse_button_down(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_check_collision_point_rec(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_bool(0);
-    if (argv[0].type != VAL_LIST || argv[0].list->count < 2) return value_bool(0);
-    if (argv[1].type != VAL_LIST || argv[1].list->count < 4) return value_bool(0);
+    if (VALUE_TYPE(argv[0]) != VAL_LIST || VALUE_AS_LIST(argv[0])->count < 2) return value_bool(0);
+    if (VALUE_TYPE(argv[1]) != VAL_LIST || VALUE_AS_LIST(argv[1])->count < 4) return value_bool(0);
 
-    GVec2 point = { (float)val_to_double(argv[0].list->items[0]), (float)val_to_double(argv[0].list->items[1]) };
+    GVec2 point = { (float)val_to_double(VALUE_AS_LIST(argv[0])->items[0]), (float)val_to_double(VALUE_AS_LIST(argv[0])->items[1]) };
     GRect rec = { 
-        (float)val_to_double(argv[1].list->items[0]), 
-        (float)val_to_double(argv[1].list->items[1]), 
-        (float)val_to_double(argv[1].list->items[2]), 
-        (float)val_to_double(argv[1].list->items[3]) 
+        (float)val_to_double(VALUE_AS_LIST(argv[1])->items[0]), 
+        (float)val_to_double(VALUE_AS_LIST(argv[1])->items[1]), 
+        (float)val_to_double(VALUE_AS_LIST(argv[1])->items[2]), 
+        (float)val_to_double(VALUE_AS_LIST(argv[1])->items[3]) 
     };
 
     return value_bool(gl_check_collision_point_rect(point, rec));
@@ -471,7 +471,7 @@ Value lib_gui_hsl(int argc, Value *argv, Env *env) {
 
 Value lib_gui_load_texture(int argc, Value *argv, Env *env) {
     if (argc < 1 || texture_count >= MAX_TEXTURES) return value_int(-1);
-    int id = gl_load_texture(argv[0].string->chars);
+    int id = gl_load_texture(VALUE_AS_STRING(argv[0])->chars);
     if (id < 0) return value_int(-1);
     texture_ids[texture_count] = id;
     texture_widths[texture_count] = gl_get_texture_width(id);
@@ -481,7 +481,7 @@ Value lib_gui_load_texture(int argc, Value *argv, Env *env) {
 
 Value lib_gui_draw_texture(int argc, Value *argv, Env *env) {
     if (argc < 3) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < texture_count) {
         gl_draw_texture(texture_ids[id], (int)val_to_double(argv[1]), (int)val_to_double(argv[2]), GCOLOR_WHITE);
     }
@@ -490,7 +490,7 @@ Value lib_gui_draw_texture(int argc, Value *argv, Env *env) {
 
 Value lib_gui_draw_texture_rot(int argc, Value *argv, struct Env *env) {
     if (argc < 4) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id < 0 || id >= texture_count) return value_null();
     float x = (float)val_to_double(argv[1]);
     float y = (float)val_to_double(argv[2]);
@@ -507,23 +507,23 @@ Value lib_gui_draw_texture_rot(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_draw_texture_pro(int argc, Value *argv, struct Env *env) {
     if (argc < 6) return value_null();
-    int id = (int)argv[0].i; 
+    int id = (int)VALUE_AS_INT(argv[0]); 
     if (id < 0 || id >= texture_count) return value_null();
     
-    if (argv[1].type != VAL_LIST || argv[1].list->count < 4) return value_null();
-    if (argv[2].type != VAL_LIST || argv[2].list->count < 4) return value_null();
-    if (argv[3].type != VAL_LIST || argv[3].list->count < 2) return value_null();
+    if (VALUE_TYPE(argv[1]) != VAL_LIST || VALUE_AS_LIST(argv[1])->count < 4) return value_null();
+    if (VALUE_TYPE(argv[2]) != VAL_LIST || VALUE_AS_LIST(argv[2])->count < 4) return value_null();
+    if (VALUE_TYPE(argv[3]) != VAL_LIST || VALUE_AS_LIST(argv[3])->count < 2) return value_null();
 
     GRect source = { 
-        (float)val_to_double(argv[1].list->items[0]), (float)val_to_double(argv[1].list->items[1]), 
-        (float)val_to_double(argv[1].list->items[2]), (float)val_to_double(argv[1].list->items[3]) 
+        (float)val_to_double(VALUE_AS_LIST(argv[1])->items[0]), (float)val_to_double(VALUE_AS_LIST(argv[1])->items[1]), 
+        (float)val_to_double(VALUE_AS_LIST(argv[1])->items[2]), (float)val_to_double(VALUE_AS_LIST(argv[1])->items[3]) 
     };
     GRect dest = { 
-        (float)val_to_double(argv[2].list->items[0]), (float)val_to_double(argv[2].list->items[1]), 
-        (float)val_to_double(argv[2].list->items[2]), (float)val_to_double(argv[2].list->items[3]) 
+        (float)val_to_double(VALUE_AS_LIST(argv[2])->items[0]), (float)val_to_double(VALUE_AS_LIST(argv[2])->items[1]), 
+        (float)val_to_double(VALUE_AS_LIST(argv[2])->items[2]), (float)val_to_double(VALUE_AS_LIST(argv[2])->items[3]) 
     };
     GVec2 origin = { 
-        (float)val_to_double(argv[3].list->items[0]), (float)val_to_double(argv[3].list->items[1]) 
+        (float)val_to_double(VALUE_AS_LIST(argv[3])->items[0]), (float)val_to_double(VALUE_AS_LIST(argv[3])->items[1]) 
     };
     float rotation = (float)val_to_double(argv[4]);
     GColor tint = val_to_color(argv[5]);
@@ -534,21 +534,21 @@ Value lib_gui_draw_texture_pro(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_get_texture_width(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_int(0);
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id < 0 || id >= texture_count) return value_int(0);
     return value_int(texture_widths[id]);
 }
 
 Value lib_gui_get_texture_height(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_int(0);
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id < 0 || id >= texture_count) return value_int(0);
     return value_int(texture_heights[id]);
 }
 
 Value lib_gui_unload_texture(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < texture_count) {
         gl_unload_texture(texture_ids[id]);
     }
@@ -569,7 +569,7 @@ Value lib_gui_close_audio_device(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_load_music(int argc, Value *argv, struct Env *env) {
     if (argc < 1 || music_count >= MAX_MUSIC) return value_int(-1);
-    int id = audio_load_music(argv[0].string->chars);
+    int id = audio_load_music(VALUE_AS_STRING(argv[0])->chars);
     if (id < 0) return value_int(-1);
     music_ids[music_count] = id;
     return value_int(music_count++);
@@ -577,14 +577,14 @@ Value lib_gui_load_music(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_unload_music_stream(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < music_count) audio_unload_music(music_ids[id]);
     return value_null();
 }
 
 Value lib_gui_load_sound(int argc, Value *argv, struct Env *env) {
     if (argc < 1 || sound_count >= MAX_SOUNDS) return value_int(-1);
-    int id = audio_load_sound(argv[0].string->chars);
+    int id = audio_load_sound(VALUE_AS_STRING(argv[0])->chars);
     if (id < 0) return value_int(-1);
     sound_ids[sound_count] = id;
     return value_int(sound_count++);
@@ -592,38 +592,38 @@ Value lib_gui_load_sound(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_unload_sound(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < sound_count) audio_unload_sound(sound_ids[id]);
     return value_null();
 }
 
 Value lib_gui_play_music(int argc, Value *argv, struct Env *env) {
-    if (argc > 0) audio_play_music(music_ids[(int)argv[0].i]);
+    if (argc > 0) audio_play_music(music_ids[(int)VALUE_AS_INT(argv[0])]);
     return value_null();
 }
 
 Value lib_gui_stop_music_stream(int argc, Value *argv, struct Env *env) {
-    if (argc > 0) audio_stop_music(music_ids[(int)argv[0].i]);
+    if (argc > 0) audio_stop_music(music_ids[(int)VALUE_AS_INT(argv[0])]);
     return value_null();
 }
 
 Value lib_gui_pause_music_stream(int argc, Value *argv, struct Env *env) {
-    if (argc > 0) audio_pause_music(music_ids[(int)argv[0].i]);
+    if (argc > 0) audio_pause_music(music_ids[(int)VALUE_AS_INT(argv[0])]);
     return value_null();
 }
 
 Value lib_gui_resume_music_stream(int argc, Value *argv, struct Env *env) {
-    if (argc > 0) audio_resume_music(music_ids[(int)argv[0].i]);
+    if (argc > 0) audio_resume_music(music_ids[(int)VALUE_AS_INT(argv[0])]);
     return value_null();
 }
 
 Value lib_gui_update_music(int argc, Value *argv, struct Env *env) {
-    if (argc > 0) audio_update_music(music_ids[(int)argv[0].i]);
+    if (argc > 0) audio_update_music(music_ids[(int)VALUE_AS_INT(argv[0])]);
     return value_null();
 }
 
 Value lib_gui_play_sound(int argc, Value *argv, struct Env *env) {
-    if (argc > 0) audio_play_sound(sound_ids[(int)argv[0].i]);
+    if (argc > 0) audio_play_sound(sound_ids[(int)VALUE_AS_INT(argv[0])]);
     return value_null();
 }
 
@@ -678,7 +678,7 @@ Value lib_gui_get_music_fft(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_get_music_time_length(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_float(0.0f);
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < music_count) {
         return value_float(audio_get_music_length(music_ids[id]));
     }
@@ -687,7 +687,7 @@ Value lib_gui_get_music_time_length(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_get_music_time_played(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_float(0.0f);
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < music_count) {
         return value_float(audio_get_music_played(music_ids[id]));
     }
@@ -696,7 +696,7 @@ Value lib_gui_get_music_time_played(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_seek_music_stream(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     float position = (float)val_to_double(argv[1]);
     if (id >= 0 && id < music_count) {
         audio_seek_music(music_ids[id], position);
@@ -708,7 +708,7 @@ Value lib_gui_seek_music_stream(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_load_font(int argc, Value *argv, Env *env) {
     if (argc < 2 || font_count >= MAX_FONTS) return value_int(-1);
-    int id = gl_load_font(argv[0].string->chars, (int)val_to_double(argv[1]));
+    int id = gl_load_font(VALUE_AS_STRING(argv[0])->chars, (int)val_to_double(argv[1]));
     if (id < 0) return value_int(-1);
     font_ids[font_count] = id;
     return value_int(font_count++);
@@ -716,11 +716,11 @@ Value lib_gui_load_font(int argc, Value *argv, Env *env) {
 
 Value lib_gui_draw_text(int argc, Value *argv, Env *env) {
     if (argc < 6) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < font_count) {
         GVec2 pos = {(float)val_to_double(argv[2]), (float)val_to_double(argv[3])};
         GColor color = (argc >= 7) ? val_to_color(argv[6]) : GCOLOR_WHITE;
-        gl_draw_text_ex(font_ids[id], argv[1].string->chars, pos,
+        gl_draw_text_ex(font_ids[id], VALUE_AS_STRING(argv[1])->chars, pos,
                         (float)val_to_double(argv[4]), (float)val_to_double(argv[5]), color);
     }
     return value_null();
@@ -728,12 +728,12 @@ Value lib_gui_draw_text(int argc, Value *argv, Env *env) {
 
 Value lib_gui_measure_text(int argc, Value *argv, struct Env *env) {
     if (argc == 2) {
-        return value_int(gl_measure_text(argv[0].string->chars, (int)val_to_double(argv[1])));
+        return value_int(gl_measure_text(VALUE_AS_STRING(argv[0])->chars, (int)val_to_double(argv[1])));
     }
     else if (argc >= 4) {
-        int id = (int)argv[0].i;
+        int id = (int)VALUE_AS_INT(argv[0]);
         if (id >= 0 && id < font_count) {
-            GVec2 size = gl_measure_text_ex(font_ids[id], argv[1].string->chars, 
+            GVec2 size = gl_measure_text_ex(font_ids[id], VALUE_AS_STRING(argv[1])->chars, 
                                             (float)val_to_double(argv[2]), (float)val_to_double(argv[3]));
             return value_int((int)size.x);
         }
@@ -743,7 +743,7 @@ Value lib_gui_measure_text(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_draw_text_default(int argc, Value *argv, struct Env *env) {
     if (argc < 5) return value_null();
-    gl_draw_text(argv[0].string->chars, (int)val_to_double(argv[1]), (int)val_to_double(argv[2]), 
+    gl_draw_text(VALUE_AS_STRING(argv[0])->chars, (int)val_to_double(argv[1]), (int)val_to_double(argv[2]), 
                  (int)val_to_double(argv[3]), val_to_color(argv[4]));
     return value_null();
 }
@@ -752,15 +752,15 @@ Value lib_gui_draw_text_default(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_begin_mode_2d(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    if (argv[0].type != VAL_LIST || argv[0].list->count < 6) return value_null();
+    if (VALUE_TYPE(argv[0]) != VAL_LIST || VALUE_AS_LIST(argv[0])->count < 6) return value_null();
     
     GCamera2D cam;
-    cam.offset.x = (float)val_to_double(argv[0].list->items[0]);
-    cam.offset.y = (float)val_to_double(argv[0].list->items[1]);
-    cam.target.x = (float)val_to_double(argv[0].list->items[2]);
-    cam.target.y = (float)val_to_double(argv[0].list->items[3]);
-    cam.rotation = (float)val_to_double(argv[0].list->items[4]);
-    cam.zoom = (float)val_to_double(argv[0].list->items[5]);
+    cam.offset.x = (float)val_to_double(VALUE_AS_LIST(argv[0])->items[0]);
+    cam.offset.y = (float)val_to_double(VALUE_AS_LIST(argv[0])->items[1]);
+    cam.target.x = (float)val_to_double(VALUE_AS_LIST(argv[0])->items[2]);
+    cam.target.y = (float)val_to_double(VALUE_AS_LIST(argv[0])->items[3]);
+    cam.rotation = (float)val_to_double(VALUE_AS_LIST(argv[0])->items[4]);
+    cam.zoom = (float)val_to_double(VALUE_AS_LIST(argv[0])->items[5]);
     
     gl_begin_mode_2d(cam);
     return value_null();
@@ -775,7 +775,7 @@ Value lib_gui_end_mode_2d(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_load_image(int argc, Value *argv, struct Env *env) {
     if (argc < 1 || image_count >= MAX_IMAGES) return value_int(-1);
-    int id = gl_load_image(argv[0].string->chars);
+    int id = gl_load_image(VALUE_AS_STRING(argv[0])->chars);
     if (id < 0) return value_int(-1);
     image_ids[image_count] = id;
     return value_int(image_count++);
@@ -783,7 +783,7 @@ Value lib_gui_load_image(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_image_rotate_cw(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < image_count) {
         gl_image_rotate_cw(image_ids[id]);
     }
@@ -792,7 +792,7 @@ Value lib_gui_image_rotate_cw(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_load_texture_from_image(int argc, Value *argv, struct Env *env) {
     if (argc < 1 || texture_count >= MAX_TEXTURES) return value_int(-1);
-    int img_id = (int)argv[0].i;
+    int img_id = (int)VALUE_AS_INT(argv[0]);
     if (img_id < 0 || img_id >= image_count) return value_int(-1);
     
     int tex_id = gl_load_texture_from_image(image_ids[img_id]);
@@ -805,7 +805,7 @@ Value lib_gui_load_texture_from_image(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_unload_image(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < image_count) {
         gl_unload_image(image_ids[id]);
     }
@@ -819,9 +819,9 @@ Value lib_gui_create_particle_pool(int argc, Value *argv, struct Env *env) {
     int count = (int)val_to_double(argv[0]);
     
     Value list = value_list();
-    list.list->items = malloc(sizeof(Value) * count);
-    list.list->capacity = count;
-    list.list->count = count;
+    VALUE_AS_LIST(list)->items = malloc(sizeof(Value) * count);
+    VALUE_AS_LIST(list)->capacity = count;
+    VALUE_AS_LIST(list)->count = count;
     
     for (int i = 0; i < count; i++) {
         Value p = value_list();
@@ -832,7 +832,7 @@ Value lib_gui_create_particle_pool(int argc, Value *argv, struct Env *env) {
         value_list_append(&p, value_float(0.0)); // hue
         value_list_append(&p, value_float(0.0)); // size
         value_list_append(&p, value_int(0));     // active
-        list.list->items[i] = p;
+        VALUE_AS_LIST(list)->items[i] = p;
     }
     
     return list;
@@ -851,7 +851,7 @@ static unsigned int unsynchsafe_to_int(unsigned char *bytes) {
 Value lib_gui_load_music_cover(int argc, Value *argv, struct Env *env) {
     if (argc < 1 || texture_count >= MAX_TEXTURES) return value_int(-1);
     
-    const char *filename = argv[0].string->chars;
+    const char *filename = VALUE_AS_STRING(argv[0])->chars;
     FILE *f = fopen(filename, "rb");
     if (!f) return value_int(-1);
     
@@ -977,7 +977,7 @@ Value lib_gui_load_render_texture(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_begin_texture_mode(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < render_texture_count) {
         gl_begin_texture_mode(render_texture_ids[id]);
     }
@@ -991,7 +991,7 @@ Value lib_gui_end_texture_mode(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_draw_render_texture(int argc, Value *argv, struct Env *env) {
     if (argc < 3) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     int x = (int)val_to_double(argv[1]);
     int y = (int)val_to_double(argv[2]);
     
@@ -1003,7 +1003,7 @@ Value lib_gui_draw_render_texture(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_unload_render_texture(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id >= 0 && id < render_texture_count) {
         gl_unload_render_texture(render_texture_ids[id]);
     }
@@ -1012,6 +1012,6 @@ Value lib_gui_unload_render_texture(int argc, Value *argv, struct Env *env) {
 
 Value lib_gui_take_screenshot(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    gl_take_screenshot(argv[0].string->chars);
+    gl_take_screenshot(VALUE_AS_STRING(argv[0])->chars);
     return value_null();
 }
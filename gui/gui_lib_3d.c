@@ -16,27 +16,27 @@
 
 
 static double val3d_to_double(Value v) {
-    if (v.type == VAL_INT) return (double)v.i;
-    if (v.type == VAL_FLOAT) return v.f;
+    if (VALUE_TYPE(v) == VAL_INT) return (double)VALUE_AS_INT(v);
+    if (VALUE_TYPE(v) == VAL_FLOAT) return VALUE_AS_FLOAT(v);
     return 0.0;
 }
 
 static GVec3 val_to_vec3(Value v) {
     GVec3 r = {0, 0, 0};
-    if (v.type != VAL_LIST || v.list->count < 3) return r;
-    r.x = (float)val3d_to_double(v.list->items[0]);
-    r.y = (float)val3d_to_double(v.list->items[1]);
-    r.z = (float)val3d_to_double(v.list->items[2]);
+    if (VALUE_TYPE(v) != VAL_LIST || VALUE_AS_LIST(v)->count < 3) return r;
+    r.x = (float)val3d_to_double(VALUE_AS_LIST(v)->items[0]);
+    r.y = (float)val3d_to_double(VALUE_AS_LIST(v)->items[1]);
+    r.z = (float)val3d_to_double(VALUE_AS_LIST(v)->items[2]);
     return r;
 }
 
 static GColor val3d_to_color(Value v) {
-    if (v.type != VAL_LIST || v.list->count < 3) return (GColor){255, 255, 255, 255};
+    if (VALUE_TYPE(v) != VAL_LIST || VALUE_AS_LIST(v)->count < 3) return (GColor){255, 255, 255, 255};
     GColor c;
-    c.r = (unsigned char)v.list->items[0].i;
-    c.g = (unsigned char)v.list->items[1].i;
-    c.b = (unsigned char)v.list->items[2].i;
-    c.a = (v.list->count > 3) ? (unsigned char)v.list->items[3].i : 255;
+    c.r = (unsigned char)VALUE_AS_INT(VALUE_AS_LIST(v)->items[0]);
+    c.g = (unsigned char)VALUE_AS_INT(VALUE_AS_LIST(v)->items[1]);
+    c.b = (unsigned char)VALUE_AS_INT(VALUE_AS_LIST(v)->items[2]);
+    c.a = (VALUE_AS_LIST(v)->count > 3) ? (unsigned char)VALUE_AS_INT(VALUE_AS_LIST(v)->items[3]) : 255;
     return c;
 }
 
@@ -70,7 +70,7 @@ Value lib_gui_create_camera_3d(int argc, Value *argv, struct Env *env) {
 // update_camera_3d(cam_id, pos, target)
 Value lib_gui_update_camera_3d(int argc, Value *argv, struct Env *env) {
     if (argc < 3) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id < 0 || id >= camera_3d_count) return value_null();
     cameras_3d[id].position = val_to_vec3(argv[1]);
     cameras_3d[id].target = val_to_vec3(argv[2]);
@@ -80,7 +80,7 @@ Value lib_gui_update_camera_3d(int argc, Value *argv, struct Env *env) {
 // update_camera_free(cam_id, speed=4.0, sensitivity=0.003)
 Value lib_gui_update_camera_free(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id < 0 || id >= camera_3d_count) return value_null();
 
     float speed = (argc >= 2) ? (float)val3d_to_double(argv[1]) : 4.0f;
@@ -92,7 +92,7 @@ Value lib_gui_update_camera_free(int argc, Value *argv, struct Env *env) {
 // set_camera_fov(cam_id, fov)
 Value lib_gui_set_camera_fov(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id < 0 || id >= camera_3d_count) return value_null();
     cameras_3d[id].fov = (float)val3d_to_double(argv[1]);
     return value_null();
@@ -109,7 +109,7 @@ Value lib_gui_capture_cursor(int argc, Value *argv, struct Env *env) {
 // begin_mode_3d(cam_id)
 Value lib_gui_begin_mode_3d(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id < 0 || id >= camera_3d_count) return value_null();
     gl3d_begin_mode_3d(cameras_3d[id]);
     return value_null();
@@ -124,7 +124,7 @@ Value lib_gui_end_mode_3d(int argc, Value *argv, struct Env *env) {
 // get_camera_forward(cam_id) → [x, y, z]
 Value lib_gui_get_camera_forward(int argc, Value *argv, struct Env *env) {
     if (argc < 1) return value_null();
-    int id = (int)argv[0].i;
+    int id = (int)VALUE_AS_INT(argv[0]);
     if (id < 0 || id >= camera_3d_count) return value_null();
     GVec3 fwd = vec3_normalize(vec3_sub(cameras_3d[id].target, cameras_3d[id].position));
     return vec3_to_value(fwd);
@@ -160,9 +160,9 @@ Value lib_gui_draw_plane(int argc, Value *argv, struct Env *env) {
     if (argc < 3) return value_null();
     GVec3 center = val_to_vec3(argv[0]);
     GVec2 size;
-    if (argv[1].type == VAL_LIST && argv[1].list->count >= 2) {
-        size.x = (float)val3d_to_double(argv[1].list->items[0]);
-        size.y = (float)val3d_to_double(argv[1].list->items[1]);
+    if (VALUE_TYPE(argv[1]) == VAL_LIST && VALUE_AS_LIST(argv[1])->count >= 2) {
+        size.x = (float)val3d_to_double(VALUE_AS_LIST(argv[1])->items[0]);
+        size.y = (float)val3d_to_double(VALUE_AS_LIST(argv[1])->items[1]);
     } else {
         float s = (float)val3d_to_double(argv[1]);
         size.x = s; size.y = s;
@@ -217,28 +217,28 @@ Value lib_gui_create_light(int argc, Value *argv, struct Env *env) {
 // set_light_enabled(light_id, enabled)
 Value lib_gui_set_light_enabled(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_null();
-    gl3d_set_light_enabled((int)argv[0].i, (int)val3d_to_double(argv[1]));
+    gl3d_set_light_enabled((int)VALUE_AS_INT(argv[0]), (int)val3d_to_double(argv[1]));
     return value_null();
 }
 
 // set_light_color(light_id, color)
 Value lib_gui_set_light_color(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_null();
-    gl3d_set_light_color((int)argv[0].i, val3d_to_color(argv[1]));
+    gl3d_set_light_color((int)VALUE_AS_INT(argv[0]), val3d_to_color(argv[1]));
     return value_null();
 }
 
 // set_light_position(light_id, pos)
 Value lib_gui_set_light_position(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_null();
-    gl3d_set_light_position((int)argv[0].i, val_to_vec3(argv[1]));
+    gl3d_set_light_position((int)VALUE_AS_INT(argv[0]), val_to_vec3(argv[1]));
     return value_null();
 }
 
 // set_light_intensity(light_id, value)
 Value lib_gui_set_light_intensity(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_null();
-    gl3d_set_light_intensity((int)argv[0].i, (float)val3d_to_double(argv[1]));
+    gl3d_set_light_intensity((int)VALUE_AS_INT(argv[0]), (float)val3d_to_double(argv[1]));
     return value_null();
 }
 
@@ -254,23 +254,23 @@ Value lib_gui_set_ambient_light(int argc, Value *argv, struct Env *env) {
 // box = [min_x, min_y, min_z, max_x, max_y, max_z]
 Value lib_gui_check_collision_boxes(int argc, Value *argv, struct Env *env) {
     if (argc < 2) return value_bool(0);
-    if (argv[0].type != VAL_LIST || argv[0].list->count < 6) return value_bool(0);
-    if (argv[1].type != VAL_LIST || argv[1].list->count < 6) return value_bool(0);
+    if (VALUE_TYPE(argv[0]) != VAL_LIST || VALUE_AS_LIST(argv[0])->count < 6) return value_bool(0);
+    if (VALUE_TYPE(argv[1]) != VAL_LIST || VALUE_AS_LIST(argv[1])->count < 6) return value_bool(0);
 
     GBoundingBox a, b;
-    a.min.x = (float)val3d_to_double(argv[0].list->items[0]);
-    a.min.y = (float)val3d_to_double(argv[0].list->items[1]);
-    a.min.z = (float)val3d_to_double(argv[0].list->items[2]);
-    a.max.x = (float)val3d_to_double(argv[0].list->items[3]);
-    a.max.y = (float)val3d_to_double(argv[0].list->items[4]);
-    a.max.z = (float)val3d_to_double(argv[0].list->items[5]);
-
-    b.min.x = (float)val3d_to_double(argv[1].list->items[0]);
-    b.min.y = (float)val3d_to_double(argv[1].list->items[1]);
-    b.min.z = (float)val3d_to_double(argv[1].list->items[2]);
-    b.max.x = (float)val3d_to_double(argv[1].list->items[3]);
-    b.max.y = (float)val3d_to_double(argv[1].list->items[4]);
-    b.max.z = (float)val3d_to_double(argv[1].list->items[5]);
+    a.min.x = (float)val3d_to_double(VALUE_AS_LIST(argv[0])->items[0]);
+    a.min.y = (float)val3d_to_double(VALUE_AS_LIST(argv[0])->items[1]);
+    a.min.z = (float)val3d_to_double(VALUE_AS_LIST(argv[0])->items[2]);
+    a.max.x = (float)val3d_to_double(VALUE_AS_LIST(argv[0])->items[3]);
+    a.max.y = (float)val3d_to_double(VALUE_AS_LIST(argv[0])->items[4]);
+    a.max.z = (float)val3d_to_double(VALUE_AS_LIST(argv[0])->items[5]);
+
+    b.min.x = (float)val3d_to_double(VALUE_AS_LIST(argv[1])->items[0]);
+    b.min.y = (float)val3d_to_double(VALUE_AS_LIST(argv[1])->items[1]);
+    b.min.z = (float)val3d_to_double(VALUE_AS_LIST(argv[1])->items[2]);
+    b.max.x = (float)val3d_to_double(VALUE_AS_LIST(argv[1])->items[3]);
+    b.max.y = (float)val3d_to_double(VALUE_AS_LIST(argv[1])->items[4]);
+    b.max.z = (float)val3d_to_double(VALUE_AS_LIST(argv[1])->items[5]);
 
     return value_bool(gl3d_check_collision_boxes(a, b));
 }
@@ -126,23 +126,30 @@ struct AstNode {
             NodeList args;
         } typed_init;
         struct { AstNode *size; } box_alloc;
-        // Fast Local Caches for Identifier Binding (O(0) Lookups inside loops)
+        // Fast Local Caches for Identifier Binding (O(0) Lookups inside loops);
+        // a new scope goes back to the (hops, slot) the name resolved to last
         struct { 
             const char *name;
             Value *cached_val; // Points directly to Environment slot
             uint64_t cached_env_version;
+            int cached_hops;
+            int cached_slot;
         } ident;
         
         struct { 
             const char *name; 
             Value *cached_val;
             uint64_t cached_env_version;
+            int cached_hops;
+            int cached_slot;
         } inc;
         
         struct { 
             const char *name; 
             Value *cached_val;
             uint64_t cached_env_version;
+            int cached_hops;
+            int cached_slot;
         } dec; // for NODE_DEC
 
         struct { BinOpKind op; AstNode *left; AstNode *right; } binop;
@@ -152,6 +159,8 @@ struct AstNode {
             AstNode *expr; 
             Value *cached_val;
             uint64_t cached_env_version;
+            int cached_hops;
+            int cached_slot;
         } assign;
         struct { AstNode *list; AstNode *index; AstNode *value; } assign_index; 
         struct { AstNode *target; AstNode *index; } index; 
@@ -191,7 +200,12 @@ struct AstNode {
 
         struct { AstNode *value; NodeList body; } casestmt;
         struct { NodeList items; } block;
-        struct { AstNode *callee; NodeList args; CallKind kind; } call;
+        struct {
+            AstNode *callee;
+            NodeList args;
+            CallKind kind;
+            int ident_args; // bare-identifier args, which natives get by reference
+        } call;
         struct {
             char *path;
             const char **names;
@@ -205,8 +219,14 @@ struct AstNode {
             const char **params;
             AstNode **defaults;
             int param_count;
+            int required_count; // params without a default
             NodeList body;
             int is_export;
+            // Names the body and defaults refer to, minus the parameters
+            // (nested functions contribute theirs). The interpreter copies
+            // only these into a closure; see env_capture.
+            const char **captures;
+            int capture_count;
         } funcdef;
 
         struct {
@@ -281,4 +301,11 @@ void ast_release(AstNode *node);
 void ast_init(void);
 void ast_cleanup(void);
 
+// Nodes come from the calling thread's arena (ast_arena is thread-local).
+// ast_use_new_arena gives the thread a fresh arena, kept until ast_cleanup,
+// and returns the one it replaced for ast_restore_arena; import prefetch
+// workers parse this way.
+struct Arena *ast_use_new_arena(void);
+void ast_restore_arena(struct Arena *prev);
+
 #endif
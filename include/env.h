@@ -12,11 +12,15 @@
 // Opaque type for the Environment
 typedef struct Env Env;
 
+// Binding epoch: bumped whenever a binding is added to or removed from any
+// environment. VM inline caches hold raw Value* slots and compare against
+// this to know the slot (and the chain lookup that produced it) is still valid.
+extern uint64_t env_binding_epoch;
+
 // Scope Management
 Env *env_create(Env *parent);
 void env_free(Env *e);
-Env *env_snapshot(Env *e);
-void env_free_chain(Env *e);
+Env *env_capture(Env *e, const char **names, int count); // flat closure record, parent = root
 void env_clear_locals(Env *e);
 uint64_t env_get_version(Env *e);
 void env_reset_version(Env *e);  // bump version after TCO rebind
@@ -32,6 +36,7 @@ void env_free_global(Env *e);
 Value *env_get(Env *e, const char *name);
 Value *env_get_local(Env *e, const char *name);
 Value *env_get_text(Env *e, const char *name);
+Value *env_get_local_writable(Env *e, const char *name); // NULL if missing or const
 void env_def(Env *e, const char *name, Value val);
 void env_def_move(Env *e, const char *name, Value *val);   // move variant (takes ownership)
 void env_def_const(Env *e, const char *name, Value val);
@@ -40,6 +45,14 @@ void env_assign(Env *e, const char *name, Value val);
 void env_assign_move(Env *e, const char *name, Value *val); // move variant (takes ownership)
 int env_has_local(Env *e, const char *name);
 
+// Slot addressing. A binding keeps its slot until its scope is cleared or
+// freed, so a lookup site can remember where a name was found (hops up the
+// parent chain, then slot) and go straight back there. env_resolve looks the
+// name up and fills both; env_at returns NULL unless that slot still holds
+// name.
+Value *env_resolve(Env *e, const char *name, int *hops, int *slot);
+Value *env_at(Env *e, const char *name, int hops, int slot);
+
 // Function Definition Management
 void env_def_func(Env *e, const char *name, AstNode *def);
 AstNode *env_get_func(Env *e, const char *name);
@@ -174,6 +174,10 @@ void        luna_gc_runtime_shutdown(void);
 int         luna_gc_runtime_enabled(void);
 GCHeap     *luna_gc_runtime_heap(void);
 void       *luna_gc_alloc(size_t size, GCTracer trace, GCFinalizer fin);
+/* While shared, luna_gc_alloc serialises allocations so several threads can
+ * compile at once (import prefetch). Nothing collects in the meantime: the
+ * main thread waits outside any safe point. */
+void        luna_gc_runtime_set_shared(int shared);
 void        luna_gc_runtime_safe_point(void);
 void        luna_gc_runtime_set_root_marker(GCRootMarker marker, void *ctx);
 void        luna_gc_runtime_add_root(void *payload);
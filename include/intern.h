@@ -4,6 +4,8 @@
 #ifndef INTERN_H
 #define INTERN_H
 
+#include <stddef.h>
+
 // Initializes the global string interning hash set
 void intern_init(void);
 
@@ -12,6 +14,9 @@ void intern_init(void);
 // If it does not exist, copies the string into the intern table and returns the new pointer.
 const char *intern_string(const char *str);
 
+// Same, for the first len bytes of str (which need not be NUL-terminated)
+const char *intern_string_n(const char *str, size_t len);
+
 // Frees all strings in the intern table and the table itself
 void intern_free_all(void);
 
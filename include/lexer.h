@@ -19,5 +19,6 @@ typedef struct {
 Lexer lexer_create(const char *source);
 Token lexer_next(Lexer *L);
 void free_token(Token *t);
+char *token_dup(const Token *t); // malloc'd, NUL-terminated copy of the text
 
 #endif
@@ -14,4 +14,22 @@
 // into the given environment so they can be called from Luna scripts.
 void env_register_stdlib(Env *env);
 
+// Builtins the VM compiler calls with VM_OP_CALL_NATIVE instead of a global
+// load and a generic call. argc is the argument count the entry applies to;
+// calls with any other count compile normally and get fn's own error. When
+// unary is set, an int or float argument is handed to it directly and the
+// result boxed as a float, or as an int when int_result is set.
+typedef struct {
+    const char *name;
+    NativeFunc fn;
+    int argc;
+    double (*unary)(double);
+    int int_result;
+} LunaNativeDef;
+
+extern const LunaNativeDef luna_native_defs[];
+
+// Index into luna_native_defs for a call to name with argc arguments, or -1.
+int luna_native_lookup(const char *name, int argc);
+
 #endif
\ No newline at end of file
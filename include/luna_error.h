@@ -40,7 +40,11 @@ typedef struct {
 void error_init(const char *source, const char *filename);
 void error_clear_last(void);
 int error_get_last(LunaErrorInfo *out);
+// Quiet mode is per thread: errors are only recorded for error_get_last() and
+// error_failed(), and luna_had_error is left alone. Import prefetch workers
+// compile in it beside the main thread.
 void error_set_quiet(int quiet);
+int error_failed(void); // luna_had_error, or this thread's quiet error
 
 // Report an error with line/column info and suggestions
 void error_report(ErrorType type, int line, int col, const char *message, const char *suggestion);
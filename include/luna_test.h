@@ -14,6 +14,7 @@ typedef struct {
     size_t count;
 } LunaTokenBuffer;
 
+// Tokens view into source, which must outlive the buffer
 int luna_lex_source(const char *source, LunaTokenBuffer *out_tokens);
 void luna_token_buffer_free(LunaTokenBuffer *buffer);
 
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#ifndef MODULE_CACHE_H
+#define MODULE_CACHE_H
+
+#include "env.h"
+
+// A module that has been loaded and executed once. Its top-level env stays
+// alive (and so stays a GC root) for the rest of the run; later imports of
+// the same file bind straight from it instead of re-running the module.
+typedef struct {
+    const char  *path;          // canonical path, interned
+    Env         *env;
+    const char **exports;       // interned names of `export` declarations
+    int          export_count;
+    long long    mtime_ns;      // file mtime when loaded
+} LunaModule;
+
+// Registry key for path: its canonical path, interned.
+const char *module_cache_key(const char *path);
+
+// Returns the cached module for path, or NULL when it has not been loaded
+// yet. With LUNA_MODULE_RELOAD=1 a module whose file changed since it was
+// loaded is dropped from the registry and NULL is returned, so it reloads.
+LunaModule *module_cache_get(const char *path);
+
+// Registers env as the module for path before its body runs, so an import
+// cycle sees the partially initialised module instead of recursing. The
+// export names are copied.
+LunaModule *module_cache_add(const char *path, Env *env, const char **exports, int export_count);
+
+// Forgets a module whose body failed; the env is left to the caller.
+void module_cache_remove(LunaModule *module);
+
+#endif
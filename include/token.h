@@ -82,21 +82,26 @@ typedef enum {
     T_INVALID
 } TokenType;
 
-#define TOKEN_INLINE_MAX 24
-
+// A token's text is a (start, length) view, usually straight into the source
+// buffer, which must outlive the tokens. Two kinds differ:
+//   T_IDENT  - start is the interned name: NUL-terminated, compare by pointer.
+//   T_STRING - the literal's contents without quotes. A view when it has no
+//              escapes, otherwise a heap buffer with escapes resolved (owned).
+// Nothing else is NUL-terminated; use token_dup for a C string.
 typedef struct {
     TokenType type;
-    char *lexeme;                  // heap-allocated, or NULL if inline
-    char ibuf[TOKEN_INLINE_MAX];   // inline buffer for short lexemes
-    long long number;
+    const char *start;
+    int length;
+    int owned;        // start is a heap buffer freed by free_token
+    long long number; // T_NUMBER value, T_CHAR character
     double fnumber;
     int line;
     int col;
 } Token;
 
-// Get the lexeme string — works for both inline and heap tokens
-static inline const char *token_str(const Token *t) {
-    return t->lexeme ? t->lexeme : t->ibuf;
+// Interned name of a T_IDENT token
+static inline const char *token_ident(const Token *t) {
+    return t->start;
 }
 
 // Returns the string representation of a token type
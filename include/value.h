@@ -6,10 +6,12 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 typedef struct Value Value; // Forward decl
 typedef struct BlocTypeDesc BlocTypeDesc;
 typedef struct TemplateObj TemplateObj;
+typedef struct RangeObj RangeObj;
 
 // Forward declaration for Environment and AstNode to avoid circular dependencies
 struct Env;
@@ -38,13 +40,9 @@ typedef enum {
     VAL_VM_CLOSURE,
     VAL_DATA_TYPE,
     VAL_TEMPLATE,
+    VAL_RANGE,      // Lazy integer sequence returned by range()
 } ValueType;
 
-#define VALUE_IS_HEAP(v) \
-    ((v).type == VAL_STRING || (v).type == VAL_LIST || (v).type == VAL_DENSE_LIST || \
-     (v).type == VAL_MAP || (v).type == VAL_CLOSURE || (v).type == VAL_VM_CLOSURE || \
-     (v).type == VAL_DATA_TYPE || (v).type == VAL_BLOC || (v).type == VAL_TEMPLATE)
-
 typedef struct {
     int ref_count;
     char *chars;
@@ -88,6 +86,8 @@ typedef struct {
     struct LunaChunk *chunk;
     struct VMUpvalue **upvalues;
     int upvalue_count;
+    struct VMUpvalue *flat; // closed-over copies, in the same allocation as upvalues
+    int flat_count;
 } VMClosureObj;
 
 typedef struct {
@@ -108,6 +108,164 @@ typedef struct {
     uint64_t handle;
 } BoxValue;
 
+#ifdef LUNA_NANBOX
+// Represents a runtime value in the language (`make NANBOX=1`): one 64-bit
+// word. Doubles are stored as their IEEE bits (NaNs canonicalized); every
+// other type lives in the NaN space with a 17-bit tag above a 47-bit payload.
+// Ints take the two tags with a zero top half, so they carry 48 bits; larger
+// ints are boxed on the heap. The word is stored XORed with VALUE_NANBOX_XOR,
+// which puts the int tag at zero: zeroed memory reads as the int 0 in both modes.
+struct Value {
+    uint64_t bits;
+};
+
+#define VALUE_NANBOX_XOR     0xFFFF000000000000ULL
+#define VALUE_NANBOX_PAYLOAD 0x00007FFFFFFFFFFFULL
+#define VALUE_NANBOX_INT_MIN (-(1LL << 47))
+#define VALUE_NANBOX_INT_MAX ((1LL << 47) - 1)
+
+// Tags (bits >> 47). Heap types take the tags with the top bit set, so
+// VALUE_IS_HEAP is one compare; 0x10-0x1F and 0x1000E and up are doubles.
+enum {
+    VALUE_TAG_POINTER    = 0x2,     // and 0x3: the full 48-bit address
+    VALUE_TAG_CHAR       = 0x4,
+    VALUE_TAG_BOOL       = 0x5,
+    VALUE_TAG_NULL       = 0x6,
+    VALUE_TAG_BLOC_TYPE  = 0x7,
+    VALUE_TAG_BOX        = 0x8,
+    VALUE_TAG_NATIVE     = 0x9,
+    VALUE_TAG_FILE       = 0xA,
+    VALUE_TAG_FUNCTION   = 0xB,
+    VALUE_TAG_STRING     = 0x10000,
+    VALUE_TAG_LIST,
+    VALUE_TAG_DENSE_LIST,
+    VALUE_TAG_MAP,
+    VALUE_TAG_CLOSURE,
+    VALUE_TAG_VM_CLOSURE,
+    VALUE_TAG_DATA_TYPE,
+    VALUE_TAG_BLOC,
+    VALUE_TAG_TEMPLATE,
+    VALUE_TAG_RANGE,
+    VALUE_TAG_BIG_INT,              // int outside 48 bits, payload is its BigIntObj
+};
+
+static const uint32_t value_nanbox_tag_of[] = {
+    [VAL_POINTER] = VALUE_TAG_POINTER,       [VAL_CHAR] = VALUE_TAG_CHAR,
+    [VAL_BOOL] = VALUE_TAG_BOOL,             [VAL_NULL] = VALUE_TAG_NULL,
+    [VAL_BLOC_TYPE] = VALUE_TAG_BLOC_TYPE,   [VAL_BOX] = VALUE_TAG_BOX,
+    [VAL_NATIVE] = VALUE_TAG_NATIVE,         [VAL_FILE] = VALUE_TAG_FILE,
+    [VAL_FUNCTION] = VALUE_TAG_FUNCTION,     [VAL_STRING] = VALUE_TAG_STRING,
+    [VAL_LIST] = VALUE_TAG_LIST,             [VAL_DENSE_LIST] = VALUE_TAG_DENSE_LIST,
+    [VAL_MAP] = VALUE_TAG_MAP,               [VAL_CLOSURE] = VALUE_TAG_CLOSURE,
+    [VAL_VM_CLOSURE] = VALUE_TAG_VM_CLOSURE, [VAL_DATA_TYPE] = VALUE_TAG_DATA_TYPE,
+    [VAL_BLOC] = VALUE_TAG_BLOC,             [VAL_TEMPLATE] = VALUE_TAG_TEMPLATE,
+    [VAL_RANGE] = VALUE_TAG_RANGE,
+};
+
+// Types of tags 0x0-0xD (low half) and 0x10000-0x1000D (high half).
+static const uint8_t value_nanbox_type_of[2][14] = {
+    { VAL_INT, VAL_INT, VAL_POINTER, VAL_POINTER, VAL_CHAR, VAL_BOOL, VAL_NULL,
+      VAL_BLOC_TYPE, VAL_BOX, VAL_NATIVE, VAL_FILE, VAL_FUNCTION, VAL_FLOAT, VAL_FLOAT },
+    { VAL_STRING, VAL_LIST, VAL_DENSE_LIST, VAL_MAP, VAL_CLOSURE, VAL_VM_CLOSURE,
+      VAL_DATA_TYPE, VAL_BLOC, VAL_TEMPLATE, VAL_RANGE, VAL_INT, VAL_FLOAT, VAL_FLOAT, VAL_FLOAT },
+};
+
+static inline ValueType value_type(Value v) {
+    uint64_t tag = v.bits >> 47;
+    if (tag < 2) return VAL_INT;
+    if (tag < 14) return (ValueType)value_nanbox_type_of[0][tag];
+    if (tag - 0x10000 < 14) return (ValueType)value_nanbox_type_of[1][tag - 0x10000];
+    return VAL_FLOAT;
+}
+
+// Payload of a pointer, handle, char or bool value.
+static inline uint64_t value_payload(Value v) {
+    return v.bits & VALUE_NANBOX_PAYLOAD;
+}
+
+static inline Value value_make(ValueType type, uint64_t payload) {
+    Value v;
+    v.bits = ((uint64_t)value_nanbox_tag_of[type] << 47) | payload;
+    return v;
+}
+
+// An int outside 48 bits. Heap-tagged, so it is collected (or ref counted)
+// like a string.
+typedef struct {
+    int ref_count;
+    long long value;
+} BigIntObj;
+
+Value value_int_boxed(long long x);
+long long value_int_unboxed(Value v); // big ints; the payload of anything else
+
+static inline Value value_int(long long x) {
+    if (x < VALUE_NANBOX_INT_MIN || x > VALUE_NANBOX_INT_MAX) return value_int_boxed(x);
+    Value v;
+    v.bits = (uint64_t)x & 0x0000FFFFFFFFFFFFULL;
+    return v;
+}
+
+static inline long long value_as_int(Value v) {
+    if ((v.bits >> 48) == 0) return (long long)(v.bits << 16) >> 16;
+    return value_int_unboxed(v);
+}
+
+static inline Value value_float(double x) {
+    Value v;
+    if (x != x) {
+        v.bits = 0x7FF8000000000000ULL ^ VALUE_NANBOX_XOR;
+    } else {
+        memcpy(&v.bits, &x, sizeof(x));
+        v.bits ^= VALUE_NANBOX_XOR;
+    }
+    return v;
+}
+
+static inline double value_as_float(Value v) {
+    uint64_t bits = v.bits ^ VALUE_NANBOX_XOR;
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+static inline Value value_char(char c) { return value_make(VAL_CHAR, (unsigned char)c); }
+static inline Value value_bool(int b) { return value_make(VAL_BOOL, b != 0); }
+static inline Value value_null(void) { return value_make(VAL_NULL, 0); }
+
+static inline Value value_pointer(uintptr_t ptr) {
+    Value v;
+    v.bits = ((uint64_t)VALUE_TAG_POINTER << 47) | ((uint64_t)ptr & 0x0000FFFFFFFFFFFFULL);
+    return v;
+}
+
+#define VALUE_IS_HEAP(v) (((v).bits >> 48) - 0x8000u < 7)
+#define VALUE_TYPE(v)          value_type(v)
+#define VALUE_AS_INT(v)        value_as_int(v)
+#define VALUE_AS_FLOAT(v)      value_as_float(v)
+#define VALUE_AS_CHAR(v)       ((char)value_payload(v))
+#define VALUE_AS_BOOL(v)       ((int)(value_payload(v) & 1))
+#define VALUE_AS_PTR(v)        ((uintptr_t)((v).bits & 0x0000FFFFFFFFFFFFULL))
+#define VALUE_AS_BLOC_TYPE(v)  ((BlocTypeDesc *)(uintptr_t)value_payload(v))
+#define VALUE_AS_BLOC(v)       ((BlocValue){ value_payload(v) })
+#define VALUE_AS_BOX(v)        ((BoxValue){ value_payload(v) })
+#define VALUE_AS_NATIVE(v)     ((void *)(uintptr_t)value_payload(v))
+#define VALUE_AS_FILE(v)       ((FILE *)(uintptr_t)value_payload(v))
+#define VALUE_AS_STRING(v)     ((StringObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_LIST(v)       ((ListObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_DLIST(v)      ((DenseListObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_MAP(v)        ((MapObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_CLOSURE(v)    ((ClosureObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_VM_CLOSURE(v) ((VMClosureObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_DTYPE(v)      ((DataTypeObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_TEMPLATE(v)   ((TemplateObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_RANGE(v)      ((RangeObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_BIG_INT(v)    ((BigIntObj *)(uintptr_t)value_payload(v))
+#define VALUE_AS_FUNC(v)       ((struct AstNode *)(uintptr_t)value_payload(v))
+// In-place update of a slot that already holds an int (float).
+#define VALUE_SET_INT(p, x)    (*(p) = value_int(x))
+#define VALUE_SET_FLOAT(p, x)  (*(p) = value_float(x))
+#else
 // Represents a runtime value in the language
 struct Value {
     ValueType type;
@@ -130,32 +288,122 @@ struct Value {
         VMClosureObj *vm_closure;
         DataTypeObj *dtype;
         TemplateObj *template_obj;
+        RangeObj *range;
         struct AstNode *func; // AST Pointer for user-defined functions
     };
 };
 
+// Pointer and handle types: the object (or handle) as a 64-bit payload.
+static inline Value value_make(ValueType type, uint64_t payload) {
+    Value v;
+    v.type = type;
+    v.ptr = (uintptr_t)payload;
+    return v;
+}
+
+static inline Value value_int(long long x) {
+    Value v;
+    v.type = VAL_INT;
+    v.i = x;
+    return v;
+}
+
+static inline Value value_float(double x) {
+    Value v;
+    v.type = VAL_FLOAT;
+    v.f = x;
+    return v;
+}
+
+static inline Value value_char(char c) {
+    Value v;
+    v.type = VAL_CHAR;
+    v.c = c;
+    return v;
+}
+
+static inline Value value_bool(int b) {
+    Value v;
+    v.type = VAL_BOOL;
+    v.b = !!b; // Ensure 0 or 1
+    return v;
+}
+
+static inline Value value_null(void) {
+    Value v;
+    v.type = VAL_NULL;
+    v.i = 0;
+    return v;
+}
+
+static inline Value value_pointer(uintptr_t ptr) {
+    Value v;
+    v.type = VAL_POINTER;
+    v.ptr = ptr;
+    return v;
+}
+
+#define VALUE_IS_HEAP(v) \
+    ((v).type == VAL_STRING || (v).type == VAL_LIST || (v).type == VAL_DENSE_LIST || \
+     (v).type == VAL_MAP || (v).type == VAL_CLOSURE || (v).type == VAL_VM_CLOSURE || \
+     (v).type == VAL_DATA_TYPE || (v).type == VAL_BLOC || (v).type == VAL_TEMPLATE || \
+     (v).type == VAL_RANGE)
+#define VALUE_TYPE(v)          ((v).type)
+#define VALUE_AS_INT(v)        ((v).i)
+#define VALUE_AS_FLOAT(v)      ((v).f)
+#define VALUE_AS_CHAR(v)       ((v).c)
+#define VALUE_AS_BOOL(v)       ((v).b)
+#define VALUE_AS_PTR(v)        ((v).ptr)
+#define VALUE_AS_BLOC_TYPE(v)  ((v).bloc_type)
+#define VALUE_AS_BLOC(v)       ((v).bloc)
+#define VALUE_AS_BOX(v)        ((v).box)
+#define VALUE_AS_NATIVE(v)     ((v).native)
+#define VALUE_AS_FILE(v)       ((v).file)
+#define VALUE_AS_STRING(v)     ((v).string)
+#define VALUE_AS_LIST(v)       ((v).list)
+#define VALUE_AS_DLIST(v)      ((v).dlist)
+#define VALUE_AS_MAP(v)        ((v).map)
+#define VALUE_AS_CLOSURE(v)    ((v).closure)
+#define VALUE_AS_VM_CLOSURE(v) ((v).vm_closure)
+#define VALUE_AS_DTYPE(v)      ((v).dtype)
+#define VALUE_AS_TEMPLATE(v)   ((v).template_obj)
+#define VALUE_AS_RANGE(v)      ((v).range)
+#define VALUE_AS_FUNC(v)       ((v).func)
+#define VALUE_SET_INT(p, x)    ((p)->i = (x))
+#define VALUE_SET_FLOAT(p, x)  ((p)->f = (x))
+#endif
+
+// range(start, end, step) without the list: element i is start + i * step.
+// step is never 0. The first write (append, index store) builds the list in
+// `list`; from then on every holder of the range reads that list instead.
+struct RangeObj {
+    int ref_count;
+    long long start;
+    long long end;
+    long long step;
+    Value list; // VAL_NULL until materialized
+};
+
+// Open-addressed slot; key is NULL for an empty slot. Keeping occupancy in
+// the key holds an entry to 24 bytes instead of 32.
 struct MapEntry {
     const char *key;
     Value value;
-    int occupied;
 };
 
 typedef Value (*NativeFunc)(int argc, Value *argv, struct Env *env);
 
 // Constructors
-Value value_int(long long x); 
-Value value_float(double x);
 Value value_string(const char *s);
 Value value_string_len(const char *s, size_t len);
 Value value_string_concat_raw(const char *left, size_t left_len, const char *right, size_t right_len);
+Value value_string_join_raw(const char *const *parts, const size_t *lens, int count); // One allocation for all parts
 Value value_string_repeat_raw(const char *s, size_t len, size_t count);
-Value value_char(char c); 
-Value value_bool(int b);
-Value value_pointer(uintptr_t ptr);
 Value value_bloc_type(const char *name, const char **fields, int field_count);
 int value_bloc_check_construct(Value descriptor, int argc, Value *argv, char *msg, size_t msg_len);
 Value value_bloc_construct(Value descriptor, int argc, Value *argv);
 Value value_bloc_get_field(Value bloc, const char *field, int *found);
+Value value_bloc_get_index(Value bloc, int idx);
 const char *value_bloc_name(Value v);
 int value_bloc_equal(Value left, Value right);
 Value value_box(size_t size, char *msg, size_t msg_len);
@@ -169,18 +417,30 @@ void value_box_promote_to_template(Value box);
 Value value_list(void);
 Value value_dense_list(void); // Constructor for dense arrays
 Value value_map(void);
+Value value_range(long long start, long long end, long long step);
+long long value_range_len(const RangeObj *range);
+Value value_range_get(const RangeObj *range, long long idx); // negative idx counts from the end
+void value_range_materialize(Value *v); // Replaces a range with its (shared) list
 Value value_closure(struct AstNode *funcdef, struct Env *env, int owns_env);
-Value value_vm_closure(struct LunaChunk *chunk, int upvalue_count);
+Value value_vm_closure(struct LunaChunk *chunk, int upvalue_count, int flat_count);
 Value value_data_type(const char *name, const char **fields, int field_count, int is_template);
 Value value_template_from_dtype(Value dtype, int argc, Value *argv, char *msg, size_t msg_len);
 Value value_template_get_field(Value template_value, const char *field, int *found);
 Value *value_template_field_slot(Value *template_value, const char *field);
 int value_template_set_field(Value *template_value, const char *field, Value *rhs, char *msg, size_t msg_len);
+Value value_template_get_index(Value template_value, int idx);
+int value_template_set_index(Value *template_value, int idx, Value *rhs);
+
+// Field layout shared by all templates/blocs of one type: the DataTypeObj or
+// BlocTypeDesc (NULL for other values). A field's index is fixed per shape.
+// value_shape_epoch changes whenever a shape is freed.
+extern uint64_t value_shape_epoch;
+const void *value_field_shape(Value v);
+int value_field_index(Value v, const char *field); // -1 if missing
 const char *value_template_name(Value v);
 int value_template_len(Value v);
 Value value_native(NativeFunc fn); 
 Value value_file(FILE *f);
-Value value_null(void);
 
 // Ref-count slow path for heap types (string, list, dense_list)
 void _value_free_refcount(Value v);
@@ -200,12 +460,17 @@ static inline Value value_copy(Value v) {
 // Transfers ownership of a value. Nulls out the source to prevent double-free.
 static inline Value value_move(Value *v) {
     Value tmp = *v;
-    v->type = VAL_NULL;
+    *v = value_null();
     return tmp;
 }
 
 // Utils
 char *value_to_string(Value v);
+#define VALUE_SCRATCH_LEN 64
+// value_to_string without the copy: a string's own chars, or ints, floats,
+// chars and bools formatted into scratch (VALUE_SCRATCH_LEN bytes). Anything
+// else falls back to value_to_string and *owned must be freed by the caller.
+const char *value_string_view(Value v, char *scratch, size_t *len, char **owned);
 void value_fprint(FILE *f, Value v); // Zero-alloc print directly to file stream
 void value_list_append(Value *list, Value v); 
 void value_list_append_move(Value *list, Value *v); // Move variant, takes ownership
@@ -213,6 +478,7 @@ void value_dlist_append(Value *list, double v); // Append to dense list
 void value_map_set(Value *map, const char *key, Value v);
 void value_map_set_move(Value *map, const char *key, Value *v);
 Value *value_map_get(Value *map, const char *key);
+Value *value_map_get_hinted(Value *map, const char *key, int *hint);
 int value_map_has(Value *map, const char *key);
 int value_map_delete(Value *map, const char *key);
 Value value_map_keys(Value map);
@@ -220,4 +486,49 @@ Value value_map_values(Value map);
 Value value_map_items(Value map);
 void value_gc_mark(Value *value, void *ctx);
 
+// Iteration step shared by for-in in the interpreter and the VM. *state is 0
+// before the first call. Stores the next element in *out and returns 1, or
+// returns 0 once the iterable is exhausted and -1 if it cannot be iterated.
+// Lists, dense lists and ranges yield elements, strings yield chars and maps
+// yield keys. Lists and maps may grow during the loop: bounds are re-read
+// on every step.
+static inline int value_iter_next(Value iterable, long long *state, Value *out) {
+    long long i = *state;
+    switch (VALUE_TYPE(iterable)) {
+        case VAL_LIST:
+            if (!VALUE_AS_LIST(iterable) || i >= VALUE_AS_LIST(iterable)->count) return 0;
+            *out = value_copy(VALUE_AS_LIST(iterable)->items[i]);
+            break;
+        case VAL_RANGE: {
+            const RangeObj *r = VALUE_AS_RANGE(iterable);
+            if (VALUE_TYPE(r->list) == VAL_LIST) return value_iter_next(r->list, state, out);
+            long long v = r->start + i * r->step;
+            if (r->step > 0 ? v >= r->end : v <= r->end) return 0;
+            *out = value_int(v);
+            break;
+        }
+        case VAL_DENSE_LIST:
+            if (!VALUE_AS_DLIST(iterable) || i >= VALUE_AS_DLIST(iterable)->count) return 0;
+            *out = value_float(VALUE_AS_DLIST(iterable)->data[i]);
+            break;
+        case VAL_STRING:
+            if (!VALUE_AS_STRING(iterable) || VALUE_AS_STRING(iterable)->chars[i] == '\0') return 0;
+            *out = value_char(VALUE_AS_STRING(iterable)->chars[i]);
+            break;
+        case VAL_MAP:
+            if (!VALUE_AS_MAP(iterable)) return 0;
+            while (i < VALUE_AS_MAP(iterable)->capacity && !VALUE_AS_MAP(iterable)->entries[i].key) i++;
+            if (i >= VALUE_AS_MAP(iterable)->capacity) {
+                *state = i;
+                return 0;
+            }
+            *out = value_string(VALUE_AS_MAP(iterable)->entries[i].key);
+            break;
+        default:
+            return -1;
+    }
+    *state = i + 1;
+    return 1;
+}
+
 #endif
\ No newline at end of file
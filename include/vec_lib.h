@@ -9,6 +9,10 @@
 // Forward declaration
 struct Env;
 
+// Operands of the vector operators (`+`, `-`, `*`, `/` between lists)
+#define VEC_IS_OPERAND(v) \
+    (VALUE_TYPE(v) == VAL_LIST || VALUE_TYPE(v) == VAL_DENSE_LIST || VALUE_TYPE(v) == VAL_RANGE)
+
 // Exposed logic for internal interpreter use (SIMD operations)
 Value vec_add_values(Value a, Value b);
 Value vec_sub_values(Value a, Value b);
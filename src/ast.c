@@ -8,7 +8,27 @@
 #include "arena.h"
 #include "intern.h"
 
-Arena *ast_arena = NULL;
+_Thread_local Arena *ast_arena = NULL;
+
+// Every arena handed out, so ast_cleanup frees the workers' arenas too
+static Arena **ast_arenas = NULL;
+static int ast_arena_count = 0;
+static int ast_arena_capacity = 0;
+
+static Arena *ast_arena_new(size_t size) {
+    Arena *arena = arena_create(size);
+    if (!arena) abort();
+    #pragma omp critical(luna_ast_arenas)
+    {
+        if (ast_arena_count == ast_arena_capacity) {
+            ast_arena_capacity = ast_arena_capacity < 8 ? 8 : ast_arena_capacity * 2;
+            ast_arenas = realloc(ast_arenas, sizeof(Arena *) * (size_t)ast_arena_capacity);
+            if (!ast_arenas) abort();
+        }
+        ast_arenas[ast_arena_count++] = arena;
+    }
+    return arena;
+}
 
 static CallKind classify_call(AstNode *callee) {
     if (!callee || callee->kind != NODE_IDENT) return CALL_GENERIC;
@@ -268,6 +288,9 @@ AstNode *ast_call(AstNode *callee, NodeList args, int line) {
     n->call.callee = callee;
     n->call.args = args;
     n->call.kind = classify_call(callee);
+    for (int i = 0; i < args.count; i++) {
+        if (args.items[i] && args.items[i]->kind == NODE_IDENT) n->call.ident_args++;
+    }
     return n;
 }
 
@@ -298,6 +321,149 @@ AstNode *ast_unsafe(NodeList body, int line) {
     return n;
 }
 
+// Free-variable collection for closures. Over-approximates: every name the
+// function mentions is listed, even ones it binds itself with let or for,
+// since a name read before its let still resolves outside. Capturing a
+// name that turns out local only costs a copy.
+typedef struct {
+    const char **names;
+    int count;
+    int capacity;
+} NameSet;
+
+static void names_add(NameSet *set, const char *name) {
+    if (!name) return;
+    for (int i = 0; i < set->count; i++) {
+        if (set->names[i] == name) return;
+    }
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 8;
+        set->names = realloc(set->names, sizeof(const char *) * (size_t)set->capacity);
+    }
+    set->names[set->count++] = name;
+}
+
+static void collect_refs(AstNode *n, NameSet *set);
+
+static void collect_list_refs(NodeList *list, NameSet *set) {
+    for (int i = 0; i < list->count; i++) collect_refs(list->items[i], set);
+}
+
+static void collect_refs(AstNode *n, NameSet *set) {
+    if (!n) return;
+    switch (n->kind) {
+        case NODE_IDENT: names_add(set, n->ident.name); break;
+        case NODE_INC: names_add(set, n->inc.name); break;
+        case NODE_DEC: names_add(set, n->dec.name); break;
+        case NODE_ASSIGN:
+            names_add(set, n->assign.name);
+            collect_refs(n->assign.expr, set);
+            break;
+        case NODE_TYPED_INIT:
+            names_add(set, n->typed_init.name);
+            collect_list_refs(&n->typed_init.args, set);
+            break;
+        case NODE_LIST: collect_list_refs(&n->list.items, set); break;
+        case NODE_MAP:
+            for (int i = 0; i < n->map.count; i++) collect_refs(n->map.values[i], set);
+            break;
+        case NODE_TEMPLATE:
+            for (int i = 0; i < n->template_string.expr_count; i++) {
+                collect_refs(n->template_string.exprs[i], set);
+            }
+            break;
+        case NODE_BINOP:
+            collect_refs(n->binop.left, set);
+            collect_refs(n->binop.right, set);
+            break;
+        case NODE_FIELD: collect_refs(n->field.target, set); break;
+        case NODE_BOX_ALLOC: collect_refs(n->box_alloc.size, set); break;
+        case NODE_LET: collect_refs(n->let.expr, set); break;
+        case NODE_ASSIGN_INDEX:
+            collect_refs(n->assign_index.list, set);
+            collect_refs(n->assign_index.index, set);
+            collect_refs(n->assign_index.value, set);
+            break;
+        case NODE_PRINT: collect_list_refs(&n->print.args, set); break;
+        case NODE_IF:
+            collect_refs(n->ifstmt.cond, set);
+            collect_list_refs(&n->ifstmt.then_block, set);
+            collect_list_refs(&n->ifstmt.else_block, set);
+            break;
+        case NODE_WHILE:
+            collect_refs(n->whilestmt.cond, set);
+            collect_list_refs(&n->whilestmt.body, set);
+            break;
+        case NODE_FOR:
+            collect_refs(n->forstmt.init, set);
+            collect_refs(n->forstmt.cond, set);
+            collect_refs(n->forstmt.incr, set);
+            collect_list_refs(&n->forstmt.body, set);
+            break;
+        case NODE_FOR_IN:
+            collect_refs(n->forin.iterable, set);
+            collect_list_refs(&n->forin.body, set);
+            break;
+        case NODE_SWITCH:
+            collect_refs(n->switchstmt.expr, set);
+            collect_list_refs(&n->switchstmt.cases, set);
+            collect_list_refs(&n->switchstmt.default_case, set);
+            break;
+        case NODE_CASE:
+            collect_refs(n->casestmt.value, set);
+            collect_list_refs(&n->casestmt.body, set);
+            break;
+        case NODE_BLOCK:
+        case NODE_GROUP:
+            collect_list_refs(&n->block.items, set);
+            break;
+        case NODE_CALL:
+            collect_refs(n->call.callee, set);
+            collect_list_refs(&n->call.args, set);
+            break;
+        case NODE_INDEX:
+            collect_refs(n->index.target, set);
+            collect_refs(n->index.index, set);
+            break;
+        case NODE_UNSAFE: collect_list_refs(&n->unsafe_block.body, set); break;
+        case NODE_RETURN: collect_refs(n->ret.expr, set); break;
+        case NODE_NOT: collect_refs(n->logic_not.expr, set); break;
+        case NODE_FUNC_DEF:
+            // Already built bottom-up: its list stands in for its body
+            for (int i = 0; i < n->funcdef.capture_count; i++) {
+                names_add(set, n->funcdef.captures[i]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void funcdef_collect_captures(AstNode *n) {
+    NameSet set = {0};
+    collect_list_refs(&n->funcdef.body, &set);
+    // Parameters are bound before the body runs; defaults see only the
+    // parameters before them, so their names are added after the filter.
+    int kept = 0;
+    for (int i = 0; i < set.count; i++) {
+        int is_param = 0;
+        for (int j = 0; j < n->funcdef.param_count; j++) {
+            if (set.names[i] == n->funcdef.params[j]) is_param = 1;
+        }
+        if (!is_param) set.names[kept++] = set.names[i];
+    }
+    set.count = kept;
+    for (int i = 0; i < n->funcdef.param_count; i++) {
+        collect_refs(n->funcdef.defaults[i], &set);
+    }
+    if (set.count > 0) {
+        n->funcdef.captures = arena_alloc(ast_arena, sizeof(const char *) * (size_t)set.count);
+        memcpy((void *)n->funcdef.captures, set.names, sizeof(const char *) * (size_t)set.count);
+    }
+    n->funcdef.capture_count = set.count;
+    free(set.names);
+}
+
 AstNode *ast_funcdef(const char *name, const char **params, AstNode **defaults, int count, NodeList body, int line) {
     AstNode *n = mk(NODE_FUNC_DEF, line);
     n->funcdef.name = name ? intern_string(name) : NULL;
@@ -306,10 +472,12 @@ AstNode *ast_funcdef(const char *name, const char **params, AstNode **defaults,
     for (int i = 0; i < count; i++) {
         n->funcdef.params[i] = intern_string(params[i]);
         n->funcdef.defaults[i] = defaults ? defaults[i] : NULL;
+        if (!n->funcdef.defaults[i]) n->funcdef.required_count++;
     }
     n->funcdef.param_count = count;
     n->funcdef.body = body;
     n->funcdef.is_export = 0;
+    funcdef_collect_captures(n);
     return n;
 }
 
@@ -565,13 +733,27 @@ void ast_release(AstNode *n) {
 
 void ast_init(void) {
     if (!ast_arena) {
-        ast_arena = arena_create(1024 * 1024 * 4); // 4MB default
+        ast_arena = ast_arena_new(1024 * 1024 * 4); // 4MB default
     }
 }
 
+Arena *ast_use_new_arena(void) {
+    Arena *prev = ast_arena;
+    ast_arena = ast_arena_new(1024 * 256); // one module; grows by chaining
+    return prev;
+}
+
+void ast_restore_arena(Arena *prev) {
+    ast_arena = prev;
+}
+
 void ast_cleanup(void) {
-    if (ast_arena) {
-        arena_free(ast_arena);
-        ast_arena = NULL;
+    for (int i = 0; i < ast_arena_count; i++) {
+        arena_free(ast_arenas[i]);
     }
+    free(ast_arenas);
+    ast_arenas = NULL;
+    ast_arena_count = 0;
+    ast_arena_capacity = 0;
+    ast_arena = NULL;
 }
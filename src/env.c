@@ -8,34 +8,43 @@
 #include "mystr.h"
 #include "luna_error.h"
 
-// Increased size and switched to power of 2 for better hash distribution
-#define TABLE_SIZE 512
+// Bindings live in slots numbered in definition order. The first
+// ENV_INLINE_VARS are stored in the Env itself, which covers almost every
+// function, loop and block scope; larger scopes (globals, modules) add
+// chunks of doubling size. Entries never move until the scope is cleared,
+// so Value pointers and (hops, slot) references handed out stay valid.
+#define ENV_INLINE_VARS 8
+#define ENV_CHUNKS 24
+// Scopes with more bindings than this also get a hash index of their slots;
+// smaller ones are scanned, comparing interned name pointers.
+#define ENV_INDEX_MIN 16
 
 // Structure to hold a variable name and its current value
 typedef struct {
     const char *name;
     Value val;
-    int occupied; // Flag for hash table occupancy
     int is_const;
 } VarEntry;
 
-
-// The Environment structure, now using a Hash Table for variables
 struct Env {
-    VarEntry vars[TABLE_SIZE]; 
     struct Env *parent; // Pointer to the enclosing scope
     uint64_t version;   // Unique ID to validate loop cache hits against function recursion
     uint64_t scope_id;
-    int occupied_slots[TABLE_SIZE]; // side array: indices of occupied var slots
-    int occupied_count;             // number of entries in occupied_slots[]
+    int count;          // bindings, in slots [0, count)
+    int index_cap;      // buckets in index (0 while the scope is small)
+    int *index;         // slot + 1 per bucket, 0 = empty
+    VarEntry *chunks[ENV_CHUNKS]; // chunk c (c >= 1) holds ENV_INLINE_VARS << (c - 1) slots
     int gc_rooted;
     struct Env *gc_prev;
     struct Env *gc_next;
     int gc_captured_root;
     struct Env *gc_captured_prev;
     struct Env *gc_captured_next;
+    VarEntry vars[ENV_INLINE_VARS];
 };
 
+uint64_t env_binding_epoch = 1;
+
 static uint64_t next_env_version = 1;
 static uint64_t next_scope_id = 1;
 static Env *gc_active_envs = NULL;
@@ -53,25 +62,112 @@ static unsigned int hash_name(const char *str) {
     // We shift right by 3 or 4 bits because pointers are typically aligned,
     // so the lowest bits are often zero.
     unsigned long long ptr_val = (unsigned long long)str;
-    unsigned int hash = (unsigned int)((ptr_val >> 4) ^ (ptr_val >> 12));
-    return hash & (TABLE_SIZE - 1);
+    return (unsigned int)((ptr_val >> 4) ^ (ptr_val >> 12));
+}
+
+// Chunk holding slot (>= ENV_INLINE_VARS): the bit length of slot / ENV_INLINE_VARS.
+static inline int slot_chunk(int slot) {
+    unsigned int rel = (unsigned int)slot / ENV_INLINE_VARS;
+#ifdef __GNUC__
+    return 32 - __builtin_clz(rel);
+#else
+    int c = 1;
+    while (rel >> c) c++;
+    return c;
+#endif
+}
+
+static inline VarEntry *env_slot(Env *e, int slot) {
+    if (slot < ENV_INLINE_VARS) return &e->vars[slot];
+    int c = slot_chunk(slot);
+    return &e->chunks[c][slot - (ENV_INLINE_VARS << (c - 1))];
+}
+
+static void env_index_insert(Env *e, int slot) {
+    unsigned int mask = (unsigned int)e->index_cap - 1;
+    unsigned int h = hash_name(env_slot(e, slot)->name) & mask;
+    while (e->index[h]) h = (h + 1) & mask;
+    e->index[h] = slot + 1;
+}
+
+static void env_index_rebuild(Env *e, int cap) {
+    free(e->index);
+    e->index = calloc((size_t)cap, sizeof(int));
+    if (!e->index) abort();
+    e->index_cap = cap;
+    for (int i = 0; i < e->count; i++) env_index_insert(e, i);
+}
+
+// Slot of name in this scope only, or -1.
+static int env_find_slot(Env *e, const char *name) {
+    if (e->index_cap) {
+        unsigned int mask = (unsigned int)e->index_cap - 1;
+        unsigned int h = hash_name(name) & mask;
+        while (e->index[h]) {
+            int slot = e->index[h] - 1;
+            if (env_slot(e, slot)->name == name) return slot;
+            h = (h + 1) & mask;
+        }
+        return -1;
+    }
+    int n = e->count < ENV_INLINE_VARS ? e->count : ENV_INLINE_VARS;
+    for (int i = 0; i < n; i++) {
+        if (e->vars[i].name == name) return i;
+    }
+    for (int i = n; i < e->count; i++) {
+        if (env_slot(e, i)->name == name) return i;
+    }
+    return -1;
+}
+
+// Takes the next slot for a new binding, allocating its chunk the first time.
+static VarEntry *env_append(Env *e, const char *name) {
+    int slot = e->count;
+    if (slot >= ENV_INLINE_VARS) {
+        int c = slot_chunk(slot);
+        if (c >= ENV_CHUNKS) return NULL;
+        if (!e->chunks[c]) {
+            e->chunks[c] = malloc(sizeof(VarEntry) * (size_t)(ENV_INLINE_VARS << (c - 1)));
+            if (!e->chunks[c]) abort();
+        }
+    }
+    VarEntry *entry = env_slot(e, slot);
+    entry->name = name;
+    e->count++;
+    if (e->index_cap) {
+        if (e->count * 2 > e->index_cap) env_index_rebuild(e, e->index_cap * 2);
+        else env_index_insert(e, slot);
+    } else if (e->count > ENV_INDEX_MIN) {
+        env_index_rebuild(e, ENV_INDEX_MIN * 4);
+    }
+    return entry;
+}
+
+static void env_release_storage(Env *e) {
+    for (int c = 1; c < ENV_CHUNKS && e->chunks[c]; c++) {
+        free(e->chunks[c]);
+        e->chunks[c] = NULL;
+    }
+    free(e->index);
+    e->index = NULL;
+    e->index_cap = 0;
+}
+
+// Frees every binding; chunks are kept for the scope's next use.
+static void env_drop_bindings(Env *e) {
+    for (int i = 0; i < e->count; i++) {
+        VarEntry *entry = env_slot(e, i);
+        value_free(entry->val);
+        entry->name = NULL;
+    }
+    e->count = 0;
+    if (e->index_cap) memset(e->index, 0, sizeof(int) * (size_t)e->index_cap);
 }
 
 static VarEntry *env_find_entry(Env *e, const char *name) {
-    unsigned int h_base = hash_name(name);
-    Env *cur_env = e;
-    while (cur_env) {
-        unsigned int h = h_base;
-        unsigned int start_index = h;
-
-        while (cur_env->vars[h].occupied) {
-            if (cur_env->vars[h].name == name) {
-                return &cur_env->vars[h];
-            }
-            h = (h + 1) & (TABLE_SIZE - 1);
-            if (h == start_index) break;
-        }
-        cur_env = cur_env->parent;
+    for (Env *cur_env = e; cur_env; cur_env = cur_env->parent) {
+        int slot = env_find_slot(cur_env, name);
+        if (slot >= 0) return env_slot(cur_env, slot);
     }
     return NULL;
 }
@@ -115,52 +211,48 @@ static void env_gc_unlink_captured_root(Env *e) {
 }
 
 static void env_def_impl(Env *e, const char *name, Value *val, int move, int is_const) {
-    unsigned int h = hash_name(name);
-    unsigned int start_index = h;
-
-    while (e->vars[h].occupied) {
-        if (e->vars[h].name == name) {
-            if (e->vars[h].is_const) {
-                error_report_with_context(ERR_NAME, 0, 0,
-                    "Cannot redefine const variable in the same scope",
-                    "Use a different name or remove the reassignment");
-                if (move) val->type = VAL_NULL;
-                return;
-            }
-            value_free(e->vars[h].val);
-            e->vars[h].val = move ? *val : value_copy(*val);
-            e->vars[h].is_const = is_const;
-            if (move) val->type = VAL_NULL;
-            return;
-        }
-        h = (h + 1) & (TABLE_SIZE - 1);
-        if (h == start_index) {
-            fprintf(stderr, "Runtime Error: Environment variable limit reached.\n");
-            if (move) val->type = VAL_NULL;
+    int slot = env_find_slot(e, name);
+    if (slot >= 0) {
+        VarEntry *entry = env_slot(e, slot);
+        if (entry->is_const) {
+            error_report_with_context(ERR_NAME, 0, 0,
+                "Cannot redefine const variable in the same scope",
+                "Use a different name or remove the reassignment");
+            if (move) *val = value_null();
             return;
         }
+        value_free(entry->val);
+        entry->val = move ? *val : value_copy(*val);
+        entry->is_const = is_const;
+        if (move) *val = value_null();
+        return;
     }
 
-    e->vars[h].name = name;
-    e->vars[h].val = move ? *val : value_copy(*val);
-    e->vars[h].occupied = 1;
-    e->vars[h].is_const = is_const;
-    e->occupied_slots[e->occupied_count++] = h;
-    if (move) val->type = VAL_NULL;
+    VarEntry *entry = env_append(e, name);
+    if (!entry) {
+        fprintf(stderr, "Runtime Error: Environment variable limit reached.\n");
+        if (move) *val = value_null();
+        return;
+    }
+    entry->val = move ? *val : value_copy(*val);
+    entry->is_const = is_const;
+    env_binding_epoch++; // a new binding may shadow a cached outer slot
+    if (move) *val = value_null();
 }
 
-// Creates a new environment scope, linking it to a parent scope
 // Pulls from freelist if available, otherwise calloc
-Env *env_create(Env *parent) {
-    Env *e;
+static Env *env_alloc(void) {
     if (env_freelist_count > 0) {
-        e = env_freelist[--env_freelist_count];
-        // Only reset what matters — vars are tracked by occupied_slots
-        e->occupied_count = 0;
-    } else {
-        e = calloc(1, sizeof(Env));
-        if (!e) return NULL;
+        // Pooled envs come back empty, keeping any chunks they grew
+        return env_freelist[--env_freelist_count];
     }
+    return calloc(1, sizeof(Env));
+}
+
+// Creates a new environment scope, linking it to a parent scope
+Env *env_create(Env *parent) {
+    Env *e = env_alloc();
+    if (!e) return NULL;
     e->parent = parent;
     e->version = next_env_version++;
     e->scope_id = next_scope_id++;
@@ -173,30 +265,34 @@ Env *env_create(Env *parent) {
     return e;
 }
 
-Env *env_snapshot(Env *e) {
-    if (!e) return NULL;
-    Env *parent_copy = env_snapshot(e->parent);
-    Env *copy = calloc(1, sizeof(Env));
-    if (!copy) return NULL;
-    copy->parent = parent_copy;
-    copy->version = e->version;
-    copy->gc_rooted = 0;
-    copy->gc_prev = NULL;
-    copy->gc_next = NULL;
-    copy->gc_captured_root = 0;
-    copy->gc_captured_prev = NULL;
-    copy->gc_captured_next = NULL;
-    for (int i = 0; i < e->occupied_count; i++) {
-        int idx = e->occupied_slots[i];
-        if (!e->vars[idx].occupied) continue;
-        copy->vars[idx].occupied = 1;
-        copy->vars[idx].name = e->vars[idx].name;
-        copy->vars[idx].is_const = e->vars[idx].is_const;
-        copy->vars[idx].val = value_copy(e->vars[idx].val);
-        copy->occupied_slots[copy->occupied_count++] = idx;
+// Closure record: copies of just the named bindings found below the root
+// scope, nearest first, with the root itself as parent so globals stay
+// live. Names bound nowhere below the root are left to the root (or to the
+// call's own scope). Freed with env_free; the root is not the record's.
+Env *env_capture(Env *e, const char **names, int count) {
+    Env *root = env_root(e);
+    Env *rec = env_alloc();
+    if (!rec) return NULL;
+    rec->parent = root;
+    rec->version = next_env_version++;
+    rec->scope_id = 0;
+    rec->gc_prev = NULL;
+    rec->gc_next = NULL;
+    for (int i = 0; i < count; i++) {
+        for (Env *cur = e; cur != root; cur = cur->parent) {
+            int slot = env_find_slot(cur, names[i]);
+            if (slot < 0) continue;
+            VarEntry *src = env_slot(cur, slot);
+            VarEntry *dst = env_append(rec, names[i]);
+            if (dst) {
+                dst->is_const = src->is_const;
+                dst->val = value_copy(src->val);
+            }
+            break;
+        }
     }
-    env_gc_link_captured_root(copy);
-    return copy;
+    env_gc_link_captured_root(rec);
+    return rec;
 }
 
 uint64_t env_get_version(Env *e) {
@@ -229,47 +325,25 @@ void env_free(Env *e) {
     }
     env_gc_unlink_active(e);
     env_gc_unlink_captured_root(e);
-    // Only visit slots we actually used, not all 512
-    for (int i = 0; i < e->occupied_count; i++) {
-        int idx = e->occupied_slots[i];
-        if (e->vars[idx].occupied) {
-            value_free(e->vars[idx].val);
-            e->vars[idx].occupied = 0;
-            e->vars[idx].name = NULL;
-            e->vars[idx].is_const = 0;
-        }
-    }
-    e->occupied_count = 0;
+    env_binding_epoch++; // slots inside e (and the chain through it) go away
+    env_drop_bindings(e);
     value_box_release_scope(e->scope_id);
     // Return to pool instead of free
     if (env_freelist_count < ENV_POOL_MAX) {
         env_freelist[env_freelist_count++] = e;
     } else {
+        env_release_storage(e);
         free(e);
     }
 }
 
-void env_free_chain(Env *e) {
-    if (!e) return;
-    Env *parent = e->parent;
-    e->parent = NULL;
-    env_free(e);
-    env_free_chain(parent);
-}
-
 // Optimization: Clear all local variables to reuse an environment block during loops.
 // This keeps pointers stable for AST lexical caching, avoiding mallocs per iteration.
-// Uses occupied_slots[] so we only touch the 2-3 vars the loop body actually defined.
+// Only the slots the loop body actually defined are touched.
 void env_clear_locals(Env *e) {
     if (!e) return;
-    for (int i = 0; i < e->occupied_count; i++) {
-        int idx = e->occupied_slots[i];
-        value_free(e->vars[idx].val);
-        e->vars[idx].occupied = 0; 
-        e->vars[idx].name = NULL;
-        e->vars[idx].is_const = 0;
-    }
-    e->occupied_count = 0;
+    if (e->count > 0) env_binding_epoch++;
+    env_drop_bindings(e);
     value_box_release_scope(e->scope_id);
 }
 
@@ -282,17 +356,15 @@ void env_free_global(Env *env) {
     if (env) {
         env_gc_unlink_active(env);
         env_gc_unlink_captured_root(env);
-        for (int i = 0; i < env->occupied_count; i++) {
-            int idx = env->occupied_slots[i];
-            if (env->vars[idx].occupied) {
-                value_free(env->vars[idx].val);
-            }
-        }
+        env_binding_epoch++;
+        env_drop_bindings(env);
         value_box_release_scope(env->scope_id);
+        env_release_storage(env);
         free(env);
     }
     // Drain the freelist on shutdown
     for (int i = 0; i < env_freelist_count; i++) {
+        env_release_storage(env_freelist[i]);
         free(env_freelist[i]);
     }
     env_freelist_count = 0;
@@ -306,25 +378,26 @@ Value *env_get(Env *e, const char *name) {
 
 Value *env_get_local(Env *e, const char *name) {
     if (!e || !name) return NULL;
-    unsigned int h = hash_name(name);
-    unsigned int start_index = h;
-    while (e->vars[h].occupied) {
-        if (e->vars[h].name == name) return &e->vars[h].val;
-        h = (h + 1) & (TABLE_SIZE - 1);
-        if (h == start_index) break;
-    }
-    return NULL;
+    int slot = env_find_slot(e, name);
+    return slot >= 0 ? &env_slot(e, slot)->val : NULL;
+}
+
+Value *env_get_local_writable(Env *e, const char *name) {
+    if (!e || !name) return NULL;
+    int slot = env_find_slot(e, name);
+    if (slot < 0) return NULL;
+    VarEntry *entry = env_slot(e, slot);
+    return entry->is_const ? NULL : &entry->val;
 }
 
 Value *env_get_text(Env *e, const char *name) {
     if (!e || !name) return NULL;
 
     for (Env *cur = e; cur; cur = cur->parent) {
-        for (int i = 0; i < cur->occupied_count; i++) {
-            int idx = cur->occupied_slots[i];
-            if (!cur->vars[idx].occupied || !cur->vars[idx].name) continue;
-            if (strcmp(cur->vars[idx].name, name) == 0) {
-                return &cur->vars[idx].val;
+        for (int i = 0; i < cur->count; i++) {
+            VarEntry *entry = env_slot(cur, i);
+            if (entry->name && strcmp(entry->name, name) == 0) {
+                return &entry->val;
             }
         }
     }
@@ -332,6 +405,27 @@ Value *env_get_text(Env *e, const char *name) {
     return NULL;
 }
 
+Value *env_resolve(Env *e, const char *name, int *hops, int *slot) {
+    int depth = 0;
+    for (Env *cur = e; cur; cur = cur->parent, depth++) {
+        int found = env_find_slot(cur, name);
+        if (found >= 0) {
+            *hops = depth;
+            *slot = found;
+            return &env_slot(cur, found)->val;
+        }
+    }
+    return NULL;
+}
+
+Value *env_at(Env *e, const char *name, int hops, int slot) {
+    Env *cur = e;
+    for (int i = 0; i < hops && cur; i++) cur = cur->parent;
+    if (!cur || slot >= cur->count) return NULL;
+    VarEntry *entry = env_slot(cur, slot);
+    return entry->name == name ? &entry->val : NULL;
+}
+
 // Defines a new variable in the current scope using the hash table
 void env_def(Env *e, const char *name, Value val) {
     env_def_impl(e, name, &val, 0, 0);
@@ -385,7 +479,7 @@ void env_assign_move(Env *e, const char *name, Value *val) {
         }
         value_free(target->val);
         target->val = *val;
-        val->type = VAL_NULL;
+        *val = value_null();
         return;
     }
 
@@ -399,62 +493,45 @@ void env_assign_move(Env *e, const char *name, Value *val) {
 
 int env_has_local(Env *e, const char *name) {
     if (!e) return 0;
-    unsigned int h = hash_name(name);
-    unsigned int start_index = h;
-    while (e->vars[h].occupied) {
-        if (e->vars[h].name == name) return 1;
-        h = (h + 1) & (TABLE_SIZE - 1);
-        if (h == start_index) break;
-    }
-    return 0;
+    return env_find_slot(e, name) >= 0;
 }
 
 // Defines a function in the current scope
 void env_def_func(Env *e, const char *name, AstNode *def) {
-    Value f;
-    f.type = VAL_FUNCTION;
-    f.func = def;
+    Value f = value_make(VAL_FUNCTION, (uintptr_t)def);
     env_def_move(e, name, &f);
 }
 
 // Looks up a function definition
 AstNode *env_get_func(Env *e, const char *name) {
     Value *v = env_get(e, name);
-    if (v && v->type == VAL_FUNCTION) {
-        return v->func;
+    if (v && VALUE_TYPE(*v) == VAL_FUNCTION) {
+        return VALUE_AS_FUNC(*v);
     }
-    if (v && v->type == VAL_CLOSURE && v->closure) {
-        return v->closure->funcdef;
+    if (v && VALUE_TYPE(*v) == VAL_CLOSURE && VALUE_AS_CLOSURE(*v)) {
+        return VALUE_AS_CLOSURE(*v)->funcdef;
     }
     return NULL;
 }
 
+static void env_gc_mark_bindings(Env *e, void *ctx) {
+    for (int i = 0; i < e->count; i++) {
+        value_gc_mark(&env_slot(e, i)->val, ctx);
+    }
+}
+
 void env_gc_mark_chain(Env *e, void *ctx) {
     for (Env *cur = e; cur; cur = cur->parent) {
-        for (int i = 0; i < cur->occupied_count; i++) {
-            int idx = cur->occupied_slots[i];
-            if (!cur->vars[idx].occupied) continue;
-            value_gc_mark(&cur->vars[idx].val, ctx);
-        }
+        env_gc_mark_bindings(cur, ctx);
     }
 }
 
 void env_gc_mark_active_roots(void *ctx) {
     for (Env *env = gc_active_envs; env; env = env->gc_next) {
-        for (int i = 0; i < env->occupied_count; i++) {
-            int idx = env->occupied_slots[i];
-            if (env->vars[idx].occupied) {
-                value_gc_mark(&env->vars[idx].val, ctx);
-            }
-        }
+        env_gc_mark_bindings(env, ctx);
     }
     for (Env *env = gc_captured_env_roots; env; env = env->gc_captured_next) {
-        for (int i = 0; i < env->occupied_count; i++) {
-            int idx = env->occupied_slots[i];
-            if (env->vars[idx].occupied) {
-                value_gc_mark(&env->vars[idx].val, ctx);
-            }
-        }
+        env_gc_mark_bindings(env, ctx);
     }
 }
 
@@ -467,23 +544,23 @@ void debug_print_keepers(void) {
         }
     }
     if (!global) return;
-    for (int i = 0; i < global->occupied_count; i++) {
-        int idx = global->occupied_slots[i];
-        if (global->vars[idx].occupied && strcmp(global->vars[idx].name, "keepers") == 0) {
-            Value v = global->vars[idx].val;
-            if (v.type == VAL_LIST && v.list) {
+    for (int i = 0; i < global->count; i++) {
+        VarEntry *entry = env_slot(global, i);
+        if (strcmp(entry->name, "keepers") == 0) {
+            Value v = entry->val;
+            if (VALUE_TYPE(v) == VAL_LIST && VALUE_AS_LIST(v)) {
                 fprintf(stderr, "VERIFY: keepers count=%d, capacity=%d, list_obj=%p, list_color=%d, items_obj=%p, items_color=%d\n",
-                        v.list->count, v.list->capacity,
-                        (void*)GC_FROM_PAYLOAD(v.list), GC_FROM_PAYLOAD(v.list)->color,
-                        (void*)v.list->items, v.list->items ? GC_FROM_PAYLOAD(v.list->items)->color : -1);
-                for (int j = 0; j < v.list->count; j++) {
-                    Value c = v.list->items[j];
-                    if (c.type == VAL_CLOSURE && c.closure) {
-                        GCObject *c_obj = GC_FROM_PAYLOAD(c.closure);
+                        VALUE_AS_LIST(v)->count, VALUE_AS_LIST(v)->capacity,
+                        (void*)GC_FROM_PAYLOAD(VALUE_AS_LIST(v)), GC_FROM_PAYLOAD(VALUE_AS_LIST(v))->color,
+                        (void*)VALUE_AS_LIST(v)->items, VALUE_AS_LIST(v)->items ? GC_FROM_PAYLOAD(VALUE_AS_LIST(v)->items)->color : -1);
+                for (int j = 0; j < VALUE_AS_LIST(v)->count; j++) {
+                    Value c = VALUE_AS_LIST(v)->items[j];
+                    if (VALUE_TYPE(c) == VAL_CLOSURE && VALUE_AS_CLOSURE(c)) {
+                        GCObject *c_obj = GC_FROM_PAYLOAD(VALUE_AS_CLOSURE(c));
                         fprintf(stderr, "  [%d] closure=%p, color=%d, env=%p\n",
-                                j, (void*)c_obj, c_obj->color, (void*)c.closure->env);
+                                j, (void*)c_obj, c_obj->color, (void*)VALUE_AS_CLOSURE(c)->env);
                     } else {
-                        fprintf(stderr, "  [%d] non-closure type=%d\n", j, c.type);
+                        fprintf(stderr, "  [%d] non-closure type=%d\n", j, VALUE_TYPE(c));
                     }
                 }
             }
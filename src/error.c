@@ -13,9 +13,9 @@ int luna_current_line = 0;
 int luna_had_error = 0;
 
 // Global source information for context display
-static SourceInfo g_source_info = {NULL, NULL};
-static LunaErrorInfo g_last_error = {0};
-static int g_error_quiet = 0;
+static _Thread_local SourceInfo g_source_info = {NULL, NULL};
+static _Thread_local LunaErrorInfo g_last_error = {0};
+static _Thread_local int g_error_quiet = 0;
 
 // ANSI color codes (can be disabled on Windows if needed)
 #ifdef _WIN32
@@ -56,7 +56,7 @@ void error_init(const char *source, const char *filename) {
 
 void error_clear_last(void) {
     memset(&g_last_error, 0, sizeof(g_last_error));
-    luna_had_error = 0;
+    if (!g_error_quiet) luna_had_error = 0;
 }
 
 int error_get_last(LunaErrorInfo *out) {
@@ -71,6 +71,10 @@ void error_set_quiet(int quiet) {
     g_error_quiet = quiet ? 1 : 0;
 }
 
+int error_failed(void) {
+    return g_error_quiet ? g_last_error.had_error : luna_had_error;
+}
+
 static void error_store_last(ErrorType type, int line, int col, const char *message, const char *suggestion) {
     memset(&g_last_error, 0, sizeof(g_last_error));
     g_last_error.had_error = 1;
@@ -139,11 +143,14 @@ static char *get_line_from_source(const char *source, int line_num) {
 }
 
 void error_report(ErrorType type, int line, int col, const char *message, const char *suggestion) {
+    if (g_error_quiet) {
+        error_store_last(type, line, col, message, suggestion);
+        return;
+    }
     luna_had_error = 1;
     // Fallback to global tracker if line is unknown
     if (line <= 0) line = luna_current_line;
     error_store_last(type, line, col, message, suggestion);
-    if (g_error_quiet) return;
 
     fprintf(stderr, "%s%s%s", color_if_enabled(COLOR_RED), error_type_name(type), color_if_enabled(COLOR_RESET));
     
@@ -165,11 +172,14 @@ void error_report(ErrorType type, int line, int col, const char *message, const
 }
 
 void error_report_with_context(ErrorType type, int line, int col, const char *message, const char *suggestion) {
+    if (g_error_quiet) {
+        error_store_last(type, line, col, message, suggestion);
+        return;
+    }
     luna_had_error = 1;
     // Fallback to global tracker if line is unknown
     if (line <= 0) line = luna_current_line;
     error_store_last(type, line, col, message, suggestion);
-    if (g_error_quiet) return;
 
     fprintf(stderr, "%s%s%s", color_if_enabled(COLOR_RED), error_type_name(type), color_if_enabled(COLOR_RESET));
     
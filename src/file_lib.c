@@ -11,8 +11,8 @@
 
 // Helper: Safely extract the FILE pointer from a Luna Value
 static FILE *get_file_ptr(Value v) {
-    if (v.type == VAL_FILE) {
-        return v.file;
+    if (VALUE_TYPE(v) == VAL_FILE) {
+        return VALUE_AS_FILE(v);
     }
     return NULL;
 }
@@ -30,14 +30,14 @@ static int check_args(int argc, int expected, const char *name) {
 Value lib_file_open(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 2, "open")) return value_null();
     
-    if (argv[0].type != VAL_STRING || argv[1].type != VAL_STRING) {
+    if (VALUE_TYPE(argv[0]) != VAL_STRING || VALUE_TYPE(argv[1]) != VAL_STRING) {
         fprintf(stderr, "Runtime Error: open() expects strings for path and mode.\n");
         return value_null();
     }
 
-    if (!argv[0].string || !argv[1].string) return value_null();
-    const char *path = argv[0].string->chars;
-    const char *mode = argv[1].string->chars;
+    if (!VALUE_AS_STRING(argv[0]) || !VALUE_AS_STRING(argv[1])) return value_null();
+    const char *path = VALUE_AS_STRING(argv[0])->chars;
+    const char *mode = VALUE_AS_STRING(argv[1])->chars;
 
     FILE *f = fopen(path, mode);
     if (!f) return value_null();
@@ -53,7 +53,7 @@ Value lib_file_close(int argc, Value *argv, Env *env) {
     if (f) {
         fclose(f);
         // Important: invalidate the handle in the current scope to prevent double-close
-        argv[0].file = NULL; 
+        argv[0] = value_file(NULL);
     }
     return value_null();
 }
@@ -123,9 +123,9 @@ Value lib_file_write(int argc, Value *argv, Env *env) {
 // file_exists(path) -> returns boolean
 Value lib_file_exists(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 1, "file_exists")) return value_null();
-    if (argv[0].type != VAL_STRING || !argv[0].string) return value_bool(0);
+    if (VALUE_TYPE(argv[0]) != VAL_STRING || !VALUE_AS_STRING(argv[0])) return value_bool(0);
 
-    FILE *f = fopen(argv[0].string->chars, "r");
+    FILE *f = fopen(VALUE_AS_STRING(argv[0])->chars, "r");
     if (f) {
         fclose(f);
         return value_bool(1);
@@ -136,9 +136,9 @@ Value lib_file_exists(int argc, Value *argv, Env *env) {
 // remove_file(path) -> returns boolean
 Value lib_file_remove(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 1, "remove_file")) return value_null();
-    if (argv[0].type != VAL_STRING || !argv[0].string) return value_bool(0);
+    if (VALUE_TYPE(argv[0]) != VAL_STRING || !VALUE_AS_STRING(argv[0])) return value_bool(0);
     
-    int res = remove(argv[0].string->chars);
+    int res = remove(VALUE_AS_STRING(argv[0])->chars);
     return value_bool(res == 0);
 }
 
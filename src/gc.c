@@ -14,6 +14,7 @@ static unsigned long long total_pause_ns = 0;
 static unsigned long long max_pause_ns = 0;
 static unsigned long long pause_events = 0;
 static GCHeap *runtime_heap = NULL;
+static int runtime_heap_shared = 0;
 
 #define GC_REMEMBER_SCAN_MAX 4096
 
@@ -1159,9 +1160,19 @@ GCHeap *luna_gc_runtime_heap(void) {
 
 void *luna_gc_alloc(size_t size, GCTracer trace, GCFinalizer fin) {
     if (!runtime_heap) return malloc(size);
+    if (runtime_heap_shared) {
+        void *payload;
+        #pragma omp critical(luna_gc_alloc)
+        payload = gc_heap_alloc(runtime_heap, size, trace, fin);
+        return payload;
+    }
     return gc_heap_alloc(runtime_heap, size, trace, fin);
 }
 
+void luna_gc_runtime_set_shared(int shared) {
+    runtime_heap_shared = shared;
+}
+
 void luna_gc_runtime_safe_point(void) {
     if (runtime_heap) gc_heap_maybe_collect(runtime_heap);
 }
@@ -4,14 +4,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "intern.h"
-#include "mystr.h"
 
 // Intern table settings. Must be power of 2 for fast & indexing
 #define INTERN_CAPACITY 8192
 
+// Slots only ever go from NULL to a string, so lookups read them without a
+// lock; inserts (and the probe that precedes them) run in a critical section.
+// That keeps interning safe for the import prefetch workers.
 typedef struct {
-    const char **strings;
+    _Atomic(const char *) *strings;
     int count;
     int capacity;
 } InternTable;
@@ -20,11 +23,10 @@ typedef struct {
 static InternTable global_intern_table = {NULL, 0, 0};
 
 // DJB2 Hash (same algorithm used in env.c for consistency)
-static unsigned int intern_hash(const char *str) {
+static unsigned int intern_hash(const char *str, size_t len) {
     unsigned int hash = 5381;
-    int c;
-    while ((c = *str++)) {
-        hash = ((hash << 5) + hash) + c; // hash * 33 + c
+    for (size_t i = 0; i < len; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char)str[i]; // hash * 33 + c
     }
     return hash;
 }
@@ -33,33 +35,29 @@ void intern_init(void) {
     global_intern_table.capacity = INTERN_CAPACITY;
     global_intern_table.count = 0;
     // calloc sets all pointers to NULL initially
-    global_intern_table.strings = calloc(global_intern_table.capacity, sizeof(const char *));
+    global_intern_table.strings = calloc(global_intern_table.capacity, sizeof(*global_intern_table.strings));
 }
 
-// Core O(1) String to Memory Resolution function
-const char *intern_string(const char *str) {
-    if (!str) return NULL;
-    
-    // Safety check - shouldn't happen if engine is initialized properly
-    if (!global_intern_table.strings) {
-        intern_init();
-    }
+static int intern_matches(const char *entry, const char *str, size_t len) {
+    // EXACT POINTER MATCH (It was already interned elsewhere)
+    if (entry == str) return entry[len] == '\0';
+    // ACTUAL STRING MATCH (Found identical characters)
+    return strncmp(entry, str, len) == 0 && entry[len] == '\0';
+}
 
-    unsigned int h = intern_hash(str) & (global_intern_table.capacity - 1);
+// Probes from h for str; returns the interned copy, or NULL with *slot set to
+// the empty slot that ends the probe
+static const char *intern_probe(const char *str, size_t len, unsigned int h, unsigned int *slot) {
+    unsigned int mask = (unsigned int)global_intern_table.capacity - 1;
     unsigned int start_index = h;
 
     // Open addressing with linear probing
-    while (global_intern_table.strings[h] != NULL) {
-        // EXACT POINTER MATCH (It was already interned elsewhere)
-        if (global_intern_table.strings[h] == str) return str;
-        
-        // ACTUAL STRING MATCH (Found identical characters)
-        if (strcmp(global_intern_table.strings[h], str) == 0) {
-            return global_intern_table.strings[h];
-        }
+    const char *entry;
+    while ((entry = atomic_load_explicit(&global_intern_table.strings[h], memory_order_acquire)) != NULL) {
+        if (intern_matches(entry, str, len)) return entry;
         
         // Probe next bucket
-        h = (h + 1) & (global_intern_table.capacity - 1);
+        h = (h + 1) & mask;
         
         // Table is fully saturated
         if (h == start_index) {
@@ -69,25 +67,58 @@ const char *intern_string(const char *str) {
             exit(1); 
         }
     }
+    *slot = h;
+    return NULL;
+}
 
-    // String does not exist - allocate a permanent copy
-    char *new_str = my_strdup(str);
-    global_intern_table.strings[h] = new_str;
-    global_intern_table.count++;
+// Core O(1) String to Memory Resolution function
+const char *intern_string_n(const char *str, size_t len) {
+    if (!str) return NULL;
     
-    return new_str;
+    // Safety check - shouldn't happen if engine is initialized properly
+    if (!global_intern_table.strings) {
+        intern_init();
+    }
+
+    unsigned int slot;
+    unsigned int h = intern_hash(str, len) & (global_intern_table.capacity - 1);
+    const char *found = intern_probe(str, len, h, &slot);
+    if (found) return found;
+
+    // String does not exist - allocate a permanent copy. Another thread may
+    // have filled the empty slot meanwhile, so probe again from it.
+    #pragma omp critical(luna_intern)
+    {
+        found = intern_probe(str, len, slot, &slot);
+        if (!found) {
+            char *new_str = malloc(len + 1);
+            if (!new_str) abort();
+            memcpy(new_str, str, len);
+            new_str[len] = '\0';
+            atomic_store_explicit(&global_intern_table.strings[slot], new_str, memory_order_release);
+            global_intern_table.count++;
+            found = new_str;
+        }
+    }
+    return found;
+}
+
+const char *intern_string(const char *str) {
+    if (!str) return NULL;
+    return intern_string_n(str, strlen(str));
 }
 
 void intern_free_all(void) {
     if (!global_intern_table.strings) return;
     
     for (int i = 0; i < global_intern_table.capacity; i++) {
-        if (global_intern_table.strings[i]) {
-            free((void *)global_intern_table.strings[i]);
+        const char *entry = atomic_load_explicit(&global_intern_table.strings[i], memory_order_relaxed);
+        if (entry) {
+            free((void *)entry);
         }
     }
     
-    free(global_intern_table.strings);
+    free((void *)global_intern_table.strings);
     global_intern_table.strings = NULL;
     global_intern_table.count = 0;
     global_intern_table.capacity = 0;
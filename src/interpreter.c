@@ -4,7 +4,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <limits.h>
 #include <stdint.h>
 #include <math.h>  // Added for fabs()
@@ -22,6 +21,7 @@
 #include "vec_lib.h"
 #include "parser.h"
 #include "util.h"
+#include "module_cache.h"
 #include "gc.h"
 
 
@@ -67,25 +67,33 @@ static int deferred_call_cap = 0;
 
 static void gc_note_heap_value_overwrite(const Value *value) {
     if (!value || !VALUE_IS_HEAP(*value)) return;
-    switch (value->type) {
+    switch (VALUE_TYPE(*value)) {
         case VAL_STRING:
-            if (value->string) luna_gc_runtime_write_barrier(value->string);
+            if (VALUE_AS_STRING(*value)) luna_gc_runtime_write_barrier(VALUE_AS_STRING(*value));
             break;
         case VAL_LIST:
-            if (value->list) luna_gc_runtime_write_barrier(value->list);
+            if (VALUE_AS_LIST(*value)) luna_gc_runtime_write_barrier(VALUE_AS_LIST(*value));
             break;
         case VAL_DENSE_LIST:
-            if (value->dlist) luna_gc_runtime_write_barrier(value->dlist);
+            if (VALUE_AS_DLIST(*value)) luna_gc_runtime_write_barrier(VALUE_AS_DLIST(*value));
             break;
         case VAL_MAP:
-            if (value->map) luna_gc_runtime_write_barrier(value->map);
+            if (VALUE_AS_MAP(*value)) luna_gc_runtime_write_barrier(VALUE_AS_MAP(*value));
             break;
         case VAL_CLOSURE:
-            if (value->closure) luna_gc_runtime_write_barrier(value->closure);
+            if (VALUE_AS_CLOSURE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_CLOSURE(*value));
             break;
         case VAL_TEMPLATE:
-            if (value->template_obj) luna_gc_runtime_write_barrier(value->template_obj);
+            if (VALUE_AS_TEMPLATE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_TEMPLATE(*value));
             break;
+        case VAL_RANGE:
+            if (VALUE_AS_RANGE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_RANGE(*value));
+            break;
+#ifdef LUNA_NANBOX
+        case VAL_INT:
+            luna_gc_runtime_write_barrier(VALUE_AS_BIG_INT(*value));
+            break;
+#endif
         default:
             break;
     }
@@ -93,32 +101,30 @@ static void gc_note_heap_value_overwrite(const Value *value) {
 
 static int gc_value_is_young_heap(const Value *value) {
     if (!value || !VALUE_IS_HEAP(*value)) return 0;
-    switch (value->type) {
+    switch (VALUE_TYPE(*value)) {
         case VAL_STRING:
-            return value->string && GC_FROM_PAYLOAD(value->string)->generation == GC_GEN_YOUNG;
+            return VALUE_AS_STRING(*value) && GC_FROM_PAYLOAD(VALUE_AS_STRING(*value))->generation == GC_GEN_YOUNG;
         case VAL_LIST:
-            return value->list && GC_FROM_PAYLOAD(value->list)->generation == GC_GEN_YOUNG;
+            return VALUE_AS_LIST(*value) && GC_FROM_PAYLOAD(VALUE_AS_LIST(*value))->generation == GC_GEN_YOUNG;
         case VAL_DENSE_LIST:
-            return value->dlist && GC_FROM_PAYLOAD(value->dlist)->generation == GC_GEN_YOUNG;
+            return VALUE_AS_DLIST(*value) && GC_FROM_PAYLOAD(VALUE_AS_DLIST(*value))->generation == GC_GEN_YOUNG;
         case VAL_MAP:
-            return value->map && GC_FROM_PAYLOAD(value->map)->generation == GC_GEN_YOUNG;
+            return VALUE_AS_MAP(*value) && GC_FROM_PAYLOAD(VALUE_AS_MAP(*value))->generation == GC_GEN_YOUNG;
         case VAL_CLOSURE:
-            return value->closure && GC_FROM_PAYLOAD(value->closure)->generation == GC_GEN_YOUNG;
+            return VALUE_AS_CLOSURE(*value) && GC_FROM_PAYLOAD(VALUE_AS_CLOSURE(*value))->generation == GC_GEN_YOUNG;
         case VAL_TEMPLATE:
-            return value->template_obj && GC_FROM_PAYLOAD(value->template_obj)->generation == GC_GEN_YOUNG;
+            return VALUE_AS_TEMPLATE(*value) && GC_FROM_PAYLOAD(VALUE_AS_TEMPLATE(*value))->generation == GC_GEN_YOUNG;
+        case VAL_RANGE:
+            return VALUE_AS_RANGE(*value) && GC_FROM_PAYLOAD(VALUE_AS_RANGE(*value))->generation == GC_GEN_YOUNG;
+#ifdef LUNA_NANBOX
+        case VAL_INT:
+            return GC_FROM_PAYLOAD(VALUE_AS_BIG_INT(*value))->generation == GC_GEN_YOUNG;
+#endif
         default:
             return 0;
     }
 }
 
-static int interp_name_start(char c) {
-    return isalpha((unsigned char)c) || c == '_';
-}
-
-static int interp_name_char(char c) {
-    return isalnum((unsigned char)c) || c == '_';
-}
-
 static void interp_append(char **buf, size_t *len, size_t *cap, const char *src, size_t src_len) {
     if (*len + src_len + 1 > *cap) {
         while (*len + src_len + 1 > *cap) *cap *= 2;
@@ -130,94 +136,6 @@ static void interp_append(char **buf, size_t *len, size_t *cap, const char *src,
     (*buf)[*len] = '\0';
 }
 
-static inline int string_may_have_interpolation(const char *src) {
-    if (!src) return 0;
-    const char *p = strchr(src, '{');
-    while (p) {
-        if (interp_name_start(p[1])) return 1;
-        p = strchr(p + 1, '{');
-    }
-    return 0;
-}
-
-static int try_interpolate_string(Env *e, const char *src, Value *out) {
-    if (!e || !src || !out || !strchr(src, '{')) return 0;
-
-    size_t cap = strlen(src) + 32;
-    size_t len = 0;
-    int changed = 0;
-    char *buf = malloc(cap);
-    if (!buf) abort();
-    buf[0] = '\0';
-
-    const char *p = src;
-    while (*p) {
-        if (*p != '{') {
-            interp_append(&buf, &len, &cap, p, 1);
-            p++;
-            continue;
-        }
-
-        const char *close = strchr(p + 1, '}');
-        if (!close) {
-            interp_append(&buf, &len, &cap, p, 1);
-            p++;
-            continue;
-        }
-
-        size_t name_len = (size_t)(close - (p + 1));
-        if (name_len == 0 || !interp_name_start(p[1])) {
-            interp_append(&buf, &len, &cap, p, (size_t)(close - p + 1));
-            p = close + 1;
-            continue;
-        }
-
-        int valid = 1;
-        for (size_t i = 1; i < name_len; i++) {
-            if (!interp_name_char(p[1 + i])) {
-                valid = 0;
-                break;
-            }
-        }
-        if (!valid) {
-            interp_append(&buf, &len, &cap, p, (size_t)(close - p + 1));
-            p = close + 1;
-            continue;
-        }
-
-        char name[256];
-        if (name_len >= sizeof(name)) {
-            interp_append(&buf, &len, &cap, p, (size_t)(close - p + 1));
-            p = close + 1;
-            continue;
-        }
-        memcpy(name, p + 1, name_len);
-        name[name_len] = '\0';
-
-        Value *slot = env_get_text(e, name);
-        if (!slot) {
-            interp_append(&buf, &len, &cap, p, (size_t)(close - p + 1));
-            p = close + 1;
-            continue;
-        }
-
-        char *rendered = value_to_string(*slot);
-        interp_append(&buf, &len, &cap, rendered, strlen(rendered));
-        free(rendered);
-        changed = 1;
-        p = close + 1;
-    }
-
-    if (!changed) {
-        free(buf);
-        return 0;
-    }
-
-    *out = value_string_len(buf, len);
-    free(buf);
-    return 1;
-}
-
 // Flags to handle 'return' statements across recursive calls
 typedef struct {
     int active;
@@ -243,6 +161,16 @@ typedef struct {
 
 static TcoPending tco_pending = {0};
 
+// Closures being called. A callback handed straight to a native (map,
+// filter, ...) is reachable only from the native's argv, so without this a
+// collection inside the call would finalize it and free its captured env.
+typedef struct CallRoot {
+    Value callee;
+    struct CallRoot *prev;
+} CallRoot;
+
+static CallRoot *call_roots = NULL;
+
 // Tracks the function currently being executed (for TCO detection in NODE_RETURN)
 static AstNode *current_executing_fn = NULL;
 static Env *current_executing_env = NULL;
@@ -381,6 +309,9 @@ void interpreter_gc_mark_runtime_roots(void *ctx) {
             value_gc_mark(&tco_pending.args[i], ctx);
         }
     }
+    for (CallRoot *root = call_roots; root; root = root->prev) {
+        value_gc_mark(&root->callee, ctx);
+    }
     for (int i = 0; i < deferred_call_count; i++) {
         value_gc_mark(&deferred_calls[i].callee, ctx);
         for (int j = 0; j < deferred_calls[i].argc; j++) {
@@ -391,48 +322,49 @@ void interpreter_gc_mark_runtime_roots(void *ctx) {
 
 // Centralized Truthiness Logic
 static int is_truthy(Value v) {
-    switch (v.type) {
-        case VAL_BOOL: return v.b;
-        case VAL_INT: return v.i != 0;
-        case VAL_FLOAT: return v.f != 0.0;
-        case VAL_POINTER: return v.ptr != 0;
+    switch (VALUE_TYPE(v)) {
+        case VAL_BOOL: return VALUE_AS_BOOL(v);
+        case VAL_INT: return VALUE_AS_INT(v) != 0;
+        case VAL_FLOAT: return VALUE_AS_FLOAT(v) != 0.0;
+        case VAL_POINTER: return VALUE_AS_PTR(v) != 0;
         case VAL_BLOC:
         case VAL_BLOC_TYPE:
         case VAL_BOX:
         case VAL_TEMPLATE:
             return 1;
-        case VAL_STRING: return v.string && v.string->chars && v.string->chars[0] != '\0'; // Empty strings are false
+        case VAL_STRING: return VALUE_AS_STRING(v) && VALUE_AS_STRING(v)->chars && VALUE_AS_STRING(v)->chars[0] != '\0'; // Empty strings are false
         case VAL_NULL: return 0;
         case VAL_LIST: 
         case VAL_DENSE_LIST:
+        case VAL_RANGE:
         case VAL_MAP: return 1; // containers are truthy
         case VAL_NATIVE: return 1;
-        case VAL_CHAR: return v.c != 0;
-        case VAL_FILE:   return v.file != NULL; // Files are truthy if open
+        case VAL_CHAR: return VALUE_AS_CHAR(v) != 0;
+        case VAL_FILE:   return VALUE_AS_FILE(v) != NULL; // Files are truthy if open
         default: return 0;
     }
 }
 
 Value instantiate_data_type(Value dtype, int argc, Value *argv, int line) {
-    if (dtype.type != VAL_DATA_TYPE || !dtype.dtype) {
+    if (VALUE_TYPE(dtype) != VAL_DATA_TYPE || !VALUE_AS_DTYPE(dtype)) {
         error_report_with_context(ERR_TYPE, line, 0,
             "Value is not a data constructor",
             "Call a data type such as Vec2(1, 2)");
         return value_null();
     }
-    if (argc != dtype.dtype->field_count) {
+    if (argc != VALUE_AS_DTYPE(dtype)->field_count) {
         char msg[256];
         snprintf(msg, sizeof(msg), "Data constructor '%s' expects %d field value(s), but got %d",
-                 dtype.dtype->name ? dtype.dtype->name : "<data>", dtype.dtype->field_count, argc);
+                 VALUE_AS_DTYPE(dtype)->name ? VALUE_AS_DTYPE(dtype)->name : "<data>", VALUE_AS_DTYPE(dtype)->field_count, argc);
         error_report_with_context(ERR_ARGUMENT, line, 0, msg,
             "Pass one value for each declared data field");
         return value_null();
     }
 
-    if (dtype.dtype->is_template) {
+    if (VALUE_AS_DTYPE(dtype)->is_template) {
         char msg[256];
         Value out = value_template_from_dtype(dtype, argc, argv, msg, sizeof(msg));
-        if (out.type == VAL_NULL) {
+        if (VALUE_TYPE(out) == VAL_NULL) {
             error_report_with_context(ERR_ARGUMENT, line, 0, msg,
                 "Pass one value for each declared template field");
         }
@@ -440,9 +372,9 @@ Value instantiate_data_type(Value dtype, int argc, Value *argv, int line) {
     }
 
     Value out = value_map();
-    value_map_set(&out, intern_string("__tag"), value_string(dtype.dtype->name ? dtype.dtype->name : ""));
-    for (int i = 0; i < dtype.dtype->field_count; i++) {
-        value_map_set(&out, dtype.dtype->fields[i], argv[i]);
+    value_map_set(&out, intern_string("__tag"), value_string(VALUE_AS_DTYPE(dtype)->name ? VALUE_AS_DTYPE(dtype)->name : ""));
+    for (int i = 0; i < VALUE_AS_DTYPE(dtype)->field_count; i++) {
+        value_map_set(&out, VALUE_AS_DTYPE(dtype)->fields[i], argv[i]);
     }
     return out;
 }
@@ -450,13 +382,67 @@ Value instantiate_data_type(Value dtype, int argc, Value *argv, int line) {
 static Value eval_expr(Env *e, AstNode *n);
 static Value exec_stmt(Env *e, AstNode *n);
 
+// Reads, parses and runs the module at path in a fresh env below the globals,
+// registering it first so later imports (and import cycles) reuse it.
+// Returns NULL if the module failed to load or run.
+static LunaModule *load_module(Env *e, const char *path, int line) {
+    char *src = read_file(path);
+    if (!src) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "Could not import file '%s'", path);
+        error_report_with_context(ERR_NAME, line, 0, msg,
+            "Check that the import path exists and ends with .lu");
+        return NULL;
+    }
+
+    error_init(src, path);
+    Parser parser;
+    parser_init(&parser, src);
+    AstNode *prog = parser_parse_program(&parser);
+    parser_close(&parser);
+    if (!prog) {
+        free(src);
+        return NULL;
+    }
+
+    const char **exported_names = NULL;
+    int exported_count = 0;
+    collect_module_exports(prog, &exported_names, &exported_count);
+
+    Env *module_env = env_create(env_root(e));
+    LunaModule *module = module_cache_add(path, module_env, exported_names, exported_count);
+    free((void *)exported_names);
+    if (module) {
+        if (prog->kind == NODE_BLOCK) {
+            for (int i = 0; i < prog->block.items.count; i++) {
+                exec_stmt(module_env, prog->block.items.items[i]);
+                gc_safe_point();
+                if (luna_had_error || return_exception.active) break;
+            }
+        } else {
+            exec_stmt(module_env, prog);
+            gc_safe_point();
+        }
+        deferred_calls_run_scope(module_env);
+        if (luna_had_error) {
+            module_cache_remove(module);
+            module = NULL;
+        }
+    }
+    if (!module) env_free(module_env);
+
+    if (prog->kind == NODE_BLOCK) nodelist_free(&prog->block.items);
+    free(src);
+    return module;
+}
+
 static long long normalize_index(long long idx, long long count) {
     if (idx < 0) idx += count;
     return idx;
 }
 static Value make_closure(Env *e, AstNode *fn) {
     int use_live_env = env_is_global(e);
-    Env *captured = use_live_env ? e : env_snapshot(e);
+    Env *captured = use_live_env ? e : env_capture(e, fn->funcdef.captures, fn->funcdef.capture_count);
     Value closure = value_closure(fn, captured, !use_live_env);
     if (fn->funcdef.name && captured && !use_live_env) {
         env_def(captured, fn->funcdef.name, closure);
@@ -467,11 +453,11 @@ static Value make_closure(Env *e, AstNode *fn) {
 static Value call_user_function_with_args(Env *caller_env, Value callee, int argc, Value *argv, int line) {
     AstNode *fn = NULL;
     Env *captured = NULL;
-    if (callee.type == VAL_CLOSURE && callee.closure) {
-        fn = callee.closure->funcdef;
-        captured = callee.closure->env;
-    } else if (callee.type == VAL_FUNCTION) {
-        fn = callee.func;
+    if (VALUE_TYPE(callee) == VAL_CLOSURE && VALUE_AS_CLOSURE(callee)) {
+        fn = VALUE_AS_CLOSURE(callee)->funcdef;
+        captured = VALUE_AS_CLOSURE(callee)->env;
+    } else if (VALUE_TYPE(callee) == VAL_FUNCTION) {
+        fn = VALUE_AS_FUNC(callee);
     } else {
         error_report_with_context(ERR_TYPE, line, 0,
             "Value is not a callable function",
@@ -479,10 +465,7 @@ static Value call_user_function_with_args(Env *caller_env, Value callee, int arg
         return value_null();
     }
 
-    int required = 0;
-    for (int i = 0; i < fn->funcdef.param_count; i++) {
-        if (!fn->funcdef.defaults[i]) required++;
-    }
+    int required = fn->funcdef.required_count;
     if (argc < required || argc > fn->funcdef.param_count) {
         char msg[128];
         snprintf(msg, sizeof(msg), "Function '%s' expects %d-%d argument(s), but got %d",
@@ -492,6 +475,8 @@ static Value call_user_function_with_args(Env *caller_env, Value callee, int arg
         return value_null();
     }
 
+    CallRoot root = { callee, call_roots };
+    call_roots = &root;
     Env *scope = env_create(captured);
     for (int i = 0; i < fn->funcdef.param_count; i++) {
         Value v;
@@ -548,18 +533,19 @@ tco_restart:
     current_executing_env = prev_env;
     deferred_calls_run_scope(scope);
     env_free(scope);
+    call_roots = root.prev;
     return ret;
 }
 
 Value luna_call_value(Env *caller_env, Value callee, int argc, Value *argv, int line) {
-    if (callee.type == VAL_VM_CLOSURE && callee.vm_closure) {
-        return luna_vm_call_closure(luna_gc_runtime_heap(), caller_env, callee.vm_closure, argc, argv, line);
+    if (VALUE_TYPE(callee) == VAL_VM_CLOSURE && VALUE_AS_VM_CLOSURE(callee)) {
+        return luna_vm_call_closure(luna_gc_runtime_heap(), caller_env, VALUE_AS_VM_CLOSURE(callee), argc, argv, line);
     }
-    if (callee.type == VAL_CLOSURE || callee.type == VAL_FUNCTION) {
+    if (VALUE_TYPE(callee) == VAL_CLOSURE || VALUE_TYPE(callee) == VAL_FUNCTION) {
         return call_user_function_with_args(caller_env, callee, argc, argv, line);
     }
-    if (callee.type == VAL_NATIVE) {
-        return ((NativeFunc)callee.native)(argc, argv, caller_env);
+    if (VALUE_TYPE(callee) == VAL_NATIVE) {
+        return ((NativeFunc)VALUE_AS_NATIVE(callee))(argc, argv, caller_env);
     }
     error_report_with_context(ERR_TYPE, line, 0,
         "Value is not callable",
@@ -576,22 +562,22 @@ static Value *get_mutable_value(Env *e, AstNode *n) {
     else if (n->kind == NODE_INDEX) {
         // Recursively get the parent list
         Value *list = get_mutable_value(e, n->index.target);
-        if (!list || (list->type != VAL_LIST && list->type != VAL_DENSE_LIST)) return NULL;
+        if (!list || (VALUE_TYPE(*list) != VAL_LIST && VALUE_TYPE(*list) != VAL_DENSE_LIST)) return NULL;
         
         // Return list reference for dense lists; indexing is handled in assignment logic
-        if (list->type == VAL_DENSE_LIST) return list;
+        if (VALUE_TYPE(*list) == VAL_DENSE_LIST) return list;
 
         // Evaluate index
         Value idx = eval_expr(e, n->index.index);
-        if (idx.type != VAL_INT) {
+        if (VALUE_TYPE(idx) != VAL_INT) {
             value_free(idx);
             return NULL;
         }
         
-        long long normalized = normalize_index(idx.i, list->list->count);
-        if (normalized < 0 || normalized >= list->list->count) {
+        long long normalized = normalize_index(VALUE_AS_INT(idx), VALUE_AS_LIST(*list)->count);
+        if (normalized < 0 || normalized >= VALUE_AS_LIST(*list)->count) {
             char msg[128];
-            snprintf(msg, sizeof(msg), "Index %lld is out of bounds for list of length %d", idx.i, list->list->count);
+            snprintf(msg, sizeof(msg), "Index %lld is out of bounds for list of length %d", VALUE_AS_INT(idx), VALUE_AS_LIST(*list)->count);
             // Updated to use n->line from the AST node
             error_report_with_context(ERR_INDEX, n->line, 0, msg,
                 "Check that your index is between 0 and len(list)-1");
@@ -600,63 +586,63 @@ static Value *get_mutable_value(Env *e, AstNode *n) {
         }
         
         // Return pointer to the specific item slot
-        Value *item_ptr = &list->list->items[normalized];
+        Value *item_ptr = &VALUE_AS_LIST(*list)->items[normalized];
         value_free(idx);
         return item_ptr;
     } else if (n->kind == NODE_FIELD) {
         Value *target = get_mutable_value(e, n->field.target);
         if (!target) return NULL;
-        if (target->type == VAL_TEMPLATE) return value_template_field_slot(target, n->field.field);
-        if (target->type == VAL_MAP) return value_map_get(target, n->field.field);
+        if (VALUE_TYPE(*target) == VAL_TEMPLATE) return value_template_field_slot(target, n->field.field);
+        if (VALUE_TYPE(*target) == VAL_MAP) return value_map_get(target, n->field.field);
     }
     return NULL;
 }
 
 // Handles binary operations like +, -, *, /, comparison
 static Value eval_binop(BinOpKind op, Value l, Value r, int line) {
-    if (l.type == VAL_POINTER && r.type == VAL_POINTER) {
+    if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) {
         switch (op) {
-            case OP_EQ: return value_bool(l.ptr == r.ptr);
-            case OP_NEQ: return value_bool(l.ptr != r.ptr);
-            case OP_LT: return value_bool(l.ptr < r.ptr);
-            case OP_GT: return value_bool(l.ptr > r.ptr);
-            case OP_LTE: return value_bool(l.ptr <= r.ptr);
-            case OP_GTE: return value_bool(l.ptr >= r.ptr);
+            case OP_EQ: return value_bool(VALUE_AS_PTR(l) == VALUE_AS_PTR(r));
+            case OP_NEQ: return value_bool(VALUE_AS_PTR(l) != VALUE_AS_PTR(r));
+            case OP_LT: return value_bool(VALUE_AS_PTR(l) < VALUE_AS_PTR(r));
+            case OP_GT: return value_bool(VALUE_AS_PTR(l) > VALUE_AS_PTR(r));
+            case OP_LTE: return value_bool(VALUE_AS_PTR(l) <= VALUE_AS_PTR(r));
+            case OP_GTE: return value_bool(VALUE_AS_PTR(l) >= VALUE_AS_PTR(r));
             default: break;
         }
     }
 
-    if (l.type == VAL_BLOC && r.type == VAL_BLOC) {
+    if (VALUE_TYPE(l) == VAL_BLOC && VALUE_TYPE(r) == VAL_BLOC) {
         if (op == OP_EQ) return value_bool(value_bloc_equal(l, r));
         if (op == OP_NEQ) return value_bool(!value_bloc_equal(l, r));
     }
 
     // 1. Handle Pure Integer Operations separately to preserve precision/types
-    if (l.type == VAL_INT && r.type == VAL_INT) {
+    if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
         switch (op) {
-            case OP_ADD: return value_int(l.i + r.i);
-            case OP_SUB: return value_int(l.i - r.i);
-            case OP_MUL: return value_int(l.i * r.i);
+            case OP_ADD: return value_int(VALUE_AS_INT(l) + VALUE_AS_INT(r));
+            case OP_SUB: return value_int(VALUE_AS_INT(l) - VALUE_AS_INT(r));
+            case OP_MUL: return value_int(VALUE_AS_INT(l) * VALUE_AS_INT(r));
             case OP_DIV: 
-                if (r.i == 0) return value_int(0); 
+                if (VALUE_AS_INT(r) == 0) return value_int(0); 
                 // Return int if exact division, float otherwise (10/2=5, 10/3=3.333)
-                if (l.i % r.i == 0) return value_int(l.i / r.i);
-                return value_float((double)l.i / (double)r.i);
-            case OP_MOD: return value_int(l.i % r.i);
-            case OP_EQ: return value_bool(l.i == r.i);
-            case OP_NEQ: return value_bool(l.i != r.i);
-            case OP_LT: return value_bool(l.i < r.i);
-            case OP_GT: return value_bool(l.i > r.i);
-            case OP_LTE: return value_bool(l.i <= r.i);
-            case OP_GTE: return value_bool(l.i >= r.i);
+                if (VALUE_AS_INT(l) % VALUE_AS_INT(r) == 0) return value_int(VALUE_AS_INT(l) / VALUE_AS_INT(r));
+                return value_float((double)VALUE_AS_INT(l) / (double)VALUE_AS_INT(r));
+            case OP_MOD: return value_int(VALUE_AS_INT(l) % VALUE_AS_INT(r));
+            case OP_EQ: return value_bool(VALUE_AS_INT(l) == VALUE_AS_INT(r));
+            case OP_NEQ: return value_bool(VALUE_AS_INT(l) != VALUE_AS_INT(r));
+            case OP_LT: return value_bool(VALUE_AS_INT(l) < VALUE_AS_INT(r));
+            case OP_GT: return value_bool(VALUE_AS_INT(l) > VALUE_AS_INT(r));
+            case OP_LTE: return value_bool(VALUE_AS_INT(l) <= VALUE_AS_INT(r));
+            case OP_GTE: return value_bool(VALUE_AS_INT(l) >= VALUE_AS_INT(r));
             default: break;
         }
     }
 
     // 2. Handle Mixed/Float Operations
-    if ((l.type == VAL_INT || l.type == VAL_FLOAT) && (r.type == VAL_INT || r.type == VAL_FLOAT)) {
-        double dl = (l.type == VAL_INT) ? (double)l.i : l.f;
-        double dr = (r.type == VAL_INT) ? (double)r.i : r.f;
+    if ((VALUE_TYPE(l) == VAL_INT || VALUE_TYPE(l) == VAL_FLOAT) && (VALUE_TYPE(r) == VAL_INT || VALUE_TYPE(r) == VAL_FLOAT)) {
+        double dl = (VALUE_TYPE(l) == VAL_INT) ? (double)VALUE_AS_INT(l) : VALUE_AS_FLOAT(l);
+        double dr = (VALUE_TYPE(r) == VAL_INT) ? (double)VALUE_AS_INT(r) : VALUE_AS_FLOAT(r);
         int is_res_float = 1; 
         
         double res = 0;
@@ -686,35 +672,35 @@ static Value eval_binop(BinOpKind op, Value l, Value r, int line) {
     }
     
     // Handle String Equality
-    if (l.type == VAL_STRING && r.type == VAL_STRING && l.string && r.string) {
-        if (op == OP_EQ) return value_bool(strcmp(l.string->chars, r.string->chars) == 0);
-        if (op == OP_NEQ) return value_bool(strcmp(l.string->chars, r.string->chars) != 0);
+    if (VALUE_TYPE(l) == VAL_STRING && VALUE_TYPE(r) == VAL_STRING && VALUE_AS_STRING(l) && VALUE_AS_STRING(r)) {
+        if (op == OP_EQ) return value_bool(strcmp(VALUE_AS_STRING(l)->chars, VALUE_AS_STRING(r)->chars) == 0);
+        if (op == OP_NEQ) return value_bool(strcmp(VALUE_AS_STRING(l)->chars, VALUE_AS_STRING(r)->chars) != 0);
     }
 
     // Handle Boolean and Null Equality
     if (op == OP_EQ) {
-        if (l.type == VAL_BOOL && r.type == VAL_BOOL) return value_bool(l.b == r.b);
-        if (l.type == VAL_NULL && r.type == VAL_NULL) return value_bool(1);
-        if (l.type == VAL_NULL || r.type == VAL_NULL) return value_bool(0);
+        if (VALUE_TYPE(l) == VAL_BOOL && VALUE_TYPE(r) == VAL_BOOL) return value_bool(VALUE_AS_BOOL(l) == VALUE_AS_BOOL(r));
+        if (VALUE_TYPE(l) == VAL_NULL && VALUE_TYPE(r) == VAL_NULL) return value_bool(1);
+        if (VALUE_TYPE(l) == VAL_NULL || VALUE_TYPE(r) == VAL_NULL) return value_bool(0);
     }
     if (op == OP_NEQ) {
-        if (l.type == VAL_BOOL && r.type == VAL_BOOL) return value_bool(l.b != r.b);
-        if (l.type == VAL_NULL && r.type == VAL_NULL) return value_bool(0);
-        if (l.type == VAL_NULL || r.type == VAL_NULL) return value_bool(1);
+        if (VALUE_TYPE(l) == VAL_BOOL && VALUE_TYPE(r) == VAL_BOOL) return value_bool(VALUE_AS_BOOL(l) != VALUE_AS_BOOL(r));
+        if (VALUE_TYPE(l) == VAL_NULL && VALUE_TYPE(r) == VAL_NULL) return value_bool(0);
+        if (VALUE_TYPE(l) == VAL_NULL || VALUE_TYPE(r) == VAL_NULL) return value_bool(1);
     }
 
     // Handle Char Equality
-    if (l.type == VAL_CHAR && r.type == VAL_CHAR) {
-        if (op == OP_EQ) return value_bool(l.c == r.c);
-        if (op == OP_NEQ) return value_bool(l.c != r.c);
+    if (VALUE_TYPE(l) == VAL_CHAR && VALUE_TYPE(r) == VAL_CHAR) {
+        if (op == OP_EQ) return value_bool(VALUE_AS_CHAR(l) == VALUE_AS_CHAR(r));
+        if (op == OP_NEQ) return value_bool(VALUE_AS_CHAR(l) != VALUE_AS_CHAR(r));
     }
 
     // Handle String Concatenation
-    if (op == OP_ADD && (l.type == VAL_STRING || r.type == VAL_STRING)) {
+    if (op == OP_ADD && (VALUE_TYPE(l) == VAL_STRING || VALUE_TYPE(r) == VAL_STRING)) {
         // Fast path: both sides are strings — concat directly (2 mallocs instead of 5)
-        if (l.type == VAL_STRING && r.type == VAL_STRING) {
-            const char *lc = (l.string && l.string->chars) ? l.string->chars : "";
-            const char *rc = (r.string && r.string->chars) ? r.string->chars : "";
+        if (VALUE_TYPE(l) == VAL_STRING && VALUE_TYPE(r) == VAL_STRING) {
+            const char *lc = (VALUE_AS_STRING(l) && VALUE_AS_STRING(l)->chars) ? VALUE_AS_STRING(l)->chars : "";
+            const char *rc = (VALUE_AS_STRING(r) && VALUE_AS_STRING(r)->chars) ? VALUE_AS_STRING(r)->chars : "";
             size_t ll = strlen(lc), rl = strlen(rc);
             return value_string_concat_raw(lc, ll, rc, rl);
         }
@@ -727,8 +713,7 @@ static Value eval_binop(BinOpKind op, Value l, Value r, int line) {
         free(sr);
         return v;
     }
-    if ((l.type == VAL_LIST || l.type == VAL_DENSE_LIST) && 
-        (r.type == VAL_LIST || r.type == VAL_DENSE_LIST)) {
+    if (VEC_IS_OPERAND(l) && VEC_IS_OPERAND(r)) {
         switch (op) {
             case OP_ADD: return vec_add_values(l, r);
             case OP_SUB: return vec_sub_values(l, r);
@@ -744,6 +729,22 @@ static Value eval_binop(BinOpKind op, Value l, Value r, int line) {
     return value_null();
 }
 
+// Binding a name site refers to. Repeat visits in one scope reuse the cached
+// pointer; a new scope (every call, every closure) goes straight to the slot
+// the name resolved to last time, and only a miss there searches the chain.
+static inline Value *lookup_site(Env *e, const char *name, Value **cached_val,
+                                 uint64_t *cached_scope, int *hops, int *slot) {
+    uint64_t scope = env_scope_id(e);
+    if (*cached_val && *cached_scope == scope) return *cached_val;
+    Value *v = env_at(e, name, *hops, *slot);
+    if (!v) v = env_resolve(e, name, hops, slot);
+    if (v) {
+        *cached_val = v;
+        *cached_scope = scope;
+    }
+    return v;
+}
+
 // Evaluates an expression node and returns a Value
 static Value eval_expr(Env *e, AstNode *n) {
     if (luna_had_error) return value_null();
@@ -755,17 +756,12 @@ static Value eval_expr(Env *e, AstNode *n) {
         case NODE_NUMBER: return value_int(n->number.value);
         case NODE_FLOAT: return value_float(n->fnumber.value);
         case NODE_STRING:
-            if (string_may_have_interpolation(n->string.text)) {
-                Value interpolated;
-                if (try_interpolate_string(e, n->string.text, &interpolated)) {
-                    return interpolated;
-                }
-            }
+            /* "{name}" never reaches here: the parser splits it into a NODE_TEMPLATE. */
             if (!luna_gc_runtime_enabled()) return value_string(n->string.text);
-            if (n->string.cached.type != VAL_STRING || !n->string.cached.string) {
+            if (VALUE_TYPE(n->string.cached) != VAL_STRING || !VALUE_AS_STRING(n->string.cached)) {
                 n->string.cached = value_string(n->string.text);
-                if (n->string.cached.string) {
-                    luna_gc_runtime_add_root(n->string.cached.string);
+                if (VALUE_AS_STRING(n->string.cached)) {
+                    luna_gc_runtime_add_root(VALUE_AS_STRING(n->string.cached));
                 }
             }
             return n->string.cached;
@@ -780,9 +776,12 @@ static Value eval_expr(Env *e, AstNode *n) {
                 const char *chunk = n->template_string.chunks[i] ? n->template_string.chunks[i] : "";
                 interp_append(&buf, &len, &cap, chunk, strlen(chunk));
                 Value part = eval_expr(e, n->template_string.exprs[i]);
-                char *rendered = value_to_string(part);
-                interp_append(&buf, &len, &cap, rendered, strlen(rendered));
-                free(rendered);
+                char scratch[VALUE_SCRATCH_LEN];
+                char *owned;
+                size_t part_len;
+                const char *rendered = value_string_view(part, scratch, &part_len, &owned);
+                interp_append(&buf, &len, &cap, rendered, part_len);
+                free(owned);
                 value_free(part);
             }
             const char *tail = n->template_string.chunks[n->template_string.expr_count] ?
@@ -826,7 +825,7 @@ static Value eval_expr(Env *e, AstNode *n) {
         }
         case NODE_FIELD: {
             Value target = eval_expr(e, n->field.target);
-            if (target.type == VAL_BOX) {
+            if (VALUE_TYPE(target) == VAL_BOX) {
                 Value res = value_null();
                 int found = 1;
                 if (n->field.field == intern_string("len")) {
@@ -846,7 +845,7 @@ static Value eval_expr(Env *e, AstNode *n) {
                 return found ? res : value_null();
             }
 
-            if (target.type == VAL_TEMPLATE) {
+            if (VALUE_TYPE(target) == VAL_TEMPLATE) {
                 int found = 0;
                 Value res = value_template_get_field(target, n->field.field, &found);
                 if (!found) {
@@ -879,7 +878,7 @@ static Value eval_expr(Env *e, AstNode *n) {
                     "Define the bloc before constructing it");
                 return value_null();
             }
-            if (ctor->type == VAL_BLOC_TYPE) {
+            if (VALUE_TYPE(*ctor) == VAL_BLOC_TYPE) {
                 int argc = n->typed_init.args.count;
                 Value *argv = argc > 0 ? malloc(sizeof(Value) * (size_t)argc) : NULL;
                 for (int i = 0; i < argc; i++) {
@@ -908,7 +907,7 @@ static Value eval_expr(Env *e, AstNode *n) {
         }
         case NODE_BOX_ALLOC: {
             Value size = eval_expr(e, n->box_alloc.size);
-            if (size.type != VAL_INT) {
+            if (VALUE_TYPE(size) != VAL_INT) {
                 error_report_with_context(ERR_TYPE, n->line, 0,
                     "box[...] expects an integer byte size",
                     "Use box[128] or another positive integer size");
@@ -916,8 +915,8 @@ static Value eval_expr(Env *e, AstNode *n) {
                 return value_null();
             }
             char msg[256];
-            Value res = value_box((size_t)size.i, msg, sizeof(msg));
-            if (res.type == VAL_NULL) {
+            Value res = value_box((size_t)VALUE_AS_INT(size), msg, sizeof(msg));
+            if (VALUE_TYPE(res) == VAL_NULL) {
                 error_report_with_context(ERR_ARGUMENT, n->line, 0, msg,
                     "Boxes are stack-scoped scratch buffers up to one cache line");
             } else {
@@ -931,11 +930,8 @@ static Value eval_expr(Env *e, AstNode *n) {
         
         // Variable lookup (O(0) Fast Local Cache)
         case NODE_IDENT: {
-            if (n->ident.cached_val && n->ident.cached_env_version == env_scope_id(e)) {
-                return value_copy(*(n->ident.cached_val));
-            }
-
-            Value *v = env_get(e, n->ident.name);
+            Value *v = lookup_site(e, n->ident.name, &n->ident.cached_val, &n->ident.cached_env_version,
+                                   &n->ident.cached_hops, &n->ident.cached_slot);
             if (!v) {
                 char msg[256];
                 snprintf(msg, sizeof(msg), "Variable '%s' is not defined", n->ident.name);
@@ -943,9 +939,6 @@ static Value eval_expr(Env *e, AstNode *n) {
                     "Declare variables with 'let' before using them");
                 return value_null();
             }
-            // Bind the cache pointer
-            n->ident.cached_val = v;
-            n->ident.cached_env_version = env_scope_id(e);
             return value_copy(*v);
         }
         
@@ -1005,39 +998,46 @@ static Value eval_expr(Env *e, AstNode *n) {
         case NODE_INDEX: {
             Value target = eval_expr(e, n->index.target);
             Value idx = eval_expr(e, n->index.index);
-            if (idx.type == VAL_INT) {
-                if (target.type == VAL_LIST && target.list) {
-                    long long normalized = normalize_index(idx.i, target.list->count);
-                    if (normalized >= 0 && normalized < target.list->count) {
-                        Value res = value_copy(target.list->items[normalized]);
+            if (VALUE_TYPE(idx) == VAL_INT) {
+                if (VALUE_TYPE(target) == VAL_LIST && VALUE_AS_LIST(target)) {
+                    long long normalized = normalize_index(VALUE_AS_INT(idx), VALUE_AS_LIST(target)->count);
+                    if (normalized >= 0 && normalized < VALUE_AS_LIST(target)->count) {
+                        Value res = value_copy(VALUE_AS_LIST(target)->items[normalized]);
                         value_free(target);
                         value_free(idx);
                         return res;
                     }
-                } else if (target.type == VAL_DENSE_LIST && target.dlist) {
-                    long long normalized = normalize_index(idx.i, target.dlist->count);
-                    if (normalized >= 0 && normalized < target.dlist->count) {
-                        Value res = value_float(target.dlist->data[normalized]);
+                } else if (VALUE_TYPE(target) == VAL_DENSE_LIST && VALUE_AS_DLIST(target)) {
+                    long long normalized = normalize_index(VALUE_AS_INT(idx), VALUE_AS_DLIST(target)->count);
+                    if (normalized >= 0 && normalized < VALUE_AS_DLIST(target)->count) {
+                        Value res = value_float(VALUE_AS_DLIST(target)->data[normalized]);
                         value_free(target);
                         value_free(idx);
                         return res;
                     }
-                } else if (target.type == VAL_STRING && target.string) {
-                    long long len = (long long)strlen(target.string->chars);
-                    long long normalized = normalize_index(idx.i, len);
+                } else if (VALUE_TYPE(target) == VAL_STRING && VALUE_AS_STRING(target)) {
+                    long long len = (long long)strlen(VALUE_AS_STRING(target)->chars);
+                    long long normalized = normalize_index(VALUE_AS_INT(idx), len);
                     if (normalized >= 0 && normalized < len) {
-                        Value res = value_char(target.string->chars[normalized]);
+                        Value res = value_char(VALUE_AS_STRING(target)->chars[normalized]);
                         value_free(target);
                         value_free(idx);
                         return res;
                     }
-                } else if (target.type == VAL_MAP) {
+                } else if (VALUE_TYPE(target) == VAL_RANGE) {
+                    long long normalized = normalize_index(VALUE_AS_INT(idx), value_range_len(VALUE_AS_RANGE(target)));
+                    if (normalized >= 0 && normalized < value_range_len(VALUE_AS_RANGE(target))) {
+                        Value res = value_range_get(VALUE_AS_RANGE(target), normalized);
+                        value_free(target);
+                        return res;
+                    }
+                } else if (VALUE_TYPE(target) == VAL_MAP) {
                     value_free(idx);
                     value_free(target);
                     return value_null();
                 }
-            } else if (idx.type == VAL_STRING && idx.string && target.type == VAL_MAP && target.map) {
-                Value *slot = value_map_get(&target, intern_string(idx.string->chars));
+            } else if (VALUE_TYPE(idx) == VAL_STRING && VALUE_AS_STRING(idx) && VALUE_TYPE(target) == VAL_MAP && VALUE_AS_MAP(target)) {
+                Value *slot = value_map_get(&target, intern_string(VALUE_AS_STRING(idx)->chars));
                 Value res = slot ? value_copy(*slot) : value_null();
                 value_free(target);
                 value_free(idx);
@@ -1050,24 +1050,16 @@ static Value eval_expr(Env *e, AstNode *n) {
 
         //  Increment Operator (++)
         case NODE_INC: {
-            Value *v = NULL;
-            if (n->inc.cached_val && n->inc.cached_env_version == env_scope_id(e)) {
-                v = n->inc.cached_val;
-            } else {
-                v = env_get(e, n->inc.name);
-                if (v) {
-                    n->inc.cached_val = v;
-                    n->inc.cached_env_version = env_scope_id(e);
-                }
-            }
+            Value *v = lookup_site(e, n->inc.name, &n->inc.cached_val, &n->inc.cached_env_version,
+                                   &n->inc.cached_hops, &n->inc.cached_slot);
             
-            if (v && v->type == VAL_INT) {
+            if (v && VALUE_TYPE(*v) == VAL_INT) {
                 Value old = value_copy(*v);
-                v->i++;
+                VALUE_SET_INT(v, VALUE_AS_INT(*v) + 1);
                 return old;
-            } else if (v && v->type == VAL_FLOAT) {
+            } else if (v && VALUE_TYPE(*v) == VAL_FLOAT) {
                 Value old = value_copy(*v);
-                v->f++;
+                VALUE_SET_FLOAT(v, VALUE_AS_FLOAT(*v) + 1);
                 return old;
             }
             return value_null();
@@ -1075,24 +1067,16 @@ static Value eval_expr(Env *e, AstNode *n) {
         
         // Decrement Operator (--)
         case NODE_DEC: {
-            Value *v = NULL;
-            if (n->dec.cached_val && n->dec.cached_env_version == env_scope_id(e)) {
-                v = n->dec.cached_val;
-            } else {
-                v = env_get(e, n->dec.name);
-                if (v) {
-                    n->dec.cached_val = v;
-                    n->dec.cached_env_version = env_scope_id(e);
-                }
-            }
+            Value *v = lookup_site(e, n->dec.name, &n->dec.cached_val, &n->dec.cached_env_version,
+                                   &n->dec.cached_hops, &n->dec.cached_slot);
             
-            if (v && v->type == VAL_INT) {
+            if (v && VALUE_TYPE(*v) == VAL_INT) {
                 Value old = value_copy(*v);
-                v->i--;
+                VALUE_SET_INT(v, VALUE_AS_INT(*v) - 1);
                 return old;
-            } else if (v && v->type == VAL_FLOAT) {
+            } else if (v && VALUE_TYPE(*v) == VAL_FLOAT) {
                 Value old = value_copy(*v);
-                v->f--;
+                VALUE_SET_FLOAT(v, VALUE_AS_FLOAT(*v) - 1);
                 return old;
             }
             return value_null();
@@ -1132,7 +1116,7 @@ static Value eval_expr(Env *e, AstNode *n) {
                         return value_null();
                     }
                     Value target = eval_expr(e, n->call.args.items[0]);
-                    if (target.type == VAL_BOX) {
+                    if (VALUE_TYPE(target) == VAL_BOX) {
                         char msg[256];
                         Value res = value_null();
                         if (!value_box_free(target, msg, sizeof(msg))) {
@@ -1266,9 +1250,9 @@ static Value eval_expr(Env *e, AstNode *n) {
                     }
 
                     Value deferred_callee = eval_expr(e, arg->call.callee);
-                    if (deferred_callee.type != VAL_CLOSURE &&
-                        deferred_callee.type != VAL_FUNCTION &&
-                        deferred_callee.type != VAL_NATIVE) {
+                    if (VALUE_TYPE(deferred_callee) != VAL_CLOSURE &&
+                        VALUE_TYPE(deferred_callee) != VAL_FUNCTION &&
+                        VALUE_TYPE(deferred_callee) != VAL_NATIVE) {
                         error_report_with_context(ERR_TYPE, n->line, 0,
                             "defer() needs a callable expression",
                             "Wrap the cleanup work in a function call, for example defer(close(file))");
@@ -1307,25 +1291,25 @@ static Value eval_expr(Env *e, AstNode *n) {
                 case CALL_SHAPE: {
                     if (n->call.args.count == 1) {
                         Value v = eval_expr(e, n->call.args.items[0]);
-                        if (v.type == VAL_BLOC) {
+                        if (VALUE_TYPE(v) == VAL_BLOC) {
                             const char *name = value_bloc_name(v);
                             Value out = name ? value_string(name) : value_null();
                             value_free(v);
                             return out;
                         }
-                        if (v.type == VAL_BOX) {
+                        if (VALUE_TYPE(v) == VAL_BOX) {
                             value_free(v);
                             return value_string("box");
                         }
-                        if (v.type == VAL_TEMPLATE) {
+                        if (VALUE_TYPE(v) == VAL_TEMPLATE) {
                             const char *name = value_template_name(v);
                             Value out = name ? value_string(name) : value_null();
                             value_free(v);
                             return out;
                         }
-                        if (v.type == VAL_MAP && v.map) {
+                        if (VALUE_TYPE(v) == VAL_MAP && VALUE_AS_MAP(v)) {
                             Value *tag = value_map_get(&v, intern_string("__tag"));
-                            if (tag && tag->type == VAL_STRING && tag->string) {
+                            if (tag && VALUE_TYPE(*tag) == VAL_STRING && VALUE_AS_STRING(*tag)) {
                                 Value out = value_copy(*tag);
                                 value_free(v);
                                 return out;
@@ -1340,12 +1324,13 @@ static Value eval_expr(Env *e, AstNode *n) {
                     if (n->call.args.count == 1) {
                         Value v = eval_expr(e, n->call.args.items[0]);
                         int len = 0;
-                        if (v.type == VAL_STRING && v.string) len = strlen(v.string->chars);
-                        if (v.type == VAL_LIST && v.list) len = v.list->count;
-                        if (v.type == VAL_DENSE_LIST && v.dlist) len = v.dlist->count;
-                        if (v.type == VAL_MAP && v.map) len = v.map->count;
-                        if (v.type == VAL_BOX) len = (int)value_box_len(v);
-                        if (v.type == VAL_TEMPLATE) len = value_template_len(v);
+                        if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v)) len = strlen(VALUE_AS_STRING(v)->chars);
+                        if (VALUE_TYPE(v) == VAL_LIST && VALUE_AS_LIST(v)) len = VALUE_AS_LIST(v)->count;
+                        if (VALUE_TYPE(v) == VAL_DENSE_LIST && VALUE_AS_DLIST(v)) len = VALUE_AS_DLIST(v)->count;
+                        if (VALUE_TYPE(v) == VAL_RANGE) len = (int)value_range_len(VALUE_AS_RANGE(v));
+                        if (VALUE_TYPE(v) == VAL_MAP && VALUE_AS_MAP(v)) len = VALUE_AS_MAP(v)->count;
+                        if (VALUE_TYPE(v) == VAL_BOX) len = (int)value_box_len(v);
+                        if (VALUE_TYPE(v) == VAL_TEMPLATE) len = value_template_len(v);
                         value_free(v);
                         return value_int(len);
                     }
@@ -1358,6 +1343,7 @@ static Value eval_expr(Env *e, AstNode *n) {
                     }
 
                     Value *list_ptr = get_mutable_value(e, n->call.args.items[0]);
+                    if (list_ptr) value_range_materialize(list_ptr);
                     Value item_val = eval_expr(e, n->call.args.items[1]);
                     if (unsafe_block_depth > 0 && unsafe_runtime_is_pointer(item_val) &&
                         !unsafe_runtime_check_gc_store(item_val, n->line)) {
@@ -1365,10 +1351,10 @@ static Value eval_expr(Env *e, AstNode *n) {
                         return value_null();
                     }
 
-                    if (list_ptr && list_ptr->type == VAL_LIST) {
+                    if (list_ptr && VALUE_TYPE(*list_ptr) == VAL_LIST) {
                         value_list_append_move(list_ptr, &item_val);
-                    } else if (list_ptr && list_ptr->type == VAL_DENSE_LIST) {
-                        double dv = (item_val.type == VAL_INT) ? (double)item_val.i : item_val.f;
+                    } else if (list_ptr && VALUE_TYPE(*list_ptr) == VAL_DENSE_LIST) {
+                        double dv = (VALUE_TYPE(item_val) == VAL_INT) ? (double)VALUE_AS_INT(item_val) : VALUE_AS_FLOAT(item_val);
                         value_dlist_append(list_ptr, dv);
                     } else {
                         error_report_with_context(ERR_ARGUMENT, n->line, 0,
@@ -1383,9 +1369,9 @@ static Value eval_expr(Env *e, AstNode *n) {
                     if (n->call.args.count == 1) {
                         Value v = eval_expr(e, n->call.args.items[0]);
                         char *tname = "unknown";
-                        switch (v.type) {
+                        switch (VALUE_TYPE(v)) {
                             case VAL_INT:
-                                tname = (v.i > INT_MAX || v.i < INT_MIN) ? "long" : "int";
+                                tname = (VALUE_AS_INT(v) > INT_MAX || VALUE_AS_INT(v) < INT_MIN) ? "long" : "int";
                                 break;
                             case VAL_FLOAT: tname = "float"; break;
                             case VAL_STRING: tname = "string"; break;
@@ -1396,7 +1382,8 @@ static Value eval_expr(Env *e, AstNode *n) {
                             case VAL_BLOC_TYPE: tname = "bloc_type"; break;
                             case VAL_BOX: tname = "box"; break;
                             case VAL_LIST:
-                            case VAL_DENSE_LIST: tname = "list"; break;
+                            case VAL_DENSE_LIST:
+                            case VAL_RANGE: tname = "list"; break;
                             case VAL_MAP: tname = "map"; break;
                             case VAL_TEMPLATE: tname = "template"; break;
                             case VAL_DATA_TYPE: tname = "data_type"; break;
@@ -1415,12 +1402,12 @@ static Value eval_expr(Env *e, AstNode *n) {
                     if (n->call.args.count == 1) {
                         Value v = eval_expr(e, n->call.args.items[0]);
                         long long res = 0;
-                        if (unsafe_runtime_is_pointer(v)) res = (long long)v.ptr;
-                        else if (v.type == VAL_STRING && v.string) res = atoll(v.string->chars);
-                        else if (v.type == VAL_FLOAT) res = (long long)v.f;
-                        else if (v.type == VAL_INT) res = v.i;
-                        else if (v.type == VAL_BOOL) res = v.b;
-                        else if (v.type == VAL_CHAR) res = (long long)v.c;
+                        if (unsafe_runtime_is_pointer(v)) res = (long long)VALUE_AS_PTR(v);
+                        else if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v)) res = atoll(VALUE_AS_STRING(v)->chars);
+                        else if (VALUE_TYPE(v) == VAL_FLOAT) res = (long long)VALUE_AS_FLOAT(v);
+                        else if (VALUE_TYPE(v) == VAL_INT) res = VALUE_AS_INT(v);
+                        else if (VALUE_TYPE(v) == VAL_BOOL) res = VALUE_AS_BOOL(v);
+                        else if (VALUE_TYPE(v) == VAL_CHAR) res = (long long)VALUE_AS_CHAR(v);
                         value_free(v);
                         return value_int(res);
                     }
@@ -1434,10 +1421,10 @@ static Value eval_expr(Env *e, AstNode *n) {
                             return value_null();
                         }
                         double res = 0.0;
-                        if (v.type == VAL_STRING && v.string) res = atof(v.string->chars);
-                        else if (v.type == VAL_INT) res = (double)v.i;
-                        else if (v.type == VAL_FLOAT) res = v.f;
-                        else if (v.type == VAL_BOOL) res = v.b ? 1.0 : 0.0;
+                        if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v)) res = atof(VALUE_AS_STRING(v)->chars);
+                        else if (VALUE_TYPE(v) == VAL_INT) res = (double)VALUE_AS_INT(v);
+                        else if (VALUE_TYPE(v) == VAL_FLOAT) res = VALUE_AS_FLOAT(v);
+                        else if (VALUE_TYPE(v) == VAL_BOOL) res = VALUE_AS_BOOL(v) ? 1.0 : 0.0;
                         value_free(v);
                         return value_float(res);
                     }
@@ -1448,7 +1435,7 @@ static Value eval_expr(Env *e, AstNode *n) {
             }
 
             Value callee = eval_expr(e, n->call.callee);
-            if (callee.type == VAL_DATA_TYPE) {
+            if (VALUE_TYPE(callee) == VAL_DATA_TYPE) {
                 int argc = n->call.args.count;
                 Value argv_stack[CALL_ARG_STACK_MAX];
                 Value *argv = argc > 0 ? call_arg_buffer(argc, argv_stack) : NULL;
@@ -1459,7 +1446,7 @@ static Value eval_expr(Env *e, AstNode *n) {
                 value_free(callee);
                 return res;
             }
-            if (callee.type == VAL_CLOSURE || callee.type == VAL_FUNCTION) {
+            if (VALUE_TYPE(callee) == VAL_CLOSURE || VALUE_TYPE(callee) == VAL_FUNCTION) {
                 if (unsafe_block_depth > 0 &&
                     !unsafe_runtime_check_call(0, n->line)) {
                     value_free(callee);
@@ -1478,7 +1465,7 @@ static Value eval_expr(Env *e, AstNode *n) {
                 return res;
             }
 
-            if (callee.type == VAL_NATIVE) {
+            if (VALUE_TYPE(callee) == VAL_NATIVE) {
                 if (unsafe_block_depth > 0 &&
                     !unsafe_runtime_check_call(1, n->line)) {
                     value_free(callee);
@@ -1487,27 +1474,40 @@ static Value eval_expr(Env *e, AstNode *n) {
                 // Evaluate Arguments first
                 int argc = n->call.args.count;
                 Value argv_stack[CALL_ARG_STACK_MAX];
-                int direct_ref_stack[CALL_ARG_STACK_MAX];
                 Value *argv = argc > 0 ? call_arg_buffer(argc, argv_stack) : NULL;
-                int *is_direct_ref = argc > 0 ? call_flag_buffer(argc, direct_ref_stack) : NULL;
+                if (n->call.ident_args == 0) {
+                    // No identifier args: nothing can be passed by reference
+                    for (int i = 0; i < argc; i++) argv[i] = eval_expr(e, n->call.args.items[i]);
+                    Value res = ((NativeFunc)VALUE_AS_NATIVE(callee))(argc, argv, e);
+                    for (int i = 0; i < argc; i++) value_free(argv[i]);
+                    call_arg_buffer_release(argv, argv_stack);
+                    value_free(callee);
+                    return res;
+                }
+
+                int direct_ref_stack[CALL_ARG_STACK_MAX] = {0};
+                int *is_direct_ref = call_flag_buffer(argc, direct_ref_stack);
                 for (int i = 0; i < argc; i++) {
                     // Now it Passes list identifiers by reference to allow in-place modification
-                    if (n->call.args.items[i]->kind == NODE_IDENT) {
-                        Value *env_ref = env_get(e, n->call.args.items[i]->ident.name);
-                        if (env_ref && (env_ref->type == VAL_LIST || env_ref->type == VAL_DENSE_LIST ||
-                                        env_ref->type == VAL_MAP || env_ref->type == VAL_TEMPLATE)) {
+                    AstNode *arg = n->call.args.items[i];
+                    if (arg->kind == NODE_IDENT) {
+                        Value *env_ref = lookup_site(e, arg->ident.name, &arg->ident.cached_val,
+                                                     &arg->ident.cached_env_version,
+                                                     &arg->ident.cached_hops, &arg->ident.cached_slot);
+                        if (env_ref && (VALUE_TYPE(*env_ref) == VAL_LIST || VALUE_TYPE(*env_ref) == VAL_DENSE_LIST ||
+                                        VALUE_TYPE(*env_ref) == VAL_MAP || VALUE_TYPE(*env_ref) == VAL_TEMPLATE)) {
                             argv[i] = *env_ref; // Pass direct reference
                             is_direct_ref[i] = 1;
                         } else {
-                            argv[i] = eval_expr(e, n->call.args.items[i]);
+                            argv[i] = env_ref ? value_copy(*env_ref) : eval_expr(e, arg);
                         }
                     } else {
-                        argv[i] = eval_expr(e, n->call.args.items[i]);
+                        argv[i] = eval_expr(e, arg);
                     }
                 }
 
                 // Call the C Function Pointer - Updated to pass environment 'e' for variable binding
-                Value res = ((NativeFunc)callee.native)(argc, argv, e);
+                Value res = ((NativeFunc)VALUE_AS_NATIVE(callee))(argc, argv, e);
 
                 // Clean up arguments
                 for (int i = 0; i < argc; i++) {
@@ -1570,20 +1570,13 @@ static Value exec_stmt(Env *e, AstNode *n) {
                 value_free(v);
                 return value_null();
             }
-            if (n->assign.cached_val && n->assign.cached_env_version == env_scope_id(e)) {
-                // O(0) cache hit update
-                value_free(*(n->assign.cached_val));
-                *(n->assign.cached_val) = v;
+            Value *target = lookup_site(e, n->assign.name, &n->assign.cached_val, &n->assign.cached_env_version,
+                                        &n->assign.cached_hops, &n->assign.cached_slot);
+            if (target) {
+                value_free(*target);
+                *target = v;
             } else {
-                Value *target = env_get(e, n->assign.name);
-                if (target) {
-                    n->assign.cached_val = target;
-                    n->assign.cached_env_version = env_scope_id(e);
-                    value_free(*target);
-                    *target = v;
-                } else {
-                    env_assign_move(e, n->assign.name, &v); // fallback: move into parent scope
-                }
+                env_assign_move(e, n->assign.name, &v); // fallback: reports the undefined name
             }
             return value_null();
         }
@@ -1597,10 +1590,11 @@ static Value exec_stmt(Env *e, AstNode *n) {
             
             // Get pointer to the actual list item in the environment
             Value *target = get_mutable_value(e, n->assign_index.list);
+            if (target) value_range_materialize(target);
             
             // Verify target is actually a list
-            if (!target || (target->type != VAL_LIST && target->type != VAL_DENSE_LIST &&
-                            target->type != VAL_MAP && target->type != VAL_TEMPLATE)) {
+            if (!target || (VALUE_TYPE(*target) != VAL_LIST && VALUE_TYPE(*target) != VAL_DENSE_LIST &&
+                            VALUE_TYPE(*target) != VAL_MAP && VALUE_TYPE(*target) != VAL_TEMPLATE)) {
                 // Use node line number
                 error_report_with_context(ERR_TYPE, n->line, 0,
                     "Cannot assign through this target",
@@ -1611,7 +1605,7 @@ static Value exec_stmt(Env *e, AstNode *n) {
 
             // Evaluate the index
             Value idx = eval_expr(e, n->assign_index.index);
-            if ((target->type == VAL_LIST || target->type == VAL_DENSE_LIST) && idx.type != VAL_INT) {
+            if ((VALUE_TYPE(*target) == VAL_LIST || VALUE_TYPE(*target) == VAL_DENSE_LIST) && VALUE_TYPE(idx) != VAL_INT) {
                 // Use node line number
                 error_report_with_context(ERR_TYPE, n->line, 0,
                     "List index must be an integer",
@@ -1621,13 +1615,13 @@ static Value exec_stmt(Env *e, AstNode *n) {
                 return value_null();
             }
 
-            if (target->type == VAL_LIST && target->list) {
-                long long normalized = normalize_index(idx.i, target->list->count);
+            if (VALUE_TYPE(*target) == VAL_LIST && VALUE_AS_LIST(*target)) {
+                long long normalized = normalize_index(VALUE_AS_INT(idx), VALUE_AS_LIST(*target)->count);
                 // Bounds Check
-                if (normalized < 0 || normalized >= target->list->count) {
+                if (normalized < 0 || normalized >= VALUE_AS_LIST(*target)->count) {
                     char msg[128];
                     snprintf(msg, sizeof(msg), "Index %lld is out of bounds for list of length %d",
-                            idx.i, target->list->count);
+                            VALUE_AS_INT(idx), VALUE_AS_LIST(*target)->count);
                     // Use node line number
                     error_report_with_context(ERR_INDEX, n->line, 0, msg,
                         "Ensure your index is between 0 and len(list)-1");
@@ -1638,16 +1632,16 @@ static Value exec_stmt(Env *e, AstNode *n) {
 
                 // Assign to the specific slot
                 // Move value directly into list slot (no copy needed)
-                Value *slot = &target->list->items[normalized];
+                Value *slot = &VALUE_AS_LIST(*target)->items[normalized];
                 gc_note_heap_value_overwrite(slot);
-                if (target->list && target->list->items && gc_value_is_young_heap(&val)) {
-                    luna_gc_runtime_remember(target->list->items);
+                if (VALUE_AS_LIST(*target) && VALUE_AS_LIST(*target)->items && gc_value_is_young_heap(&val)) {
+                    luna_gc_runtime_remember(VALUE_AS_LIST(*target)->items);
                 }
                 value_free(*slot);
                 *slot = val;
-                val.type = VAL_NULL;
-            } else if (target->type == VAL_MAP && target->map) {
-                if (idx.type != VAL_STRING || !idx.string) {
+                val = value_null();
+            } else if (VALUE_TYPE(*target) == VAL_MAP && VALUE_AS_MAP(*target)) {
+                if (VALUE_TYPE(idx) != VAL_STRING || !VALUE_AS_STRING(idx)) {
                     error_report_with_context(ERR_TYPE, n->line, 0,
                         "Map assignment index must be a string",
                         "Use map[\"field\"] = value for map and data values");
@@ -1655,9 +1649,9 @@ static Value exec_stmt(Env *e, AstNode *n) {
                     value_free(idx);
                     return value_null();
                 }
-                value_map_set_move(target, intern_string(idx.string->chars), &val);
-            } else if (target->type == VAL_TEMPLATE) {
-                if (idx.type != VAL_STRING || !idx.string) {
+                value_map_set_move(target, intern_string(VALUE_AS_STRING(idx)->chars), &val);
+            } else if (VALUE_TYPE(*target) == VAL_TEMPLATE) {
+                if (VALUE_TYPE(idx) != VAL_STRING || !VALUE_AS_STRING(idx)) {
                     error_report_with_context(ERR_TYPE, n->line, 0,
                         "Template assignment index must be a string",
                         "Use template[\"field\"] = value or template.field = value");
@@ -1666,18 +1660,18 @@ static Value exec_stmt(Env *e, AstNode *n) {
                     return value_null();
                 }
                 char msg[256];
-                if (!value_template_set_field(target, intern_string(idx.string->chars), &val, msg, sizeof(msg))) {
+                if (!value_template_set_field(target, intern_string(VALUE_AS_STRING(idx)->chars), &val, msg, sizeof(msg))) {
                     error_report_with_context(ERR_NAME, n->line, 0, msg,
                         "Assign only to declared template fields");
                     value_free(val);
                     value_free(idx);
                     return value_null();
                 }
-            } else if (target->type == VAL_DENSE_LIST && target->dlist) {
+            } else if (VALUE_TYPE(*target) == VAL_DENSE_LIST && VALUE_AS_DLIST(*target)) {
                 // Direct high-performance assignment for dense lists
-                long long normalized = normalize_index(idx.i, target->dlist->count);
-                if (normalized >= 0 && normalized < target->dlist->count) {
-                    target->dlist->data[normalized] = (val.type == VAL_INT) ? (double)val.i : val.f;
+                long long normalized = normalize_index(VALUE_AS_INT(idx), VALUE_AS_DLIST(*target)->count);
+                if (normalized >= 0 && normalized < VALUE_AS_DLIST(*target)->count) {
+                    VALUE_AS_DLIST(*target)->data[normalized] = (VALUE_TYPE(val) == VAL_INT) ? (double)VALUE_AS_INT(val) : VALUE_AS_FLOAT(val);
                 }
             }
             
@@ -1802,26 +1796,11 @@ static Value exec_stmt(Env *e, AstNode *n) {
         case NODE_FOR_IN: {
             Value iterable = eval_expr(e, n->forin.iterable);
             Env *scope = env_create(e);
-            long long count = 0;
-
-            if (iterable.type == VAL_LIST && iterable.list) count = iterable.list->count;
-            else if (iterable.type == VAL_DENSE_LIST && iterable.dlist) count = iterable.dlist->count;
-            else if (iterable.type == VAL_STRING && iterable.string) count = (long long)strlen(iterable.string->chars);
-            else {
-                error_report_with_context(ERR_TYPE, n->line, 0,
-                    "for-in expects a list, dense list, or string",
-                    "Use for (let item in list) { ... }");
-                value_free(iterable);
-                env_free(scope);
-                return value_null();
-            }
-
-            for (long long i = 0; i < count; i++) {
-                Value item = value_null();
-                if (iterable.type == VAL_LIST) item = value_copy(iterable.list->items[i]);
-                else if (iterable.type == VAL_DENSE_LIST) item = value_float(iterable.dlist->data[i]);
-                else item = value_char(iterable.string->chars[i]);
+            long long state = 0;
+            Value item;
+            int more;
 
+            while ((more = value_iter_next(iterable, &state, &item)) > 0) {
                 env_clear_locals(scope);
                 env_def_move(scope, n->forin.name, &item);
 
@@ -1841,6 +1820,11 @@ static Value exec_stmt(Env *e, AstNode *n) {
                     continue;
                 }
             }
+            if (more < 0) {
+                error_report_with_context(ERR_TYPE, n->line, 0,
+                    "for-in expects a list, dense list, string, map, or range",
+                    "Use for (let item in list) { ... }");
+            }
 
             value_free(iterable);
             deferred_calls_run_scope(scope);
@@ -1858,14 +1842,14 @@ static Value exec_stmt(Env *e, AstNode *n) {
                 int eq = 0;
                 
                 // Compare switch value with case value
-                if (val.type == cval.type) {
-                    if (val.type == VAL_INT) eq = (val.i == cval.i);
-                    else if (val.type == VAL_FLOAT) eq = (val.f == cval.f);
-                    else if (val.type == VAL_STRING && val.string && cval.string) eq = !strcmp(val.string->chars, cval.string->chars);
-                    else if (val.type == VAL_BOOL) eq = (val.b == cval.b);
-                    else if (val.type == VAL_CHAR) eq = (val.c == cval.c);
-                } else if (val.type == VAL_INT && cval.type == VAL_FLOAT) eq = (val.i == cval.f);
-                else if (val.type == VAL_FLOAT && cval.type == VAL_INT) eq = (val.f == cval.i);
+                if (VALUE_TYPE(val) == VALUE_TYPE(cval)) {
+                    if (VALUE_TYPE(val) == VAL_INT) eq = (VALUE_AS_INT(val) == VALUE_AS_INT(cval));
+                    else if (VALUE_TYPE(val) == VAL_FLOAT) eq = (VALUE_AS_FLOAT(val) == VALUE_AS_FLOAT(cval));
+                    else if (VALUE_TYPE(val) == VAL_STRING && VALUE_AS_STRING(val) && VALUE_AS_STRING(cval)) eq = !strcmp(VALUE_AS_STRING(val)->chars, VALUE_AS_STRING(cval)->chars);
+                    else if (VALUE_TYPE(val) == VAL_BOOL) eq = (VALUE_AS_BOOL(val) == VALUE_AS_BOOL(cval));
+                    else if (VALUE_TYPE(val) == VAL_CHAR) eq = (VALUE_AS_CHAR(val) == VALUE_AS_CHAR(cval));
+                } else if (VALUE_TYPE(val) == VAL_INT && VALUE_TYPE(cval) == VAL_FLOAT) eq = (VALUE_AS_INT(val) == VALUE_AS_FLOAT(cval));
+                else if (VALUE_TYPE(val) == VAL_FLOAT && VALUE_TYPE(cval) == VAL_INT) eq = (VALUE_AS_FLOAT(val) == VALUE_AS_INT(cval));
                 value_free(cval);
 
                 if (eq) {
@@ -1932,67 +1916,30 @@ static Value exec_stmt(Env *e, AstNode *n) {
         }
 
         case NODE_IMPORT: {
-            char *src = read_file(n->import_stmt.path);
-            if (!src) {
-                char msg[256];
-                snprintf(msg, sizeof(msg), "Could not import file '%s'", n->import_stmt.path);
-                error_report_with_context(ERR_NAME, n->line, 0, msg,
-                    "Check that the import path exists and ends with .lu");
-                return value_null();
-            }
-
-            error_init(src, n->import_stmt.path);
-            Parser parser;
-            parser_init(&parser, src);
-            AstNode *prog = parser_parse_program(&parser);
-            parser_close(&parser);
-            if (prog) {
-                const char **exported_names = NULL;
-                int exported_count = 0;
-                collect_module_exports(prog, &exported_names, &exported_count);
-
-                Env *module_parent = env_root(e);
-                Env *module_env = env_create(module_parent);
-                if (prog->kind == NODE_BLOCK) {
-                    for (int i = 0; i < prog->block.items.count; i++) {
-                        exec_stmt(module_env, prog->block.items.items[i]);
-                        gc_safe_point();
-                        if (luna_had_error || return_exception.active) break;
-                    }
-                } else {
-                    exec_stmt(module_env, prog);
-                    gc_safe_point();
+            LunaModule *module = module_cache_get(n->import_stmt.path);
+            if (!module) module = load_module(e, n->import_stmt.path, n->line);
+            if (!module) return value_null();
+
+            const char **names = n->import_stmt.name_count > 0 ? n->import_stmt.names : module->exports;
+            int name_count = n->import_stmt.name_count > 0 ? n->import_stmt.name_count : module->export_count;
+            for (int i = 0; i < name_count; i++) {
+                if (!module_name_requested(names[i], module->exports, module->export_count)) {
+                    char msg[256];
+                    snprintf(msg, sizeof(msg), "Module '%s' does not export '%s'", n->import_stmt.path, names[i]);
+                    error_report_with_context(ERR_NAME, n->line, 0, msg,
+                        "Export names explicitly in the module before using them");
+                    break;
                 }
-
-                if (!luna_had_error) {
-                    const char **names = n->import_stmt.name_count > 0 ? n->import_stmt.names : exported_names;
-                    int name_count = n->import_stmt.name_count > 0 ? n->import_stmt.name_count : exported_count;
-                    for (int i = 0; i < name_count; i++) {
-                        if (!module_name_requested(names[i], exported_names, exported_count)) {
-                            char msg[256];
-                            snprintf(msg, sizeof(msg), "Module '%s' does not export '%s'", n->import_stmt.path, names[i]);
-                            error_report_with_context(ERR_NAME, n->line, 0, msg,
-                                "Export names explicitly in the module before using them");
-                            break;
-                        }
-                        Value *slot = env_get_local(module_env, names[i]);
-                        if (!slot) {
-                            char msg[256];
-                            snprintf(msg, sizeof(msg), "Export '%s' is missing from module '%s'", names[i], n->import_stmt.path);
-                            error_report_with_context(ERR_NAME, n->line, 0, msg,
-                                "Make sure the exported value is defined at module top level");
-                            break;
-                        }
-                        env_def(e, names[i], *slot);
-                    }
+                Value *slot = env_get_local(module->env, names[i]);
+                if (!slot) {
+                    char msg[256];
+                    snprintf(msg, sizeof(msg), "Export '%s' is missing from module '%s'", names[i], n->import_stmt.path);
+                    error_report_with_context(ERR_NAME, n->line, 0, msg,
+                        "Make sure the exported value is defined at module top level");
+                    break;
                 }
-
-                deferred_calls_run_scope(module_env);
-                env_free(module_env);
-                free((void *)exported_names);
-                nodelist_free(&prog->block.items);
+                env_def(e, names[i], *slot);
             }
-            free(src);
             return value_null();
         }
         case NODE_UNSAFE: {
@@ -2034,7 +1981,7 @@ static Value exec_stmt(Env *e, AstNode *n) {
         }
         case NODE_BLOC_DEF: {
             Value btype = value_bloc_type(n->bloc_def.name, n->bloc_def.fields, n->bloc_def.field_count);
-            if (btype.type == VAL_NULL) {
+            if (VALUE_TYPE(btype) == VAL_NULL) {
                 char msg[256];
                 snprintf(msg, sizeof(msg), "Bloc '%s' conflicts with an existing bloc definition", n->bloc_def.name);
                 error_report_with_context(ERR_NAME, n->line, 0, msg,
@@ -2109,6 +2056,7 @@ Value interpret(AstNode *prog, Env *env) {
     tco_pending.args = NULL;
     current_executing_fn = NULL;
     current_executing_env = NULL;
+    call_roots = NULL;
     unsafe_block_depth = 0;
     unsafe_runtime_reset();
     data_runtime_init();
@@ -7,7 +7,11 @@
 #include <ctype.h>
 #include "lexer.h"
 #include "token.h"
-#include "mystr.h"
+#include "intern.h"
+
+#if defined(__GNUC__) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
 
 // Returns the character at the current position without advancing
 static int lx_at(Lexer *L) {
@@ -38,64 +42,156 @@ static void lx_advance(Lexer *L) {
     L->col = L->pos - L->line_start + 1;
 }
 
+// Moves to end, which the caller knows has no newline before it
+static void lx_skip_to(Lexer *L, size_t end) {
+    L->pos = end;
+    L->col = L->pos - L->line_start + 1;
+}
+
+// Moves to end, counting any newlines on the way (multi-line strings)
+static void lx_skip_lines_to(Lexer *L, size_t end) {
+    const char *nl;
+    while ((nl = memchr(L->src + L->pos, '\n', end - L->pos)) != NULL) {
+        L->line++;
+        L->pos = (size_t)(nl - L->src) + 1;
+        L->line_start = L->pos;
+    }
+    lx_skip_to(L, end);
+}
+
+// Run scanners. Each returns the first position at or after pos whose byte is
+// outside the run. With SSE2 or AVX2 they classify 16 or 32 bytes per step;
+// the scalar loop finishes the last partial block, so no load crosses len
+// (the source buffer is only guaranteed up to its terminator).
+static int is_ident_char(int c) {
+    return isalnum(c) || c == '_';
+}
+
+static int is_blank(int c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#define LX_VEC_BYTES 32
+typedef __m256i LxVec;
+static inline LxVec lx_load(const char *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline LxVec lx_eq(LxVec x, char c) { return _mm256_cmpeq_epi8(x, _mm256_set1_epi8(c)); }
+static inline LxVec lx_or(LxVec a, LxVec b) { return _mm256_or_si256(a, b); }
+static inline LxVec lx_andnot(LxVec a, LxVec b) { return _mm256_andnot_si256(a, b); }
+// Bytes in [lo, lo + n): unsigned x - lo <= n - 1, via min
+static inline LxVec lx_in_range(LxVec x, char lo, char n) {
+    LxVec d = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8((char)(n - 1))), d);
+}
+static inline LxVec lx_fold_case(LxVec x) { return _mm256_or_si256(x, _mm256_set1_epi8(0x20)); }
+static inline unsigned int lx_mask(LxVec m) { return (unsigned int)_mm256_movemask_epi8(m); }
+#define LX_MASK_ALL 0xFFFFFFFFu
+#elif defined(__GNUC__) && defined(__SSE2__)
+#define LX_VEC_BYTES 16
+typedef __m128i LxVec;
+static inline LxVec lx_load(const char *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline LxVec lx_eq(LxVec x, char c) { return _mm_cmpeq_epi8(x, _mm_set1_epi8(c)); }
+static inline LxVec lx_or(LxVec a, LxVec b) { return _mm_or_si128(a, b); }
+static inline LxVec lx_andnot(LxVec a, LxVec b) { return _mm_andnot_si128(a, b); }
+static inline LxVec lx_in_range(LxVec x, char lo, char n) {
+    LxVec d = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8((char)(n - 1))), d);
+}
+static inline LxVec lx_fold_case(LxVec x) { return _mm_or_si128(x, _mm_set1_epi8(0x20)); }
+static inline unsigned int lx_mask(LxVec m) { return (unsigned int)_mm_movemask_epi8(m); }
+#define LX_MASK_ALL 0xFFFFu
+#endif
+
+static size_t scan_ident(const char *s, size_t pos, size_t len) {
+#ifdef LX_VEC_BYTES
+    while (pos + LX_VEC_BYTES <= len) {
+        LxVec x = lx_load(s + pos);
+        LxVec ok = lx_or(lx_or(lx_in_range(lx_fold_case(x), 'a', 26), lx_in_range(x, '0', 10)),
+                         lx_eq(x, '_'));
+        unsigned int miss = ~lx_mask(ok) & LX_MASK_ALL;
+        if (miss) return pos + (size_t)__builtin_ctz(miss);
+        pos += LX_VEC_BYTES;
+    }
+#endif
+    while (pos < len && is_ident_char((unsigned char)s[pos])) pos++;
+    return pos;
+}
+
+static size_t scan_digits(const char *s, size_t pos, size_t len) {
+#ifdef LX_VEC_BYTES
+    while (pos + LX_VEC_BYTES <= len) {
+        unsigned int miss = ~lx_mask(lx_in_range(lx_load(s + pos), '0', 10)) & LX_MASK_ALL;
+        if (miss) return pos + (size_t)__builtin_ctz(miss);
+        pos += LX_VEC_BYTES;
+    }
+#endif
+    while (pos < len && isdigit((unsigned char)s[pos])) pos++;
+    return pos;
+}
+
+// Spaces, tabs, \r, \f, \v; stops at newlines, which are tokens
+static size_t scan_blanks(const char *s, size_t pos, size_t len) {
+#ifdef LX_VEC_BYTES
+    while (pos + LX_VEC_BYTES <= len) {
+        LxVec x = lx_load(s + pos);
+        // \t..\r is 9..13; take out \n (10)
+        LxVec ok = lx_or(lx_eq(x, ' '), lx_andnot(lx_eq(x, '\n'), lx_in_range(x, '\t', 5)));
+        unsigned int miss = ~lx_mask(ok) & LX_MASK_ALL;
+        if (miss) return pos + (size_t)__builtin_ctz(miss);
+        pos += LX_VEC_BYTES;
+    }
+#endif
+    while (pos < len && is_blank((unsigned char)s[pos])) pos++;
+    return pos;
+}
+
+// Next closing quote or backslash inside a string literal
+static size_t scan_string_body(const char *s, size_t pos, size_t len) {
+#ifdef LX_VEC_BYTES
+    while (pos + LX_VEC_BYTES <= len) {
+        LxVec x = lx_load(s + pos);
+        unsigned int hit = lx_mask(lx_or(lx_eq(x, '"'), lx_eq(x, '\\')));
+        if (hit) return pos + (size_t)__builtin_ctz(hit);
+        pos += LX_VEC_BYTES;
+    }
+#endif
+    while (pos < len && s[pos] != '"' && s[pos] != '\\') pos++;
+    return pos;
+}
+
 // Skips whitespace but treats newlines as tokens (for line counting/statement end)
 static void lx_skip_ws_but_keep_nl(Lexer *L) {
     while (1) {
         int c = lx_at(L);
         
-        // Handle Hash comments (# ...)
-        if (c == '#') {
-            while (lx_at(L) != '\n' && lx_at(L) != 0) {
-                lx_advance(L);
-            }
-            continue;
-        }
-        
-        // Handle C-style comments (// ...)
-        if (c == '/' && lx_peek(L, 1) == '/') {
-            while (lx_at(L) != '\n' && lx_at(L) != 0) {
-                lx_advance(L);
-            }
+        // Handle Hash comments (# ...) and C-style comments (// ...):
+        // memchr finds the end of line a vector at a time
+        if (c == '#' || (c == '/' && lx_peek(L, 1) == '/')) {
+            const char *nl = memchr(L->src + L->pos, '\n', L->len - L->pos);
+            lx_skip_to(L, nl ? (size_t)(nl - L->src) : L->len);
             continue;
         }
         
         // Skip standard whitespace
-        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
-            lx_advance(L);
+        if (is_blank(c)) {
+            lx_skip_to(L, scan_blanks(L->src, L->pos, L->len));
             continue;
         }
         break;
     }
 }
 
-// Helper to create a token struct
+// Helper to create a token struct; the text is a view, nothing is copied
 static Token make_token(TokenType ttype, const char *start, size_t length) {
     Token t;
     t.type = ttype;
+    t.start = start;
+    t.length = (int)length;
+    t.owned = 0;
     t.number = 0;
     t.fnumber = 0.0;
     t.line = 0; 
     t.col = 0;
-    
-    if (length > 0 && length < TOKEN_INLINE_MAX) {
-        // Short lexeme — store in inline buffer, zero mallocs
-        memcpy(t.ibuf, start, length);
-        t.ibuf[length] = '\0';
-        t.lexeme = NULL;
-    } else if (length >= TOKEN_INLINE_MAX) {
-        // Long lexeme — heap allocate
-        char *buf = malloc(length + 1);
-        if (buf) {
-            memcpy(buf, start, length);
-            buf[length] = '\0';
-        }
-        t.lexeme = buf;
-        t.ibuf[0] = '\0';
-    } else {
-        // Empty string — inline
-        t.ibuf[0] = '\0';
-        t.lexeme = NULL;
-    }
     return t;
 }
 
@@ -103,10 +199,20 @@ void free_token(Token *t) {
     if (!t) {
         return;
     }
-    if (t->lexeme) {
-        free(t->lexeme);
+    if (t->owned) {
+        free((char *)t->start);
     }
-    t->lexeme = NULL;
+    t->start = "";
+    t->length = 0;
+    t->owned = 0;
+}
+
+char *token_dup(const Token *t) {
+    char *out = malloc((size_t)t->length + 1);
+    if (!out) abort();
+    memcpy(out, t->start, (size_t)t->length);
+    out[t->length] = '\0';
+    return out;
 }
 
 Lexer lexer_create(const char *source) {
@@ -142,20 +248,36 @@ Token lexer_next(Lexer *L) {
         return t;
     }
 
-    // Handle Strings (Double Quotes) with Escape Sequence processing
+    // Handle Strings (Double Quotes). Without escapes the token is a view of
+    // the source; with them the contents are unescaped into an owned buffer.
     if (c == '"') {
         lx_advance(L); // Skip opening quote
-        
-        // Buffer to build processed string. Max length is remaining source length.
-        char *buf = malloc(L->len - L->pos + 1);
-        int i = 0;
+        size_t start = L->pos;
+        size_t end = scan_string_body(L->src, start, L->len);
+        int has_escape = 0;
+        while (end < L->len && L->src[end] == '\\') {
+            has_escape = 1;
+            end = end + 2 > L->len ? L->len : end + 2;
+            end = scan_string_body(L->src, end, L->len);
+        }
+        lx_skip_lines_to(L, end);
+        if (lx_at(L) == '"') lx_advance(L); // Eat closing quote
 
-        while (lx_at(L) != 0 && lx_at(L) != '"') {
-            if (lx_at(L) == '\\') {
-                lx_advance(L); // Skip backslash
-                int next = lx_at(L);
-                if (next == 0) break;
+        Token t = make_token(T_STRING, L->src + start, end - start);
+        t.line = token_line;
+        t.col = token_col;
+        if (!has_escape) {
+            return t;
+        }
 
+        char *buf = malloc(end - start + 1);
+        if (!buf) abort();
+        size_t i = 0;
+        for (size_t k = start; k < end; k++) {
+            int ch = (unsigned char)L->src[k];
+            if (ch == '\\') {
+                if (++k >= end) break;
+                int next = (unsigned char)L->src[k];
                 switch (next) {
                     case 'n':  buf[i++] = '\n'; break;
                     case 't':  buf[i++] = '\t'; break;
@@ -165,35 +287,19 @@ Token lexer_next(Lexer *L) {
                     default:   buf[i++] = (char)next; break; 
                 }
             } else {
-                buf[i++] = (char)lx_at(L);
+                buf[i++] = (char)ch;
             }
-            lx_advance(L);
         }
-
-        if (lx_at(L) == '"') lx_advance(L); // Eat closing quote
         buf[i] = '\0';
-        
-        Token t;
-        t.type = T_STRING;
-        t.number = 0;
-        t.fnumber = 0.0;
-        t.line = token_line;
-        t.col = token_col;
-
-        // Short strings use inline buffer, long ones keep the heap buffer
-        if (i < TOKEN_INLINE_MAX) {
-            memcpy(t.ibuf, buf, i + 1);
-            t.lexeme = NULL;
-            free(buf);
-        } else {
-            t.lexeme = buf;
-            t.ibuf[0] = '\0';
-        }
+        t.start = buf;
+        t.length = (int)i;
+        t.owned = 1;
         return t;
     }
 
     // Handle Characters (Single Quotes)
     if (c == '\'') {
+        size_t start = L->pos;
         lx_advance(L); // Skip opening '
         int char_val = lx_at(L);
         
@@ -213,13 +319,8 @@ Token lexer_next(Lexer *L) {
             lx_advance(L); // Eat closing '
         }
 
-        Token t;
-        t.type = T_CHAR;
-        t.lexeme = NULL;
-        t.ibuf[0] = (char)char_val;
-        t.ibuf[1] = '\0';
-        t.number = 0;
-        t.fnumber = 0.0;
+        Token t = make_token(T_CHAR, L->src + start, L->pos - start);
+        t.number = (char)char_val;
         t.line = token_line;
         t.col = token_col;
         return t;
@@ -336,7 +437,6 @@ Token lexer_next(Lexer *L) {
     }
     // Handle Single-character Operators
     TokenType single_op = T_INVALID;
-    char single_char[2] = {(char)c, '\0'};
 
     if (c == '=') single_op = T_EQ;
     else if (c == '+') single_op = T_PLUS;
@@ -358,8 +458,8 @@ Token lexer_next(Lexer *L) {
     else if (c == ';') single_op = T_SEMICOLON;
     else if (c == '!') single_op = T_NOT; 
     if (single_op != T_INVALID) {
+        Token t = make_token(single_op, L->src + L->pos, 1);
         lx_advance(L);
-        Token t = make_token(single_op, single_char, 1);
         t.line = token_line;
         t.col = token_col;
         return t;
@@ -368,28 +468,29 @@ Token lexer_next(Lexer *L) {
     // Handle Numbers (Integers and Floats)
     if (isdigit(c)) {
         size_t start = L->pos;
-        while (isdigit(lx_at(L))) {
-            lx_advance(L);
-        }
+        size_t end = scan_digits(L->src, start, L->len);
 
         // Check for decimal point for floating point numbers
         int is_float = 0;
-        if (lx_at(L) == '.' && isdigit(lx_peek(L, 1))) {
+        if (end + 1 < L->len && L->src[end] == '.' && isdigit((unsigned char)L->src[end + 1])) {
             is_float = 1;
-            lx_advance(L); // eat dot
-            while (isdigit(lx_at(L))) {
-                lx_advance(L);
-            }
+            end = scan_digits(L->src, end + 1, L->len);
         }
+        lx_skip_to(L, end);
 
-        size_t len = L->pos - start;
+        size_t len = end - start;
         Token t = make_token(is_float ? T_FLOAT : T_NUMBER, L->src + start, len);
-        const char *numstr = token_str(&t);
         if (is_float) {
-            t.fnumber = atof(numstr);
+            // strtod needs a terminator; literals longer than this are
+            // beyond double precision anyway
+            char numbuf[64];
+            size_t n = len < sizeof(numbuf) - 1 ? len : sizeof(numbuf) - 1;
+            memcpy(numbuf, L->src + start, n);
+            numbuf[n] = '\0';
+            t.fnumber = strtod(numbuf, NULL);
         } else {
-            // Use strtoll for long long
-            t.number = strtoll(numstr, NULL, 10);
+            // strtoll stops at the first non-digit, so the view is enough
+            t.number = strtoll(L->src + start, NULL, 10);
         }
         t.line = token_line;
         t.col = token_col;
@@ -399,121 +500,105 @@ Token lexer_next(Lexer *L) {
     // Handle Identifiers and Keywords
     if (isalpha(c) || c == '_') {
         size_t start = L->pos;
-        while (isalnum(lx_at(L)) || lx_at(L) == '_') {
-            lx_advance(L);
-        }
-        size_t len = L->pos - start;
-
-        Token t;
-        t.number = 0;
-        t.fnumber = 0.0;
-        t.line = token_line;
-        t.col = token_col;
-
-        const char *buf;
-        if (len < TOKEN_INLINE_MAX) {
-            memcpy(t.ibuf, L->src + start, len);
-            t.ibuf[len] = '\0';
-            t.lexeme = NULL;
-            buf = t.ibuf;
-        } else {
-            char *heap = malloc(len + 1);
-            memcpy(heap, L->src + start, len);
-            heap[len] = '\0';
-            t.lexeme = heap;
-            buf = heap;
-        }
+        size_t len = scan_ident(L->src, start, L->len) - start;
+        const char *buf = L->src + start;
+        lx_skip_to(L, start + len);
 
+#define KW(word) (len == sizeof(word) - 1 && memcmp(buf, word, sizeof(word) - 1) == 0)
         TokenType tt = T_IDENT;
-        // First-char dispatch to avoid 30+ strcmp per identifier token
+        // First-char dispatch to avoid 30+ compares per identifier token
         switch (buf[0]) {
-            case 'a': if (!strcmp(buf, "and")) tt = T_AND; break;
+            case 'a': if (KW("and")) tt = T_AND; break;
             case 'b':
-                if (!strcmp(buf, "break")) tt = T_BREAK;
-                else if (!strcmp(buf, "bloc")) tt = T_BLOC;
-                else if (!strcmp(buf, "box")) tt = T_BOX;
-                else if (!strcmp(buf, "balls")) tt = T_LET;
-                else if (!strcmp(buf, "big_balls")) tt = T_LET;
+                if (KW("break")) tt = T_BREAK;
+                else if (KW("bloc")) tt = T_BLOC;
+                else if (KW("box")) tt = T_BOX;
+                else if (KW("balls")) tt = T_LET;
+                else if (KW("big_balls")) tt = T_LET;
                 break;
             case 'c':
-                if (!strcmp(buf, "case")) tt = T_CASE;
-                else if (!strcmp(buf, "const")) tt = T_CONST;
-                else if (!strcmp(buf, "continue")) tt = T_CONTINUE;
+                if (KW("case")) tt = T_CASE;
+                else if (KW("const")) tt = T_CONST;
+                else if (KW("continue")) tt = T_CONTINUE;
                 break;
             case 'd':
-                if (!strcmp(buf, "data")) tt = T_DATA;
-                if (!strcmp(buf, "default")) tt = T_DEFAULT;
-                else if (!strcmp(buf, "drop_balls")) tt = T_BREAK;
+                if (KW("data")) tt = T_DATA;
+                if (KW("default")) tt = T_DEFAULT;
+                else if (KW("drop_balls")) tt = T_BREAK;
                 break;
             case 'e':
-                if (!strcmp(buf, "else")) tt = T_ELSE;
-                else if (!strcmp(buf, "else_balls")) tt = T_ELSE;
-                else if (!strcmp(buf, "export")) tt = T_EXPORT;
+                if (KW("else")) tt = T_ELSE;
+                else if (KW("else_balls")) tt = T_ELSE;
+                else if (KW("export")) tt = T_EXPORT;
                 break;
             case 'f':
-                if (!strcmp(buf, "func")) tt = T_FUNC;
-                else if (!strcmp(buf, "for")) tt = T_FOR;
-                else if (!strcmp(buf, "false")) tt = T_FALSE;
-                else if (!strcmp(buf, "from")) tt = T_FROM;
+                if (KW("func")) tt = T_FUNC;
+                else if (KW("for")) tt = T_FOR;
+                else if (KW("false")) tt = T_FALSE;
+                else if (KW("from")) tt = T_FROM;
                 break;
             case 'g':
-                if (!strcmp(buf, "grab_balls")) tt = T_FUNC;
+                if (KW("grab_balls")) tt = T_FUNC;
                 break;
             case 'i':
-                if (!strcmp(buf, "if")) tt = T_IF;
-                else if (!strcmp(buf, "import")) tt = T_IMPORT;
-                else if (!strcmp(buf, "in")) tt = T_IN;
-                else if (!strcmp(buf, "input")) tt = T_INPUT;
-                else if (!strcmp(buf, "if_balls")) tt = T_IF;
+                if (KW("if")) tt = T_IF;
+                else if (KW("import")) tt = T_IMPORT;
+                else if (KW("in")) tt = T_IN;
+                else if (KW("input")) tt = T_INPUT;
+                else if (KW("if_balls")) tt = T_IF;
                 break;
             case 'j':
-                if (!strcmp(buf, "jiggle_balls")) tt = T_CONTINUE;
+                if (KW("jiggle_balls")) tt = T_CONTINUE;
                 break;
             case 'l':
-                if (!strcmp(buf, "let")) tt = T_LET;
-                else if (!strcmp(buf, "loop_your_balls")) tt = T_FOR;
+                if (KW("let")) tt = T_LET;
+                else if (KW("loop_your_balls")) tt = T_FOR;
                 break;
             case 'n':
-                if (!strcmp(buf, "not")) tt = T_NOT;
+                if (KW("not")) tt = T_NOT;
                 break;
             case 'o':
-                if (!strcmp(buf, "or")) tt = T_OR;
+                if (KW("or")) tt = T_OR;
                 break;
             case 'p':
-                if (!strcmp(buf, "print")) tt = T_PRINT;
+                if (KW("print")) tt = T_PRINT;
                 break;
             case 'r':
-                if (!strcmp(buf, "return")) tt = T_RETURN;
+                if (KW("return")) tt = T_RETURN;
                 break;
             case 's':
-                if (!strcmp(buf, "switch")) tt = T_SWITCH;
-                else if (!strcmp(buf, "shared_balls")) tt = T_LET;
-                else if (!strcmp(buf, "switch_balls")) tt = T_SWITCH;
-                else if (!strcmp(buf, "spin_balls")) tt = T_WHILE;
+                if (KW("switch")) tt = T_SWITCH;
+                else if (KW("shared_balls")) tt = T_LET;
+                else if (KW("switch_balls")) tt = T_SWITCH;
+                else if (KW("spin_balls")) tt = T_WHILE;
                 break;
             case 't':
-                if (!strcmp(buf, "true")) tt = T_TRUE;
-                else if (!strcmp(buf, "template")) tt = T_TEMPLATE;
+                if (KW("true")) tt = T_TRUE;
+                else if (KW("template")) tt = T_TEMPLATE;
                 break;
             case 'u':
-                if (!strcmp(buf, "unsafe")) tt = T_UNSAFE;
-                else if (!strcmp(buf, "use")) tt = T_USE;
+                if (KW("unsafe")) tt = T_UNSAFE;
+                else if (KW("use")) tt = T_USE;
                 break;
             case 'w':
-                if (!strcmp(buf, "while")) tt = T_WHILE;
+                if (KW("while")) tt = T_WHILE;
                 break;
             default: break;
         }
+#undef KW
 
-        t.type = tt;
+        // Names are interned straight from the source; keywords stay views
+        Token t = make_token(tt, tt == T_IDENT ? intern_string_n(buf, len) : buf, len);
+        t.line = token_line;
+        t.col = token_col;
         return t;
     }
 
     // Handle Unknown Characters
     size_t start = L->pos;
     lx_advance(L);
-    Token t = make_token(T_IDENT, L->src + start, 1);
+    Token t = make_token(T_IDENT, intern_string_n(L->src + start, 1), 1);
     t.line = token_line;
     t.col = token_col;
     return t;
-}
\ No newline at end of file
+}
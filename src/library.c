@@ -8,6 +8,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <math.h>
+#include <string.h>
 #include "library.h"
 #include "intern.h"
 #include "value.h"
@@ -31,24 +33,25 @@ Value lib_sand_update(int argc, Value *argv, Env *env);
 // Helper: Local truthiness check for assert
 // (This logic mirrors the interpreter's is_truthy to keep modules decoupled)
 static int lib_is_truthy(Value v) {
-    switch (v.type) {
-        case VAL_BOOL:   return v.b;
-        case VAL_INT:    return v.i != 0;
-        case VAL_FLOAT:  return v.f != 0.0;
+    switch (VALUE_TYPE(v)) {
+        case VAL_BOOL:   return VALUE_AS_BOOL(v);
+        case VAL_INT:    return VALUE_AS_INT(v) != 0;
+        case VAL_FLOAT:  return VALUE_AS_FLOAT(v) != 0.0;
         case VAL_BLOC:
         case VAL_BLOC_TYPE:
         case VAL_BOX:
         case VAL_TEMPLATE:
             return 1;
-        case VAL_STRING: return v.string && v.string->chars && v.string->chars[0] != '\0';
+        case VAL_STRING: return VALUE_AS_STRING(v) && VALUE_AS_STRING(v)->chars && VALUE_AS_STRING(v)->chars[0] != '\0';
         case VAL_NULL:   return 0;
         case VAL_LIST:   
         case VAL_DENSE_LIST:
+        case VAL_RANGE:
         case VAL_MAP: return 1; // container values are truthy
         case VAL_NATIVE: return 1;
         case VAL_CLOSURE: return 1;
-        case VAL_CHAR:   return v.c != 0;
-        case VAL_FILE:   return v.file != NULL; // Files are truthy if open
+        case VAL_CHAR:   return VALUE_AS_CHAR(v) != 0;
+        case VAL_FILE:   return VALUE_AS_FILE(v) != NULL; // Files are truthy if open
         default:         return 0;
     }
 }
@@ -77,8 +80,8 @@ static Value lib_assert(int argc, Value *argv, Env *env) {
 // Native implementation of input(prompt) for the VM's NODE_INPUT.
 static Value lib_input(int argc, Value *argv, Env *env) {
     (void)env;
-    if (argc >= 1 && argv[0].type == VAL_STRING && argv[0].string) {
-        printf("%s", argv[0].string->chars);
+    if (argc >= 1 && VALUE_TYPE(argv[0]) == VAL_STRING && VALUE_AS_STRING(argv[0])) {
+        printf("%s", VALUE_AS_STRING(argv[0])->chars);
     }
     char buf[256];
     if (fgets(buf, sizeof(buf), stdin)) {
@@ -97,20 +100,20 @@ static Value lib_shape(int argc, Value *argv, Env *env) {
         return value_null();
     }
     Value v = argv[0];
-    if (v.type == VAL_BLOC) {
+    if (VALUE_TYPE(v) == VAL_BLOC) {
         const char *name = value_bloc_name(v);
         return name ? value_string(name) : value_null();
     }
-    if (v.type == VAL_BOX) {
+    if (VALUE_TYPE(v) == VAL_BOX) {
         return value_string("box");
     }
-    if (v.type == VAL_TEMPLATE) {
+    if (VALUE_TYPE(v) == VAL_TEMPLATE) {
         const char *name = value_template_name(v);
         return name ? value_string(name) : value_null();
     }
-    if (v.type == VAL_MAP && v.map) {
+    if (VALUE_TYPE(v) == VAL_MAP && VALUE_AS_MAP(v)) {
         Value *tag = value_map_get(&v, intern_string("__tag"));
-        if (tag && tag->type == VAL_STRING && tag->string) {
+        if (tag && VALUE_TYPE(*tag) == VAL_STRING && VALUE_AS_STRING(*tag)) {
             return value_copy(*tag);
         }
     }
@@ -154,7 +157,7 @@ static Value lib_free(int argc, Value *argv, Env *env) {
             "Use free(boxValue) or free(ptr)");
         return value_null();
     }
-    if (argv[0].type == VAL_BOX) {
+    if (VALUE_TYPE(argv[0]) == VAL_BOX) {
         char msg[256];
         if (!value_box_free(argv[0], msg, sizeof(msg))) {
             error_report_with_context(ERR_RUNTIME, 0, 0, msg,
@@ -241,8 +244,8 @@ static Value lib_type(int argc, Value *argv, Env *env) {
     }
     Value v = argv[0];
     const char *tname = "unknown";
-    switch (v.type) {
-        case VAL_INT: tname = (v.i > INT_MAX || v.i < INT_MIN) ? "long" : "int"; break;
+    switch (VALUE_TYPE(v)) {
+        case VAL_INT: tname = (VALUE_AS_INT(v) > INT_MAX || VALUE_AS_INT(v) < INT_MIN) ? "long" : "int"; break;
         case VAL_FLOAT: tname = "float"; break;
         case VAL_STRING: tname = "string"; break;
         case VAL_CHAR: tname = "char"; break;
@@ -252,7 +255,8 @@ static Value lib_type(int argc, Value *argv, Env *env) {
         case VAL_BLOC_TYPE: tname = "bloc_type"; break;
         case VAL_BOX: tname = "box"; break;
         case VAL_LIST:
-        case VAL_DENSE_LIST: tname = "list"; break;
+        case VAL_DENSE_LIST:
+        case VAL_RANGE: tname = "list"; break;
         case VAL_MAP: tname = "map"; break;
         case VAL_TEMPLATE: tname = "template"; break;
         case VAL_DATA_TYPE: tname = "data_type"; break;
@@ -276,12 +280,12 @@ static Value lib_int(int argc, Value *argv, Env *env) {
     }
     Value v = argv[0];
     long long res = 0;
-    if (unsafe_runtime_is_pointer(v)) res = (long long)v.ptr;
-    else if (v.type == VAL_STRING && v.string) res = atoll(v.string->chars);
-    else if (v.type == VAL_FLOAT) res = (long long)v.f;
-    else if (v.type == VAL_INT) res = v.i;
-    else if (v.type == VAL_BOOL) res = v.b;
-    else if (v.type == VAL_CHAR) res = (long long)v.c;
+    if (unsafe_runtime_is_pointer(v)) res = (long long)VALUE_AS_PTR(v);
+    else if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v)) res = atoll(VALUE_AS_STRING(v)->chars);
+    else if (VALUE_TYPE(v) == VAL_FLOAT) res = (long long)VALUE_AS_FLOAT(v);
+    else if (VALUE_TYPE(v) == VAL_INT) res = VALUE_AS_INT(v);
+    else if (VALUE_TYPE(v) == VAL_BOOL) res = VALUE_AS_BOOL(v);
+    else if (VALUE_TYPE(v) == VAL_CHAR) res = (long long)VALUE_AS_CHAR(v);
     return value_int(res);
 }
 
@@ -297,57 +301,57 @@ static Value lib_float(int argc, Value *argv, Env *env) {
         return value_null();
     }
     double res = 0.0;
-    if (v.type == VAL_STRING && v.string) res = atof(v.string->chars);
-    else if (v.type == VAL_INT) res = (double)v.i;
-    else if (v.type == VAL_FLOAT) res = v.f;
-    else if (v.type == VAL_BOOL) res = v.b ? 1.0 : 0.0;
+    if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v)) res = atof(VALUE_AS_STRING(v)->chars);
+    else if (VALUE_TYPE(v) == VAL_INT) res = (double)VALUE_AS_INT(v);
+    else if (VALUE_TYPE(v) == VAL_FLOAT) res = VALUE_AS_FLOAT(v);
+    else if (VALUE_TYPE(v) == VAL_BOOL) res = VALUE_AS_BOOL(v) ? 1.0 : 0.0;
     return value_float(res);
 }
 
 static Value lib_map_set(int argc, Value *argv, Env *env) {
-    if (argc != 3 || argv[0].type != VAL_MAP || argv[1].type != VAL_STRING || !argv[1].string) {
+    if (argc != 3 || VALUE_TYPE(argv[0]) != VAL_MAP || VALUE_TYPE(argv[1]) != VAL_STRING || !VALUE_AS_STRING(argv[1])) {
         error_report(ERR_ARGUMENT, 0, 0,
             "map_set() expects (map, string, value)",
             "Usage: map_set(myMap, \"key\", value)");
         return value_null();
     }
-    value_map_set(&argv[0], intern_string(argv[1].string->chars), argv[2]);
+    value_map_set(&argv[0], intern_string(VALUE_AS_STRING(argv[1])->chars), argv[2]);
     return value_null();
 }
 
 static Value lib_map_get(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_MAP || argv[1].type != VAL_STRING || !argv[1].string) {
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_MAP || VALUE_TYPE(argv[1]) != VAL_STRING || !VALUE_AS_STRING(argv[1])) {
         error_report(ERR_ARGUMENT, 0, 0,
             "map_get() expects (map, string)",
             "Usage: map_get(myMap, \"key\")");
         return value_null();
     }
-    Value *value = value_map_get(&argv[0], intern_string(argv[1].string->chars));
+    Value *value = value_map_get(&argv[0], intern_string(VALUE_AS_STRING(argv[1])->chars));
     return value ? value_copy(*value) : value_null();
 }
 
 static Value lib_map_has(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_MAP || argv[1].type != VAL_STRING || !argv[1].string) {
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_MAP || VALUE_TYPE(argv[1]) != VAL_STRING || !VALUE_AS_STRING(argv[1])) {
         error_report(ERR_ARGUMENT, 0, 0,
             "map_has() expects (map, string)",
             "Usage: map_has(myMap, \"key\")");
         return value_null();
     }
-    return value_bool(value_map_has(&argv[0], intern_string(argv[1].string->chars)));
+    return value_bool(value_map_has(&argv[0], intern_string(VALUE_AS_STRING(argv[1])->chars)));
 }
 
 static Value lib_map_delete(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_MAP || argv[1].type != VAL_STRING || !argv[1].string) {
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_MAP || VALUE_TYPE(argv[1]) != VAL_STRING || !VALUE_AS_STRING(argv[1])) {
         error_report(ERR_ARGUMENT, 0, 0,
             "map_delete() expects (map, string)",
             "Usage: map_delete(myMap, \"key\")");
         return value_null();
     }
-    return value_bool(value_map_delete(&argv[0], intern_string(argv[1].string->chars)));
+    return value_bool(value_map_delete(&argv[0], intern_string(VALUE_AS_STRING(argv[1])->chars)));
 }
 
 static Value lib_map_keys(int argc, Value *argv, Env *env) {
-    if (argc != 1 || argv[0].type != VAL_MAP) {
+    if (argc != 1 || VALUE_TYPE(argv[0]) != VAL_MAP) {
         error_report(ERR_ARGUMENT, 0, 0,
             "map_keys() expects 1 map",
             "Usage: map_keys(myMap)");
@@ -357,7 +361,7 @@ static Value lib_map_keys(int argc, Value *argv, Env *env) {
 }
 
 static Value lib_map_values(int argc, Value *argv, Env *env) {
-    if (argc != 1 || argv[0].type != VAL_MAP) {
+    if (argc != 1 || VALUE_TYPE(argv[0]) != VAL_MAP) {
         error_report(ERR_ARGUMENT, 0, 0,
             "map_values() expects 1 map",
             "Usage: map_values(myMap)");
@@ -367,7 +371,7 @@ static Value lib_map_values(int argc, Value *argv, Env *env) {
 }
 
 static Value lib_map_items(int argc, Value *argv, Env *env) {
-    if (argc != 1 || argv[0].type != VAL_MAP) {
+    if (argc != 1 || VALUE_TYPE(argv[0]) != VAL_MAP) {
         error_report(ERR_ARGUMENT, 0, 0,
             "map_items() expects 1 map",
             "Usage: map_items(myMap)");
@@ -381,15 +385,15 @@ static Value lib_range(int argc, Value *argv, Env *env) {
     long long end = 0;
     long long step = 1;
 
-    if (argc == 1 && argv[0].type == VAL_INT) {
-        end = argv[0].i;
-    } else if (argc == 2 && argv[0].type == VAL_INT && argv[1].type == VAL_INT) {
-        start = argv[0].i;
-        end = argv[1].i;
-    } else if (argc == 3 && argv[0].type == VAL_INT && argv[1].type == VAL_INT && argv[2].type == VAL_INT) {
-        start = argv[0].i;
-        end = argv[1].i;
-        step = argv[2].i;
+    if (argc == 1 && VALUE_TYPE(argv[0]) == VAL_INT) {
+        end = VALUE_AS_INT(argv[0]);
+    } else if (argc == 2 && VALUE_TYPE(argv[0]) == VAL_INT && VALUE_TYPE(argv[1]) == VAL_INT) {
+        start = VALUE_AS_INT(argv[0]);
+        end = VALUE_AS_INT(argv[1]);
+    } else if (argc == 3 && VALUE_TYPE(argv[0]) == VAL_INT && VALUE_TYPE(argv[1]) == VAL_INT && VALUE_TYPE(argv[2]) == VAL_INT) {
+        start = VALUE_AS_INT(argv[0]);
+        end = VALUE_AS_INT(argv[1]);
+        step = VALUE_AS_INT(argv[2]);
     } else {
         error_report(ERR_ARGUMENT, 0, 0,
             "range() expects 1-3 integer arguments",
@@ -404,17 +408,61 @@ static Value lib_range(int argc, Value *argv, Env *env) {
         return value_null();
     }
 
-    Value out = value_list();
-    if (step > 0) {
-        for (long long i = start; i < end; i += step) {
-            value_list_append(&out, value_int(i));
-        }
-    } else {
-        for (long long i = start; i > end; i += step) {
-            value_list_append(&out, value_int(i));
+    // Lazy: for-in steps through it without building the list, and len()
+    // and indexing compute their answer. It reads as a list everywhere else.
+    return value_range(start, end, step);
+}
+
+// Hot, side-effect-free builtins. Names must match env_register_stdlib;
+// the VM checks the global still holds fn before taking the direct path.
+const LunaNativeDef luna_native_defs[] = {
+    { "len",     lib_str_len,      1, NULL,  0 },
+    { "type",    lib_type,         1, NULL,  0 },
+    { "int",     lib_int,          1, NULL,  0 },
+    { "float",   lib_float,        1, NULL,  0 },
+    { "map_get", lib_map_get,      2, NULL,  0 },
+    { "map_has", lib_map_has,      2, NULL,  0 },
+    { "char_at", lib_str_char_at,  2, NULL,  0 },
+    { "abs",     lib_math_abs,     1, NULL,  0 },
+    { "min",     lib_math_min,     2, NULL,  0 },
+    { "max",     lib_math_max,     2, NULL,  0 },
+    { "clamp",   lib_math_clamp,   3, NULL,  0 },
+    { "sign",    lib_math_sign,    1, NULL,  0 },
+    { "pow",     lib_math_pow,     2, NULL,  0 },
+    { "sqrt",    lib_math_sqrt,    1, sqrt,  0 },
+    { "cbrt",    lib_math_cbrt,    1, cbrt,  0 },
+    { "exp",     lib_math_exp,     1, exp,   0 },
+    { "ln",      lib_math_ln,      1, log,   0 },
+    { "log10",   lib_math_log10,   1, log10, 0 },
+    { "sin",     lib_math_sin,     1, sin,   0 },
+    { "cos",     lib_math_cos,     1, cos,   0 },
+    { "tan",     lib_math_tan,     1, tan,   0 },
+    { "asin",    lib_math_asin,    1, asin,  0 },
+    { "acos",    lib_math_acos,    1, acos,  0 },
+    { "atan",    lib_math_atan,    1, atan,  0 },
+    { "atan2",   lib_math_atan2,   2, NULL,  0 },
+    { "sinh",    lib_math_sinh,    1, sinh,  0 },
+    { "cosh",    lib_math_cosh,    1, cosh,  0 },
+    { "tanh",    lib_math_tanh,    1, tanh,  0 },
+    { "floor",   lib_math_floor,   1, floor, 1 },
+    { "ceil",    lib_math_ceil,    1, ceil,  1 },
+    { "round",   lib_math_round,   1, round, 1 },
+    { "trunc",   lib_math_trunc,   1, trunc, 1 },
+    { "mod",     lib_math_mod,     2, NULL,  0 },
+    { "vec_add", lib_vec_add,      2, NULL,  0 },
+    { "vec_sub", lib_vec_sub,      2, NULL,  0 },
+    { "vec_mul", lib_vec_mul,      2, NULL,  0 },
+    { "vec_div", lib_vec_div,      2, NULL,  0 },
+    { NULL,      NULL,             0, NULL,  0 },
+};
+
+int luna_native_lookup(const char *name, int argc) {
+    for (int i = 0; luna_native_defs[i].name; i++) {
+        if (luna_native_defs[i].argc == argc && strcmp(luna_native_defs[i].name, name) == 0) {
+            return i;
         }
     }
-    return out;
+    return -1;
 }
 
 void env_register_stdlib(Env *env) {
@@ -12,7 +12,7 @@
 #include "arena.h"
 #include "interpreter.h"
 
-extern Arena *ast_arena;
+extern _Thread_local Arena *ast_arena;
 
 // Threshold for switching from Merge Sort to Insertion Sort
 #define SORT_THRESHOLD 16
@@ -20,32 +20,32 @@ extern Arena *ast_arena;
 
 // Helper: Check if a < b for Luna Values
 static int value_less_than(Value a, Value b) {
-    if (a.type == VAL_INT && b.type == VAL_INT) return a.i < b.i;
-    if (a.type == VAL_FLOAT && b.type == VAL_FLOAT) return a.f < b.f;
-    if (a.type == VAL_INT && b.type == VAL_FLOAT) return (double)a.i < b.f;
-    if (a.type == VAL_FLOAT && b.type == VAL_INT) return a.f < (double)b.i;
-    if (a.type == VAL_STRING && b.type == VAL_STRING && a.string && b.string) return strcmp(a.string->chars, b.string->chars) < 0;
+    if (VALUE_TYPE(a) == VAL_INT && VALUE_TYPE(b) == VAL_INT) return VALUE_AS_INT(a) < VALUE_AS_INT(b);
+    if (VALUE_TYPE(a) == VAL_FLOAT && VALUE_TYPE(b) == VAL_FLOAT) return VALUE_AS_FLOAT(a) < VALUE_AS_FLOAT(b);
+    if (VALUE_TYPE(a) == VAL_INT && VALUE_TYPE(b) == VAL_FLOAT) return (double)VALUE_AS_INT(a) < VALUE_AS_FLOAT(b);
+    if (VALUE_TYPE(a) == VAL_FLOAT && VALUE_TYPE(b) == VAL_INT) return VALUE_AS_FLOAT(a) < (double)VALUE_AS_INT(b);
+    if (VALUE_TYPE(a) == VAL_STRING && VALUE_TYPE(b) == VAL_STRING && VALUE_AS_STRING(a) && VALUE_AS_STRING(b)) return strcmp(VALUE_AS_STRING(a)->chars, VALUE_AS_STRING(b)->chars) < 0;
     return 0; 
 }
 
 static int value_equals(Value a, Value b) {
-    if (a.type == b.type) {
-        if (a.type == VAL_INT) return a.i == b.i;
-        if (a.type == VAL_FLOAT) return a.f == b.f;
-        if (a.type == VAL_BOOL) return a.b == b.b;
-        if (a.type == VAL_CHAR) return a.c == b.c;
-        if (a.type == VAL_STRING && a.string && b.string) return strcmp(a.string->chars, b.string->chars) == 0;
-        if (a.type == VAL_NULL) return 1;
-    }
-    if (a.type == VAL_INT && b.type == VAL_FLOAT) return (double)a.i == b.f;
-    if (a.type == VAL_FLOAT && b.type == VAL_INT) return a.f == (double)b.i;
+    if (VALUE_TYPE(a) == VALUE_TYPE(b)) {
+        if (VALUE_TYPE(a) == VAL_INT) return VALUE_AS_INT(a) == VALUE_AS_INT(b);
+        if (VALUE_TYPE(a) == VAL_FLOAT) return VALUE_AS_FLOAT(a) == VALUE_AS_FLOAT(b);
+        if (VALUE_TYPE(a) == VAL_BOOL) return VALUE_AS_BOOL(a) == VALUE_AS_BOOL(b);
+        if (VALUE_TYPE(a) == VAL_CHAR) return VALUE_AS_CHAR(a) == VALUE_AS_CHAR(b);
+        if (VALUE_TYPE(a) == VAL_STRING && VALUE_AS_STRING(a) && VALUE_AS_STRING(b)) return strcmp(VALUE_AS_STRING(a)->chars, VALUE_AS_STRING(b)->chars) == 0;
+        if (VALUE_TYPE(a) == VAL_NULL) return 1;
+    }
+    if (VALUE_TYPE(a) == VAL_INT && VALUE_TYPE(b) == VAL_FLOAT) return (double)VALUE_AS_INT(a) == VALUE_AS_FLOAT(b);
+    if (VALUE_TYPE(a) == VAL_FLOAT && VALUE_TYPE(b) == VAL_INT) return VALUE_AS_FLOAT(a) == (double)VALUE_AS_INT(b);
     return 0;
 }
 
 static int list_all_ints(const ListObj *list) {
     if (!list) return 0;
     for (int i = 0; i < list->count; i++) {
-        if (list->items[i].type != VAL_INT) return 0;
+        if (VALUE_TYPE(list->items[i]) != VAL_INT) return 0;
     }
     return 1;
 }
@@ -66,7 +66,7 @@ static void radix_sort_int_list(ListObj *list) {
         unsigned shift = (unsigned)pass * 8u;
 
         for (int i = 0; i < n; i++) {
-            unsigned long long key = ((unsigned long long)in[i].i) ^ 0x8000000000000000ULL;
+            unsigned long long key = ((unsigned long long)VALUE_AS_INT(in[i])) ^ 0x8000000000000000ULL;
             unsigned byte = (unsigned)((key >> shift) & 0xFFu);
             counts[byte]++;
         }
@@ -77,7 +77,7 @@ static void radix_sort_int_list(ListObj *list) {
         }
 
         for (int i = 0; i < n; i++) {
-            unsigned long long key = ((unsigned long long)in[i].i) ^ 0x8000000000000000ULL;
+            unsigned long long key = ((unsigned long long)VALUE_AS_INT(in[i])) ^ 0x8000000000000000ULL;
             unsigned byte = (unsigned)((key >> shift) & 0xFFu);
             out[offsets[byte]++] = in[i];
         }
@@ -95,21 +95,22 @@ static void radix_sort_int_list(ListObj *list) {
 }
 
 static int lib_is_truthy(Value v) {
-    switch (v.type) {
-        case VAL_BOOL: return v.b;
-        case VAL_INT: return v.i != 0;
-        case VAL_FLOAT: return v.f != 0.0;
-        case VAL_STRING: return v.string && v.string->chars && v.string->chars[0] != '\0';
+    switch (VALUE_TYPE(v)) {
+        case VAL_BOOL: return VALUE_AS_BOOL(v);
+        case VAL_INT: return VALUE_AS_INT(v) != 0;
+        case VAL_FLOAT: return VALUE_AS_FLOAT(v) != 0.0;
+        case VAL_STRING: return VALUE_AS_STRING(v) && VALUE_AS_STRING(v)->chars && VALUE_AS_STRING(v)->chars[0] != '\0';
         case VAL_NULL: return 0;
         case VAL_LIST:
         case VAL_DENSE_LIST:
+        case VAL_RANGE:
         case VAL_MAP:
         case VAL_TEMPLATE: return 1;
         case VAL_NATIVE:
         case VAL_CLOSURE:
         case VAL_FUNCTION: return 1;
-        case VAL_CHAR: return v.c != 0;
-        case VAL_FILE: return v.file != NULL;
+        case VAL_CHAR: return VALUE_AS_CHAR(v) != 0;
+        case VAL_FILE: return VALUE_AS_FILE(v) != NULL;
         default: return 0;
     }
 }
@@ -169,21 +170,22 @@ static void hybrid_sort(Value *items, int l, int r, Value *scratch) {
 }
 
 Value lib_list_sort(int argc, Value *argv, Env *env) {
-    if (argc != 1 || argv[0].type != VAL_LIST) {
+    if (argc == 1) value_range_materialize(&argv[0]);
+    if (argc != 1 || VALUE_TYPE(argv[0]) != VAL_LIST) {
         error_report(ERR_ARGUMENT, 0, 0, "sort() expects 1 list", "Usage: sort(myList)");
         return value_null();
     }
 
     Value list = argv[0];
-    if (list.list && list.list->count > 1) {
-        int n = list.list->count;
-        if (n >= RADIX_SORT_THRESHOLD && list_all_ints(list.list)) {
-            radix_sort_int_list(list.list);
+    if (VALUE_AS_LIST(list) && VALUE_AS_LIST(list)->count > 1) {
+        int n = VALUE_AS_LIST(list)->count;
+        if (n >= RADIX_SORT_THRESHOLD && list_all_ints(VALUE_AS_LIST(list))) {
+            radix_sort_int_list(VALUE_AS_LIST(list));
         } else {
             // Single scratch buffer for all merges — avoids malloc/free per merge
             Value *scratch = malloc((size_t)n * sizeof(Value));
             if (!scratch) return value_null();
-            hybrid_sort(list.list->items, 0, n - 1, scratch);
+            hybrid_sort(VALUE_AS_LIST(list)->items, 0, n - 1, scratch);
             free(scratch);
         }
     }
@@ -195,42 +197,43 @@ Value lib_list_ssort(int argc, Value *argv, Env *env) {
         error_report(ERR_ARGUMENT, 0, 0, "ssort() expects 1 list", "Usage: ssort(myList)");
         return value_null();
     }
+    value_range_materialize(&argv[0]);
 
-    if (argv[0].type == VAL_LIST) {
+    if (VALUE_TYPE(argv[0]) == VAL_LIST) {
         Value list = argv[0];
-        if (!list.list || list.list->count <= 1) return value_null();
+        if (!VALUE_AS_LIST(list) || VALUE_AS_LIST(list)->count <= 1) return value_null();
 
         int write = 1;
-        Value last = list.list->items[0];
-        for (int read = 1; read < list.list->count; read++) {
-            Value cur = list.list->items[read];
+        Value last = VALUE_AS_LIST(list)->items[0];
+        for (int read = 1; read < VALUE_AS_LIST(list)->count; read++) {
+            Value cur = VALUE_AS_LIST(list)->items[read];
             if (!value_less_than(cur, last)) {
-                if (write != read) list.list->items[write] = cur;
+                if (write != read) VALUE_AS_LIST(list)->items[write] = cur;
                 last = cur;
                 write++;
             } else {
                 value_free(cur);
             }
         }
-        list.list->count = write;
+        VALUE_AS_LIST(list)->count = write;
         return value_null();
     }
 
-    if (argv[0].type == VAL_DENSE_LIST) {
+    if (VALUE_TYPE(argv[0]) == VAL_DENSE_LIST) {
         Value list = argv[0];
-        if (!list.dlist || list.dlist->count <= 1) return value_null();
+        if (!VALUE_AS_DLIST(list) || VALUE_AS_DLIST(list)->count <= 1) return value_null();
 
         int write = 1;
-        double last = list.dlist->data[0];
-        for (int read = 1; read < list.dlist->count; read++) {
-            double cur = list.dlist->data[read];
+        double last = VALUE_AS_DLIST(list)->data[0];
+        for (int read = 1; read < VALUE_AS_DLIST(list)->count; read++) {
+            double cur = VALUE_AS_DLIST(list)->data[read];
             if (cur >= last) {
-                if (write != read) list.dlist->data[write] = cur;
+                if (write != read) VALUE_AS_DLIST(list)->data[write] = cur;
                 last = cur;
                 write++;
             }
         }
-        list.dlist->count = write;
+        VALUE_AS_DLIST(list)->count = write;
         return value_null();
     }
 
@@ -239,7 +242,8 @@ Value lib_list_ssort(int argc, Value *argv, Env *env) {
 }
 
 Value lib_list_append(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_LIST) {
+    if (argc == 2) value_range_materialize(&argv[0]);
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_LIST) {
         error_report(ERR_ARGUMENT, 0, 0, "list_append() expects a list and a value", "Usage: list_append(list, value)");
         return value_null();
     }
@@ -249,13 +253,14 @@ Value lib_list_append(int argc, Value *argv, Env *env) {
 }
 
 Value lib_list_remove(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_LIST || argv[1].type != VAL_INT) {
+    if (argc == 2) value_range_materialize(&argv[0]);
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_LIST || VALUE_TYPE(argv[1]) != VAL_INT) {
         error_report(ERR_ARGUMENT, 0, 0, "remove() expects (list, index)", "Usage: remove(list, index)");
         return value_null();
     }
 
-    ListObj *list = argv[0].list;
-    long long idx = argv[1].i;
+    ListObj *list = VALUE_AS_LIST(argv[0]);
+    long long idx = VALUE_AS_INT(argv[1]);
     if (!list) return value_null();
     if (idx < 0) idx += list->count;
     if (idx < 0 || idx >= list->count) {
@@ -273,12 +278,13 @@ Value lib_list_remove(int argc, Value *argv, Env *env) {
 }
 
 Value lib_list_find(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_LIST) {
+    if (argc == 2) value_range_materialize(&argv[0]);
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_LIST) {
         error_report(ERR_ARGUMENT, 0, 0, "find() expects (list, value)", "Usage: find(list, value)");
         return value_null();
     }
 
-    ListObj *list = argv[0].list;
+    ListObj *list = VALUE_AS_LIST(argv[0]);
     if (!list) return value_int(-1);
     for (int i = 0; i < list->count; i++) {
         if (value_equals(list->items[i], argv[1])) {
@@ -289,17 +295,18 @@ Value lib_list_find(int argc, Value *argv, Env *env) {
 }
 
 Value lib_list_map(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_LIST) {
+    if (argc == 2) value_range_materialize(&argv[0]);
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_LIST) {
         error_report(ERR_ARGUMENT, 0, 0, "map() expects (list, func)", "Usage: map(list, func(x) { ... })");
         return value_null();
     }
-    if (argv[1].type != VAL_CLOSURE && argv[1].type != VAL_FUNCTION && argv[1].type != VAL_NATIVE && argv[1].type != VAL_VM_CLOSURE) {
+    if (VALUE_TYPE(argv[1]) != VAL_CLOSURE && VALUE_TYPE(argv[1]) != VAL_FUNCTION && VALUE_TYPE(argv[1]) != VAL_NATIVE && VALUE_TYPE(argv[1]) != VAL_VM_CLOSURE) {
         error_report(ERR_ARGUMENT, 0, 0, "map() expects a callable second argument", "Pass a function value as the mapper");
         return value_null();
     }
 
     Value result = value_list();
-    ListObj *list = argv[0].list;
+    ListObj *list = VALUE_AS_LIST(argv[0]);
     if (!list) return result;
     for (int i = 0; i < list->count; i++) {
         Value args[1];
@@ -312,17 +319,18 @@ Value lib_list_map(int argc, Value *argv, Env *env) {
 }
 
 Value lib_list_filter(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_LIST) {
+    if (argc == 2) value_range_materialize(&argv[0]);
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_LIST) {
         error_report(ERR_ARGUMENT, 0, 0, "filter() expects (list, func)", "Usage: filter(list, func(x) { ... })");
         return value_null();
     }
-    if (argv[1].type != VAL_CLOSURE && argv[1].type != VAL_FUNCTION && argv[1].type != VAL_NATIVE && argv[1].type != VAL_VM_CLOSURE) {
+    if (VALUE_TYPE(argv[1]) != VAL_CLOSURE && VALUE_TYPE(argv[1]) != VAL_FUNCTION && VALUE_TYPE(argv[1]) != VAL_NATIVE && VALUE_TYPE(argv[1]) != VAL_VM_CLOSURE) {
         error_report(ERR_ARGUMENT, 0, 0, "filter() expects a callable second argument", "Pass a function value as the predicate");
         return value_null();
     }
 
     Value result = value_list();
-    ListObj *list = argv[0].list;
+    ListObj *list = VALUE_AS_LIST(argv[0]);
     if (!list) return result;
     for (int i = 0; i < list->count; i++) {
         Value args[1];
@@ -338,17 +346,18 @@ Value lib_list_filter(int argc, Value *argv, Env *env) {
 }
 
 Value lib_list_reduce(int argc, Value *argv, Env *env) {
-    if (argc != 3 || argv[0].type != VAL_LIST) {
+    if (argc == 3) value_range_materialize(&argv[0]);
+    if (argc != 3 || VALUE_TYPE(argv[0]) != VAL_LIST) {
         error_report(ERR_ARGUMENT, 0, 0, "reduce() expects (list, func, init)", "Usage: reduce(list, func(acc, x) { ... }, init)");
         return value_null();
     }
-    if (argv[1].type != VAL_CLOSURE && argv[1].type != VAL_FUNCTION && argv[1].type != VAL_NATIVE && argv[1].type != VAL_VM_CLOSURE) {
+    if (VALUE_TYPE(argv[1]) != VAL_CLOSURE && VALUE_TYPE(argv[1]) != VAL_FUNCTION && VALUE_TYPE(argv[1]) != VAL_NATIVE && VALUE_TYPE(argv[1]) != VAL_VM_CLOSURE) {
         error_report(ERR_ARGUMENT, 0, 0, "reduce() expects a callable second argument", "Pass a function value as the reducer");
         return value_null();
     }
 
     Value acc = value_copy(argv[2]);
-    ListObj *list = argv[0].list;
+    ListObj *list = VALUE_AS_LIST(argv[0]);
     if (!list) return acc;
     for (int i = 0; i < list->count; i++) {
         Value args[2];
@@ -366,14 +375,15 @@ Value lib_list_reduce(int argc, Value *argv, Env *env) {
 // Fisher-Yates Shuffle Implementation
 //It should work now I suppose
 Value lib_list_shuffle(int argc, Value *argv, Env *env) {
-    if (argc != 1 || argv[0].type != VAL_LIST) {
+    if (argc == 1) value_range_materialize(&argv[0]);
+    if (argc != 1 || VALUE_TYPE(argv[0]) != VAL_LIST) {
         error_report(ERR_ARGUMENT, 0, 0, "shuffle() expects 1 list", "Usage: shuffle(myList)");
         return value_null();
     }
 
     Value list = argv[0];
-    if (!list.list) return value_null();
-    int n = list.list->count;
+    if (!VALUE_AS_LIST(list)) return value_null();
+    int n = VALUE_AS_LIST(list)->count;
     if (n <= 1) return value_null();
 
     for (int i = n - 1; i > 0; i--) {
@@ -381,9 +391,9 @@ Value lib_list_shuffle(int argc, Value *argv, Env *env) {
         int j = (int)(math_internal_next() % (i + 1));
         
         // Swap
-        Value temp = list.list->items[i];
-        list.list->items[i] = list.list->items[j];
-        list.list->items[j] = temp;
+        Value temp = VALUE_AS_LIST(list)->items[i];
+        VALUE_AS_LIST(list)->items[i] = VALUE_AS_LIST(list)->items[j];
+        VALUE_AS_LIST(list)->items[j] = temp;
     }
     
     return value_null();
@@ -391,23 +401,23 @@ Value lib_list_shuffle(int argc, Value *argv, Env *env) {
 
 // Generate a pre-flattened contiguous C-Array for Zero-Copy Math Operations
 Value lib_dense_list(int argc, Value *argv, Env *env) {
-    if (argc != 2 || argv[0].type != VAL_INT || argv[1].type != VAL_FLOAT) {
+    if (argc != 2 || VALUE_TYPE(argv[0]) != VAL_INT || VALUE_TYPE(argv[1]) != VAL_FLOAT) {
         error_report(ERR_ARGUMENT, 0, 0, "dense_list() expects (size: int, fill: float)", "Usage: dense_list(100, 1.5)");
         return value_null();
     }
 
-    int size = argv[0].i;
-    double fill_value = argv[1].f;
+    int size = VALUE_AS_INT(argv[0]);
+    double fill_value = VALUE_AS_FLOAT(argv[1]);
 
     if (size <= 0) return value_dense_list();
 
     Value res = value_dense_list();
-    res.dlist->count = size;
-    res.dlist->capacity = size;
-    res.dlist->data = malloc(sizeof(double) * size);
+    VALUE_AS_DLIST(res)->count = size;
+    VALUE_AS_DLIST(res)->capacity = size;
+    VALUE_AS_DLIST(res)->data = malloc(sizeof(double) * size);
 
     for (int i = 0; i < size; i++) {
-        res.dlist->data[i] = fill_value;
+        VALUE_AS_DLIST(res)->data[i] = fill_value;
     }
 
     return res;
@@ -5,15 +5,6 @@
 #include <string.h>
 #include "luna_test.h"
 #include "lexer.h"
-#include "mystr.h"
-
-static Token token_clone(Token token) {
-    Token copy = token;
-    if (token.lexeme) {
-        copy.lexeme = my_strdup(token.lexeme);
-    }
-    return copy;
-}
 
 int luna_lex_source(const char *source, LunaTokenBuffer *out_tokens) {
     Lexer lexer;
@@ -41,8 +32,9 @@ int luna_lex_source(const char *source, LunaTokenBuffer *out_tokens) {
             out_tokens->items = grown;
         }
 
-        out_tokens->items[out_tokens->count++] = token_clone(token);
-        free_token(&token);
+        // Tokens are views into source (owned only for escaped strings), so
+        // they move into the buffer as they are
+        out_tokens->items[out_tokens->count++] = token;
 
         if (out_tokens->items[out_tokens->count - 1].type == T_EOF) {
             break;
@@ -104,10 +96,10 @@ AstNode *luna_ast_binop_right(const AstNode *node) {
 }
 
 ValueType luna_value_type_of(const Value *value) {
-    return value ? value->type : VAL_NULL;
+    return value ? VALUE_TYPE(*value) : VAL_NULL;
 }
 
 long long luna_value_as_int(const Value *value) {
-    if (!value || value->type != VAL_INT) return 0;
-    return value->i;
+    if (!value || VALUE_TYPE(*value) != VAL_INT) return 0;
+    return VALUE_AS_INT(*value);
 }
\ No newline at end of file
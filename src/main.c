@@ -21,6 +21,8 @@
 #include "unsafe_runtime.h"
 #include "gc.h"
 #include "luna_vm.h"
+#include "luna_unit.h"
+#include "luna_prefetch.h"
 #include "luna_compiler.h"
 
 #define MAX_INPUT 1024
@@ -253,7 +255,7 @@ static void register_definitions(Env *env, AstNode *n) {
         env_def_move(env, n->data_def.name, &dtype);
     } else if (n->kind == NODE_BLOC_DEF) {
         Value btype = value_bloc_type(n->bloc_def.name, n->bloc_def.fields, n->bloc_def.field_count);
-        if (btype.type != VAL_NULL) {
+        if (VALUE_TYPE(btype) != VAL_NULL) {
             env_def_move(env, n->bloc_def.name, &btype);
         }
     }
@@ -313,26 +315,36 @@ int main(int argc, char **argv) {
         // Initialize error system with file source
         error_init(src, argv[1]);
 
-        Parser parser;
-        parser_init(&parser, src);
+        // Execute the parsed program on the bytecode VM.
+        if (getenv("LUNA_USE_INTERPRETER")) {
+            Parser parser;
+            parser_init(&parser, src);
 
-        AstNode *prog = parser_parse_program(&parser);
+            AstNode *prog = parser_parse_program(&parser);
 
-        //Clean up the parser (freeing the last token) immediately after parsing
-        parser_close(&parser);
+            //Clean up the parser (freeing the last token) immediately after parsing
+            parser_close(&parser);
 
-        if (!prog) {
-            fprintf(stderr, "Parsing failed.\n");
-            free(src);
-            env_free_global(global_env);
-            return 1;
-        }
-        // Execute the parsed program on the bytecode VM.
-        if (getenv("LUNA_USE_INTERPRETER")) {
+            if (!prog) {
+                fprintf(stderr, "Parsing failed.\n");
+                free(src);
+                env_free_global(global_env);
+                return 1;
+            }
             interpret(prog, global_env);
+            ast_free(prog);
         } else {
-            register_definitions(global_env, prog);
-            LunaChunk *chunk = luna_compile_program(prog);
+            // Lex, parse and compile, or load the chunk from the .luc cache.
+            LunaUnit *unit = luna_unit_from_source(src);
+            if (!unit) {
+                fprintf(stderr, "Parsing failed.\n");
+                free(src);
+                env_free_global(global_env);
+                return 1;
+            }
+            luna_unit_define(unit, global_env);
+            luna_prefetch_imports(unit);
+            LunaChunk *chunk = unit->chunk;
             LunaVM vm;
             luna_vm_init(&vm, luna_gc_runtime_heap());
             vm.env = global_env;
@@ -342,23 +354,28 @@ int main(int argc, char **argv) {
 
             // Auto-call main() if defined and takes no arguments.
             Value *main_val = env_get(global_env, intern_string("main"));
-            if (main_val && main_val->type == VAL_VM_CLOSURE && main_val->vm_closure &&
-                main_val->vm_closure->chunk->param_count == 0 &&
-                main_val->vm_closure->chunk->upvalue_count == 0) {
-                Value mret = luna_vm_run(&vm, main_val->vm_closure->chunk);
+            if (main_val && VALUE_TYPE(*main_val) == VAL_VM_CLOSURE && VALUE_AS_VM_CLOSURE(*main_val) &&
+                VALUE_AS_VM_CLOSURE(*main_val)->chunk->param_count == 0 &&
+                VALUE_AS_VM_CLOSURE(*main_val)->chunk->upvalue_count == 0) {
+                Value mret = luna_vm_run(&vm, VALUE_AS_VM_CLOSURE(*main_val)->chunk);
                 value_free(mret);
             }
 
             luna_vm_free(&vm);
             luna_gc_runtime_set_root_marker(luna_mark_runtime_roots, NULL);
+            luna_prefetch_clear();
             luna_chunk_free(chunk);
             free(chunk);
+            ast_free(unit->prog);
+            luna_unit_free(unit);
         }
 
-        ast_free(prog);
         free(src);
     }
 
+    if (getenv("LUNA_VM_STATS")) {
+        luna_vm_stats_print(stderr);
+    }
     if (getenv("LUNA_GC_STATS")) {
         LunaGCStats stats = gc_stats_snapshot();
         fprintf(stderr, "LUNA_GC_STATS,%.3f,%.3f,%llu\n",
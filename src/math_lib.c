@@ -36,8 +36,8 @@ static uint64_t next(void) {
 
 // Helper: Extract double from Value safely
 static double val_to_double(Value v) {
-    if (v.type == VAL_INT) return (double)v.i;
-    if (v.type == VAL_FLOAT) return v.f;
+    if (VALUE_TYPE(v) == VAL_INT) return (double)VALUE_AS_INT(v);
+    if (VALUE_TYPE(v) == VAL_FLOAT) return VALUE_AS_FLOAT(v);
     return 0.0; // Default or error value
 }
 
@@ -56,10 +56,10 @@ Value lib_math_abs(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 1, "abs")) return value_null();
     
     Value v = argv[0];
-    if (v.type == VAL_INT) {
-        return value_int(v.i < 0 ? -v.i : v.i);
-    } else if (v.type == VAL_FLOAT) {
-        return value_float(fabs(v.f));
+    if (VALUE_TYPE(v) == VAL_INT) {
+        return value_int(VALUE_AS_INT(v) < 0 ? -VALUE_AS_INT(v) : VALUE_AS_INT(v));
+    } else if (VALUE_TYPE(v) == VAL_FLOAT) {
+        return value_float(fabs(VALUE_AS_FLOAT(v)));
     }
     return value_null();
 }
@@ -70,7 +70,7 @@ Value lib_math_min(int argc, Value *argv, Env *env) {
     double b = val_to_double(argv[1]);
     
     // Return appropriate type
-    if (argv[0].type == VAL_INT && argv[1].type == VAL_INT)
+    if (VALUE_TYPE(argv[0]) == VAL_INT && VALUE_TYPE(argv[1]) == VAL_INT)
         return value_int(a < b ? (long long)a : (long long)b);
     else
         return value_float(a < b ? a : b);
@@ -81,7 +81,7 @@ Value lib_math_max(int argc, Value *argv, Env *env) {
     double a = val_to_double(argv[0]);
     double b = val_to_double(argv[1]);
     
-    if (argv[0].type == VAL_INT && argv[1].type == VAL_INT)
+    if (VALUE_TYPE(argv[0]) == VAL_INT && VALUE_TYPE(argv[1]) == VAL_INT)
         return value_int(a > b ? (long long)a : (long long)b);
     else
         return value_float(a > b ? a : b);
@@ -96,7 +96,7 @@ Value lib_math_clamp(int argc, Value *argv, Env *env) {
     double res = (x < min) ? min : ((x > max) ? max : x);
 
     // If all inputs are ints, return int
-    if (argv[0].type == VAL_INT && argv[1].type == VAL_INT && argv[2].type == VAL_INT) {
+    if (VALUE_TYPE(argv[0]) == VAL_INT && VALUE_TYPE(argv[1]) == VAL_INT && VALUE_TYPE(argv[2]) == VAL_INT) {
         return value_int((long long)res);
     }
     return value_float(res);
@@ -255,7 +255,7 @@ Value lib_math_srand(int argc, Value *argv, Env *env) {
     if (argc == 0) {
         seed = get_os_entropy();
     } else {
-        seed = (argv[0].type == VAL_INT) ? (uint64_t)argv[0].i : (uint64_t)argv[0].f;
+        seed = (VALUE_TYPE(argv[0]) == VAL_INT) ? (uint64_t)VALUE_AS_INT(argv[0]) : (uint64_t)VALUE_AS_FLOAT(argv[0]);
     }
     
     // SplitMix64 to scramble the seed for the state array
@@ -280,10 +280,10 @@ Value lib_math_rand(int argc, Value *argv, Env *env) {
     
     long long min = 0, max = 0;
     if (argc == 1) {
-        max = (argv[0].type == VAL_INT) ? argv[0].i : (long long)argv[0].f;
+        max = (VALUE_TYPE(argv[0]) == VAL_INT) ? VALUE_AS_INT(argv[0]) : (long long)VALUE_AS_FLOAT(argv[0]);
     } else if (argc == 2) {
-        min = (argv[0].type == VAL_INT) ? argv[0].i : (long long)argv[0].f;
-        max = (argv[1].type == VAL_INT) ? argv[1].i : (long long)argv[1].f;
+        min = (VALUE_TYPE(argv[0]) == VAL_INT) ? VALUE_AS_INT(argv[0]) : (long long)VALUE_AS_FLOAT(argv[0]);
+        max = (VALUE_TYPE(argv[1]) == VAL_INT) ? VALUE_AS_INT(argv[1]) : (long long)VALUE_AS_FLOAT(argv[1]);
     } else {
         fprintf(stderr, "Runtime Error: rand() takes 0, 1, or 2 arguments.\n");
         return value_null();
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#define _XOPEN_SOURCE 700  // realpath, st_mtim
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "module_cache.h"
+#include "intern.h"
+
+// Registry of loaded modules, keyed by interned canonical path. Programs
+// import a handful of files, so a flat array with pointer compares is enough.
+static LunaModule **modules = NULL;
+static int module_count = 0;
+static int module_capacity = 0;
+
+static int reload_enabled = -1;
+
+static int module_reload_enabled(void) {
+    if (reload_enabled < 0) {
+        const char *raw = getenv("LUNA_MODULE_RELOAD");
+        reload_enabled = raw && strcmp(raw, "0") != 0;
+    }
+    return reload_enabled;
+}
+
+// Same file, same key: "a/../b.lu", "./b.lu" and "b.lu" all map to one entry.
+// Falls back to the path as written when it cannot be resolved.
+const char *module_cache_key(const char *path) {
+    char *resolved = realpath(path, NULL);
+    if (!resolved) return intern_string(path);
+    const char *canon = intern_string(resolved);
+    free(resolved);
+    return canon;
+}
+
+static long long file_mtime_ns(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    return (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+static int module_index(LunaModule *module) {
+    for (int i = 0; i < module_count; i++) {
+        if (modules[i] == module) return i;
+    }
+    return -1;
+}
+
+static void module_drop(int index) {
+    LunaModule *module = modules[index];
+    modules[index] = modules[--module_count];
+    free((void *)module->exports);
+    free(module);
+}
+
+LunaModule *module_cache_get(const char *path) {
+    const char *canon = module_cache_key(path);
+    for (int i = 0; i < module_count; i++) {
+        LunaModule *module = modules[i];
+        if (module->path != canon) continue;
+        if (module_reload_enabled() && file_mtime_ns(canon) != module->mtime_ns) {
+            // The old env is not freed: values bound from it by earlier
+            // imports (closures in particular) may still point into it.
+            module_drop(i);
+            return NULL;
+        }
+        return module;
+    }
+    return NULL;
+}
+
+LunaModule *module_cache_add(const char *path, Env *env, const char **exports, int export_count) {
+    if (module_count == module_capacity) {
+        int new_capacity = module_capacity < 8 ? 8 : module_capacity * 2;
+        LunaModule **grown = realloc(modules, sizeof(LunaModule *) * (size_t)new_capacity);
+        if (!grown) return NULL;
+        modules = grown;
+        module_capacity = new_capacity;
+    }
+
+    LunaModule *module = calloc(1, sizeof(LunaModule));
+    if (!module) return NULL;
+    module->path = module_cache_key(path);
+    module->env = env;
+    module->mtime_ns = file_mtime_ns(module->path);
+    if (export_count > 0) {
+        module->exports = malloc(sizeof(const char *) * (size_t)export_count);
+        if (!module->exports) {
+            free(module);
+            return NULL;
+        }
+        memcpy((void *)module->exports, exports, sizeof(const char *) * (size_t)export_count);
+        module->export_count = export_count;
+    }
+    modules[module_count++] = module;
+    return module;
+}
+
+void module_cache_remove(LunaModule *module) {
+    int index = module ? module_index(module) : -1;
+    if (index >= 0) module_drop(index);
+}
@@ -7,7 +7,6 @@
 #include "parser.h"
 #include "ast.h"
 #include "token.h"
-#include "mystr.h"
 #include "luna_error.h"
 #include "intern.h"
 
@@ -123,9 +122,8 @@ static AstNode *parse_inline_expr(const char *src, int line) {
 }
 
 static AstNode *parse_string_literal_or_template(Parser *p, int line) {
-    const char *raw = token_str(&p->cur);
-    char *s = my_strdup(raw);
-    size_t len = strlen(s);
+    char *s = token_dup(&p->cur);
+    size_t len = (size_t)p->cur.length;
     free_token(&p->cur);
     advance(p);
 
@@ -385,7 +383,7 @@ static AstNode *parse_declaration(Parser *p, int is_const) {
         }
 
         names = realloc(names, sizeof(const char*) * (name_count + 1));
-        names[name_count++] = intern_string(token_str(&p->cur));
+        names[name_count++] = token_ident(&p->cur);
         advance(p);
     } while (match(p, T_COMMA));
 
@@ -454,7 +452,7 @@ static AstNode *primary(Parser *p) {
         return parse_string_literal_or_template(p, line);
     }
     if (check(p, T_CHAR)) {
-        char c = token_str(&p->cur)[0];
+        char c = (char)p->cur.number;
         free_token(&p->cur);
         advance(p);
         return ast_char(c, line);
@@ -469,7 +467,7 @@ static AstNode *primary(Parser *p) {
     }
     if (check(p, T_IDENT)) {
         // Core Optimization: All variable identifiers are now Interned Pointers
-        const char *name = intern_string(token_str(&p->cur));
+        const char *name = token_ident(&p->cur);
         free_token(&p->cur);
         advance(p);
         return ast_ident(name, line); // No need to free, managed by intern table
@@ -535,7 +533,7 @@ static AstNode *primary(Parser *p) {
                     keys = new_keys;
                     values = new_values;
                 }
-                keys[count] = intern_string(token_str(&p->cur));
+                keys[count] = intern_string_n(p->cur.start, (size_t)p->cur.length);
                 free_token(&p->cur);
                 advance(p);
                 consume(p, T_COLON, "Expected ':' after map key");
@@ -561,7 +559,7 @@ static AstNode *primary(Parser *p) {
         char *prompt = NULL;
         if (!check(p, T_RPAREN)) {
             if (check(p, T_STRING)) {
-                prompt = my_strdup(token_str(&p->cur));
+                prompt = token_dup(&p->cur);
                 advance(p);
             } else {
                 error_report_with_context(ERR_SYNTAX, p->cur.line, p->cur.col,
@@ -644,7 +642,7 @@ static AstNode *call_or_index(Parser *p) {
                 p->had_error = 1;
                 return NULL;
             }
-            const char *field = intern_string(token_str(&p->cur));
+            const char *field = token_ident(&p->cur);
             advance(p);
             expr = ast_field(expr, field, line);
         } else if (match(p, T_INC)) {
@@ -905,7 +903,9 @@ static AstNode *statement(Parser *p) {
 
     if (match(p, T_USE)) {
         if (check(p, T_STRING)) {
-            AstNode *n = ast_import(token_str(&p->cur), NULL, 0, 1, line);
+            char *path = token_dup(&p->cur);
+            AstNode *n = ast_import(path, NULL, 0, 1, line);
+            free(path);
             free_token(&p->cur);
             advance(p);
             return n;
@@ -923,7 +923,7 @@ static AstNode *statement(Parser *p) {
                 break;
             }
             names = realloc(names, sizeof(const char *) * (name_count + 1));
-            names[name_count++] = intern_string(token_str(&p->cur));
+            names[name_count++] = token_ident(&p->cur);
             advance(p);
             if (!match(p, T_COMMA)) break;
         }
@@ -937,7 +937,9 @@ static AstNode *statement(Parser *p) {
             free(names);
             return NULL;
         }
-        AstNode *n = ast_import(token_str(&p->cur), names, name_count, 1, line);
+        char *path = token_dup(&p->cur);
+        AstNode *n = ast_import(path, names, name_count, 1, line);
+        free(path);
         free(names);
         free_token(&p->cur);
         advance(p);
@@ -952,7 +954,9 @@ static AstNode *statement(Parser *p) {
             p->had_error = 1;
             return NULL;
         }
-        AstNode *n = ast_import(token_str(&p->cur), NULL, 0, 0, line);
+        char *path = token_dup(&p->cur);
+        AstNode *n = ast_import(path, NULL, 0, 0, line);
+        free(path);
         free_token(&p->cur);
         advance(p);
         return n;
@@ -1056,7 +1060,7 @@ static AstNode *statement(Parser *p) {
                 p->had_error = 1;
                 return NULL;
             }
-            const char *name = intern_string(token_str(&p->cur));
+            const char *name = token_ident(&p->cur);
             advance(p);
             if (match(p, T_IN)) {
                 AstNode *iterable = expression(p);
@@ -1275,7 +1279,7 @@ static AstNode *function_def(Parser *p) {
         p->had_error = 1;
         return NULL;
     }
-    const char *name = intern_string(token_str(&p->cur));
+    const char *name = token_ident(&p->cur);
     advance(p);
 
     return function_literal(p, name, line);
@@ -1289,7 +1293,7 @@ static AstNode *data_def(Parser *p, int line, int is_template) {
         p->had_error = 1;
         return NULL;
     }
-    const char *name = intern_string(token_str(&p->cur));
+    const char *name = token_ident(&p->cur);
     advance(p);
     consume(p, T_LBRACE, "Expected '{' after data type name");
     const char **fields = NULL;
@@ -1304,7 +1308,7 @@ static AstNode *data_def(Parser *p, int line, int is_template) {
             break;
         }
         fields = realloc(fields, sizeof(const char *) * (size_t)(field_count + 1));
-        fields[field_count++] = intern_string(token_str(&p->cur));
+        fields[field_count++] = token_ident(&p->cur);
         advance(p);
         while (match(p, T_NEWLINE));
         if (!match(p, T_COMMA)) break;
@@ -1327,7 +1331,7 @@ static AstNode *bloc_def(Parser *p, int line) {
         p->had_error = 1;
         return NULL;
     }
-    const char *name = intern_string(token_str(&p->cur));
+    const char *name = token_ident(&p->cur);
     advance(p);
     consume(p, T_LBRACE, "Expected '{' after bloc type name");
     const char **fields = NULL;
@@ -1342,7 +1346,7 @@ static AstNode *bloc_def(Parser *p, int line) {
             break;
         }
         fields = realloc(fields, sizeof(const char *) * (size_t)(field_count + 1));
-        fields[field_count++] = intern_string(token_str(&p->cur));
+        fields[field_count++] = token_ident(&p->cur);
         advance(p);
         while (match(p, T_NEWLINE));
         if (!match(p, T_COMMA)) break;
@@ -1374,7 +1378,7 @@ static AstNode *function_literal(Parser *p, const char *name, int line) {
             }
             params = realloc(params, sizeof(const char*) * (count + 1));
             defaults = realloc(defaults, sizeof(AstNode*) * (count + 1));
-            params[count++] = intern_string(token_str(&p->cur));
+            params[count++] = token_ident(&p->cur);
             advance(p);
             defaults[count - 1] = match(p, T_EQ) ? expression(p) : NULL;
         } while (match(p, T_COMMA));
@@ -28,9 +28,9 @@ Value lib_sand_init(int argc, Value *argv, Env *env) {
 // Set Cell
 Value lib_sand_set(int argc, Value *argv, Env *env) {
     if (argc != 3) return value_int(0);
-    int x = (int)(argv[0].i);
-    int y = (int)(argv[1].i);
-    int type = (int)(argv[2].i);
+    int x = (int)(VALUE_AS_INT(argv[0]));
+    int y = (int)(VALUE_AS_INT(argv[1]));
+    int type = (int)(VALUE_AS_INT(argv[2]));
 
     if (x >= 0 && x < GRID_W && y >= 0 && y < GRID_H) {
         sand_grid[y * GRID_W + x] = type;
@@ -41,8 +41,8 @@ Value lib_sand_set(int argc, Value *argv, Env *env) {
 // Get Cell
 Value lib_sand_get(int argc, Value *argv, Env *env) {
     if (argc != 2) return value_int(0);
-    int x = (int)(argv[0].i);
-    int y = (int)(argv[1].i);
+    int x = (int)(VALUE_AS_INT(argv[0]));
+    int y = (int)(VALUE_AS_INT(argv[1]));
 
     if (x >= 0 && x < GRID_W && y >= 0 && y < GRID_H) {
         return value_int(sand_grid[y * GRID_W + x]);
@@ -21,8 +21,8 @@ static int check_args(int argc, int expected, const char *name) {
 
 // Helper to ensure an argument is a string and return it
 static const char *get_str_arg(Value *argv, int index) {
-    if (argv[index].type != VAL_STRING || !argv[index].string) return NULL;
-    return argv[index].string->chars;
+    if (VALUE_TYPE(argv[index]) != VAL_STRING || !VALUE_AS_STRING(argv[index])) return NULL;
+    return VALUE_AS_STRING(argv[index])->chars;
 }
 
 // Basic Operations
@@ -34,22 +34,25 @@ Value lib_str_len(int argc, Value *argv, Env *env) {
     }
 
     Value v = argv[0];
-    if (v.type == VAL_STRING && v.string) {
-        return value_int((long long)strlen(v.string->chars));
+    if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v)) {
+        return value_int((long long)strlen(VALUE_AS_STRING(v)->chars));
     } 
-    else if (v.type == VAL_LIST && v.list) {
-        return value_int((long long)v.list->count);
+    else if (VALUE_TYPE(v) == VAL_LIST && VALUE_AS_LIST(v)) {
+        return value_int((long long)VALUE_AS_LIST(v)->count);
     } 
-    else if (v.type == VAL_DENSE_LIST && v.dlist) {
-        return value_int((long long)v.dlist->count);
+    else if (VALUE_TYPE(v) == VAL_DENSE_LIST && VALUE_AS_DLIST(v)) {
+        return value_int((long long)VALUE_AS_DLIST(v)->count);
     }
-    else if (v.type == VAL_MAP && v.map) {
-        return value_int((long long)v.map->count);
+    else if (VALUE_TYPE(v) == VAL_RANGE) {
+        return value_int(value_range_len(VALUE_AS_RANGE(v)));
     }
-    else if (v.type == VAL_BOX) {
+    else if (VALUE_TYPE(v) == VAL_MAP && VALUE_AS_MAP(v)) {
+        return value_int((long long)VALUE_AS_MAP(v)->count);
+    }
+    else if (VALUE_TYPE(v) == VAL_BOX) {
         return value_int((long long)value_box_len(v));
     }
-    else if (v.type == VAL_TEMPLATE) {
+    else if (VALUE_TYPE(v) == VAL_TEMPLATE) {
         return value_int((long long)value_template_len(v));
     }
     else {
@@ -88,8 +91,8 @@ Value lib_str_substring(int argc, Value *argv, Env *env) {
     const char *s = get_str_arg(argv, 0);
     if (!s) return value_null();
     
-    long long start = argv[1].i;
-    long long len = argv[2].i;
+    long long start = VALUE_AS_INT(argv[1]);
+    long long len = VALUE_AS_INT(argv[2]);
     long long str_len = strlen(s);
     
     if (start < 0) start = 0;
@@ -108,13 +111,14 @@ Value lib_str_substring(int argc, Value *argv, Env *env) {
 
 Value lib_str_slice(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 3, "slice")) return value_null();
+    value_range_materialize(&argv[0]);
 
     // Add List support for slicing
-    if (argv[0].type == VAL_LIST && argv[0].list) {
+    if (VALUE_TYPE(argv[0]) == VAL_LIST && VALUE_AS_LIST(argv[0])) {
         Value src = argv[0];
-        long long start = argv[1].i;
-        long long end = argv[2].i;
-        long long count = src.list->count;
+        long long start = VALUE_AS_INT(argv[1]);
+        long long end = VALUE_AS_INT(argv[2]);
+        long long count = VALUE_AS_LIST(src)->count;
 
         // Handle negative indices
         if (start < 0) start += count;
@@ -127,7 +131,7 @@ Value lib_str_slice(int argc, Value *argv, Env *env) {
 
         Value result = value_list();
         for (long long i = start; i < end; i++) {
-            value_list_append(&result, src.list->items[i]);
+            value_list_append(&result, VALUE_AS_LIST(src)->items[i]);
         }
         return result;
     }
@@ -135,8 +139,8 @@ Value lib_str_slice(int argc, Value *argv, Env *env) {
     const char *s = get_str_arg(argv, 0);
     if (!s) return value_null();
     
-    long long start = argv[1].i;
-    long long end = argv[2].i;
+    long long start = VALUE_AS_INT(argv[1]);
+    long long end = VALUE_AS_INT(argv[2]);
     long long str_len = strlen(s);
     
     // Handle negative indices (Python style)
@@ -163,7 +167,7 @@ Value lib_str_char_at(int argc, Value *argv, Env *env) {
     const char *s = get_str_arg(argv, 0);
     if (!s) return value_null();
     
-    long long idx = argv[1].i;
+    long long idx = VALUE_AS_INT(argv[1]);
     if (idx < 0 || (size_t)idx >= strlen(s)) return value_string("");
     
     // Return as a single-char string
@@ -206,7 +210,7 @@ Value lib_str_last_index_of(int argc, Value *argv, Env *env) {
 
 Value lib_str_contains(int argc, Value *argv, Env *env) {
     Value idx = lib_str_index_of(argc, argv, env);
-    int found = (idx.i != -1);
+    int found = (VALUE_AS_INT(idx) != -1);
     value_free(idx); // Just checking existence
     return value_bool(found);
 }
@@ -377,7 +381,7 @@ Value lib_str_reverse(int argc, Value *argv, Env *env) {
 Value lib_str_repeat(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 2, "repeat")) return value_null();
     const char *s = get_str_arg(argv, 0);
-    long long count = argv[1].i;
+    long long count = VALUE_AS_INT(argv[1]);
 
     if (!s || count <= 0) return value_string("");
 
@@ -388,7 +392,7 @@ Value lib_str_repeat(int argc, Value *argv, Env *env) {
 Value lib_str_pad_left(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 3, "pad_left")) return value_null();
     const char *s = get_str_arg(argv, 0);
-    long long width = argv[1].i;
+    long long width = VALUE_AS_INT(argv[1]);
     // Third arg is CHAR string
     const char *pad_char_str = get_str_arg(argv, 2);
     char pad_c = (pad_char_str && strlen(pad_char_str) > 0) ? pad_char_str[0] : ' ';
@@ -413,7 +417,7 @@ Value lib_str_pad_left(int argc, Value *argv, Env *env) {
 Value lib_str_pad_right(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 3, "pad_right")) return value_null();
     const char *s = get_str_arg(argv, 0);
-    long long width = argv[1].i;
+    long long width = VALUE_AS_INT(argv[1]);
     const char *pad_char_str = get_str_arg(argv, 2);
     char pad_c = (pad_char_str && strlen(pad_char_str) > 0) ? pad_char_str[0] : ' ';
 
@@ -434,12 +438,12 @@ Value lib_str_pad_right(int argc, Value *argv, Env *env) {
 }
 
 Value lib_str_format(int argc, Value *argv, Env *env) {
-    if (argc < 1 || argv[0].type != VAL_STRING || !argv[0].string) {
+    if (argc < 1 || VALUE_TYPE(argv[0]) != VAL_STRING || !VALUE_AS_STRING(argv[0])) {
         error_report(ERR_ARGUMENT, 0, 0, "format() expects a template string", "Usage: format(\"Hello {}\", name)");
         return value_null();
     }
 
-    const char *tmpl = argv[0].string->chars;
+    const char *tmpl = VALUE_AS_STRING(argv[0])->chars;
     size_t total_len = 0;
     int arg_index = 1;
 
@@ -515,19 +519,20 @@ Value lib_str_split(int argc, Value *argv, Env *env) {
 
 Value lib_str_join(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 2, "join")) return value_null();
+    value_range_materialize(&argv[0]);
     
     // Arg 0 is LIST, Arg 1 is Delimiter
-    if (argv[0].type != VAL_LIST || !argv[0].list) return value_string("");
+    if (VALUE_TYPE(argv[0]) != VAL_LIST || !VALUE_AS_LIST(argv[0])) return value_string("");
     const char *delim = get_str_arg(argv, 1);
     if (!delim) delim = "";
     
     // Calculate total length
     size_t total_len = 0;
     size_t delim_len = strlen(delim);
-    int count = argv[0].list->count;
+    int count = VALUE_AS_LIST(argv[0])->count;
     
     for (int i = 0; i < count; i++) {
-        char *s = value_to_string(argv[0].list->items[i]);
+        char *s = value_to_string(VALUE_AS_LIST(argv[0])->items[i]);
         total_len += strlen(s);
         free(s);
         if (i < count - 1) total_len += delim_len;
@@ -537,7 +542,7 @@ Value lib_str_join(int argc, Value *argv, Env *env) {
     res[0] = '\0';
     
     for (int i = 0; i < count; i++) {
-        char *s = value_to_string(argv[0].list->items[i]);
+        char *s = value_to_string(VALUE_AS_LIST(argv[0])->items[i]);
         strcat(res, s);
         free(s);
         if (i < count - 1) strcat(res, delim);
@@ -597,9 +602,9 @@ Value lib_str_is_space(int argc, Value *argv, Env *env) {
 Value lib_str_to_int(int argc, Value *argv, Env *env) {
     if (!check_args(argc, 1, "to_int")) return value_null();
     Value v = argv[0];
-    if (v.type == VAL_INT) return v;
-    if (v.type == VAL_FLOAT) return value_int((long long)v.f);
-    if (v.type == VAL_STRING && v.string && v.string->chars) return value_int(strtoll(v.string->chars, NULL, 10));
+    if (VALUE_TYPE(v) == VAL_INT) return v;
+    if (VALUE_TYPE(v) == VAL_FLOAT) return value_int((long long)VALUE_AS_FLOAT(v));
+    if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v) && VALUE_AS_STRING(v)->chars) return value_int(strtoll(VALUE_AS_STRING(v)->chars, NULL, 10));
     return value_int(0);
 }
 
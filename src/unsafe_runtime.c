@@ -209,7 +209,7 @@ int unsafe_runtime_inside_block(void) {
 }
 
 int unsafe_runtime_is_pointer(Value v) {
-    return v.type == VAL_POINTER && unsafe_find_owner(v.ptr) != NULL;
+    return VALUE_TYPE(v) == VAL_POINTER && unsafe_find_owner(VALUE_AS_PTR(v)) != NULL;
 }
 
 int unsafe_runtime_begin_block(int line) {
@@ -226,22 +226,22 @@ void unsafe_runtime_end_block(void) {
 
 int unsafe_runtime_check_gc_store(Value v, int line) {
     if (!unsafe_runtime_is_pointer(v)) return 1;
-    return unsafe_runtime_check(luna_mem_gc_store_ok(v.ptr), line);
+    return unsafe_runtime_check(luna_mem_gc_store_ok(VALUE_AS_PTR(v)), line);
 }
 
 int unsafe_runtime_check_escape(Value v, int line) {
     if (!unsafe_runtime_is_pointer(v)) return 1;
-    return unsafe_runtime_check(luna_mem_escape_ok(v.ptr), line);
+    return unsafe_runtime_check(luna_mem_escape_ok(VALUE_AS_PTR(v)), line);
 }
 
 int unsafe_runtime_check_compare(Value left, Value right, int op, int line) {
     if (!unsafe_runtime_is_pointer(left) || !unsafe_runtime_is_pointer(right)) return 1;
-    return unsafe_runtime_check(luna_mem_cmp_ok(left.ptr, right.ptr, op), line);
+    return unsafe_runtime_check(luna_mem_cmp_ok(VALUE_AS_PTR(left), VALUE_AS_PTR(right), op), line);
 }
 
 int unsafe_runtime_check_cast(Value v, int target_type, int line) {
     if (!unsafe_runtime_is_pointer(v)) return 1;
-    return unsafe_runtime_check(luna_mem_cast_ok(v.ptr, target_type), line);
+    return unsafe_runtime_check(luna_mem_cast_ok(VALUE_AS_PTR(v), target_type), line);
 }
 
 int unsafe_runtime_check_call(int is_builtin, int line) {
@@ -249,8 +249,8 @@ int unsafe_runtime_check_call(int is_builtin, int line) {
 }
 
 Value unsafe_runtime_alloc(Value size, int line) {
-    int is_integer = size.type == VAL_INT;
-    long long cells = is_integer ? size.i : 0;
+    int is_integer = VALUE_TYPE(size) == VAL_INT;
+    long long cells = is_integer ? VALUE_AS_INT(size) : 0;
     if (!unsafe_runtime_check(luna_mem_alloc_size_ok(cells, is_integer), line)) {
         return value_null();
     }
@@ -277,12 +277,12 @@ Value unsafe_runtime_free(Value ptrv, int line) {
         return value_null();
     }
 
-    PointerMeta *meta = unsafe_find_exact(ptrv.ptr);
+    PointerMeta *meta = unsafe_find_exact(VALUE_AS_PTR(ptrv));
     if (!meta || meta->kind != PTR_KIND_ALLOC || !meta->owns_allocation) {
         report_unsafe_error(13, line);
         return value_null();
     }
-    if (!unsafe_runtime_check(luna_mem_free_ok(ptrv.ptr), line)) {
+    if (!unsafe_runtime_check(luna_mem_free_ok(VALUE_AS_PTR(ptrv)), line)) {
         return value_null();
     }
 
@@ -296,20 +296,20 @@ Value unsafe_runtime_deref(Value ptrv, int line) {
         return value_null();
     }
 
-    PointerMeta *meta = unsafe_find_owner(ptrv.ptr);
+    PointerMeta *meta = unsafe_find_owner(VALUE_AS_PTR(ptrv));
     if (!meta) {
         report_unsafe_error(13, line);
         return value_null();
     }
     PointerMeta *alloc_meta = unsafe_resolve_alloc_meta(meta);
     if (meta->kind == PTR_KIND_ALLOC &&
-        !unsafe_runtime_check(luna_mem_deref_ok(ptrv.ptr), line)) {
+        !unsafe_runtime_check(luna_mem_deref_ok(VALUE_AS_PTR(ptrv)), line)) {
         return value_null();
     }
 
-    Value *slot = (Value *)(uintptr_t)ptrv.ptr;
+    Value *slot = (Value *)(uintptr_t)VALUE_AS_PTR(ptrv);
     if (meta->kind == PTR_KIND_ALLOC) {
-        size_t idx = (ptrv.ptr - alloc_meta->base) / sizeof(Value);
+        size_t idx = (VALUE_AS_PTR(ptrv) - alloc_meta->base) / sizeof(Value);
         return (alloc_meta->init_flags && alloc_meta->init_flags[idx]) ? value_copy(*slot) : value_null();
     }
     return value_copy(*slot);
@@ -321,23 +321,23 @@ Value unsafe_runtime_store(Value ptrv, Value rhs, int line) {
         return value_null();
     }
 
-    PointerMeta *meta = unsafe_find_owner(ptrv.ptr);
+    PointerMeta *meta = unsafe_find_owner(VALUE_AS_PTR(ptrv));
     if (!meta) {
         report_unsafe_error(13, line);
         return value_null();
     }
     PointerMeta *alloc_meta = unsafe_resolve_alloc_meta(meta);
     if (meta->kind == PTR_KIND_ALLOC &&
-        !unsafe_runtime_check(luna_mem_store_ok(ptrv.ptr), line)) {
+        !unsafe_runtime_check(luna_mem_store_ok(VALUE_AS_PTR(ptrv)), line)) {
         return value_null();
     }
     if (!unsafe_runtime_check_gc_store(rhs, line)) {
         return value_null();
     }
 
-    Value *slot = (Value *)(uintptr_t)ptrv.ptr;
+    Value *slot = (Value *)(uintptr_t)VALUE_AS_PTR(ptrv);
     if (meta->kind == PTR_KIND_ALLOC) {
-        size_t idx = (ptrv.ptr - alloc_meta->base) / sizeof(Value);
+        size_t idx = (VALUE_AS_PTR(ptrv) - alloc_meta->base) / sizeof(Value);
         if (alloc_meta->init_flags && alloc_meta->init_flags[idx]) value_free(*slot);
         *slot = value_copy(rhs);
         if (alloc_meta->init_flags) alloc_meta->init_flags[idx] = 1;
@@ -349,27 +349,27 @@ Value unsafe_runtime_store(Value ptrv, Value rhs, int line) {
 }
 
 Value unsafe_runtime_ptr_add(Value basev, Value offv, int line) {
-    if (!unsafe_runtime_is_pointer(basev) || offv.type != VAL_INT) {
+    if (!unsafe_runtime_is_pointer(basev) || VALUE_TYPE(offv) != VAL_INT) {
         error_report_with_context(ERR_TYPE, line, 0,
             "ptr_add() expects a pointer and an integer offset",
             "Use ptr_add(buf, 1).");
         return value_null();
     }
 
-    PointerMeta *owner = unsafe_find_owner(basev.ptr);
+    PointerMeta *owner = unsafe_find_owner(VALUE_AS_PTR(basev));
     if (!owner) {
         report_unsafe_error(13, line);
         return value_null();
     }
 
     uintptr_t out_ptr = 0;
-    size_t byte_offset = (size_t)offv.i * sizeof(Value);
+    size_t byte_offset = (size_t)VALUE_AS_INT(offv) * sizeof(Value);
     if (owner->kind == PTR_KIND_ALLOC &&
-        !unsafe_runtime_check(luna_mem_ptr_add_ok(basev.ptr, byte_offset, &out_ptr), line)) {
+        !unsafe_runtime_check(luna_mem_ptr_add_ok(VALUE_AS_PTR(basev), byte_offset, &out_ptr), line)) {
         return value_null();
     }
     if (owner->kind != PTR_KIND_ALLOC) {
-        out_ptr = basev.ptr + byte_offset;
+        out_ptr = VALUE_AS_PTR(basev) + byte_offset;
     }
 
     unsafe_register_alias_meta(out_ptr, owner);
@@ -377,7 +377,7 @@ Value unsafe_runtime_ptr_add(Value basev, Value offv, int line) {
 }
 
 Value unsafe_runtime_addr(Value *slot, int line) {
-    uintptr_t target = unsafe_runtime_is_pointer(*slot) ? slot->ptr : (uintptr_t)slot;
+    uintptr_t target = unsafe_runtime_is_pointer(*slot) ? VALUE_AS_PTR(*slot) : (uintptr_t)slot;
     if (!unsafe_runtime_check(luna_mem_addr_ok(target, 1), line)) {
         return value_null();
     }
@@ -391,8 +391,8 @@ Value unsafe_runtime_defer(Value ptrv, int line) {
         report_unsafe_error(13, line);
         return value_null();
     }
-    luna_mem_defer(ptrv.ptr);
-    unsafe_defer_push_local(ptrv.ptr);
+    luna_mem_defer(VALUE_AS_PTR(ptrv));
+    unsafe_defer_push_local(VALUE_AS_PTR(ptrv));
     return value_null();
 }
 
@@ -37,6 +37,11 @@ struct BlocTypeDesc {
 
 static BlocTypeDesc *bloc_registry = NULL;
 
+/* Bumped whenever a DataTypeObj dies so caches keyed on its address never
+ * match a different type later allocated at the same spot. BlocTypeDescs live
+ * for the whole run and never need this. */
+uint64_t value_shape_epoch = 1;
+
 typedef struct {
     int in_use;
     int ref_count;
@@ -69,6 +74,9 @@ struct TemplateObj {
 #define VALUE_BOX_MAX_BYTES VALUE_BLOC_INLINE_MAX
 #define TEMPLATE_MIN_CHUNK_BYTES (16 * 1024)
 static BoxSlot box_slots[BOX_SLOT_MAX];
+/* Box slots are handed out low-first and never return to !in_use, so every
+ * live box sits below this mark; scope release scans only that prefix. */
+static int box_slots_high = 0;
 
 static BlocSlot *bloc_slot_from_handle(uint64_t handle) {
     if (handle == 0 || handle > BLOC_SLOT_MAX) return NULL;
@@ -106,6 +114,7 @@ static uint64_t box_alloc_slot(size_t size) {
         box_slots[i].len = size;
         box_slots[i].cap = size;
         box_slots[i].bytes = bytes;
+        if ((int)i >= box_slots_high) box_slots_high = (int)i + 1;
         return i + 1;
     }
     return 0;
@@ -150,7 +159,7 @@ static BlocTypeDesc *bloc_find_desc(const char *name) {
 }
 
 static BlocFieldKind bloc_kind_for_value(Value v) {
-    switch (v.type) {
+    switch (VALUE_TYPE(v)) {
         case VAL_INT: return BLOC_FIELD_INT;
         case VAL_FLOAT: return BLOC_FIELD_FLOAT;
         case VAL_BOOL: return BLOC_FIELD_BOOL;
@@ -167,7 +176,7 @@ static int bloc_kind_size(BlocFieldKind kind, Value v) {
         case BLOC_FIELD_BOOL: return (int)sizeof(unsigned char);
         case BLOC_FIELD_CHAR: return (int)sizeof(char);
         case BLOC_FIELD_BLOC: {
-            BlocSlot *slot = (v.type == VAL_BLOC) ? bloc_slot_from_handle(v.bloc.handle) : NULL;
+            BlocSlot *slot = (VALUE_TYPE(v) == VAL_BLOC) ? bloc_slot_from_handle(VALUE_AS_BLOC(v).handle) : NULL;
             return (slot && slot->desc) ? slot->desc->total_size : 0;
         }
         default: return 0;
@@ -216,7 +225,7 @@ static int bloc_validate_layout(BlocTypeDesc *desc, int argc, Value *argv, char
                          desc->name ? desc->name : "<bloc>", desc->fields[i]);
                 return 0;
             }
-            BlocSlot *nested_slot = (actual_kind == BLOC_FIELD_BLOC) ? bloc_slot_from_handle(argv[i].bloc.handle) : NULL;
+            BlocSlot *nested_slot = (actual_kind == BLOC_FIELD_BLOC) ? bloc_slot_from_handle(VALUE_AS_BLOC(argv[i]).handle) : NULL;
             if (actual_kind == BLOC_FIELD_BLOC && desc->nested_descs[i] != (nested_slot ? nested_slot->desc : NULL)) {
                 snprintf(msg, msg_len,
                          "Bloc '%s' field '%s' must use the same nested bloc type",
@@ -228,7 +237,7 @@ static int bloc_validate_layout(BlocTypeDesc *desc, int argc, Value *argv, char
 
         desc->kinds[i] = (unsigned char)actual_kind;
         if (actual_kind == BLOC_FIELD_BLOC) {
-            BlocSlot *nested_slot = bloc_slot_from_handle(argv[i].bloc.handle);
+            BlocSlot *nested_slot = bloc_slot_from_handle(VALUE_AS_BLOC(argv[i]).handle);
             desc->nested_descs[i] = nested_slot ? nested_slot->desc : NULL;
         } else {
             desc->nested_descs[i] = NULL;
@@ -258,22 +267,28 @@ static int bloc_validate_layout(BlocTypeDesc *desc, int argc, Value *argv, char
 
 static void bloc_store_field(unsigned char *dest, BlocFieldKind kind, Value v, int size) {
     switch (kind) {
-        case BLOC_FIELD_INT:
-            memcpy(dest, &v.i, sizeof(long long));
+        case BLOC_FIELD_INT: {
+            long long i = VALUE_AS_INT(v);
+            memcpy(dest, &i, sizeof(long long));
             break;
-        case BLOC_FIELD_FLOAT:
-            memcpy(dest, &v.f, sizeof(double));
+        }
+        case BLOC_FIELD_FLOAT: {
+            double f = VALUE_AS_FLOAT(v);
+            memcpy(dest, &f, sizeof(double));
             break;
+        }
         case BLOC_FIELD_BOOL: {
-            unsigned char b = (unsigned char)(v.b ? 1 : 0);
+            unsigned char b = (unsigned char)(VALUE_AS_BOOL(v) ? 1 : 0);
             memcpy(dest, &b, sizeof(unsigned char));
             break;
         }
-        case BLOC_FIELD_CHAR:
-            memcpy(dest, &v.c, sizeof(char));
+        case BLOC_FIELD_CHAR: {
+            char c = VALUE_AS_CHAR(v);
+            memcpy(dest, &c, sizeof(char));
             break;
+        }
         case BLOC_FIELD_BLOC: {
-            BlocSlot *slot = bloc_slot_from_handle(v.bloc.handle);
+            BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(v).handle);
             if (slot) memcpy(dest, slot->bytes, (size_t)size);
             break;
         }
@@ -313,9 +328,8 @@ static Value bloc_load_field(const BlocTypeDesc *desc, int idx, const unsigned c
             break;
         }
         case BLOC_FIELD_BLOC: {
-            out.type = VAL_BLOC;
-            out.bloc.handle = bloc_alloc_slot(desc->nested_descs[idx]);
-            BlocSlot *slot = bloc_slot_from_handle(out.bloc.handle);
+            out = value_make(VAL_BLOC, bloc_alloc_slot(desc->nested_descs[idx]));
+            BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(out).handle);
             if (slot && slot->desc) {
                 memcpy(slot->bytes, field_src, (size_t)slot->desc->total_size);
             }
@@ -366,7 +380,7 @@ static void map_entries_trace(GCObject *obj, void *ctx) {
             trace->scan_resume = i;
             return;
         }
-        if (entries[i].occupied) {
+        if (entries[i].key) {
             value_gc_mark(&entries[i].value, ctx);
             if (trace->deadline_hit) {
                 trace->scan_resume = i;
@@ -398,6 +412,15 @@ static void dense_list_finalize(GCObject *obj) {
     (void)obj;
 }
 
+static void range_trace(GCObject *obj, void *ctx) {
+    RangeObj *range = (RangeObj *)GC_PAYLOAD(obj);
+    value_gc_mark(&range->list, ctx);
+}
+
+static void range_finalize(GCObject *obj) {
+    (void)obj;
+}
+
 static void map_trace(GCObject *obj, void *ctx) {
     MapObj *map = (MapObj *)GC_PAYLOAD(obj);
     if (map->entries) gc_visit_ref(ctx, (void **)&map->entries);
@@ -414,7 +437,7 @@ static void closure_trace(GCObject *obj, void *ctx) {
 
 static void closure_finalize(GCObject *obj) {
     ClosureObj *closure = (ClosureObj *)GC_PAYLOAD(obj);
-    if (closure->owns_env) env_free_chain(closure->env);
+    if (closure->owns_env) env_free(closure->env);
 }
 
 static void mark_chunk_constants(LunaChunk *chunk, void *ctx) {
@@ -430,10 +453,16 @@ static void mark_chunk_constants(LunaChunk *chunk, void *ctx) {
 static void vm_closure_trace(GCObject *obj, void *ctx) {
     VMClosureObj *closure = (VMClosureObj *)GC_PAYLOAD(obj);
     for (int i = 0; i < closure->upvalue_count; i++) {
-        if (closure->upvalues[i]) {
+        VMUpvalue *upval = closure->upvalues[i];
+        int is_flat = closure->flat_count > 0 && upval >= closure->flat &&
+                      upval < closure->flat + closure->flat_count;
+        if (upval && !is_flat) {
             gc_visit_ref(ctx, (void **)&closure->upvalues[i]);
         }
     }
+    for (int i = 0; i < closure->flat_count; i++) {
+        value_gc_mark(&closure->flat[i].closed, ctx);
+    }
     mark_chunk_constants(closure->chunk, ctx);
 }
 
@@ -458,6 +487,7 @@ static void data_type_trace(GCObject *obj, void *ctx) {
 
 static void data_type_finalize(GCObject *obj) {
     (void)obj;
+    value_shape_epoch++;
 }
 
 static void template_trace(GCObject *obj, void *ctx) {
@@ -497,13 +527,13 @@ static void template_finalize(GCObject *obj) {
     TemplateObj *templ = (TemplateObj *)GC_PAYLOAD(obj);
     for (int i = 0; i < templ->field_count; i++) {
         Value *field = &templ->fields[i];
-        if (field->type == VAL_BOX) {
-            BoxSlot *slot = box_slot_from_handle(field->box.handle);
+        if (VALUE_TYPE(*field) == VAL_BOX) {
+            BoxSlot *slot = box_slot_from_handle(VALUE_AS_BOX(*field).handle);
             box_free_slot(slot);
         } else {
             value_free(*field);
         }
-        field->type = VAL_NULL;
+        *field = value_null();
     }
 }
 
@@ -565,28 +595,36 @@ static void gc_note_owner_write_value(void *payload, const Value *value) {
 
     // Incremental tri-color barrier: if a container links a heap child while marking,
     // shade the child so black->white edges are not lost.
-    switch (value->type) {
+    switch (VALUE_TYPE(*value)) {
         case VAL_STRING:
-            if (value->string) luna_gc_runtime_write_barrier(value->string);
+            if (VALUE_AS_STRING(*value)) luna_gc_runtime_write_barrier(VALUE_AS_STRING(*value));
             break;
         case VAL_LIST:
-            if (value->list) luna_gc_runtime_write_barrier(value->list);
+            if (VALUE_AS_LIST(*value)) luna_gc_runtime_write_barrier(VALUE_AS_LIST(*value));
             break;
         case VAL_DENSE_LIST:
-            if (value->dlist) luna_gc_runtime_write_barrier(value->dlist);
+            if (VALUE_AS_DLIST(*value)) luna_gc_runtime_write_barrier(VALUE_AS_DLIST(*value));
             break;
         case VAL_MAP:
-            if (value->map) luna_gc_runtime_write_barrier(value->map);
+            if (VALUE_AS_MAP(*value)) luna_gc_runtime_write_barrier(VALUE_AS_MAP(*value));
             break;
         case VAL_CLOSURE:
-            if (value->closure) luna_gc_runtime_write_barrier(value->closure);
+            if (VALUE_AS_CLOSURE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_CLOSURE(*value));
             break;
         case VAL_DATA_TYPE:
-            if (value->dtype) luna_gc_runtime_write_barrier(value->dtype);
+            if (VALUE_AS_DTYPE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_DTYPE(*value));
             break;
         case VAL_TEMPLATE:
-            if (value->template_obj) luna_gc_runtime_write_barrier(value->template_obj);
+            if (VALUE_AS_TEMPLATE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_TEMPLATE(*value));
+            break;
+        case VAL_RANGE:
+            if (VALUE_AS_RANGE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_RANGE(*value));
+            break;
+#ifdef LUNA_NANBOX
+        case VAL_INT:
+            luna_gc_runtime_write_barrier(VALUE_AS_BIG_INT(*value));
             break;
+#endif
         default:
             break;
     }
@@ -599,28 +637,36 @@ static void gc_note_owner_write_value(void *payload, const Value *value) {
 static void gc_note_value_overwrite(const Value *value) {
     if (!luna_gc_runtime_enabled() || !value || !VALUE_IS_HEAP(*value)) return;
 
-    switch (value->type) {
+    switch (VALUE_TYPE(*value)) {
         case VAL_STRING:
-            if (value->string) luna_gc_runtime_write_barrier(value->string);
+            if (VALUE_AS_STRING(*value)) luna_gc_runtime_write_barrier(VALUE_AS_STRING(*value));
             break;
         case VAL_LIST:
-            if (value->list) luna_gc_runtime_write_barrier(value->list);
+            if (VALUE_AS_LIST(*value)) luna_gc_runtime_write_barrier(VALUE_AS_LIST(*value));
             break;
         case VAL_DENSE_LIST:
-            if (value->dlist) luna_gc_runtime_write_barrier(value->dlist);
+            if (VALUE_AS_DLIST(*value)) luna_gc_runtime_write_barrier(VALUE_AS_DLIST(*value));
             break;
         case VAL_MAP:
-            if (value->map) luna_gc_runtime_write_barrier(value->map);
+            if (VALUE_AS_MAP(*value)) luna_gc_runtime_write_barrier(VALUE_AS_MAP(*value));
             break;
         case VAL_CLOSURE:
-            if (value->closure) luna_gc_runtime_write_barrier(value->closure);
+            if (VALUE_AS_CLOSURE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_CLOSURE(*value));
             break;
         case VAL_DATA_TYPE:
-            if (value->dtype) luna_gc_runtime_write_barrier(value->dtype);
+            if (VALUE_AS_DTYPE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_DTYPE(*value));
             break;
         case VAL_TEMPLATE:
-            if (value->template_obj) luna_gc_runtime_write_barrier(value->template_obj);
+            if (VALUE_AS_TEMPLATE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_TEMPLATE(*value));
+            break;
+        case VAL_RANGE:
+            if (VALUE_AS_RANGE(*value)) luna_gc_runtime_write_barrier(VALUE_AS_RANGE(*value));
             break;
+#ifdef LUNA_NANBOX
+        case VAL_INT:
+            luna_gc_runtime_write_barrier(VALUE_AS_BIG_INT(*value));
+            break;
+#endif
         default:
             break;
     }
@@ -636,11 +682,10 @@ static void map_init_storage(MapObj *map, int capacity) {
 
 static void map_reinsert_entry(MapObj *map, const char *key, Value value) {
     unsigned int idx = map_hash(key) & (map->capacity - 1);
-    while (map->entries[idx].occupied) {
+    while (map->entries[idx].key) {
         idx = (idx + 1) & (map->capacity - 1);
     }
     gc_note_owner_write_value(map->entries, &value);
-    map->entries[idx].occupied = 1;
     map->entries[idx].key = key;
     map->entries[idx].value = value;
     map->count++;
@@ -660,7 +705,7 @@ static void map_grow(MapObj *map, int min_capacity) {
     }
 
     for (int i = 0; i < old_capacity; i++) {
-        if (old_entries[i].occupied) {
+        if (old_entries[i].key) {
             map_reinsert_entry(map, old_entries[i].key, old_entries[i].value);
         }
     }
@@ -681,7 +726,7 @@ static MapEntry *map_find_entry(MapObj *map, const char *key) {
     if (!map || !map->entries || map->capacity == 0) return NULL;
     unsigned int idx = map_hash(key) & (map->capacity - 1);
     unsigned int start = idx;
-    while (map->entries[idx].occupied) {
+    while (map->entries[idx].key) {
         if (map->entries[idx].key == key) return &map->entries[idx];
         idx = (idx + 1) & (map->capacity - 1);
         if (idx == start) break;
@@ -691,56 +736,63 @@ static MapEntry *map_find_entry(MapObj *map, const char *key) {
 
 static void map_close_delete_gap(MapObj *map, int hole_idx) {
     int idx = (hole_idx + 1) & (map->capacity - 1);
-    while (map->entries[idx].occupied) {
+    while (map->entries[idx].key) {
         MapEntry entry = map->entries[idx];
         gc_note_value_overwrite(&map->entries[idx].value);
-        map->entries[idx].occupied = 0;
+        map->entries[idx].key = NULL;
         map->count--;
         map_reinsert_entry(map, entry.key, entry.value);
         idx = (idx + 1) & (map->capacity - 1);
     }
 }
 
-// Constructor for integer values
-Value value_int(long long x) {
+#ifdef LUNA_NANBOX
+// Ints outside 48 bits get a cell of their own, allocated like a string.
+Value value_int_boxed(long long x) {
+    BigIntObj *cell;
+    if (luna_gc_runtime_enabled()) {
+        cell = (BigIntObj *)luna_gc_alloc(sizeof(BigIntObj), string_trace, string_finalize);
+        cell->ref_count = 0;
+    } else {
+        cell = malloc(sizeof(BigIntObj));
+        if (!cell) abort();
+        cell->ref_count = 1;
+    }
+    cell->value = x;
     Value v;
-    v.type = VAL_INT;
-    v.i = x;
+    v.bits = ((uint64_t)VALUE_TAG_BIG_INT << 47) | (uint64_t)(uintptr_t)cell;
     return v;
 }
 
-// Constructor for floating point values
-Value value_float(double x) {
-    Value v;
-    v.type = VAL_FLOAT;
-    v.f = x;
-    return v;
+long long value_int_unboxed(Value v) {
+    if ((v.bits >> 47) == VALUE_TAG_BIG_INT) return VALUE_AS_BIG_INT(v)->value;
+    return (long long)value_payload(v);
 }
+#endif
 
 Value value_string_len(const char *s, size_t len) {
-    Value v;
-    v.type = VAL_STRING;
+    StringObj *str;
     if (luna_gc_runtime_enabled()) {
-        v.string = (StringObj *)luna_gc_alloc(sizeof(StringObj) + len + 1, string_trace, string_finalize);
-        v.string->ref_count = 0;
-        v.string->chars = (char *)(v.string + 1);
+        str = (StringObj *)luna_gc_alloc(sizeof(StringObj) + len + 1, string_trace, string_finalize);
+        str->ref_count = 0;
+        str->chars = (char *)(str + 1);
         if (s) {
-            memcpy(v.string->chars, s, len + 1);
+            memcpy(str->chars, s, len + 1);
         } else {
-            v.string->chars[0] = '\0';
+            str->chars[0] = '\0';
         }
     } else {
-        v.string = malloc(sizeof(StringObj));
-        v.string->ref_count = 1;
+        str = malloc(sizeof(StringObj));
+        str->ref_count = 1;
         if (s) {
-            v.string->chars = malloc(len + 1);
-            memcpy(v.string->chars, s, len);
-            v.string->chars[len] = '\0';
+            str->chars = malloc(len + 1);
+            memcpy(str->chars, s, len);
+            str->chars[len] = '\0';
         } else {
-            v.string->chars = my_strdup("");
+            str->chars = my_strdup("");
         }
     }
-    return v;
+    return value_make(VAL_STRING, (uintptr_t)str);
 }
 
 // Constructor for string values
@@ -749,73 +801,72 @@ Value value_string(const char *s) {
 }
 
 Value value_string_concat_raw(const char *left, size_t left_len, const char *right, size_t right_len) {
-    Value v;
+    StringObj *str;
     size_t total_len = left_len + right_len;
 
-    v.type = VAL_STRING;
     if (luna_gc_runtime_enabled()) {
-        v.string = (StringObj *)luna_gc_alloc(sizeof(StringObj) + total_len + 1, string_trace, string_finalize);
-        v.string->ref_count = 0;
-        v.string->chars = (char *)(v.string + 1);
+        str = (StringObj *)luna_gc_alloc(sizeof(StringObj) + total_len + 1, string_trace, string_finalize);
+        str->ref_count = 0;
+        str->chars = (char *)(str + 1);
     } else {
-        v.string = malloc(sizeof(StringObj));
-        v.string->ref_count = 1;
-        v.string->chars = malloc(total_len + 1);
+        str = malloc(sizeof(StringObj));
+        str->ref_count = 1;
+        str->chars = malloc(total_len + 1);
     }
 
-    if (left_len) memcpy(v.string->chars, left, left_len);
-    if (right_len) memcpy(v.string->chars + left_len, right, right_len);
-    v.string->chars[total_len] = '\0';
-    return v;
+    if (left_len) memcpy(str->chars, left, left_len);
+    if (right_len) memcpy(str->chars + left_len, right, right_len);
+    str->chars[total_len] = '\0';
+    return value_make(VAL_STRING, (uintptr_t)str);
+}
+
+Value value_string_join_raw(const char *const *parts, const size_t *lens, int count) {
+    StringObj *str;
+    size_t total_len = 0;
+    for (int i = 0; i < count; i++) total_len += lens[i];
+
+    if (luna_gc_runtime_enabled()) {
+        str = (StringObj *)luna_gc_alloc(sizeof(StringObj) + total_len + 1, string_trace, string_finalize);
+        str->ref_count = 0;
+        str->chars = (char *)(str + 1);
+    } else {
+        str = malloc(sizeof(StringObj));
+        str->ref_count = 1;
+        str->chars = malloc(total_len + 1);
+    }
+
+    char *dst = str->chars;
+    for (int i = 0; i < count; i++) {
+        if (lens[i]) memcpy(dst, parts[i], lens[i]);
+        dst += lens[i];
+    }
+    *dst = '\0';
+    return value_make(VAL_STRING, (uintptr_t)str);
 }
 
 Value value_string_repeat_raw(const char *s, size_t len, size_t count) {
     if (!s || count == 0 || len == 0) return value_string("");
 
     size_t total_len = len * count;
-    Value v;
-    v.type = VAL_STRING;
+    StringObj *str;
 
     if (luna_gc_runtime_enabled()) {
-        v.string = (StringObj *)luna_gc_alloc(sizeof(StringObj) + total_len + 1, string_trace, string_finalize);
-        v.string->ref_count = 0;
-        v.string->chars = (char *)(v.string + 1);
+        str = (StringObj *)luna_gc_alloc(sizeof(StringObj) + total_len + 1, string_trace, string_finalize);
+        str->ref_count = 0;
+        str->chars = (char *)(str + 1);
     } else {
-        v.string = malloc(sizeof(StringObj));
-        v.string->ref_count = 1;
-        v.string->chars = malloc(total_len + 1);
+        str = malloc(sizeof(StringObj));
+        str->ref_count = 1;
+        str->chars = malloc(total_len + 1);
     }
 
-    char *dst = v.string->chars;
+    char *dst = str->chars;
     for (size_t i = 0; i < count; i++) {
         memcpy(dst, s, len);
         dst += len;
     }
     *dst = '\0';
-    return v;
-}
-
-// Constructor for char values
-Value value_char(char c) {
-    Value v;
-    v.type = VAL_CHAR;
-    v.c = c;
-    return v;
-}
-
-// Constructor for boolean values
-Value value_bool(int b) {
-    Value v;
-    v.type = VAL_BOOL;
-    v.b = !!b; // Ensure 0 or 1
-    return v;
-}
-
-Value value_pointer(uintptr_t ptr) {
-    Value v;
-    v.type = VAL_POINTER;
-    v.ptr = ptr;
-    return v;
+    return value_make(VAL_STRING, (uintptr_t)str);
 }
 
 Value value_box(size_t size, char *msg, size_t msg_len) {
@@ -838,18 +889,15 @@ Value value_box(size_t size, char *msg, size_t msg_len) {
 
     data_runtime_track_box(handle);
 
-    Value v;
-    v.type = VAL_BOX;
-    v.box.handle = handle;
-    return v;
+    return value_make(VAL_BOX, handle);
 }
 
 int value_box_free(Value box, char *msg, size_t msg_len) {
-    if (box.type == VAL_BOX && !data_runtime_check_box_free(box.box.handle, 0)) {
+    if (VALUE_TYPE(box) == VAL_BOX && !data_runtime_check_box_free(VALUE_AS_BOX(box).handle, 0)) {
         if (msg && msg_len > 0) snprintf(msg, msg_len, "box was already freed (use-after-free)");
         return 0;
     }
-    BoxSlot *slot = (box.type == VAL_BOX) ? box_slot_from_handle(box.box.handle) : NULL;
+    BoxSlot *slot = (VALUE_TYPE(box) == VAL_BOX) ? box_slot_from_handle(VALUE_AS_BOX(box).handle) : NULL;
     if (!slot) {
         if (msg && msg_len > 0) snprintf(msg, msg_len, "free() expects a live box value");
         return 0;
@@ -864,29 +912,29 @@ int value_box_free(Value box, char *msg, size_t msg_len) {
 }
 
 size_t value_box_len(Value box) {
-    BoxSlot *slot = (box.type == VAL_BOX) ? box_slot_from_handle(box.box.handle) : NULL;
+    BoxSlot *slot = (VALUE_TYPE(box) == VAL_BOX) ? box_slot_from_handle(VALUE_AS_BOX(box).handle) : NULL;
     return slot ? slot->len : 0;
 }
 
 size_t value_box_cap(Value box) {
-    BoxSlot *slot = (box.type == VAL_BOX) ? box_slot_from_handle(box.box.handle) : NULL;
+    BoxSlot *slot = (VALUE_TYPE(box) == VAL_BOX) ? box_slot_from_handle(VALUE_AS_BOX(box).handle) : NULL;
     return slot ? slot->cap : 0;
 }
 
 int value_box_is_live(Value box) {
-    BoxSlot *slot = (box.type == VAL_BOX) ? box_slot_from_handle(box.box.handle) : NULL;
+    BoxSlot *slot = (VALUE_TYPE(box) == VAL_BOX) ? box_slot_from_handle(VALUE_AS_BOX(box).handle) : NULL;
     return slot && !slot->freed;
 }
 
 void value_box_mark_scope(Value box, uint64_t scope_id) {
-    BoxSlot *slot = (box.type == VAL_BOX) ? box_slot_from_handle(box.box.handle) : NULL;
+    BoxSlot *slot = (VALUE_TYPE(box) == VAL_BOX) ? box_slot_from_handle(VALUE_AS_BOX(box).handle) : NULL;
     if (!slot || slot->freed || slot->owned_by_template) return;
     slot->scope_id = scope_id;
 }
 
 void value_box_release_scope(uint64_t scope_id) {
     if (!scope_id) return;
-    for (int i = 0; i < BOX_SLOT_MAX; i++) {
+    for (int i = 0; i < box_slots_high; i++) {
         BoxSlot *slot = &box_slots[i];
         if (!slot->in_use || slot->freed || slot->owned_by_template) continue;
         if (slot->scope_id == scope_id) box_free_slot(slot);
@@ -894,16 +942,13 @@ void value_box_release_scope(uint64_t scope_id) {
 }
 
 void value_box_promote_to_template(Value box) {
-    BoxSlot *slot = (box.type == VAL_BOX) ? box_slot_from_handle(box.box.handle) : NULL;
+    BoxSlot *slot = (VALUE_TYPE(box) == VAL_BOX) ? box_slot_from_handle(VALUE_AS_BOX(box).handle) : NULL;
     if (!slot || slot->freed) return;
     slot->owned_by_template = 1;
     slot->scope_id = 0;
 }
 
 Value value_bloc_type(const char *name, const char **fields, int field_count) {
-    Value v;
-    v.type = VAL_BLOC_TYPE;
-
     /* Rust-side validation: empty name, duplicate fields, oversize */
     if (!data_runtime_check_bloc(name, fields, field_count, 0)) {
         return value_null();
@@ -912,12 +957,9 @@ Value value_bloc_type(const char *name, const char **fields, int field_count) {
     BlocTypeDesc *existing = bloc_find_desc(name);
     if (existing) {
         if (!bloc_is_same_schema(existing, fields, field_count)) {
-            v.type = VAL_NULL;
-            v.i = 0;
-            return v;
+            return value_null();
         }
-        v.bloc_type = existing;
-        return v;
+        return value_make(VAL_BLOC_TYPE, (uintptr_t)existing);
     }
 
     BlocTypeDesc *desc = calloc(1, sizeof(BlocTypeDesc));
@@ -935,31 +977,29 @@ Value value_bloc_type(const char *name, const char **fields, int field_count) {
     desc->next = bloc_registry;
     bloc_registry = desc;
 
-    v.bloc_type = desc;
-    return v;
+    return value_make(VAL_BLOC_TYPE, (uintptr_t)desc);
 }
 
 int value_bloc_check_construct(Value descriptor, int argc, Value *argv, char *msg, size_t msg_len) {
-    if (descriptor.type != VAL_BLOC_TYPE || !descriptor.bloc_type) {
+    if (VALUE_TYPE(descriptor) != VAL_BLOC_TYPE || !VALUE_AS_BLOC_TYPE(descriptor)) {
         snprintf(msg, msg_len, "Value is not a bloc constructor");
         return 0;
     }
-    return bloc_validate_layout(descriptor.bloc_type, argc, argv, msg, msg_len);
+    return bloc_validate_layout(VALUE_AS_BLOC_TYPE(descriptor), argc, argv, msg, msg_len);
 }
 
 Value value_bloc_construct(Value descriptor, int argc, Value *argv) {
     Value out = value_null();
-    if (descriptor.type != VAL_BLOC_TYPE || !descriptor.bloc_type) return out;
+    if (VALUE_TYPE(descriptor) != VAL_BLOC_TYPE || !VALUE_AS_BLOC_TYPE(descriptor)) return out;
 
-    out.type = VAL_BLOC;
-    out.bloc.handle = bloc_alloc_slot(descriptor.bloc_type);
-    BlocSlot *slot = bloc_slot_from_handle(out.bloc.handle);
+    out = value_make(VAL_BLOC, bloc_alloc_slot(VALUE_AS_BLOC_TYPE(descriptor)));
+    BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(out).handle);
     if (!slot) return value_null();
 
     for (int i = 0; i < argc; i++) {
-        BlocFieldKind kind = (BlocFieldKind)descriptor.bloc_type->kinds[i];
+        BlocFieldKind kind = (BlocFieldKind)VALUE_AS_BLOC_TYPE(descriptor)->kinds[i];
         int size = bloc_kind_size(kind, argv[i]);
-        bloc_store_field(slot->bytes + descriptor.bloc_type->offsets[i], kind, argv[i], size);
+        bloc_store_field(slot->bytes + VALUE_AS_BLOC_TYPE(descriptor)->offsets[i], kind, argv[i], size);
     }
 
     return out;
@@ -967,7 +1007,7 @@ Value value_bloc_construct(Value descriptor, int argc, Value *argv) {
 
 Value value_bloc_get_field(Value bloc, const char *field, int *found) {
     if (found) *found = 0;
-    BlocSlot *slot = (bloc.type == VAL_BLOC) ? bloc_slot_from_handle(bloc.bloc.handle) : NULL;
+    BlocSlot *slot = (VALUE_TYPE(bloc) == VAL_BLOC) ? bloc_slot_from_handle(VALUE_AS_BLOC(bloc).handle) : NULL;
     if (!slot || !slot->desc) return value_null();
 
     int idx = bloc_find_field_index(slot->desc, field);
@@ -977,83 +1017,136 @@ Value value_bloc_get_field(Value bloc, const char *field, int *found) {
     return bloc_load_field(slot->desc, idx, slot->bytes);
 }
 
+Value value_bloc_get_index(Value bloc, int idx) {
+    BlocSlot *slot = (VALUE_TYPE(bloc) == VAL_BLOC) ? bloc_slot_from_handle(VALUE_AS_BLOC(bloc).handle) : NULL;
+    if (!slot || !slot->desc || idx < 0 || idx >= slot->desc->field_count) return value_null();
+    return bloc_load_field(slot->desc, idx, slot->bytes);
+}
+
 const char *value_bloc_name(Value v) {
-    if (v.type == VAL_BLOC) {
-        BlocSlot *slot = bloc_slot_from_handle(v.bloc.handle);
+    if (VALUE_TYPE(v) == VAL_BLOC) {
+        BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(v).handle);
         if (slot && slot->desc) return slot->desc->name;
     }
-    if (v.type == VAL_BLOC_TYPE && v.bloc_type) return v.bloc_type->name;
+    if (VALUE_TYPE(v) == VAL_BLOC_TYPE && VALUE_AS_BLOC_TYPE(v)) return VALUE_AS_BLOC_TYPE(v)->name;
     return NULL;
 }
 
 int value_bloc_equal(Value left, Value right) {
-    if (left.type != VAL_BLOC || right.type != VAL_BLOC) return 0;
-    BlocSlot *left_slot = bloc_slot_from_handle(left.bloc.handle);
-    BlocSlot *right_slot = bloc_slot_from_handle(right.bloc.handle);
+    if (VALUE_TYPE(left) != VAL_BLOC || VALUE_TYPE(right) != VAL_BLOC) return 0;
+    BlocSlot *left_slot = bloc_slot_from_handle(VALUE_AS_BLOC(left).handle);
+    BlocSlot *right_slot = bloc_slot_from_handle(VALUE_AS_BLOC(right).handle);
     if (!left_slot || !right_slot || !left_slot->desc || left_slot->desc != right_slot->desc) return 0;
     return memcmp(left_slot->bytes, right_slot->bytes, (size_t)left_slot->desc->total_size) == 0;
 }
 
 // Constructor for empty lists
 Value value_list(void) {
-    Value v;
-    v.type = VAL_LIST;
-    v.list = (ListObj *)luna_gc_alloc(sizeof(ListObj), list_trace, list_finalize);
-    v.list->ref_count = 0;
-    v.list->items = NULL;
-    v.list->count = 0;
-    v.list->capacity = 0;
-    return v;
+    ListObj *list = (ListObj *)luna_gc_alloc(sizeof(ListObj), list_trace, list_finalize);
+    list->ref_count = 0;
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    return value_make(VAL_LIST, (uintptr_t)list);
 }
 
 // Constructor for empty dense lists
 Value value_dense_list(void) {
-    Value v;
-    v.type = VAL_DENSE_LIST;
-    v.dlist = (DenseListObj *)luna_gc_alloc(sizeof(DenseListObj), dense_list_trace, dense_list_finalize);
-    v.dlist->ref_count = 0;
-    v.dlist->data = NULL;
-    v.dlist->count = 0;
-    v.dlist->capacity = 0;
-    return v;
+    DenseListObj *dlist = (DenseListObj *)luna_gc_alloc(sizeof(DenseListObj), dense_list_trace, dense_list_finalize);
+    dlist->ref_count = 0;
+    dlist->data = NULL;
+    dlist->count = 0;
+    dlist->capacity = 0;
+    return value_make(VAL_DENSE_LIST, (uintptr_t)dlist);
 }
 
 Value value_map(void) {
-    Value v;
-    v.type = VAL_MAP;
-    v.map = (MapObj *)luna_gc_alloc(sizeof(MapObj), map_trace, map_finalize);
-    v.map->ref_count = 0;
-    v.map->entries = NULL;
-    v.map->count = 0;
-    v.map->capacity = 0;
-    map_init_storage(v.map, 8);
-    return v;
+    MapObj *map = (MapObj *)luna_gc_alloc(sizeof(MapObj), map_trace, map_finalize);
+    map->ref_count = 0;
+    map->entries = NULL;
+    map->count = 0;
+    map->capacity = 0;
+    map_init_storage(map, 8);
+    return value_make(VAL_MAP, (uintptr_t)map);
+}
+
+Value value_range(long long start, long long end, long long step) {
+    RangeObj *range = (RangeObj *)luna_gc_alloc(sizeof(RangeObj), range_trace, range_finalize);
+    range->ref_count = 0;
+    range->start = start;
+    range->end = end;
+    range->step = step;
+    range->list = value_null();
+    return value_make(VAL_RANGE, (uintptr_t)range);
+}
+
+long long value_range_len(const RangeObj *range) {
+    if (VALUE_TYPE(range->list) == VAL_LIST) return VALUE_AS_LIST(range->list)->count;
+    if (range->step > 0) {
+        if (range->start >= range->end) return 0;
+        return (range->end - range->start + range->step - 1) / range->step;
+    }
+    if (range->start <= range->end) return 0;
+    return (range->start - range->end - range->step - 1) / -range->step;
+}
+
+Value value_range_get(const RangeObj *range, long long idx) {
+    long long len = value_range_len(range);
+    if (idx < 0) idx += len;
+    if (idx < 0 || idx >= len) return value_null();
+    if (VALUE_TYPE(range->list) == VAL_LIST) return value_copy(VALUE_AS_LIST(range->list)->items[idx]);
+    return value_int(range->start + idx * range->step);
+}
+
+// Natives and statements that need a real list (to mutate it or hand out its
+// items) call this on their own copy of the value. The list is kept in the
+// range, so writes through one copy are seen through all others.
+void value_range_materialize(Value *v) {
+    if (VALUE_TYPE(*v) != VAL_RANGE) return;
+    RangeObj *range = VALUE_AS_RANGE(*v);
+    if (VALUE_TYPE(range->list) != VAL_LIST) {
+        long long n = value_range_len(range);
+        Value list = value_list();
+        for (long long i = 0; i < n; i++) {
+            value_list_append(&list, value_int(range->start + i * range->step));
+        }
+        gc_note_owner_write_value(range, &list);
+        range->list = list;
+    }
+    Value list = value_copy(range->list);
+    value_free(*v);
+    *v = list;
 }
 
 Value value_closure(struct AstNode *funcdef, struct Env *env, int owns_env) {
-    Value v;
-    v.type = VAL_CLOSURE;
-    v.closure = (ClosureObj *)luna_gc_alloc(sizeof(ClosureObj), closure_trace, closure_finalize);
-    v.closure->ref_count = 0;
-    v.closure->funcdef = funcdef;
-    v.closure->env = env;
-    v.closure->owns_env = owns_env;
-    return v;
-}
-
-Value value_vm_closure(struct LunaChunk *chunk, int upvalue_count) {
-    Value v;
-    v.type = VAL_VM_CLOSURE;
-    v.vm_closure = (VMClosureObj *)luna_gc_alloc(sizeof(VMClosureObj), vm_closure_trace, vm_closure_finalize);
-    v.vm_closure->ref_count = 0;
-    v.vm_closure->chunk = chunk;
-    v.vm_closure->upvalue_count = upvalue_count;
+    ClosureObj *closure = (ClosureObj *)luna_gc_alloc(sizeof(ClosureObj), closure_trace, closure_finalize);
+    closure->ref_count = 0;
+    closure->funcdef = funcdef;
+    closure->env = env;
+    closure->owns_env = owns_env;
+    return value_make(VAL_CLOSURE, (uintptr_t)closure);
+}
+
+/* flat_count of the upvalues are captured by value: their VMUpvalue cells
+ * trail the pointer array in one allocation and stay closed, so they need no
+ * GC object and never join the VM's open-upvalue list. */
+Value value_vm_closure(struct LunaChunk *chunk, int upvalue_count, int flat_count) {
+    VMClosureObj *closure = (VMClosureObj *)luna_gc_alloc(sizeof(VMClosureObj), vm_closure_trace, vm_closure_finalize);
+    closure->ref_count = 0;
+    closure->chunk = chunk;
+    closure->upvalue_count = upvalue_count;
+    closure->flat = NULL;
+    closure->flat_count = flat_count;
     if (upvalue_count > 0) {
-        v.vm_closure->upvalues = calloc(upvalue_count, sizeof(VMUpvalue*));
+        closure->upvalues = calloc(1, sizeof(VMUpvalue*) * (size_t)upvalue_count +
+                                      sizeof(VMUpvalue) * (size_t)flat_count);
+        if (flat_count > 0) {
+            closure->flat = (VMUpvalue *)(closure->upvalues + upvalue_count);
+        }
     } else {
-        v.vm_closure->upvalues = NULL;
+        closure->upvalues = NULL;
     }
-    return v;
+    return value_make(VAL_VM_CLOSURE, (uintptr_t)closure);
 }
 
 Value value_data_type(const char *name, const char **fields, int field_count, int is_template) {
@@ -1064,45 +1157,44 @@ Value value_data_type(const char *name, const char **fields, int field_count, in
         }
     }
 
-    Value v;
-    v.type = VAL_DATA_TYPE;
+    DataTypeObj *dtype;
     if (luna_gc_runtime_enabled()) {
-        v.dtype = (DataTypeObj *)luna_gc_alloc(sizeof(DataTypeObj) + sizeof(const char *) * (size_t)field_count,
-                                               data_type_trace, data_type_finalize);
-        v.dtype->ref_count = 0;
-        v.dtype->fields = (const char **)(v.dtype + 1);
+        dtype = (DataTypeObj *)luna_gc_alloc(sizeof(DataTypeObj) + sizeof(const char *) * (size_t)field_count,
+                                             data_type_trace, data_type_finalize);
+        dtype->ref_count = 0;
+        dtype->fields = (const char **)(dtype + 1);
     } else {
-        v.dtype = malloc(sizeof(DataTypeObj));
-        v.dtype->ref_count = 1;
-        v.dtype->fields = field_count > 0 ? malloc(sizeof(const char *) * (size_t)field_count) : NULL;
+        dtype = malloc(sizeof(DataTypeObj));
+        dtype->ref_count = 1;
+        dtype->fields = field_count > 0 ? malloc(sizeof(const char *) * (size_t)field_count) : NULL;
     }
-    v.dtype->name = name;
-    v.dtype->field_count = field_count;
-    v.dtype->is_template = is_template;
+    dtype->name = name;
+    dtype->field_count = field_count;
+    dtype->is_template = is_template;
     for (int i = 0; i < field_count; i++) {
-        v.dtype->fields[i] = fields[i];
+        dtype->fields[i] = fields[i];
     }
-    return v;
+    return value_make(VAL_DATA_TYPE, (uintptr_t)dtype);
 }
 
 Value value_template_from_dtype(Value dtype, int argc, Value *argv, char *msg, size_t msg_len) {
     Value out = value_null();
-    if (dtype.type != VAL_DATA_TYPE || !dtype.dtype || !dtype.dtype->is_template) {
+    if (VALUE_TYPE(dtype) != VAL_DATA_TYPE || !VALUE_AS_DTYPE(dtype) || !VALUE_AS_DTYPE(dtype)->is_template) {
         if (msg && msg_len > 0) snprintf(msg, msg_len, "Value is not a template constructor");
         return out;
     }
     /* Rust-side arity check */
-    if (!data_runtime_check_template_arity(dtype.dtype->name, argc, 0)) {
+    if (!data_runtime_check_template_arity(VALUE_AS_DTYPE(dtype)->name, argc, 0)) {
         if (msg && msg_len > 0) {
             snprintf(msg, msg_len, "Template '%s' expects %d field value(s), but got %d",
-                     dtype.dtype->name ? dtype.dtype->name : "<template>", dtype.dtype->field_count, argc);
+                     VALUE_AS_DTYPE(dtype)->name ? VALUE_AS_DTYPE(dtype)->name : "<template>", VALUE_AS_DTYPE(dtype)->field_count, argc);
         }
         return out;
     }
-    if (argc != dtype.dtype->field_count) {
+    if (argc != VALUE_AS_DTYPE(dtype)->field_count) {
         if (msg && msg_len > 0) {
             snprintf(msg, msg_len, "Template '%s' expects %d field value(s), but got %d",
-                     dtype.dtype->name ? dtype.dtype->name : "<template>", dtype.dtype->field_count, argc);
+                     VALUE_AS_DTYPE(dtype)->name ? VALUE_AS_DTYPE(dtype)->name : "<template>", VALUE_AS_DTYPE(dtype)->field_count, argc);
         }
         return out;
     }
@@ -1114,21 +1206,19 @@ Value value_template_from_dtype(Value dtype, int argc, Value *argv, char *msg, s
         return out;
     }
 
-    templ->dtype = dtype.dtype;
+    templ->dtype = VALUE_AS_DTYPE(dtype);
     templ->field_count = argc;
     templ->payload_bytes = sizeof(struct TemplateObj) + sizeof(Value) * (size_t)argc;
     templ->chunk_bytes = chunk_bytes;
     for (int i = 0; i < argc; i++) {
         templ->fields[i] = value_copy(argv[i]);
-        if (templ->fields[i].type == VAL_BOX) {
+        if (VALUE_TYPE(templ->fields[i]) == VAL_BOX) {
             data_runtime_check_containment(DATA_KIND_TEMPLATE, DATA_KIND_BOX, 0);
             value_box_promote_to_template(templ->fields[i]);
         }
     }
 
-    out.type = VAL_TEMPLATE;
-    out.template_obj = templ;
-    return out;
+    return value_make(VAL_TEMPLATE, (uintptr_t)templ);
 }
 
 static int template_find_field_index(const TemplateObj *templ, const char *field) {
@@ -1139,37 +1229,67 @@ static int template_find_field_index(const TemplateObj *templ, const char *field
     return -1;
 }
 
+const void *value_field_shape(Value v) {
+    if (VALUE_TYPE(v) == VAL_TEMPLATE) return VALUE_AS_TEMPLATE(v) ? VALUE_AS_TEMPLATE(v)->dtype : NULL;
+    if (VALUE_TYPE(v) == VAL_BLOC) {
+        BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(v).handle);
+        return slot ? slot->desc : NULL;
+    }
+    return NULL;
+}
+
+int value_field_index(Value v, const char *field) {
+    if (VALUE_TYPE(v) == VAL_TEMPLATE) return template_find_field_index(VALUE_AS_TEMPLATE(v), field);
+    if (VALUE_TYPE(v) == VAL_BLOC) {
+        BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(v).handle);
+        return slot ? bloc_find_field_index(slot->desc, field) : -1;
+    }
+    return -1;
+}
+
+Value value_template_get_index(Value template_value, int idx) {
+    if (VALUE_TYPE(template_value) != VAL_TEMPLATE || !VALUE_AS_TEMPLATE(template_value)) return value_null();
+    if (idx < 0 || idx >= VALUE_AS_TEMPLATE(template_value)->field_count) return value_null();
+    return value_copy(VALUE_AS_TEMPLATE(template_value)->fields[idx]);
+}
+
 Value value_template_get_field(Value template_value, const char *field, int *found) {
     if (found) *found = 0;
-    if (template_value.type != VAL_TEMPLATE || !template_value.template_obj) return value_null();
-    int idx = template_find_field_index(template_value.template_obj, field);
+    if (VALUE_TYPE(template_value) != VAL_TEMPLATE || !VALUE_AS_TEMPLATE(template_value)) return value_null();
+    int idx = template_find_field_index(VALUE_AS_TEMPLATE(template_value), field);
     if (idx < 0) return value_null();
     if (found) *found = 1;
-    return value_copy(template_value.template_obj->fields[idx]);
+    return value_copy(VALUE_AS_TEMPLATE(template_value)->fields[idx]);
 }
 
 Value *value_template_field_slot(Value *template_value, const char *field) {
-    if (!template_value || template_value->type != VAL_TEMPLATE || !template_value->template_obj) return NULL;
-    int idx = template_find_field_index(template_value->template_obj, field);
+    if (!template_value || VALUE_TYPE(*template_value) != VAL_TEMPLATE || !VALUE_AS_TEMPLATE(*template_value)) return NULL;
+    int idx = template_find_field_index(VALUE_AS_TEMPLATE(*template_value), field);
     if (idx < 0) return NULL;
-    return &template_value->template_obj->fields[idx];
+    return &VALUE_AS_TEMPLATE(*template_value)->fields[idx];
 }
 
 int value_template_set_field(Value *template_value, const char *field, Value *rhs, char *msg, size_t msg_len) {
-    if (!template_value || template_value->type != VAL_TEMPLATE || !template_value->template_obj) {
+    if (!template_value || VALUE_TYPE(*template_value) != VAL_TEMPLATE || !VALUE_AS_TEMPLATE(*template_value)) {
         if (msg && msg_len > 0) snprintf(msg, msg_len, "Target is not a template value");
         return 0;
     }
-    int idx = template_find_field_index(template_value->template_obj, field);
+    int idx = template_find_field_index(VALUE_AS_TEMPLATE(*template_value), field);
     if (idx < 0) {
         if (msg && msg_len > 0) snprintf(msg, msg_len, "Template field '%s' does not exist", field ? field : "");
         return 0;
     }
-    Value *slot = &template_value->template_obj->fields[idx];
+    return value_template_set_index(template_value, idx, rhs);
+}
+
+int value_template_set_index(Value *template_value, int idx, Value *rhs) {
+    if (!template_value || VALUE_TYPE(*template_value) != VAL_TEMPLATE || !VALUE_AS_TEMPLATE(*template_value)) return 0;
+    if (idx < 0 || idx >= VALUE_AS_TEMPLATE(*template_value)->field_count) return 0;
+    Value *slot = &VALUE_AS_TEMPLATE(*template_value)->fields[idx];
     value_free(*slot);
     *slot = value_move(rhs);
-    gc_note_owner_write_value(template_value->template_obj, slot);
-    if (slot->type == VAL_BOX) {
+    gc_note_owner_write_value(VALUE_AS_TEMPLATE(*template_value), slot);
+    if (VALUE_TYPE(*slot) == VAL_BOX) {
         data_runtime_check_containment(DATA_KIND_TEMPLATE, DATA_KIND_BOX, 0);
         value_box_promote_to_template(*slot);
     }
@@ -1177,37 +1297,23 @@ int value_template_set_field(Value *template_value, const char *field, Value *rh
 }
 
 const char *value_template_name(Value v) {
-    if (v.type != VAL_TEMPLATE || !v.template_obj || !v.template_obj->dtype) return NULL;
-    return v.template_obj->dtype->name;
+    if (VALUE_TYPE(v) != VAL_TEMPLATE || !VALUE_AS_TEMPLATE(v) || !VALUE_AS_TEMPLATE(v)->dtype) return NULL;
+    return VALUE_AS_TEMPLATE(v)->dtype->name;
 }
 
 int value_template_len(Value v) {
-    if (v.type != VAL_TEMPLATE || !v.template_obj) return 0;
-    return v.template_obj->field_count;
+    if (VALUE_TYPE(v) != VAL_TEMPLATE || !VALUE_AS_TEMPLATE(v)) return 0;
+    return VALUE_AS_TEMPLATE(v)->field_count;
 }
 
 // Constructor for native functions
 Value value_native(NativeFunc fn) {
-    Value v;
-    v.type = VAL_NATIVE;
-    v.native = (void *)fn;
-    return v;
+    return value_make(VAL_NATIVE, (uintptr_t)fn);
 }
 
 // Constructor for file handles
 Value value_file(FILE *f) {
-    Value v;
-    v.type = VAL_FILE;
-    v.file = f;
-    return v;
-}
-
-// Constructor for null/void values
-Value value_null(void) {
-    Value v;
-    v.type = VAL_NULL;
-    v.i = 0;
-    return v;
+    return value_make(VAL_FILE, (uintptr_t)f);
 }
 
 // Frees memory associated with a heap-allocated Value (slow path)
@@ -1222,60 +1328,71 @@ void _value_free_refcount(Value v) {
     struct timespec end_ts;
     clock_gettime(CLOCK_MONOTONIC, &start_ts);
 
-    if (v.type == VAL_STRING && v.string) {
-        v.string->ref_count--;
-        if (v.string->ref_count == 0) {
-            free(v.string->chars);
-            free(v.string);
-        }
-    } else if (v.type == VAL_LIST && v.list) {
-        v.list->ref_count--;
-        if (v.list->ref_count == 0) {
-            for (int i = 0; i < v.list->count; i++) {
-                value_free(v.list->items[i]);
+    if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v)) {
+        VALUE_AS_STRING(v)->ref_count--;
+        if (VALUE_AS_STRING(v)->ref_count == 0) {
+            free(VALUE_AS_STRING(v)->chars);
+            free(VALUE_AS_STRING(v));
+        }
+    } else if (VALUE_TYPE(v) == VAL_LIST && VALUE_AS_LIST(v)) {
+        VALUE_AS_LIST(v)->ref_count--;
+        if (VALUE_AS_LIST(v)->ref_count == 0) {
+            for (int i = 0; i < VALUE_AS_LIST(v)->count; i++) {
+                value_free(VALUE_AS_LIST(v)->items[i]);
             }
-            free(v.list->items);
-            free(v.list);
-        }
-    } else if (v.type == VAL_DENSE_LIST && v.dlist) {
-        v.dlist->ref_count--;
-        if (v.dlist->ref_count == 0) {
-            free(v.dlist->data);
-            free(v.dlist);
-        }
-    } else if (v.type == VAL_MAP && v.map) {
-        v.map->ref_count--;
-        if (v.map->ref_count == 0) {
-            for (int i = 0; i < v.map->capacity; i++) {
-                if (v.map->entries[i].occupied) {
-                    value_free(v.map->entries[i].value);
+            free(VALUE_AS_LIST(v)->items);
+            free(VALUE_AS_LIST(v));
+        }
+    } else if (VALUE_TYPE(v) == VAL_DENSE_LIST && VALUE_AS_DLIST(v)) {
+        VALUE_AS_DLIST(v)->ref_count--;
+        if (VALUE_AS_DLIST(v)->ref_count == 0) {
+            free(VALUE_AS_DLIST(v)->data);
+            free(VALUE_AS_DLIST(v));
+        }
+    } else if (VALUE_TYPE(v) == VAL_MAP && VALUE_AS_MAP(v)) {
+        VALUE_AS_MAP(v)->ref_count--;
+        if (VALUE_AS_MAP(v)->ref_count == 0) {
+            for (int i = 0; i < VALUE_AS_MAP(v)->capacity; i++) {
+                if (VALUE_AS_MAP(v)->entries[i].key) {
+                    value_free(VALUE_AS_MAP(v)->entries[i].value);
                 }
             }
-            free(v.map->entries);
-            free(v.map);
-        }
-    } else if (v.type == VAL_CLOSURE && v.closure) {
-        v.closure->ref_count--;
-        if (v.closure->ref_count == 0) {
-            if (v.closure->owns_env) env_free_chain(v.closure->env);
-            free(v.closure);
-        }
-    } else if (v.type == VAL_VM_CLOSURE && v.vm_closure) {
-        v.vm_closure->ref_count--;
-        if (v.vm_closure->ref_count == 0) {
+            free(VALUE_AS_MAP(v)->entries);
+            free(VALUE_AS_MAP(v));
+        }
+    } else if (VALUE_TYPE(v) == VAL_CLOSURE && VALUE_AS_CLOSURE(v)) {
+        VALUE_AS_CLOSURE(v)->ref_count--;
+        if (VALUE_AS_CLOSURE(v)->ref_count == 0) {
+            if (VALUE_AS_CLOSURE(v)->owns_env) env_free(VALUE_AS_CLOSURE(v)->env);
+            free(VALUE_AS_CLOSURE(v));
+        }
+    } else if (VALUE_TYPE(v) == VAL_VM_CLOSURE && VALUE_AS_VM_CLOSURE(v)) {
+        VALUE_AS_VM_CLOSURE(v)->ref_count--;
+        if (VALUE_AS_VM_CLOSURE(v)->ref_count == 0) {
             // upvalues freed by GC finalize hook vm_closure_finalize
-            free(v.vm_closure);
+            free(VALUE_AS_VM_CLOSURE(v));
         }
-    } else if (v.type == VAL_DATA_TYPE && v.dtype) {
-        v.dtype->ref_count--;
-        if (v.dtype->ref_count == 0) {
-            free((void *)v.dtype->fields);
-            free(v.dtype);
+    } else if (VALUE_TYPE(v) == VAL_DATA_TYPE && VALUE_AS_DTYPE(v)) {
+        VALUE_AS_DTYPE(v)->ref_count--;
+        if (VALUE_AS_DTYPE(v)->ref_count == 0) {
+            free((void *)VALUE_AS_DTYPE(v)->fields);
+            free(VALUE_AS_DTYPE(v));
+            value_shape_epoch++;
         }
-    } else if (v.type == VAL_TEMPLATE) {
+    } else if (VALUE_TYPE(v) == VAL_RANGE && VALUE_AS_RANGE(v)) {
+        VALUE_AS_RANGE(v)->ref_count--;
+        if (VALUE_AS_RANGE(v)->ref_count == 0) {
+            value_free(VALUE_AS_RANGE(v)->list);
+            free(VALUE_AS_RANGE(v));
+        }
+#ifdef LUNA_NANBOX
+    } else if (VALUE_TYPE(v) == VAL_INT) {
+        if (--VALUE_AS_BIG_INT(v)->ref_count == 0) free(VALUE_AS_BIG_INT(v));
+#endif
+    } else if (VALUE_TYPE(v) == VAL_TEMPLATE) {
         /* GC-managed; nothing to free in the refcount fallback path. */
-    } else if (v.type == VAL_BLOC) {
-        BlocSlot *slot = bloc_slot_from_handle(v.bloc.handle);
+    } else if (VALUE_TYPE(v) == VAL_BLOC) {
+        BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(v).handle);
         if (slot) {
             slot->ref_count--;
             if (slot->ref_count <= 0) {
@@ -1306,32 +1423,40 @@ Value _value_copy_refcount(Value v) {
         return v;
     }
 
-    switch (v.type) {
+    switch (VALUE_TYPE(v)) {
         case VAL_STRING:
-            if (v.string) v.string->ref_count++;
+            if (VALUE_AS_STRING(v)) VALUE_AS_STRING(v)->ref_count++;
             break;
         case VAL_LIST:
-            if (v.list) v.list->ref_count++;
+            if (VALUE_AS_LIST(v)) VALUE_AS_LIST(v)->ref_count++;
             break;
         case VAL_DENSE_LIST:
-            if (v.dlist) v.dlist->ref_count++;
+            if (VALUE_AS_DLIST(v)) VALUE_AS_DLIST(v)->ref_count++;
             break;
         case VAL_MAP:
-            if (v.map) v.map->ref_count++;
+            if (VALUE_AS_MAP(v)) VALUE_AS_MAP(v)->ref_count++;
             break;
         case VAL_CLOSURE:
-            if (v.closure) v.closure->ref_count++;
+            if (VALUE_AS_CLOSURE(v)) VALUE_AS_CLOSURE(v)->ref_count++;
             break;
         case VAL_VM_CLOSURE:
-            if (v.vm_closure) v.vm_closure->ref_count++;
+            if (VALUE_AS_VM_CLOSURE(v)) VALUE_AS_VM_CLOSURE(v)->ref_count++;
             break;
         case VAL_DATA_TYPE:
-            if (v.dtype) v.dtype->ref_count++;
+            if (VALUE_AS_DTYPE(v)) VALUE_AS_DTYPE(v)->ref_count++;
             break;
         case VAL_TEMPLATE:
             break;
+        case VAL_RANGE:
+            if (VALUE_AS_RANGE(v)) VALUE_AS_RANGE(v)->ref_count++;
+            break;
+#ifdef LUNA_NANBOX
+        case VAL_INT:
+            VALUE_AS_BIG_INT(v)->ref_count++;
+            break;
+#endif
         case VAL_BLOC: {
-            BlocSlot *slot = bloc_slot_from_handle(v.bloc.handle);
+            BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(v).handle);
             if (slot) slot->ref_count++;
             break;
         }
@@ -1344,56 +1469,86 @@ Value _value_copy_refcount(Value v) {
 void value_gc_mark(Value *value, void *ctx) {
     if (!value || !VALUE_IS_HEAP(*value)) return;
 
-    switch (value->type) {
-        case VAL_STRING:
-            if (value->string) gc_visit_ref(ctx, (void **)&value->string);
-            break;
-        case VAL_LIST:
-            if (value->list) gc_visit_ref(ctx, (void **)&value->list);
-            break;
-        case VAL_DENSE_LIST:
-            if (value->dlist) gc_visit_ref(ctx, (void **)&value->dlist);
-            break;
-        case VAL_MAP:
-            if (value->map) gc_visit_ref(ctx, (void **)&value->map);
-            break;
-        case VAL_CLOSURE:
-            if (value->closure) gc_visit_ref(ctx, (void **)&value->closure);
-            break;
-        case VAL_VM_CLOSURE:
-            if (value->vm_closure) gc_visit_ref(ctx, (void **)&value->vm_closure);
-            break;
-        case VAL_DATA_TYPE:
-            if (value->dtype) gc_visit_ref(ctx, (void **)&value->dtype);
-            break;
-        case VAL_TEMPLATE:
-            if (value->template_obj) gc_visit_ref(ctx, (void **)&value->template_obj);
-            break;
+    void *obj = NULL;
+    switch (VALUE_TYPE(*value)) {
+        case VAL_STRING:     obj = VALUE_AS_STRING(*value); break;
+        case VAL_LIST:       obj = VALUE_AS_LIST(*value); break;
+        case VAL_DENSE_LIST: obj = VALUE_AS_DLIST(*value); break;
+        case VAL_MAP:        obj = VALUE_AS_MAP(*value); break;
+        case VAL_CLOSURE:    obj = VALUE_AS_CLOSURE(*value); break;
+        case VAL_VM_CLOSURE: obj = VALUE_AS_VM_CLOSURE(*value); break;
+        case VAL_DATA_TYPE:  obj = VALUE_AS_DTYPE(*value); break;
+        case VAL_TEMPLATE:   obj = VALUE_AS_TEMPLATE(*value); break;
+        case VAL_RANGE:      obj = VALUE_AS_RANGE(*value); break;
+#ifdef LUNA_NANBOX
+        case VAL_INT:        obj = VALUE_AS_BIG_INT(*value); break;
+#endif
+        default:             break;
+    }
+    // The collector does not move objects, so the slot is only read.
+    if (obj) gc_visit_ref(ctx, &obj);
+}
+
+// Converts a Value to a string representation (for printing)
+const char *value_string_view(Value v, char *scratch, size_t *len, char **owned) {
+    *owned = NULL;
+    switch (VALUE_TYPE(v)) {
+        case VAL_STRING: {
+            const char *chars = VALUE_AS_STRING(v) && VALUE_AS_STRING(v)->chars ? VALUE_AS_STRING(v)->chars : "";
+            *len = strlen(chars);
+            return chars;
+        }
+        case VAL_INT: {
+            // Digits are written backwards from the end of scratch.
+            char *end = scratch + VALUE_SCRATCH_LEN;
+            char *p = end;
+            unsigned long long u = VALUE_AS_INT(v) < 0 ? 0ULL - (unsigned long long)VALUE_AS_INT(v) : (unsigned long long)VALUE_AS_INT(v);
+            do {
+                *--p = (char)('0' + u % 10);
+                u /= 10;
+            } while (u);
+            if (VALUE_AS_INT(v) < 0) *--p = '-';
+            *len = (size_t)(end - p);
+            return p;
+        }
+        case VAL_FLOAT: {
+            int n = snprintf(scratch, VALUE_SCRATCH_LEN, "%.6g", VALUE_AS_FLOAT(v));
+            *len = n < 0 ? 0 : (size_t)n;
+            return scratch;
+        }
+        case VAL_CHAR:
+            scratch[0] = VALUE_AS_CHAR(v);
+            *len = VALUE_AS_CHAR(v) ? 1 : 0;
+            return scratch;
+        case VAL_BOOL:
+            *len = VALUE_AS_BOOL(v) ? 4 : 5;
+            return VALUE_AS_BOOL(v) ? "true" : "false";
         default:
-            break;
+            *owned = value_to_string(v);
+            *len = strlen(*owned);
+            return *owned;
     }
 }
 
-// Converts a Value to a string representation (for printing)
 char *value_to_string(Value v) {
     char buf[128];
-    switch (v.type) {
+    switch (VALUE_TYPE(v)) {
         case VAL_INT:
-            snprintf(buf, 128, "%lld", v.i); // Use lld for long long
+            snprintf(buf, 128, "%lld", VALUE_AS_INT(v)); // Use lld for long long
             return my_strdup(buf);
         case VAL_FLOAT:
-            snprintf(buf, 128, "%.6g", v.f);
+            snprintf(buf, 128, "%.6g", VALUE_AS_FLOAT(v));
             return my_strdup(buf);
         case VAL_BOOL:
-            return my_strdup(v.b ? "true" : "false");
+            return my_strdup(VALUE_AS_BOOL(v) ? "true" : "false");
         case VAL_POINTER:
-            snprintf(buf, sizeof(buf), "ptr(0x%llx)", (unsigned long long)v.ptr);
+            snprintf(buf, sizeof(buf), "ptr(0x%llx)", (unsigned long long)VALUE_AS_PTR(v));
             return my_strdup(buf);
         case VAL_BLOC_TYPE:
-            if (v.bloc_type && v.bloc_type->name) {
-                size_t len = strlen(v.bloc_type->name) + 8;
+            if (VALUE_AS_BLOC_TYPE(v) && VALUE_AS_BLOC_TYPE(v)->name) {
+                size_t len = strlen(VALUE_AS_BLOC_TYPE(v)->name) + 8;
                 char *res = malloc(len);
-                snprintf(res, len, "<bloc %s>", v.bloc_type->name);
+                snprintf(res, len, "<bloc %s>", VALUE_AS_BLOC_TYPE(v)->name);
                 return res;
             }
             return my_strdup("<bloc>");
@@ -1401,7 +1556,7 @@ char *value_to_string(Value v) {
             size_t cap = 64;
             size_t pos = 0;
             char *res = malloc(cap);
-            BlocSlot *slot = bloc_slot_from_handle(v.bloc.handle);
+            BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(v).handle);
             BlocTypeDesc *desc = slot ? slot->desc : NULL;
             const char *name = (desc && desc->name) ? desc->name : "bloc";
             size_t name_len = strlen(name);
@@ -1439,7 +1594,7 @@ char *value_to_string(Value v) {
         case VAL_BOX: {
             size_t len = 48;
             char *res = malloc(len);
-            BoxSlot *slot = box_slot_from_handle(v.box.handle);
+            BoxSlot *slot = box_slot_from_handle(VALUE_AS_BOX(v).handle);
             if (!slot) {
                 snprintf(res, len, "<box invalid>");
             } else if (slot->freed) {
@@ -1450,7 +1605,7 @@ char *value_to_string(Value v) {
             return res;
         }
         case VAL_CHAR:
-            snprintf(buf, 128, "%c", v.c);
+            snprintf(buf, 128, "%c", VALUE_AS_CHAR(v));
             return my_strdup(buf);
         case VAL_NATIVE:
             return my_strdup("<native function>");
@@ -1461,15 +1616,15 @@ char *value_to_string(Value v) {
         case VAL_VM_CLOSURE:
             return my_strdup("<vm closure>");
         case VAL_DATA_TYPE:
-            if (v.dtype && v.dtype->name) {
-                size_t len = strlen(v.dtype->name) + 8;
+            if (VALUE_AS_DTYPE(v) && VALUE_AS_DTYPE(v)->name) {
+                size_t len = strlen(VALUE_AS_DTYPE(v)->name) + 8;
                 char *res = malloc(len);
-                snprintf(res, len, "<data %s>", v.dtype->name);
+                snprintf(res, len, "<data %s>", VALUE_AS_DTYPE(v)->name);
                 return res;
             }
             return my_strdup("<data>");
         case VAL_TEMPLATE: {
-            TemplateObj *templ = v.template_obj;
+            TemplateObj *templ = VALUE_AS_TEMPLATE(v);
             const char *name = (templ && templ->dtype && templ->dtype->name) ? templ->dtype->name : "template";
             size_t cap = 96, pos = 0;
             char *res = malloc(cap);
@@ -1502,11 +1657,11 @@ char *value_to_string(Value v) {
             return res;
         }
         case VAL_FILE:
-            if (v.file) return my_strdup("<file handle>");
+            if (VALUE_AS_FILE(v)) return my_strdup("<file handle>");
             else return my_strdup("<closed file>");
         case VAL_STRING:
-            if (v.string && v.string->chars) {
-                return my_strdup(v.string->chars);
+            if (VALUE_AS_STRING(v) && VALUE_AS_STRING(v)->chars) {
+                return my_strdup(VALUE_AS_STRING(v)->chars);
             } else {
                 return my_strdup("");
             }
@@ -1515,13 +1670,13 @@ char *value_to_string(Value v) {
             size_t cap = 64, pos = 0;
             char *res = malloc(cap);
             res[pos++] = '[';
-            if (v.list) {
-                for (int i = 0; i < v.list->count; i++) {
+            if (VALUE_AS_LIST(v)) {
+                for (int i = 0; i < VALUE_AS_LIST(v)->count; i++) {
                     if (i > 0) { 
                         if (pos + 2 >= cap) { cap *= 2; res = realloc(res, cap); }
                         res[pos++] = ','; res[pos++] = ' '; 
                     }
-                    char *vs = value_to_string(v.list->items[i]);
+                    char *vs = value_to_string(VALUE_AS_LIST(v)->items[i]);
                     size_t vl = strlen(vs);
                     while (pos + vl + 2 >= cap) { cap *= 2; res = realloc(res, cap); }
                     memcpy(res + pos, vs, vl);
@@ -1533,19 +1688,34 @@ char *value_to_string(Value v) {
             res[pos] = '\0';
             return res;
         }
+        case VAL_RANGE: {
+            if (VALUE_TYPE(VALUE_AS_RANGE(v)->list) == VAL_LIST) return value_to_string(VALUE_AS_RANGE(v)->list);
+            size_t cap = 64, pos = 0;
+            char *res = malloc(cap);
+            res[pos++] = '[';
+            long long n = value_range_len(VALUE_AS_RANGE(v));
+            for (long long i = 0; i < n; i++) {
+                while (pos + 32 >= cap) { cap *= 2; res = realloc(res, cap); }
+                pos += (size_t)snprintf(res + pos, cap - pos, i > 0 ? ", %lld" : "%lld",
+                                        VALUE_AS_RANGE(v)->start + i * VALUE_AS_RANGE(v)->step);
+            }
+            res[pos++] = ']';
+            res[pos] = '\0';
+            return res;
+        }
         case VAL_DENSE_LIST: {
             // O(n) dense-list-to-string: track write position
             size_t cap = 64, pos = 0;
             char *res = malloc(cap);
             res[pos++] = 'd'; res[pos++] = '[';
-            if (v.dlist) {
-                for (int i = 0; i < v.dlist->count; i++) {
+            if (VALUE_AS_DLIST(v)) {
+                for (int i = 0; i < VALUE_AS_DLIST(v)->count; i++) {
                     if (i > 0) {
                         if (pos + 2 >= cap) { cap *= 2; res = realloc(res, cap); }
                         res[pos++] = ','; res[pos++] = ' ';
                     }
                     char tbuf[64];
-                    int tl = snprintf(tbuf, 64, "%.6g", v.dlist->data[i]);
+                    int tl = snprintf(tbuf, 64, "%.6g", VALUE_AS_DLIST(v)->data[i]);
                     while (pos + tl + 2 >= cap) { cap *= 2; res = realloc(res, cap); }
                     memcpy(res + pos, tbuf, tl);
                     pos += tl;
@@ -1560,11 +1730,11 @@ char *value_to_string(Value v) {
             char *res = malloc(cap);
             res[pos++] = '{';
             int first = 1;
-            if (v.map) {
-                for (int i = 0; i < v.map->capacity; i++) {
-                    if (!v.map->entries[i].occupied) continue;
-                    const char *key = v.map->entries[i].key ? v.map->entries[i].key : "";
-                    char *vs = value_to_string(v.map->entries[i].value);
+            if (VALUE_AS_MAP(v)) {
+                for (int i = 0; i < VALUE_AS_MAP(v)->capacity; i++) {
+                    if (!VALUE_AS_MAP(v)->entries[i].key) continue;
+                    const char *key = VALUE_AS_MAP(v)->entries[i].key ? VALUE_AS_MAP(v)->entries[i].key : "";
+                    char *vs = value_to_string(VALUE_AS_MAP(v)->entries[i].value);
                     size_t kl = strlen(key), vl = strlen(vs);
                     size_t needed = pos + (first ? 0 : 2) + kl + vl + 6;
                     while (needed >= cap) { cap *= 2; res = realloc(res, cap); }
@@ -1593,18 +1763,18 @@ char *value_to_string(Value v) {
 // Prints a Value directly to a file stream without allocating memory.
 // For primitives this is zero-alloc. Lists still recurse but avoid the O(n²) strcat.
 void value_fprint(FILE *f, Value v) {
-    switch (v.type) {
-        case VAL_INT:    fprintf(f, "%lld", v.i); break;
-        case VAL_FLOAT:  fprintf(f, "%.6g", v.f); break;
-        case VAL_BOOL:   fputs(v.b ? "true" : "false", f); break;
-        case VAL_POINTER: fprintf(f, "ptr(0x%llx)", (unsigned long long)v.ptr); break;
+    switch (VALUE_TYPE(v)) {
+        case VAL_INT:    fprintf(f, "%lld", VALUE_AS_INT(v)); break;
+        case VAL_FLOAT:  fprintf(f, "%.6g", VALUE_AS_FLOAT(v)); break;
+        case VAL_BOOL:   fputs(VALUE_AS_BOOL(v) ? "true" : "false", f); break;
+        case VAL_POINTER: fprintf(f, "ptr(0x%llx)", (unsigned long long)VALUE_AS_PTR(v)); break;
         case VAL_BLOC_TYPE:
-            if (v.bloc_type && v.bloc_type->name) fprintf(f, "<bloc %s>", v.bloc_type->name);
+            if (VALUE_AS_BLOC_TYPE(v) && VALUE_AS_BLOC_TYPE(v)->name) fprintf(f, "<bloc %s>", VALUE_AS_BLOC_TYPE(v)->name);
             else fputs("<bloc>", f);
             break;
         case VAL_BLOC:
         {
-            BlocSlot *slot = bloc_slot_from_handle(v.bloc.handle);
+            BlocSlot *slot = bloc_slot_from_handle(VALUE_AS_BLOC(v).handle);
             BlocTypeDesc *desc = slot ? slot->desc : NULL;
             if (desc && desc->name) fputs(desc->name, f);
             else fputs("bloc", f);
@@ -1622,25 +1792,25 @@ void value_fprint(FILE *f, Value v) {
             break;
         }
         case VAL_BOX: {
-            BoxSlot *slot = box_slot_from_handle(v.box.handle);
+            BoxSlot *slot = box_slot_from_handle(VALUE_AS_BOX(v).handle);
             if (!slot) fputs("<box invalid>", f);
             else if (slot->freed) fputs("<box freed>", f);
             else fprintf(f, "<box len=%zu cap=%zu>", slot->len, slot->cap);
             break;
         }
-        case VAL_CHAR:   fputc(v.c, f); break;
+        case VAL_CHAR:   fputc(VALUE_AS_CHAR(v), f); break;
         case VAL_NATIVE: fputs("<native function>", f); break;
-        case VAL_FILE:   fputs(v.file ? "<file handle>" : "<closed file>", f); break;
+        case VAL_FILE:   fputs(VALUE_AS_FILE(v) ? "<file handle>" : "<closed file>", f); break;
         case VAL_NULL:   fputs("null", f); break;
         case VAL_FUNCTION: fputs("<function>", f); break;
         case VAL_CLOSURE: fputs("<closure>", f); break;
         case VAL_VM_CLOSURE: fputs("<vm closure>", f); break;
         case VAL_DATA_TYPE:
-            if (v.dtype && v.dtype->name) fprintf(f, "<data %s>", v.dtype->name);
+            if (VALUE_AS_DTYPE(v) && VALUE_AS_DTYPE(v)->name) fprintf(f, "<data %s>", VALUE_AS_DTYPE(v)->name);
             else fputs("<data>", f);
             break;
         case VAL_TEMPLATE: {
-            TemplateObj *templ = v.template_obj;
+            TemplateObj *templ = VALUE_AS_TEMPLATE(v);
             const char *name = (templ && templ->dtype && templ->dtype->name) ? templ->dtype->name : "template";
             fputs(name, f);
             fputc('{', f);
@@ -1656,24 +1826,38 @@ void value_fprint(FILE *f, Value v) {
             break;
         }
         case VAL_STRING:
-            if (v.string && v.string->chars) fputs(v.string->chars, f);
+            if (VALUE_AS_STRING(v) && VALUE_AS_STRING(v)->chars) fputs(VALUE_AS_STRING(v)->chars, f);
             break;
         case VAL_LIST:
             fputc('[', f);
-            if (v.list) {
-                for (int i = 0; i < v.list->count; i++) {
+            if (VALUE_AS_LIST(v)) {
+                for (int i = 0; i < VALUE_AS_LIST(v)->count; i++) {
                     if (i > 0) fputs(", ", f);
-                    value_fprint(f, v.list->items[i]);
+                    value_fprint(f, VALUE_AS_LIST(v)->items[i]);
                 }
             }
             fputc(']', f);
             break;
+        case VAL_RANGE: {
+            if (VALUE_TYPE(VALUE_AS_RANGE(v)->list) == VAL_LIST) {
+                value_fprint(f, VALUE_AS_RANGE(v)->list);
+                break;
+            }
+            fputc('[', f);
+            long long n = value_range_len(VALUE_AS_RANGE(v));
+            for (long long i = 0; i < n; i++) {
+                if (i > 0) fputs(", ", f);
+                fprintf(f, "%lld", VALUE_AS_RANGE(v)->start + i * VALUE_AS_RANGE(v)->step);
+            }
+            fputc(']', f);
+            break;
+        }
         case VAL_DENSE_LIST:
             fputs("d[", f);
-            if (v.dlist) {
-                for (int i = 0; i < v.dlist->count; i++) {
+            if (VALUE_AS_DLIST(v)) {
+                for (int i = 0; i < VALUE_AS_DLIST(v)->count; i++) {
                     if (i > 0) fputs(", ", f);
-                    fprintf(f, "%.6g", v.dlist->data[i]);
+                    fprintf(f, "%.6g", VALUE_AS_DLIST(v)->data[i]);
                 }
             }
             fputc(']', f);
@@ -1681,12 +1865,12 @@ void value_fprint(FILE *f, Value v) {
         case VAL_MAP: {
             fputc('{', f);
             int first = 1;
-            if (v.map) {
-                for (int i = 0; i < v.map->capacity; i++) {
-                    if (!v.map->entries[i].occupied) continue;
+            if (VALUE_AS_MAP(v)) {
+                for (int i = 0; i < VALUE_AS_MAP(v)->capacity; i++) {
+                    if (!VALUE_AS_MAP(v)->entries[i].key) continue;
                     if (!first) fputs(", ", f);
-                    fprintf(f, "\"%s\": ", v.map->entries[i].key ? v.map->entries[i].key : "");
-                    value_fprint(f, v.map->entries[i].value);
+                    fprintf(f, "\"%s\": ", VALUE_AS_MAP(v)->entries[i].key ? VALUE_AS_MAP(v)->entries[i].key : "");
+                    value_fprint(f, VALUE_AS_MAP(v)->entries[i].value);
                     first = 0;
                 }
             }
@@ -1698,191 +1882,203 @@ void value_fprint(FILE *f, Value v) {
 
 // Appends a value to a list, resizing capacity if needed
 void value_list_append(Value *list, Value v) {
-    if (list->type != VAL_LIST || !list->list) {
+    if (VALUE_TYPE(*list) != VAL_LIST || !VALUE_AS_LIST(*list)) {
         return;
     }
-    if (list->list->count >= list->list->capacity) {
-        int n = list->list->capacity == 0 ? 4 : list->list->capacity * 2;
+    if (VALUE_AS_LIST(*list)->count >= VALUE_AS_LIST(*list)->capacity) {
+        int n = VALUE_AS_LIST(*list)->capacity == 0 ? 4 : VALUE_AS_LIST(*list)->capacity * 2;
         if (luna_gc_runtime_enabled()) {
-            Value *old_items = list->list->items;
+            Value *old_items = VALUE_AS_LIST(*list)->items;
             Value *grown = alloc_list_items_buffer(n);
             if (old_items) {
-                memcpy(grown, old_items, sizeof(Value) * (size_t)list->list->count);
-                for (int i = 0; i < list->list->count; i++) {
+                memcpy(grown, old_items, sizeof(Value) * (size_t)VALUE_AS_LIST(*list)->count);
+                for (int i = 0; i < VALUE_AS_LIST(*list)->count; i++) {
                     gc_note_owner_write_value(grown, &grown[i]);
                 }
             }
             gc_note_payload_overwrite(old_items);
-            list->list->items = grown;
-            gc_note_owner_write(list->list);
+            VALUE_AS_LIST(*list)->items = grown;
+            gc_note_owner_write(VALUE_AS_LIST(*list));
             if (grown) {
                 luna_gc_runtime_write_barrier(grown);
             }
         } else {
-            list->list->items = realloc(list->list->items, sizeof(Value) * (size_t)n);
+            VALUE_AS_LIST(*list)->items = realloc(VALUE_AS_LIST(*list)->items, sizeof(Value) * (size_t)n);
         }
-        list->list->capacity = n;
+        VALUE_AS_LIST(*list)->capacity = n;
     }
-    gc_note_owner_write_value(list->list->items, &v);
-    list->list->items[list->list->count++] = value_copy(v);
+    gc_note_owner_write_value(VALUE_AS_LIST(*list)->items, &v);
+    VALUE_AS_LIST(*list)->items[VALUE_AS_LIST(*list)->count++] = value_copy(v);
 }
 
 // Appends a value to a list with move semantics (takes ownership, no copy)
 void value_list_append_move(Value *list, Value *v) {
-    if (list->type != VAL_LIST || !list->list) {
+    if (VALUE_TYPE(*list) != VAL_LIST || !VALUE_AS_LIST(*list)) {
         return;
     }
-    if (list->list->count >= list->list->capacity) {
-        int n = list->list->capacity == 0 ? 4 : list->list->capacity * 2;
+    if (VALUE_AS_LIST(*list)->count >= VALUE_AS_LIST(*list)->capacity) {
+        int n = VALUE_AS_LIST(*list)->capacity == 0 ? 4 : VALUE_AS_LIST(*list)->capacity * 2;
         if (luna_gc_runtime_enabled()) {
-            Value *old_items = list->list->items;
+            Value *old_items = VALUE_AS_LIST(*list)->items;
             Value *grown = alloc_list_items_buffer(n);
             if (old_items) {
-                memcpy(grown, old_items, sizeof(Value) * (size_t)list->list->count);
-                for (int i = 0; i < list->list->count; i++) {
+                memcpy(grown, old_items, sizeof(Value) * (size_t)VALUE_AS_LIST(*list)->count);
+                for (int i = 0; i < VALUE_AS_LIST(*list)->count; i++) {
                     gc_note_owner_write_value(grown, &grown[i]);
                 }
             }
             gc_note_payload_overwrite(old_items);
-            list->list->items = grown;
-            gc_note_owner_write(list->list);
+            VALUE_AS_LIST(*list)->items = grown;
+            gc_note_owner_write(VALUE_AS_LIST(*list));
             if (grown) {
                 luna_gc_runtime_write_barrier(grown);
             }
         } else {
-            list->list->items = realloc(list->list->items, sizeof(Value) * (size_t)n);
+            VALUE_AS_LIST(*list)->items = realloc(VALUE_AS_LIST(*list)->items, sizeof(Value) * (size_t)n);
         }
-        list->list->capacity = n;
+        VALUE_AS_LIST(*list)->capacity = n;
     }
-    gc_note_owner_write_value(list->list->items, v);
-    list->list->items[list->list->count++] = *v;
-    v->type = VAL_NULL;
+    gc_note_owner_write_value(VALUE_AS_LIST(*list)->items, v);
+    VALUE_AS_LIST(*list)->items[VALUE_AS_LIST(*list)->count++] = *v;
+    *v = value_null();
 }
 
 // Appends a double directly to a dense list
 void value_dlist_append(Value *list, double v) {
-    if (list->type != VAL_DENSE_LIST || !list->dlist) {
+    if (VALUE_TYPE(*list) != VAL_DENSE_LIST || !VALUE_AS_DLIST(*list)) {
         return;
     }
-    if (list->dlist->count >= list->dlist->capacity) {
-        int n = list->dlist->capacity == 0 ? 4 : list->dlist->capacity * 2;
+    if (VALUE_AS_DLIST(*list)->count >= VALUE_AS_DLIST(*list)->capacity) {
+        int n = VALUE_AS_DLIST(*list)->capacity == 0 ? 4 : VALUE_AS_DLIST(*list)->capacity * 2;
         if (luna_gc_runtime_enabled()) {
-            double *old_data = list->dlist->data;
+            double *old_data = VALUE_AS_DLIST(*list)->data;
             double *grown = alloc_dense_data_buffer(n);
             if (old_data) {
-                memcpy(grown, old_data, sizeof(double) * (size_t)list->dlist->count);
+                memcpy(grown, old_data, sizeof(double) * (size_t)VALUE_AS_DLIST(*list)->count);
             }
             gc_note_payload_overwrite(old_data);
-            list->dlist->data = grown;
-            gc_note_owner_write(list->dlist);
+            VALUE_AS_DLIST(*list)->data = grown;
+            gc_note_owner_write(VALUE_AS_DLIST(*list));
         } else {
-            list->dlist->data = realloc(list->dlist->data, sizeof(double) * (size_t)n);
+            VALUE_AS_DLIST(*list)->data = realloc(VALUE_AS_DLIST(*list)->data, sizeof(double) * (size_t)n);
         }
-        list->dlist->capacity = n;
+        VALUE_AS_DLIST(*list)->capacity = n;
     }
-    list->dlist->data[list->dlist->count++] = v;
+    VALUE_AS_DLIST(*list)->data[VALUE_AS_DLIST(*list)->count++] = v;
 }
 
 void value_map_set(Value *map, const char *key, Value v) {
-    if (!map || map->type != VAL_MAP || !map->map || !key) return;
-    map_ensure_capacity(map->map);
-    MapEntry *entry = map_find_entry(map->map, key);
+    if (!map || VALUE_TYPE(*map) != VAL_MAP || !VALUE_AS_MAP(*map) || !key) return;
+    map_ensure_capacity(VALUE_AS_MAP(*map));
+    MapEntry *entry = map_find_entry(VALUE_AS_MAP(*map), key);
     if (entry) {
-        gc_note_owner_write_value(map->map->entries, &v);
+        gc_note_owner_write_value(VALUE_AS_MAP(*map)->entries, &v);
         gc_note_value_overwrite(&entry->value);
         value_free(entry->value);
         entry->value = value_copy(v);
         return;
     }
 
-    unsigned int idx = map_hash(key) & (map->map->capacity - 1);
-    while (map->map->entries[idx].occupied) {
-        idx = (idx + 1) & (map->map->capacity - 1);
+    unsigned int idx = map_hash(key) & (VALUE_AS_MAP(*map)->capacity - 1);
+    while (VALUE_AS_MAP(*map)->entries[idx].key) {
+        idx = (idx + 1) & (VALUE_AS_MAP(*map)->capacity - 1);
     }
-    gc_note_owner_write_value(map->map->entries, &v);
-    map->map->entries[idx].occupied = 1;
-    map->map->entries[idx].key = key;
-    map->map->entries[idx].value = value_copy(v);
-    map->map->count++;
+    gc_note_owner_write_value(VALUE_AS_MAP(*map)->entries, &v);
+    VALUE_AS_MAP(*map)->entries[idx].key = key;
+    VALUE_AS_MAP(*map)->entries[idx].value = value_copy(v);
+    VALUE_AS_MAP(*map)->count++;
 }
 
 void value_map_set_move(Value *map, const char *key, Value *v) {
-    if (!map || map->type != VAL_MAP || !map->map || !key || !v) return;
-    map_ensure_capacity(map->map);
-    MapEntry *entry = map_find_entry(map->map, key);
+    if (!map || VALUE_TYPE(*map) != VAL_MAP || !VALUE_AS_MAP(*map) || !key || !v) return;
+    map_ensure_capacity(VALUE_AS_MAP(*map));
+    MapEntry *entry = map_find_entry(VALUE_AS_MAP(*map), key);
     if (entry) {
-        gc_note_owner_write_value(map->map->entries, v);
+        gc_note_owner_write_value(VALUE_AS_MAP(*map)->entries, v);
         gc_note_value_overwrite(&entry->value);
         value_free(entry->value);
         entry->value = *v;
-        v->type = VAL_NULL;
+        *v = value_null();
         return;
     }
 
-    unsigned int idx = map_hash(key) & (map->map->capacity - 1);
-    while (map->map->entries[idx].occupied) {
-        idx = (idx + 1) & (map->map->capacity - 1);
+    unsigned int idx = map_hash(key) & (VALUE_AS_MAP(*map)->capacity - 1);
+    while (VALUE_AS_MAP(*map)->entries[idx].key) {
+        idx = (idx + 1) & (VALUE_AS_MAP(*map)->capacity - 1);
     }
-    gc_note_owner_write_value(map->map->entries, v);
-    map->map->entries[idx].occupied = 1;
-    map->map->entries[idx].key = key;
-    map->map->entries[idx].value = *v;
-    map->map->count++;
-    v->type = VAL_NULL;
+    gc_note_owner_write_value(VALUE_AS_MAP(*map)->entries, v);
+    VALUE_AS_MAP(*map)->entries[idx].key = key;
+    VALUE_AS_MAP(*map)->entries[idx].value = *v;
+    VALUE_AS_MAP(*map)->count++;
+    *v = value_null();
 }
 
 Value *value_map_get(Value *map, const char *key) {
-    MapEntry *entry = (!map || map->type != VAL_MAP) ? NULL : map_find_entry(map->map, key);
+    MapEntry *entry = (!map || VALUE_TYPE(*map) != VAL_MAP) ? NULL : map_find_entry(VALUE_AS_MAP(*map), key);
     return entry ? &entry->value : NULL;
 }
 
+/* Like value_map_get, but first tries the entry index in *hint (the slot the
+ * key was found in last time) and refreshes it after a full probe. */
+Value *value_map_get_hinted(Value *map, const char *key, int *hint) {
+    if (!map || VALUE_TYPE(*map) != VAL_MAP || !VALUE_AS_MAP(*map) || !VALUE_AS_MAP(*map)->entries) return NULL;
+    MapObj *m = VALUE_AS_MAP(*map);
+    int h = *hint;
+    if (h >= 0 && h < m->capacity && key && m->entries[h].key == key) {
+        return &m->entries[h].value;
+    }
+    MapEntry *entry = map_find_entry(m, key);
+    if (!entry) return NULL;
+    *hint = (int)(entry - m->entries);
+    return &entry->value;
+}
+
 int value_map_has(Value *map, const char *key) {
     return value_map_get(map, key) != NULL;
 }
 
 int value_map_delete(Value *map, const char *key) {
-    if (!map || map->type != VAL_MAP || !map->map || !key) return 0;
-    MapEntry *entry = map_find_entry(map->map, key);
+    if (!map || VALUE_TYPE(*map) != VAL_MAP || !VALUE_AS_MAP(*map) || !key) return 0;
+    MapEntry *entry = map_find_entry(VALUE_AS_MAP(*map), key);
     if (!entry) return 0;
-    int idx = (int)(entry - map->map->entries);
-    gc_note_owner_write(map->map->entries);
+    int idx = (int)(entry - VALUE_AS_MAP(*map)->entries);
+    gc_note_owner_write(VALUE_AS_MAP(*map)->entries);
     gc_note_value_overwrite(&entry->value);
     value_free(entry->value);
-    entry->occupied = 0;
     entry->key = NULL;
-    map->map->count--;
-    map_close_delete_gap(map->map, idx);
+    VALUE_AS_MAP(*map)->count--;
+    map_close_delete_gap(VALUE_AS_MAP(*map), idx);
     return 1;
 }
 
 Value value_map_keys(Value map) {
     Value keys = value_list();
-    if (map.type != VAL_MAP || !map.map) return keys;
-    for (int i = 0; i < map.map->capacity; i++) {
-        if (!map.map->entries[i].occupied) continue;
-        value_list_append(&keys, value_string(map.map->entries[i].key));
+    if (VALUE_TYPE(map) != VAL_MAP || !VALUE_AS_MAP(map)) return keys;
+    for (int i = 0; i < VALUE_AS_MAP(map)->capacity; i++) {
+        if (!VALUE_AS_MAP(map)->entries[i].key) continue;
+        value_list_append(&keys, value_string(VALUE_AS_MAP(map)->entries[i].key));
     }
     return keys;
 }
 
 Value value_map_values(Value map) {
     Value out = value_list();
-    if (map.type != VAL_MAP || !map.map || !map.map->entries) return out;
-    for (int i = 0; i < map.map->capacity; i++) {
-        if (!map.map->entries[i].occupied) continue;
-        value_list_append(&out, map.map->entries[i].value);
+    if (VALUE_TYPE(map) != VAL_MAP || !VALUE_AS_MAP(map) || !VALUE_AS_MAP(map)->entries) return out;
+    for (int i = 0; i < VALUE_AS_MAP(map)->capacity; i++) {
+        if (!VALUE_AS_MAP(map)->entries[i].key) continue;
+        value_list_append(&out, VALUE_AS_MAP(map)->entries[i].value);
     }
     return out;
 }
 
 Value value_map_items(Value map) {
     Value out = value_list();
-    if (map.type != VAL_MAP || !map.map || !map.map->entries) return out;
-    for (int i = 0; i < map.map->capacity; i++) {
-        if (!map.map->entries[i].occupied) continue;
+    if (VALUE_TYPE(map) != VAL_MAP || !VALUE_AS_MAP(map) || !VALUE_AS_MAP(map)->entries) return out;
+    for (int i = 0; i < VALUE_AS_MAP(map)->capacity; i++) {
+        if (!VALUE_AS_MAP(map)->entries[i].key) continue;
         Value pair = value_list();
-        value_list_append(&pair, value_string(map.map->entries[i].key));
-        value_list_append(&pair, map.map->entries[i].value);
+        value_list_append(&pair, value_string(VALUE_AS_MAP(map)->entries[i].key));
+        value_list_append(&pair, VALUE_AS_MAP(map)->entries[i].value);
         value_list_append_move(&out, &pair);
     }
     return out;
@@ -9,7 +9,7 @@
 #include "env.h"
 #include "arena.h"
 
-extern Arena *ast_arena;
+extern _Thread_local Arena *ast_arena;
 
 // Vector operation function signature used by the AVX2/native math helpers.
 typedef void (*VecOp)(long long count, double *a, double *b, double *out);
@@ -40,22 +40,32 @@ IMPL_VEC_OP_AVX2(vec_div_c, _mm256_div_pd, /)
 
 // Helper to extract double
 static double get_val(Value v) {
-    if (v.type == VAL_INT) return (double)v.i;
-    if (v.type == VAL_FLOAT) return v.f;
+    if (VALUE_TYPE(v) == VAL_INT) return (double)VALUE_AS_INT(v);
+    if (VALUE_TYPE(v) == VAL_FLOAT) return VALUE_AS_FLOAT(v);
     return 0.0;
 }
 
 // Internal helper to get a raw double array from either standard or dense lists
 static double* get_raw_buffer(Value v, int *count) {
-    if (v.type == VAL_DENSE_LIST && v.dlist) {
-        *count = v.dlist->count;
-        return v.dlist->data;
+    if (VALUE_TYPE(v) == VAL_DENSE_LIST && VALUE_AS_DLIST(v)) {
+        *count = VALUE_AS_DLIST(v)->count;
+        return VALUE_AS_DLIST(v)->data;
     }
-    if (v.type == VAL_LIST && v.list) {
-        *count = v.list->count;
+    if (VALUE_TYPE(v) == VAL_LIST && VALUE_AS_LIST(v)) {
+        *count = VALUE_AS_LIST(v)->count;
         double *buf = malloc(sizeof(double) * (*count));
         for (int i = 0; i < *count; i++) {
-            buf[i] = get_val(v.list->items[i]);
+            buf[i] = get_val(VALUE_AS_LIST(v)->items[i]);
+        }
+        return buf;
+    }
+    if (VALUE_TYPE(v) == VAL_RANGE && VALUE_AS_RANGE(v)) {
+        *count = (int)value_range_len(VALUE_AS_RANGE(v));
+        double *buf = malloc(sizeof(double) * (*count));
+        for (int i = 0; i < *count; i++) {
+            Value item = value_range_get(VALUE_AS_RANGE(v), i);
+            buf[i] = get_val(item);
+            value_free(item);
         }
         return buf;
     }
@@ -66,27 +76,39 @@ static double* get_raw_buffer(Value v, int *count) {
 
 // Generic handler that takes Values directly
 static Value vec_op_direct(Value list_a, Value list_b, VecOp op) {
+    // A lazy range is worked on as its list, built on copies of the operands
+    if (VALUE_TYPE(list_a) == VAL_RANGE || VALUE_TYPE(list_b) == VAL_RANGE) {
+        Value a = value_copy(list_a);
+        Value b = value_copy(list_b);
+        value_range_materialize(&a);
+        value_range_materialize(&b);
+        Value res = vec_op_direct(a, b, op);
+        value_free(a);
+        value_free(b);
+        return res;
+    }
+
     // Fast path for Dense Lists (Zero-copy)
-    if (list_a.type == VAL_DENSE_LIST && list_b.type == VAL_DENSE_LIST && list_a.dlist && list_b.dlist) {
-        int count = list_a.dlist->count < list_b.dlist->count ? list_a.dlist->count : list_b.dlist->count;
+    if (VALUE_TYPE(list_a) == VAL_DENSE_LIST && VALUE_TYPE(list_b) == VAL_DENSE_LIST && VALUE_AS_DLIST(list_a) && VALUE_AS_DLIST(list_b)) {
+        int count = VALUE_AS_DLIST(list_a)->count < VALUE_AS_DLIST(list_b)->count ? VALUE_AS_DLIST(list_a)->count : VALUE_AS_DLIST(list_b)->count;
         if (count == 0) return value_dense_list();
 
         Value res = value_dense_list();
-        res.dlist->data = malloc(sizeof(double) * count);
-        res.dlist->count = count;
-        res.dlist->capacity = count;
+        VALUE_AS_DLIST(res)->data = malloc(sizeof(double) * count);
+        VALUE_AS_DLIST(res)->count = count;
+        VALUE_AS_DLIST(res)->capacity = count;
 
         // Call ASM directly on existing buffers
-        op(count, list_a.dlist->data, list_b.dlist->data, res.dlist->data);
+        op(count, VALUE_AS_DLIST(list_a)->data, VALUE_AS_DLIST(list_b)->data, VALUE_AS_DLIST(res)->data);
         return res;
     }
 
     // Safety check: both must be lists
-    if (list_a.type != VAL_LIST || list_b.type != VAL_LIST) {
+    if (VALUE_TYPE(list_a) != VAL_LIST || VALUE_TYPE(list_b) != VAL_LIST) {
         return value_null();
     }
 
-    int count = list_a.list->count < list_b.list->count ? list_a.list->count : list_b.list->count;
+    int count = VALUE_AS_LIST(list_a)->count < VALUE_AS_LIST(list_b)->count ? VALUE_AS_LIST(list_a)->count : VALUE_AS_LIST(list_b)->count;
     if (count == 0) return value_list();
 
     // Allocate & Pack using ultra-fast AST Arena instead of OS malloc
@@ -97,8 +119,8 @@ static Value vec_op_direct(Value list_a, Value list_b, VecOp op) {
     double *raw_out = malloc(sizeof(double) * count);
 
     for (int i = 0; i < count; i++) {
-        raw_a[i] = get_val(list_a.list->items[i]);
-        raw_b[i] = get_val(list_b.list->items[i]);
+        raw_a[i] = get_val(VALUE_AS_LIST(list_a)->items[i]);
+        raw_b[i] = get_val(VALUE_AS_LIST(list_b)->items[i]);
     }
 
     // Call ASM macro
@@ -106,9 +128,9 @@ static Value vec_op_direct(Value list_a, Value list_b, VecOp op) {
 
     // Unpack - Changed to Dense List for better downstream performance
     Value res = value_dense_list();
-    res.dlist->data = raw_out;
-    res.dlist->count = count;
-    res.dlist->capacity = count;
+    VALUE_AS_DLIST(res)->data = raw_out;
+    VALUE_AS_DLIST(res)->count = count;
+    VALUE_AS_DLIST(res)->capacity = count;
 
     // raw_a and raw_b are automatically bulk deallocated by ast_arena at statement end
     // raw_out is now managed by 'res'
@@ -126,25 +148,29 @@ Value vec_div_values(Value a, Value b) { return vec_op_direct(a, b, vec_div_c);
 
 Value lib_mat_mul(int argc, Value *argv, Env *env) {
     if (argc != 2) return value_null();
+    value_range_materialize(&argv[0]);
+    value_range_materialize(&argv[1]);
     Value A = argv[0];
     Value B = argv[1];
 
-    if ((A.type != VAL_LIST && A.type != VAL_DENSE_LIST) || 
-        (B.type != VAL_LIST && B.type != VAL_DENSE_LIST)) return value_null();
+    if ((VALUE_TYPE(A) != VAL_LIST && VALUE_TYPE(A) != VAL_DENSE_LIST) || 
+        (VALUE_TYPE(B) != VAL_LIST && VALUE_TYPE(B) != VAL_DENSE_LIST)) return value_null();
 
-    int rows_a = (A.type == VAL_LIST && A.list) ? A.list->count : 1;
-    int rows_b = (B.type == VAL_LIST && B.list) ? B.list->count : 1;
+    int rows_a = (VALUE_TYPE(A) == VAL_LIST && VALUE_AS_LIST(A)) ? VALUE_AS_LIST(A)->count : 1;
+    int rows_b = (VALUE_TYPE(B) == VAL_LIST && VALUE_AS_LIST(B)) ? VALUE_AS_LIST(B)->count : 1;
     if (rows_a == 0 || rows_b == 0) return value_list();
 
     int cols_a = 0;
-    Value first_row_a = (A.type == VAL_LIST && A.list && A.list->count > 0) ? A.list->items[0] : A;
-    if (first_row_a.type == VAL_LIST && first_row_a.list) cols_a = first_row_a.list->count;
-    else if (first_row_a.type == VAL_DENSE_LIST && first_row_a.dlist) cols_a = first_row_a.dlist->count;
+    Value first_row_a = (VALUE_TYPE(A) == VAL_LIST && VALUE_AS_LIST(A) && VALUE_AS_LIST(A)->count > 0) ? VALUE_AS_LIST(A)->items[0] : A;
+    if (VALUE_TYPE(first_row_a) == VAL_LIST && VALUE_AS_LIST(first_row_a)) cols_a = VALUE_AS_LIST(first_row_a)->count;
+    else if (VALUE_TYPE(first_row_a) == VAL_DENSE_LIST && VALUE_AS_DLIST(first_row_a)) cols_a = VALUE_AS_DLIST(first_row_a)->count;
+    else if (VALUE_TYPE(first_row_a) == VAL_RANGE && VALUE_AS_RANGE(first_row_a)) cols_a = (int)value_range_len(VALUE_AS_RANGE(first_row_a));
 
     int cols_b = 0;
-    Value first_row_b = (B.type == VAL_LIST && B.list && B.list->count > 0) ? B.list->items[0] : B;
-    if (first_row_b.type == VAL_LIST && first_row_b.list) cols_b = first_row_b.list->count;
-    else if (first_row_b.type == VAL_DENSE_LIST && first_row_b.dlist) cols_b = first_row_b.dlist->count;
+    Value first_row_b = (VALUE_TYPE(B) == VAL_LIST && VALUE_AS_LIST(B) && VALUE_AS_LIST(B)->count > 0) ? VALUE_AS_LIST(B)->items[0] : B;
+    if (VALUE_TYPE(first_row_b) == VAL_LIST && VALUE_AS_LIST(first_row_b)) cols_b = VALUE_AS_LIST(first_row_b)->count;
+    else if (VALUE_TYPE(first_row_b) == VAL_DENSE_LIST && VALUE_AS_DLIST(first_row_b)) cols_b = VALUE_AS_DLIST(first_row_b)->count;
+    else if (VALUE_TYPE(first_row_b) == VAL_RANGE && VALUE_AS_RANGE(first_row_b)) cols_b = (int)value_range_len(VALUE_AS_RANGE(first_row_b));
 
     if (cols_a != rows_b || cols_a == 0) {
         printf("Runtime Error: Matrix dimension mismatch (%d cols vs %d rows)\n", cols_a, rows_b);
@@ -155,20 +181,20 @@ Value lib_mat_mul(int argc, Value *argv, Env *env) {
     double *flat_A = arena_alloc(ast_arena, rows_a * cols_a * sizeof(double));
     for (int i = 0; i < rows_a; i++) {
         int a_len;
-        Value row_a_val = (A.type == VAL_LIST && A.list) ? A.list->items[i] : A;
+        Value row_a_val = (VALUE_TYPE(A) == VAL_LIST && VALUE_AS_LIST(A)) ? VALUE_AS_LIST(A)->items[i] : A;
         double *a_row_ptr = get_raw_buffer(row_a_val, &a_len);
         for (int j = 0; j < cols_a; j++) flat_A[i * cols_a + j] = a_row_ptr[j];
-        if (row_a_val.type == VAL_LIST) free(a_row_ptr); // free works here because get_raw_buffer uses malloc for standard lists
+        if (VALUE_TYPE(row_a_val) != VAL_DENSE_LIST) free(a_row_ptr); // free works here because get_raw_buffer uses malloc for standard lists and ranges
     }
 
     // Pre-flatten Matrix B using AST Arena pointer bump
     double *flat_B = arena_alloc(ast_arena, rows_b * cols_b * sizeof(double));
     for (int i = 0; i < rows_b; i++) {
         int b_len;
-        Value row_b_val = (B.type == VAL_LIST && B.list) ? B.list->items[i] : B;
+        Value row_b_val = (VALUE_TYPE(B) == VAL_LIST && VALUE_AS_LIST(B)) ? VALUE_AS_LIST(B)->items[i] : B;
         double *b_row_ptr = get_raw_buffer(row_b_val, &b_len);
         for (int j = 0; j < cols_b; j++) flat_B[i * cols_b + j] = b_row_ptr[j];
-        if (row_b_val.type == VAL_LIST) free(b_row_ptr);
+        if (VALUE_TYPE(row_b_val) != VAL_DENSE_LIST) free(b_row_ptr);
     }
 
     // Allocate flat result matrix using arena, and zero initialize it
@@ -192,11 +218,11 @@ Value lib_mat_mul(int argc, Value *argv, Env *env) {
         Value row = value_dense_list();
         // Since dense lists are long-lived structures, leave them on standard heap
         // If they were on the Arena, they'd be wiped during the next interpreter teardown.
-        row.dlist->data = malloc(cols_b * sizeof(double));
-        row.dlist->count = cols_b;
-        row.dlist->capacity = cols_b;
+        VALUE_AS_DLIST(row)->data = malloc(cols_b * sizeof(double));
+        VALUE_AS_DLIST(row)->count = cols_b;
+        VALUE_AS_DLIST(row)->capacity = cols_b;
         for (int j = 0; j < cols_b; j++) {
-            row.dlist->data[j] = flat_C[i * cols_b + j];
+            VALUE_AS_DLIST(row)->data[j] = flat_C[i * cols_b + j];
         }
         value_list_append(&res, row);
         value_free(row);
@@ -211,6 +237,8 @@ static Value vec_generic_wrapper(int argc, Value *argv, Value (*func)(Value, Val
         printf("Error: %s expects 2 lists\n", name);
         return value_null();
     }
+    value_range_materialize(&argv[0]);
+    value_range_materialize(&argv[1]);
     return func(argv[0], argv[1]);
 }
 
@@ -229,12 +257,12 @@ Value lib_vec_mul_inline(int argc, Value *argv, Env *env) {
     Value list_b = argv[1];
     
     // Only support dense lists for ultra-fast in-place math
-    if (list_a.type == VAL_DENSE_LIST && list_b.type == VAL_DENSE_LIST && list_a.dlist && list_b.dlist) {
-        int count = list_a.dlist->count < list_b.dlist->count ? list_a.dlist->count : list_b.dlist->count;
+    if (VALUE_TYPE(list_a) == VAL_DENSE_LIST && VALUE_TYPE(list_b) == VAL_DENSE_LIST && VALUE_AS_DLIST(list_a) && VALUE_AS_DLIST(list_b)) {
+        int count = VALUE_AS_DLIST(list_a)->count < VALUE_AS_DLIST(list_b)->count ? VALUE_AS_DLIST(list_a)->count : VALUE_AS_DLIST(list_b)->count;
         if (count == 0) return value_null();
         
         // Output directly into list_a (in-place)
-        vec_mul_c(count, list_a.dlist->data, list_b.dlist->data, list_a.dlist->data);
+        vec_mul_c(count, VALUE_AS_DLIST(list_a)->data, VALUE_AS_DLIST(list_b)->data, VALUE_AS_DLIST(list_a)->data);
     } else {
         printf("Error: vec_mul_inline requires dense lists for A and B.\n");
     }
@@ -30,6 +30,10 @@ run_luna() {
     local src="$1"
     if [[ "$(basename "$src")" == test_gc_* ]]; then
         env LUNA_GC_STRESS=1 LUNA_GC_VERIFY=1 "$BIN" "$src"
+    elif [[ "$(basename "$src")" == test_jit_* ]]; then
+        env LUNA_JIT=1 "$BIN" "$src"
+    elif [[ "$(basename "$src")" == test_vm_profile* ]]; then
+        env LUNA_VM_PROFILE=1 "$BIN" "$src"
     else
         "$BIN" "$src"
     fi
@@ -80,55 +84,97 @@ run_split_golden_test() {
     fi
 }
 
-# Loop through all .lu files
-for src in "$TEST_DIR"/*.lu; do
-    # Check if glob found nothing
-    [ -e "$src" ] || continue
+# Runs every test/*.lu (or those matching $1) against $BIN
+run_suite() {
+    for src in "$TEST_DIR"/${1:-*.lu}; do
+        # Check if glob found nothing
+        [ -e "$src" ] || continue
 
-    base_name=$(basename "$src")
-    expect_file="${src%.lu}.expect"
+        base_name=$(basename "$src")
+        expect_file="${src%.lu}.expect"
 
-    if [ "$base_name" = "test_unsafe_errors.lu" ]; then
-        run_split_golden_test "$src" "$expect_file"
-        continue
-    fi
+        # VM-only behaviour; the tree-walking interpreter is not expected to match
+        if [ -n "$LUNA_USE_INTERPRETER" ] && [[ "$base_name" == test_vm_* ]]; then
+            echo -e "${YELLOW}[SKIP] $base_name (VM only)${NC}"
+            continue
+        fi
+
+        if [ "$base_name" = "test_unsafe_errors.lu" ]; then
+            run_split_golden_test "$src" "$expect_file"
+            continue
+        fi
 
-    # --- CASE 1: Golden File Test (Compare Output) ---
-    if [ -f "$expect_file" ]; then
-        # Run and save output to temp file
-        run_luna "$src" > "$TEMP_OUT" 2>&1
-        
-        # Compare output (ignoring trailing whitespace issues)
-        diff -q --strip-trailing-cr "$TEMP_OUT" "$expect_file" > /dev/null
-        
-        if [ $? -eq 0 ]; then
-            echo -e "${GREEN}[PASS] $base_name (Output Match)${NC}"
-            ((PASSED++))
+        # --- CASE 1: Golden File Test (Compare Output) ---
+        if [ -f "$expect_file" ]; then
+            # Run and save output to temp file
+            run_luna "$src" > "$TEMP_OUT" 2>&1
+            
+            # Compare output (ignoring trailing whitespace issues)
+            diff -q --strip-trailing-cr "$TEMP_OUT" "$expect_file" > /dev/null
+            
+            if [ $? -eq 0 ]; then
+                echo -e "${GREEN}[PASS] $base_name (Output Match)${NC}"
+                ((PASSED++))
+            else
+                echo -e "${RED}[FAIL] $base_name (Output Mismatch)${NC}"
+                echo -e "${YELLOW}Expected:${NC}"
+                cat "$expect_file"
+                echo -e "${YELLOW}Actual:${NC}"
+                cat "$TEMP_OUT"
+                ((FAILED++))
+            fi
+
+        # --- CASE 2: Assertion Test (Check Exit Code) ---
         else
-            echo -e "${RED}[FAIL] $base_name (Output Mismatch)${NC}"
-            echo -e "${YELLOW}Expected:${NC}"
-            cat "$expect_file"
-            echo -e "${YELLOW}Actual:${NC}"
-            cat "$TEMP_OUT"
-            ((FAILED++))
+            # Run and capture stderr just in case it fails
+            run_luna "$src" > /dev/null 2> "$TEMP_OUT"
+            EXIT_CODE=$?
+
+            if [ $EXIT_CODE -eq 0 ]; then
+                echo -e "${GREEN}[PASS] $base_name (Assertion)${NC}"
+                ((PASSED++))
+            else
+                echo -e "${RED}[FAIL] $base_name (Assertion Failed)${NC}"
+                cat "$TEMP_OUT"
+                ((FAILED++))
+            fi
         fi
+    done
+}
 
-    # --- CASE 2: Assertion Test (Check Exit Code) ---
+run_suite
+
+# The same suite against the NaN-boxed Value (`make NANBOX=1`), built into its
+# own object directory. LUNA_TEST_NANBOX=0 skips it.
+if [ "${LUNA_TEST_NANBOX:-1}" != "0" ]; then
+    echo "========================================"
+    echo "  NaN-boxed build (make NANBOX=1)"
+    echo "========================================"
+    if make -s NANBOX=1 OBJDIR=obj/nanbox BINDIR=bin/nanbox > "$TEMP_OUT" 2>&1; then
+        BIN="./bin/nanbox/luna"
+        run_suite
     else
-        # Run and capture stderr just in case it fails
-        run_luna "$src" > /dev/null 2> "$TEMP_OUT"
-        EXIT_CODE=$?
+        echo -e "${RED}[FAIL] make NANBOX=1 (Build Failed)${NC}"
+        cat "$TEMP_OUT"
+        ((FAILED++))
+    fi
+fi
 
-        if [ $EXIT_CODE -eq 0 ]; then
-            echo -e "${GREEN}[PASS] $base_name (Assertion)${NC}"
-            ((PASSED++))
-        else
-            echo -e "${RED}[FAIL] $base_name (Assertion Failed)${NC}"
-            cat "$TEMP_OUT"
-            ((FAILED++))
-        fi
+# The profiler tests against a `make VM_PROFILE=1` build, where
+# LUNA_VM_PROFILE turns the hooks on. LUNA_TEST_PROFILE=0 skips it.
+if [ "${LUNA_TEST_PROFILE:-1}" != "0" ]; then
+    echo "========================================"
+    echo "  Profiling build (make VM_PROFILE=1)"
+    echo "========================================"
+    if make -s VM_PROFILE=1 OBJDIR=obj/profile BINDIR=bin/profile > "$TEMP_OUT" 2>&1; then
+        BIN="./bin/profile/luna"
+        run_suite "test_vm_profile*.lu"
+    else
+        echo -e "${RED}[FAIL] make VM_PROFILE=1 (Build Failed)${NC}"
+        cat "$TEMP_OUT"
+        ((FAILED++))
     fi
-done
+fi
 
 # Cleanup
 rm -f "$TEMP_OUT"
@@ -4,17 +4,25 @@
 #include <stdlib.h>
 #include <string.h>
 #include "luna_chunk.h"
+#include "luna_opcode.h"
+#include "luna_jit.h"
 
 void luna_chunk_init(LunaChunk *chunk) {
     chunk->code = NULL;
     chunk->code_len = 0;
     chunk->code_cap = 0;
-    chunk->line_map = NULL;
+    chunk->lines = NULL;
     chunk->line_len = 0;
     chunk->line_cap = 0;
     chunk->constants = NULL;
     chunk->const_len = 0;
     chunk->const_cap = 0;
+    chunk->global_caches = NULL;
+    chunk->global_cache_len = 0;
+    chunk->global_cache_cap = 0;
+    chunk->field_caches = NULL;
+    chunk->field_cache_len = 0;
+    chunk->field_cache_cap = 0;
     chunk->reg_count = 0;
     chunk->param_count = 0;
     chunk->upvalue_count = 0;
@@ -22,17 +30,20 @@ void luna_chunk_init(LunaChunk *chunk) {
     chunk->subchunks = NULL;
     chunk->subchunk_len = 0;
     chunk->subchunk_cap = 0;
+    chunk->jit_loops = NULL;
 }
 
 void luna_chunk_free(LunaChunk *chunk) {
     if (chunk->code) free(chunk->code);
-    if (chunk->line_map) free(chunk->line_map);
+    if (chunk->lines) free(chunk->lines);
     
     // Free constants
     for (size_t i = 0; i < chunk->const_len; i++) {
         value_free(chunk->constants[i]);
     }
     if (chunk->constants) free(chunk->constants);
+    if (chunk->global_caches) free(chunk->global_caches);
+    if (chunk->field_caches) free(chunk->field_caches);
 
     // Free subchunks
     for (int i = 0; i < chunk->subchunk_len; i++) {
@@ -40,32 +51,55 @@ void luna_chunk_free(LunaChunk *chunk) {
         free(chunk->subchunks[i]);
     }
     if (chunk->subchunks) free(chunk->subchunks);
+    luna_jit_chunk_free(chunk);
 
     luna_chunk_init(chunk);
 }
 
-void luna_chunk_write(LunaChunk *chunk, uint8_t byte, int line) {
+void luna_chunk_write(LunaChunk *chunk, LunaInsn word, int line) {
     if (chunk->code_len >= chunk->code_cap) {
-        chunk->code_cap = chunk->code_cap ? chunk->code_cap * 2 : 128;
-        chunk->code = realloc(chunk->code, chunk->code_cap * sizeof(uint8_t));
+        chunk->code_cap = chunk->code_cap ? chunk->code_cap * 2 : 64;
+        chunk->code = realloc(chunk->code, chunk->code_cap * sizeof(LunaInsn));
     }
-    chunk->code[chunk->code_len++] = byte;
+    luna_chunk_add_line(chunk, chunk->code_len, line);
+    chunk->code[chunk->code_len++] = word;
+}
 
+/* Records that code from offset on belongs to line. Offsets must be added in
+ * increasing order; a run only starts when the line changes. */
+void luna_chunk_add_line(LunaChunk *chunk, size_t offset, int line) {
+    if (chunk->line_len > 0 && chunk->lines[chunk->line_len - 1].line == line) return;
     if (chunk->line_len >= chunk->line_cap) {
-        chunk->line_cap = chunk->line_cap ? chunk->line_cap * 2 : 128;
-        chunk->line_map = realloc(chunk->line_map, chunk->line_cap * sizeof(int));
+        chunk->line_cap = chunk->line_cap ? chunk->line_cap * 2 : 16;
+        chunk->lines = realloc(chunk->lines, chunk->line_cap * sizeof(LunaLineRun));
+    }
+    chunk->lines[chunk->line_len].offset = (uint32_t)offset;
+    chunk->lines[chunk->line_len].line = line;
+    chunk->line_len++;
+}
+
+int luna_chunk_line_at(const LunaChunk *chunk, size_t offset) {
+    if (chunk->line_len == 0) return 0;
+    size_t lo = 0, hi = chunk->line_len;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (chunk->lines[mid].offset <= offset) lo = mid;
+        else hi = mid;
     }
-    chunk->line_map[chunk->line_len++] = line;
+    return chunk->lines[lo].line;
 }
 
 int luna_chunk_add_constant(LunaChunk *chunk, Value val) {
     // Check if duplicate constant exists to save space (mostly for strings/idents)
     for (size_t i = 0; i < chunk->const_len; i++) {
         Value existing = chunk->constants[i];
-        if (existing.type == val.type) {
-            if (existing.type == VAL_INT && existing.i == val.i) return (int)i;
-            if (existing.type == VAL_FLOAT && existing.f == val.f) return (int)i;
-            if (existing.type == VAL_STRING && strcmp(existing.string->chars, val.string->chars) == 0) {
+        if (VALUE_TYPE(existing) == VALUE_TYPE(val)) {
+            if (VALUE_TYPE(existing) == VAL_INT && VALUE_AS_INT(existing) == VALUE_AS_INT(val)) return (int)i;
+            if (VALUE_TYPE(existing) == VAL_FLOAT) {
+                double x = VALUE_AS_FLOAT(existing), y = VALUE_AS_FLOAT(val);
+                if (memcmp(&x, &y, sizeof(double)) == 0) return (int)i;
+            }
+            if (VALUE_TYPE(existing) == VAL_STRING && strcmp(VALUE_AS_STRING(existing)->chars, VALUE_AS_STRING(val)->chars) == 0) {
                 value_free(val); // free duplicate copy
                 return (int)i;
             }
@@ -88,3 +122,66 @@ int luna_chunk_add_subchunk(LunaChunk *chunk, LunaChunk *sub) {
     chunk->subchunks[chunk->subchunk_len] = sub;
     return chunk->subchunk_len++;
 }
+
+int luna_chunk_add_global_cache(LunaChunk *chunk, const char *interned_name) {
+    if (chunk->global_cache_len >= chunk->global_cache_cap) {
+        chunk->global_cache_cap = chunk->global_cache_cap ? chunk->global_cache_cap * 2 : 16;
+        chunk->global_caches = realloc(chunk->global_caches,
+                                       chunk->global_cache_cap * sizeof(LunaGlobalCache));
+    }
+    LunaGlobalCache *gc = &chunk->global_caches[chunk->global_cache_len];
+    gc->name = interned_name;
+    gc->env = NULL;
+    gc->epoch = 0;
+    gc->slot = NULL;
+    return (int)(chunk->global_cache_len++);
+}
+
+int luna_chunk_add_field_cache(LunaChunk *chunk, const char *interned_name) {
+    if (chunk->field_cache_len >= chunk->field_cache_cap) {
+        chunk->field_cache_cap = chunk->field_cache_cap ? chunk->field_cache_cap * 2 : 16;
+        chunk->field_caches = realloc(chunk->field_caches,
+                                      chunk->field_cache_cap * sizeof(LunaFieldCache));
+    }
+    LunaFieldCache *fc = &chunk->field_caches[chunk->field_cache_len];
+    memset(fc, 0, sizeof(*fc));
+    fc->name = interned_name;
+    fc->map_hint = -1;
+    return (int)(chunk->field_cache_len++);
+}
+
+int luna_chunk_op_length(const LunaChunk *chunk, size_t offset) {
+    const LunaInsn *ip = chunk->code + offset;
+    switch (LUNA_OP(ip[0])) {
+        case VM_OP_MAP_SET:
+        case VM_OP_FIELD_GET:
+        case VM_OP_FIELD_SET:
+        case VM_OP_CALL_NAMED:
+        case VM_OP_TAIL_CALL:
+        case VM_OP_JUMP_IF_NOT_LT:
+        case VM_OP_JUMP_IF_NOT_LTE:
+        case VM_OP_JUMP_IF_NOT_GT:
+        case VM_OP_JUMP_IF_NOT_GTE:
+        case VM_OP_LOOP_IF_LT:
+        case VM_OP_LOOP_IF_LTE:
+        case VM_OP_LOOP_IF_GT:
+        case VM_OP_LOOP_IF_GTE:
+        case VM_OP_FOR_ITER:
+            return 2;
+        case VM_OP_LOAD_INT64:
+        case VM_OP_LOAD_FLOAT64:
+        case VM_OP_CALL_NATIVE:
+            return 3;
+        case VM_OP_CLOSURE:
+            return 1 + chunk->subchunks[LUNA_BX(ip[0])]->upvalue_count;
+        case VM_OP_IMPORT:
+            return 2 + (int)LUNA_A(ip[0]);
+        case VM_OP_SWITCH_TABLE:
+            return 4 + (int)ip[1];
+        case VM_OP_SWITCH_HASH:
+            return 4 + 2 * (int)ip[1] + (int)LUNA_BX(ip[0]) + 1;
+        default:
+            /* Everything else fits in one word. */
+            return 1;
+    }
+}
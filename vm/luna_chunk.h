@@ -6,21 +6,117 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include "value.h"
+#include "luna_opcode.h"
+
+struct Env;
+struct LunaJitLoop;
+
+/* Code is an array of 32-bit instruction words. The low byte of the first
+ * word is the opcode; the rest holds up to three 8-bit operands A, B, C, or
+ * A and a 16-bit Bx (sBx when signed, e.g. a jump offset). Operands that do
+ * not fit (constant and cache indexes next to two registers, 32-bit branch
+ * offsets, capture lists, switch tables) follow in whole trailing words.
+ * Numbers too wide for sBx follow as two words (LOAD_INT64 / LOAD_FLOAT64).
+ * Offsets into code and jump distances count words. */
+typedef uint32_t LunaInsn;
+
+#define LUNA_OP(w)   ((Opcode)((w) & 0xFF))
+#define LUNA_A(w)    (((w) >> 8) & 0xFF)
+#define LUNA_B(w)    (((w) >> 16) & 0xFF)
+#define LUNA_C(w)    ((w) >> 24)
+#define LUNA_BX(w)   ((w) >> 16)
+#define LUNA_SBX(w)  ((int16_t)((w) >> 16))
+
+#define LUNA_ABC(op, a, b, c) ((LunaInsn)(op) | (LunaInsn)(uint8_t)(a) << 8 | \
+                               (LunaInsn)(uint8_t)(b) << 16 | (LunaInsn)(uint8_t)(c) << 24)
+#define LUNA_ABX(op, a, bx)   ((LunaInsn)(op) | (LunaInsn)(uint8_t)(a) << 8 | \
+                               (LunaInsn)(uint16_t)(bx) << 16)
+
+/* Replaces the opcode of an instruction word, keeping its operands. */
+static inline LunaInsn luna_insn_with_op(LunaInsn w, Opcode op) {
+    return (w & ~(LunaInsn)0xFF) | (LunaInsn)op;
+}
+
+/* Replaces the Bx operand of an instruction word. */
+static inline LunaInsn luna_insn_with_bx(LunaInsn w, uint16_t bx) {
+    return (w & 0xFFFF) | (LunaInsn)bx << 16;
+}
+
+/* The 64-bit immediate of LOAD_INT64 / LOAD_FLOAT64 from its two trailing words. */
+static inline uint64_t luna_insn_imm64(const LunaInsn *words) {
+    return (uint64_t)words[0] | (uint64_t)words[1] << 32;
+}
+
+/* Whether a float literal loads as a LOAD_FLOAT sBx immediate: integral,
+ * within int16 range and not -0.0. */
+static inline int luna_float_fits_sbx(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return v >= INT16_MIN && v <= INT16_MAX && v == (double)(int16_t)v &&
+           bits != 0x8000000000000000ULL;
+}
+
+/* Inline cache for one GET_GLOBAL / SET_GLOBAL instruction. The name is
+ * interned once at compile time; env/epoch/slot are filled on first execution
+ * and stay valid until a binding is added or removed (env_binding_epoch). */
+typedef struct {
+    const char *name;
+    struct Env *env;
+    uint64_t    epoch;
+    Value      *slot;
+} LunaGlobalCache;
+
+/* Polymorphic inline cache for one FIELD_GET / FIELD_SET instruction. Each way
+ * maps a field shape (value_field_shape) to the field's index in that shape;
+ * all ways are dropped when value_shape_epoch moves. Map targets have no
+ * shape and use map_hint, the entry index the key was last found at. */
+#define LUNA_FIELD_IC_WAYS 4
+
+typedef struct {
+    const void *shape;
+    int         index;
+} LunaFieldICEntry;
+
+typedef struct {
+    const char      *name;
+    uint64_t         epoch;
+    int              count;
+    int              map_hint;
+    LunaFieldICEntry ways[LUNA_FIELD_IC_WAYS];
+} LunaFieldCache;
+
+/* Run-length line table: runs[i] gives the source line for code offsets
+ * from runs[i].offset up to the next run. The VM never touches it while
+ * dispatching; it is only consulted when an error or the debugger needs a
+ * line (luna_chunk_line_at). */
+typedef struct {
+    uint32_t offset;
+    int32_t  line;
+} LunaLineRun;
 
 typedef struct LunaChunk {
-    uint8_t *code;
-    size_t   code_len;
+    LunaInsn *code;
+    size_t   code_len;       // in words
     size_t   code_cap;
 
-    int     *line_map;
-    size_t   line_len;
+    LunaLineRun *lines;
+    size_t   line_len;       // number of runs
     size_t   line_cap;
 
     Value   *constants;
     size_t   const_len;
     size_t   const_cap;
 
+    LunaGlobalCache *global_caches;
+    size_t   global_cache_len;
+    size_t   global_cache_cap;
+
+    LunaFieldCache *field_caches;
+    size_t   field_cache_len;
+    size_t   field_cache_cap;
+
     int      reg_count;      // max registers needed by this chunk's stack frame
     int      param_count;    // number of expected arguments
     int      upvalue_count;  // number of upvalues captured by this chunk
@@ -29,12 +125,54 @@ typedef struct LunaChunk {
     struct LunaChunk **subchunks;
     int      subchunk_len;
     int      subchunk_cap;
+
+    struct LunaJitLoop *jit_loops;  // loops seen / compiled by luna_jit.c
 } LunaChunk;
 
+/* SWITCH_TABLE and SWITCH_HASH carry one jump offset per case plus a default
+ * at word LUNA_SWITCH_DEFAULT_POS, all relative to the end of the
+ * instruction:
+ *   SWITCH_TABLE A=val B=kind, count, low, default, [offset]*count
+ *   SWITCH_HASH  A=val Bx=mask, count, seed, default,
+ *                [const_idx, offset]*count, [slot]*(mask + 1)
+ * A table slot k holds the offset for value low + k. A hash slot holds a
+ * case number + 1 (0 when empty); lookups start at the string's hash and
+ * probe forward. */
+#define LUNA_SWITCH_DEFAULT_POS 3
+#define LUNA_SWITCH_INT  0
+#define LUNA_SWITCH_CHAR 1
+
+static inline int luna_switch_case_count(const LunaInsn *ip) {
+    return (int)ip[1];
+}
+
+/* Word holding the jump offset of case k. */
+static inline int luna_switch_case_pos(const LunaInsn *ip, int k) {
+    return LUNA_OP(ip[0]) == VM_OP_SWITCH_TABLE ? 4 + k : 5 + 2 * k;
+}
+
+static inline uint32_t luna_switch_hash(const char *s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (; *s; s++) {
+        h ^= (uint8_t)*s;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
 void luna_chunk_init(LunaChunk *chunk);
 void luna_chunk_free(LunaChunk *chunk);
-void luna_chunk_write(LunaChunk *chunk, uint8_t byte, int line);
+void luna_chunk_write(LunaChunk *chunk, LunaInsn word, int line);
+void luna_chunk_add_line(LunaChunk *chunk, size_t offset, int line);
+int luna_chunk_line_at(const LunaChunk *chunk, size_t offset);
 int  luna_chunk_add_constant(LunaChunk *chunk, Value val);
 int  luna_chunk_add_subchunk(LunaChunk *chunk, LunaChunk *sub);
+int  luna_chunk_add_global_cache(LunaChunk *chunk, const char *interned_name);
+int  luna_chunk_add_field_cache(LunaChunk *chunk, const char *interned_name);
+
+/* Length in words of the instruction starting at `offset`, trailing operand
+ * words included. CLOSURE, IMPORT and the switches are variable length and
+ * are sized from their operands. */
+int  luna_chunk_op_length(const LunaChunk *chunk, size_t offset);
 
 #endif // LUNA_CHUNK_H
@@ -5,9 +5,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "luna_compiler.h"
 #include "luna_opcode.h"
+#include "luna_optimizer.h"
 #include "intern.h"
+#include "library.h"
 
 typedef struct {
     const char *name;
@@ -19,8 +22,19 @@ typedef struct {
 typedef struct {
     uint8_t index;
     int is_local;
+    int by_value; /* never reassigned: captured as a copy (VM_CAPTURE_VALUE) */
 } Upvalue;
 
+/* Names a function body rebinds (assignment, ++/--, address_of), nested
+ * function bodies included. A captured local that is not in its function's
+ * set keeps its value for the closure's whole life, so it is copied into the
+ * closure instead of shared through a VMUpvalue. */
+typedef struct {
+    const char **names;
+    int count;
+    int capacity;
+} NameSet;
+
 typedef struct Loop {
     int start_ip;
     int scope_depth;
@@ -28,6 +42,10 @@ typedef struct Loop {
     int break_count;
     int break_cap;
     int is_switch; /* pseudo-loop for switch: `break` ends switch, `continue` skips it */
+    int continue_forward; /* continue jumps ahead to the increment/test, patched later */
+    int *continue_jumps;
+    int continue_count;
+    int continue_cap;
     struct Loop *outer;
 } Loop;
 
@@ -43,6 +61,7 @@ typedef struct Compiler {
 
     Upvalue upvalues[256];
     int upvalue_count;
+    NameSet assigned;
 
     Loop *current_loop;
     int last_line;
@@ -59,6 +78,9 @@ static void compiler_init(Compiler *c, Compiler *parent, const char *name) {
     c->next_reg = 0;
     c->max_regs = 0;
     c->upvalue_count = 0;
+    c->assigned.names = NULL;
+    c->assigned.count = 0;
+    c->assigned.capacity = 0;
     c->current_loop = NULL;
     c->last_line = 1;
     c->stmt_count = 0;
@@ -74,71 +96,114 @@ static int allocate_reg(Compiler *c) {
     return reg;
 }
 
-static void emit_byte(Compiler *c, uint8_t byte, int line) {
-    luna_chunk_write(c->chunk, byte, line);
+static void emit_word(Compiler *c, LunaInsn word, int line) {
+    luna_chunk_write(c->chunk, word, line);
     c->last_line = line;
 }
 
 static void emit_opcode(Compiler *c, Opcode op, int line) {
-    emit_byte(c, (uint8_t)op, line);
+    emit_word(c, LUNA_ABC(op, 0, 0, 0), line);
+}
+
+/* GET_GLOBAL / SET_GLOBAL operand: index of an inline-cache entry holding the
+ * name interned once here, so the VM never hashes the string on the hot path.
+ * Every site naming the same global in a chunk shares one entry. */
+static int add_global_cache(Compiler *c, const char *name) {
+    const char *interned = intern_string(name);
+    for (size_t i = 0; i < c->chunk->global_cache_len; i++) {
+        if (c->chunk->global_caches[i].name == interned) return (int)i;
+    }
+    return luna_chunk_add_global_cache(c->chunk, interned);
 }
 
-static void emit_16(Compiler *c, uint16_t val, int line) {
-    emit_byte(c, (uint8_t)(val & 0xFF), line);
-    emit_byte(c, (uint8_t)((val >> 8) & 0xFF), line);
+/* Constant, global-cache and subchunk indices travel in 16-bit operands. */
+static uint16_t index_operand(int idx, const char *what) {
+    if (idx < 0 || idx > UINT16_MAX) {
+        fprintf(stderr, "Compile error: too many %s in one function (limit %d)\n", what, UINT16_MAX + 1);
+        abort();
+    }
+    return (uint16_t)idx;
 }
 
 static void emit_2(Compiler *c, Opcode op, uint8_t arg1, int line) {
-    emit_opcode(c, op, line);
-    emit_byte(c, arg1, line);
+    emit_word(c, LUNA_ABC(op, arg1, 0, 0), line);
 }
 
 static void emit_3(Compiler *c, Opcode op, uint8_t arg1, uint8_t arg2, int line) {
-    emit_opcode(c, op, line);
-    emit_byte(c, arg1, line);
-    emit_byte(c, arg2, line);
+    emit_word(c, LUNA_ABC(op, arg1, arg2, 0), line);
 }
 
 static void emit_4(Compiler *c, Opcode op, uint8_t arg1, uint8_t arg2, uint8_t arg3, int line) {
-    emit_opcode(c, op, line);
-    emit_byte(c, arg1, line);
-    emit_byte(c, arg2, line);
-    emit_byte(c, arg3, line);
+    emit_word(c, LUNA_ABC(op, arg1, arg2, arg3), line);
+}
+
+static void emit_abx(Compiler *c, Opcode op, uint8_t arg1, uint16_t bx, int line) {
+    emit_word(c, LUNA_ABX(op, arg1, bx), line);
+}
+
+/* Number literals that fit sBx load as immediates; the rest (and any float
+ * with a fraction, or -0.0) carry all 64 bits in two trailing words, which
+ * saves the constant-pool load on every execution. */
+static void emit_load_imm64(Compiler *c, Opcode op, uint8_t dst, uint64_t bits, int line) {
+    emit_2(c, op, dst, line);
+    emit_word(c, (LunaInsn)bits, line);
+    emit_word(c, (LunaInsn)(bits >> 32), line);
+}
+
+static void emit_load_int(Compiler *c, uint8_t dst, long long val, int line) {
+    if (val >= INT16_MIN && val <= INT16_MAX) {
+        emit_abx(c, VM_OP_LOAD_INT, dst, (uint16_t)(int16_t)val, line);
+    } else {
+        emit_load_imm64(c, VM_OP_LOAD_INT64, dst, (uint64_t)val, line);
+    }
+}
+
+static void emit_load_float(Compiler *c, uint8_t dst, double val, int line) {
+    if (luna_float_fits_sbx(val)) {
+        emit_abx(c, VM_OP_LOAD_FLOAT, dst, (uint16_t)(int16_t)val, line);
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &val, sizeof(bits));
+        emit_load_imm64(c, VM_OP_LOAD_FLOAT64, dst, bits, line);
+    }
+}
+
+/* Stores the offset of the jump instruction at jump_ip, counted from the end
+ * of that instruction. JUMP and JUMP_IF_* keep it in sBx; the fused
+ * compare-and-branch ops and FOR_ITER in their trailing word. */
+static void set_jump_offset(Compiler *c, int jump_ip, int offset) {
+    int len = luna_chunk_op_length(c->chunk, (size_t)jump_ip);
+    if (len > 1) {
+        c->chunk->code[jump_ip + len - 1] = (LunaInsn)(int32_t)offset;
+        return;
+    }
+    if (offset < -32768 || offset > 32767) {
+        fprintf(stderr, "Compile error: jump offset out of range\n");
+        abort();
+    }
+    c->chunk->code[jump_ip] = luna_insn_with_bx(c->chunk->code[jump_ip], (uint16_t)offset);
 }
 
 static int emit_jump(Compiler *c, Opcode op, int line) {
-    emit_opcode(c, op, line);
     int jump_ip = (int)c->chunk->code_len;
-    emit_16(c, 0xFFFF, line);
+    emit_opcode(c, op, line);
     return jump_ip;
 }
 
 static int emit_jump_cond(Compiler *c, Opcode op, uint8_t cond_reg, int line) {
-    emit_opcode(c, op, line);
-    emit_byte(c, cond_reg, line);
     int jump_ip = (int)c->chunk->code_len;
-    emit_16(c, 0xFFFF, line);
+    emit_2(c, op, cond_reg, line);
     return jump_ip;
 }
 
 static void patch_jump(Compiler *c, int jump_ip) {
-    int offset = (int)c->chunk->code_len - (jump_ip + 2);
-    if (offset < -32768 || offset > 32767) {
-        fprintf(stderr, "Compile error: jump offset out of range\n");
-        abort();
-    }
-    c->chunk->code[jump_ip] = (uint8_t)(offset & 0xFF);
-    c->chunk->code[jump_ip + 1] = (uint8_t)((offset >> 8) & 0xFF);
+    int len = luna_chunk_op_length(c->chunk, (size_t)jump_ip);
+    set_jump_offset(c, jump_ip, (int)c->chunk->code_len - (jump_ip + len));
 }
 
 static void emit_loop_jump(Compiler *c, int dest_ip, int line) {
-    emit_opcode(c, VM_OP_JUMP, line);
-    int offset = dest_ip - ((int)c->chunk->code_len + 2);
-    if (offset < -32768 || offset > 32767) {
-        fprintf(stderr, "Compile error: loop offset out of range\n");
-        abort();
-    }
-    emit_16(c, (uint16_t)offset, line);
+    int jump_ip = emit_jump(c, VM_OP_JUMP, line);
+    set_jump_offset(c, jump_ip, dest_ip - (int)c->chunk->code_len);
 }
 
 static int resolve_local(Compiler *c, const char *name) {
@@ -150,7 +215,148 @@ static int resolve_local(Compiler *c, const char *name) {
     return -1;
 }
 
-static int add_upvalue(Compiler *c, uint8_t index, int is_local) {
+static int nameset_has(const NameSet *set, const char *name) {
+    for (int i = 0; i < set->count; i++) {
+        if (set->names[i] == name) return 1;
+    }
+    return 0;
+}
+
+static void nameset_add(NameSet *set, const char *name) {
+    if (!name || nameset_has(set, name)) return;
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity < 8 ? 8 : set->capacity * 2;
+        set->names = realloc(set->names, sizeof(const char *) * (size_t)set->capacity);
+    }
+    set->names[set->count++] = name;
+}
+
+static void collect_assigned(NameSet *set, AstNode *n);
+
+static void collect_assigned_list(NameSet *set, const NodeList *list) {
+    for (int i = 0; i < list->count; i++) {
+        collect_assigned(set, list->items[i]);
+    }
+}
+
+static void collect_assigned(NameSet *set, AstNode *n) {
+    if (!n) return;
+    switch (n->kind) {
+        case NODE_ASSIGN:
+            nameset_add(set, n->assign.name);
+            collect_assigned(set, n->assign.expr);
+            break;
+        case NODE_INC:
+            nameset_add(set, n->inc.name);
+            break;
+        case NODE_DEC:
+            nameset_add(set, n->dec.name);
+            break;
+        case NODE_CALL:
+            if (n->call.kind == CALL_ADDRESS_OF && n->call.args.count == 1 &&
+                n->call.args.items[0] && n->call.args.items[0]->kind == NODE_IDENT) {
+                nameset_add(set, n->call.args.items[0]->ident.name);
+            }
+            collect_assigned(set, n->call.callee);
+            collect_assigned_list(set, &n->call.args);
+            break;
+        case NODE_TEMPLATE:
+            for (int i = 0; i < n->template_string.expr_count; i++) {
+                collect_assigned(set, n->template_string.exprs[i]);
+            }
+            break;
+        case NODE_LIST:
+            collect_assigned_list(set, &n->list.items);
+            break;
+        case NODE_MAP:
+            for (int i = 0; i < n->map.count; i++) {
+                collect_assigned(set, n->map.values[i]);
+            }
+            break;
+        case NODE_FIELD:
+            collect_assigned(set, n->field.target);
+            break;
+        case NODE_TYPED_INIT:
+            collect_assigned_list(set, &n->typed_init.args);
+            break;
+        case NODE_BOX_ALLOC:
+            collect_assigned(set, n->box_alloc.size);
+            break;
+        case NODE_BINOP:
+            collect_assigned(set, n->binop.left);
+            collect_assigned(set, n->binop.right);
+            break;
+        case NODE_LET:
+            collect_assigned(set, n->let.expr);
+            break;
+        case NODE_ASSIGN_INDEX:
+            collect_assigned(set, n->assign_index.list);
+            collect_assigned(set, n->assign_index.index);
+            collect_assigned(set, n->assign_index.value);
+            break;
+        case NODE_INDEX:
+            collect_assigned(set, n->index.target);
+            collect_assigned(set, n->index.index);
+            break;
+        case NODE_NOT:
+            collect_assigned(set, n->logic_not.expr);
+            break;
+        case NODE_PRINT:
+            collect_assigned_list(set, &n->print.args);
+            break;
+        case NODE_IF:
+            collect_assigned(set, n->ifstmt.cond);
+            collect_assigned_list(set, &n->ifstmt.then_block);
+            collect_assigned_list(set, &n->ifstmt.else_block);
+            break;
+        case NODE_WHILE:
+            collect_assigned(set, n->whilestmt.cond);
+            collect_assigned_list(set, &n->whilestmt.body);
+            break;
+        case NODE_FOR:
+            collect_assigned(set, n->forstmt.init);
+            collect_assigned(set, n->forstmt.cond);
+            collect_assigned(set, n->forstmt.incr);
+            collect_assigned_list(set, &n->forstmt.body);
+            break;
+        case NODE_FOR_IN:
+            collect_assigned(set, n->forin.iterable);
+            collect_assigned_list(set, &n->forin.body);
+            break;
+        case NODE_SWITCH:
+            collect_assigned(set, n->switchstmt.expr);
+            collect_assigned_list(set, &n->switchstmt.cases);
+            collect_assigned_list(set, &n->switchstmt.default_case);
+            break;
+        case NODE_CASE:
+            collect_assigned(set, n->casestmt.value);
+            collect_assigned_list(set, &n->casestmt.body);
+            break;
+        case NODE_BLOCK:
+        case NODE_GROUP:
+            collect_assigned_list(set, &n->block.items);
+            break;
+        case NODE_UNSAFE:
+            collect_assigned_list(set, &n->unsafe_block.body);
+            break;
+        case NODE_FUNC_DEF:
+            /* Nested bodies count too: they rebind captured names with SET_UPVAL. */
+            if (n->funcdef.defaults) {
+                for (int i = 0; i < n->funcdef.param_count; i++) {
+                    collect_assigned(set, n->funcdef.defaults[i]);
+                }
+            }
+            collect_assigned_list(set, &n->funcdef.body);
+            break;
+        case NODE_RETURN:
+            collect_assigned(set, n->ret.expr);
+            break;
+        default:
+            break;
+    }
+}
+
+static int add_upvalue(Compiler *c, uint8_t index, int is_local, int by_value) {
     for (int i = 0; i < c->upvalue_count; i++) {
         if (c->upvalues[i].index == index && c->upvalues[i].is_local == is_local) {
             return i;
@@ -158,6 +364,7 @@ static int add_upvalue(Compiler *c, uint8_t index, int is_local) {
     }
     c->upvalues[c->upvalue_count].index = index;
     c->upvalues[c->upvalue_count].is_local = is_local;
+    c->upvalues[c->upvalue_count].by_value = by_value;
     return c->upvalue_count++;
 }
 
@@ -167,12 +374,12 @@ static int resolve_upvalue(Compiler *c, const char *name) {
     int local = resolve_local(c->parent, name);
     if (local != -1) {
         c->parent->locals[local].is_upvalue = 1;
-        return add_upvalue(c, (uint8_t)local, 1);
+        return add_upvalue(c, (uint8_t)local, 1, !nameset_has(&c->parent->assigned, name));
     }
 
     int upvalue = resolve_upvalue(c->parent, name);
     if (upvalue != -1) {
-        return add_upvalue(c, (uint8_t)upvalue, 0);
+        return add_upvalue(c, (uint8_t)upvalue, 0, c->parent->upvalues[upvalue].by_value);
     }
 
     return -1;
@@ -217,12 +424,103 @@ static int compile_expr_to_any_reg(Compiler *c, AstNode *n) {
     return compile_expr(c, n, -1);
 }
 
+/* Compiles a loop/if condition and emits the jump taken when it is false.
+ * Relational conditions become a single JUMP_IF_NOT_<cmp> on the operand
+ * registers instead of a compare into a temp followed by JUMP_IF_FALSE. */
+static int compile_jump_if_false(Compiler *c, AstNode *cond, int line) {
+    if (cond->kind == NODE_BINOP) {
+        Opcode op = VM_OP_HALT;
+        switch (cond->binop.op) {
+            case OP_LT:  op = VM_OP_JUMP_IF_NOT_LT; break;
+            case OP_LTE: op = VM_OP_JUMP_IF_NOT_LTE; break;
+            case OP_GT:  op = VM_OP_JUMP_IF_NOT_GT; break;
+            case OP_GTE: op = VM_OP_JUMP_IF_NOT_GTE; break;
+            default: break;
+        }
+        if (op != VM_OP_HALT) {
+            int lhs = compile_expr_to_any_reg(c, cond->binop.left);
+            int rhs = compile_expr_to_any_reg(c, cond->binop.right);
+            int jump_ip = (int)c->chunk->code_len;
+            emit_3(c, op, lhs, rhs, line);
+            emit_word(c, 0, line);
+            return jump_ip;
+        }
+    }
+    int reg = compile_expr_to_any_reg(c, cond);
+    return emit_jump_cond(c, VM_OP_JUMP_IF_FALSE, reg, line);
+}
+
+/* LOOP_IF_<cmp> for a relational condition, or VM_OP_HALT if it is not one. */
+static Opcode loop_branch_op(AstNode *cond) {
+    if (!cond || cond->kind != NODE_BINOP) return VM_OP_HALT;
+    switch (cond->binop.op) {
+        case OP_LT:  return VM_OP_LOOP_IF_LT;
+        case OP_LTE: return VM_OP_LOOP_IF_LTE;
+        case OP_GT:  return VM_OP_LOOP_IF_GT;
+        case OP_GTE: return VM_OP_LOOP_IF_GTE;
+        default:     return VM_OP_HALT;
+    }
+}
+
+static void emit_loop_branch(Compiler *c, Opcode op, int lhs, int rhs, int dest_ip, int line) {
+    emit_3(c, op, lhs, rhs, line);
+    emit_word(c, (LunaInsn)(int32_t)(dest_ip - ((int)c->chunk->code_len + 1)), line);
+}
+
+static void loop_begin(Compiler *c, Loop *loop, int start_ip, int is_switch, int continue_forward) {
+    loop->start_ip = start_ip;
+    loop->scope_depth = c->scope_depth;
+    loop->break_jumps = NULL;
+    loop->break_count = 0;
+    loop->break_cap = 0;
+    loop->is_switch = is_switch;
+    loop->continue_forward = continue_forward;
+    loop->continue_jumps = NULL;
+    loop->continue_count = 0;
+    loop->continue_cap = 0;
+    loop->outer = c->current_loop;
+    c->current_loop = loop;
+}
+
+/* Lands every pending forward `continue` at the current position. */
+static void loop_patch_continues(Compiler *c, Loop *loop) {
+    for (int i = 0; i < loop->continue_count; i++) {
+        patch_jump(c, loop->continue_jumps[i]);
+    }
+    loop->continue_count = 0;
+}
+
+static void loop_end(Compiler *c, Loop *loop) {
+    for (int i = 0; i < loop->break_count; i++) {
+        patch_jump(c, loop->break_jumps[i]);
+    }
+    if (loop->break_jumps) free(loop->break_jumps);
+    if (loop->continue_jumps) free(loop->continue_jumps);
+    c->current_loop = loop->outer;
+}
+
+/* Index of the builtin a call can reach through VM_OP_CALL_NATIVE: a plain
+ * call to a name that is neither a local nor an upvalue, listed in
+ * luna_native_defs for this many arguments. -1 otherwise. */
+static int resolve_native(Compiler *c, AstNode *call) {
+    AstNode *callee = call->call.callee;
+    if (!callee || callee->kind != NODE_IDENT) return -1;
+    if (call->call.kind == CALL_APPEND || call->call.kind == CALL_ADDRESS_OF ||
+        call->call.kind == CALL_DEFER) {
+        return -1;
+    }
+    if (resolve_local(c, callee->ident.name) != -1) return -1;
+    if (resolve_upvalue(c, callee->ident.name) != -1) return -1;
+    return luna_native_lookup(callee->ident.name, call->call.args.count);
+}
+
 /* Compiles a function definition into a subchunk, emits VM_OP_CLOSURE with
  * upvalue capture data, and returns the register holding the closure. */
 static int compile_function_value(Compiler *c, AstNode *n, int line) {
     Compiler fn_compiler;
     compiler_init(&fn_compiler, c, n->funcdef.name);
     fn_compiler.chunk->param_count = n->funcdef.param_count;
+    collect_assigned(&fn_compiler.assigned, n);
 
     // Parameter variables are mapped to registers 0, 1, 2...
     for (int i = 0; i < n->funcdef.param_count; i++) {
@@ -233,8 +531,7 @@ static int compile_function_value(Compiler *c, AstNode *n, int line) {
     for (int i = 0; i < n->funcdef.param_count; i++) {
         if (!n->funcdef.defaults || !n->funcdef.defaults[i]) continue;
         int has = allocate_reg(&fn_compiler);
-        emit_2(&fn_compiler, VM_OP_HAS_ARG, has, line);
-        emit_byte(&fn_compiler, (uint8_t)i, line);
+        emit_3(&fn_compiler, VM_OP_HAS_ARG, has, (uint8_t)i, line);
         int skip = emit_jump_cond(&fn_compiler, VM_OP_JUMP_IF_TRUE, has, line);
         compile_expr(&fn_compiler, n->funcdef.defaults[i], i);
         patch_jump(&fn_compiler, skip);
@@ -261,18 +558,97 @@ static int compile_function_value(Compiler *c, AstNode *n, int line) {
 
     // Instantiate closure at runtime
     int dst = allocate_reg(c);
-    emit_2(c, VM_OP_CLOSURE, dst, line);
-    emit_16(c, sub_idx, line);
+    emit_abx(c, VM_OP_CLOSURE, dst, index_operand(sub_idx, "functions"), line);
 
     // Write upvalue data so VM knows how to capture them
     for (int i = 0; i < fn_compiler.upvalue_count; i++) {
-        emit_byte(c, fn_compiler.upvalues[i].is_local ? 1 : 0, line);
-        emit_byte(c, fn_compiler.upvalues[i].index, line);
+        uint8_t flags = 0;
+        if (fn_compiler.upvalues[i].is_local) flags |= VM_CAPTURE_LOCAL;
+        if (fn_compiler.upvalues[i].by_value) flags |= VM_CAPTURE_VALUE;
+        emit_word(c, (LunaInsn)flags | (LunaInsn)fn_compiler.upvalues[i].index << 8, line);
     }
+    free(fn_compiler.assigned.names);
 
     return dst;
 }
 
+/* String building. A template "a{x}b" and a `+` chain whose leftmost
+ * operand is a string ("a" + x + "b") both just join the string forms of
+ * their pieces, so they compile to one CONCAT_N over consecutive registers
+ * instead of an ADD (and a temporary string) per piece. Nested templates and
+ * chains are flattened into the same CONCAT_N. */
+#define CONCAT_GROUP 32
+
+typedef struct {
+    int first;  // register of piece 0
+    int count;
+} ConcatParts;
+
+static int is_string_concat(AstNode *n) {
+    while (n && n->kind == NODE_BINOP && n->binop.op == OP_ADD) n = n->binop.left;
+    return n && (n->kind == NODE_STRING || n->kind == NODE_TEMPLATE);
+}
+
+/* Next piece register; a full group is joined into its first register,
+ * which then becomes piece 0 of the next one. */
+static int concat_next_reg(Compiler *c, ConcatParts *parts, int line) {
+    if (parts->count == CONCAT_GROUP) {
+        emit_4(c, VM_OP_CONCAT_N, (uint8_t)parts->first, (uint8_t)parts->first,
+               (uint8_t)parts->count, line);
+        parts->count = 1;
+    }
+    c->next_reg = parts->first + parts->count;
+    parts->count++;
+    return allocate_reg(c);
+}
+
+static void concat_add(Compiler *c, ConcatParts *parts, AstNode *n) {
+    if (n->kind == NODE_STRING || n->kind == NODE_TEMPLATE) {
+        int pieces = n->kind == NODE_STRING ? 0 : n->template_string.expr_count;
+        for (int i = 0; i <= pieces; i++) {
+            const char *text = n->kind == NODE_STRING ? n->string.text : n->template_string.chunks[i];
+            if (text && text[0]) {
+                int idx = luna_chunk_add_constant(c->chunk, value_string(text));
+                emit_abx(c, VM_OP_LOAD_CONST, (uint8_t)concat_next_reg(c, parts, n->line),
+                         index_operand(idx, "constants"), n->line);
+            }
+            if (i < pieces) {
+                AstNode *expr = n->template_string.exprs[i];
+                if (is_string_concat(expr)) {
+                    concat_add(c, parts, expr);
+                } else {
+                    compile_expr(c, expr, concat_next_reg(c, parts, n->line));
+                }
+            }
+        }
+    } else if (n->kind == NODE_BINOP && n->binop.op == OP_ADD && is_string_concat(n)) {
+        concat_add(c, parts, n->binop.left);
+        if (is_string_concat(n->binop.right)) {
+            concat_add(c, parts, n->binop.right);
+        } else {
+            compile_expr(c, n->binop.right, concat_next_reg(c, parts, n->line));
+        }
+    } else {
+        compile_expr(c, n, concat_next_reg(c, parts, n->line));
+    }
+}
+
+static int compile_concat(Compiler *c, AstNode *n, int target_reg) {
+    int line = n->line;
+    int old_reg = c->next_reg;
+    int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
+    ConcatParts parts = { c->next_reg, 0 };
+    concat_add(c, &parts, n);
+    if (parts.count == 0) {
+        int idx = luna_chunk_add_constant(c->chunk, value_string(""));
+        emit_abx(c, VM_OP_LOAD_CONST, (uint8_t)dst, index_operand(idx, "constants"), line);
+    } else {
+        emit_4(c, VM_OP_CONCAT_N, (uint8_t)dst, (uint8_t)parts.first, (uint8_t)parts.count, line);
+    }
+    c->next_reg = (target_reg != -1) ? old_reg : dst + 1;
+    return dst;
+}
+
 static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
     if (!n) return -1;
     int line = n->line;
@@ -281,41 +657,26 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
     switch (n->kind) {
         case NODE_NUMBER: {
             int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
-            emit_opcode(c, VM_OP_LOAD_INT, line);
-            emit_byte(c, dst, line);
-            // Write 64-bit int value directly into bytecode
-            long long val = n->number.value;
-            for (int i = 0; i < 8; i++) {
-                emit_byte(c, (uint8_t)((val >> (i * 8)) & 0xFF), line);
-            }
+            emit_load_int(c, (uint8_t)dst, n->number.value, line);
             return dst;
         }
         case NODE_FLOAT: {
             int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
-            emit_opcode(c, VM_OP_LOAD_FLOAT, line);
-            emit_byte(c, dst, line);
-            double val = n->fnumber.value;
-            uint64_t bits;
-            memcpy(&bits, &val, sizeof(double));
-            for (int i = 0; i < 8; i++) {
-                emit_byte(c, (uint8_t)((bits >> (i * 8)) & 0xFF), line);
-            }
+            emit_load_float(c, (uint8_t)dst, n->fnumber.value, line);
             return dst;
         }
         case NODE_STRING: {
             int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
             Value v = value_string(n->string.text);
             int const_idx = luna_chunk_add_constant(c->chunk, v);
-            emit_2(c, VM_OP_LOAD_CONST, dst, line);
-            emit_16(c, const_idx, line);
+            emit_abx(c, VM_OP_LOAD_CONST, dst, index_operand(const_idx, "constants"), line);
             return dst;
         }
         case NODE_CHAR: {
             int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
             Value v = value_char(n->character.value);
             int const_idx = luna_chunk_add_constant(c->chunk, v);
-            emit_2(c, VM_OP_LOAD_CONST, dst, line);
-            emit_16(c, const_idx, line);
+            emit_abx(c, VM_OP_LOAD_CONST, dst, index_operand(const_idx, "constants"), line);
             return dst;
         }
         case NODE_BOOL: {
@@ -342,10 +703,8 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
             }
             // Global
             int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
-            Value name_val = value_string(n->ident.name);
-            int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-            emit_2(c, VM_OP_GET_GLOBAL, dst, line);
-            emit_16(c, name_idx, line);
+            int name_idx = add_global_cache(c, n->ident.name);
+            emit_abx(c, VM_OP_GET_GLOBAL, dst, index_operand(name_idx, "globals"), line);
             return dst;
         }
         case NODE_BINOP: {
@@ -364,6 +723,23 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
                 return dst;
             }
 
+            if (n->binop.op == OP_ADD && is_string_concat(n)) {
+                return compile_concat(c, n, target_reg);
+            }
+
+            /* x + <small int literal> -> ADDI, skipping the LOAD_INT. */
+            if (n->binop.op == OP_ADD && n->binop.right->kind == NODE_NUMBER &&
+                n->binop.right->number.value >= -128 && n->binop.right->number.value <= 127) {
+                int lhs = compile_expr_to_any_reg(c, n->binop.left);
+                c->next_reg = old_reg;
+                int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
+                emit_4(c, VM_OP_ADDI, dst, lhs, (uint8_t)(int8_t)n->binop.right->number.value, line);
+                if (target_reg == -1) {
+                    c->next_reg = dst + 1;
+                }
+                return dst;
+            }
+
             int lhs = compile_expr_to_any_reg(c, n->binop.left);
             int rhs = compile_expr_to_any_reg(c, n->binop.right);
             
@@ -406,12 +782,7 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
         case NODE_INC: {
             int reg = resolve_local(c, n->inc.name);
             if (reg != -1) {
-                int temp = allocate_reg(c);
-                emit_opcode(c, VM_OP_LOAD_INT, line);
-                emit_byte(c, temp, line);
-                long long one = 1;
-                for (int i = 0; i < 8; i++) emit_byte(c, (uint8_t)((one >> (i * 8)) & 0xFF), line);
-                emit_4(c, VM_OP_ADD, reg, reg, temp, line);
+                emit_3(c, VM_OP_INC_LOCAL, reg, 1, line);
                 c->next_reg = old_reg;
                 if (target_reg != -1) {
                     emit_3(c, VM_OP_MOVE, target_reg, reg, line);
@@ -421,21 +792,11 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
             }
             // Global
             int temp_val = allocate_reg(c);
-            Value name_val = value_string(n->inc.name);
-            int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-            emit_2(c, VM_OP_GET_GLOBAL, temp_val, line);
-            emit_16(c, name_idx, line);
-
-            int temp_one = allocate_reg(c);
-            emit_opcode(c, VM_OP_LOAD_INT, line);
-            emit_byte(c, temp_one, line);
-            long long one = 1;
-            for (int i = 0; i < 8; i++) emit_byte(c, (uint8_t)((one >> (i * 8)) & 0xFF), line);
-
-            emit_4(c, VM_OP_ADD, temp_val, temp_val, temp_one, line);
-            emit_opcode(c, VM_OP_SET_GLOBAL, line);
-            emit_16(c, name_idx, line);
-            emit_byte(c, temp_val, line);
+            uint16_t name_idx = index_operand(add_global_cache(c, n->inc.name), "globals");
+            emit_abx(c, VM_OP_GET_GLOBAL, temp_val, name_idx, line);
+
+            emit_3(c, VM_OP_INC_LOCAL, temp_val, 1, line);
+            emit_abx(c, VM_OP_SET_GLOBAL, temp_val, name_idx, line);
 
             c->next_reg = old_reg;
             if (target_reg != -1) {
@@ -449,12 +810,7 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
         case NODE_DEC: {
             int reg = resolve_local(c, n->dec.name);
             if (reg != -1) {
-                int temp = allocate_reg(c);
-                emit_opcode(c, VM_OP_LOAD_INT, line);
-                emit_byte(c, temp, line);
-                long long one = 1;
-                for (int i = 0; i < 8; i++) emit_byte(c, (uint8_t)((one >> (i * 8)) & 0xFF), line);
-                emit_4(c, VM_OP_SUB, reg, reg, temp, line);
+                emit_3(c, VM_OP_INC_LOCAL, reg, (uint8_t)-1, line);
                 c->next_reg = old_reg;
                 if (target_reg != -1) {
                     emit_3(c, VM_OP_MOVE, target_reg, reg, line);
@@ -464,21 +820,11 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
             }
             // Global
             int temp_val = allocate_reg(c);
-            Value name_val = value_string(n->dec.name);
-            int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-            emit_2(c, VM_OP_GET_GLOBAL, temp_val, line);
-            emit_16(c, name_idx, line);
-
-            int temp_one = allocate_reg(c);
-            emit_opcode(c, VM_OP_LOAD_INT, line);
-            emit_byte(c, temp_one, line);
-            long long one = 1;
-            for (int i = 0; i < 8; i++) emit_byte(c, (uint8_t)((one >> (i * 8)) & 0xFF), line);
-
-            emit_4(c, VM_OP_SUB, temp_val, temp_val, temp_one, line);
-            emit_opcode(c, VM_OP_SET_GLOBAL, line);
-            emit_16(c, name_idx, line);
-            emit_byte(c, temp_val, line);
+            uint16_t name_idx = index_operand(add_global_cache(c, n->dec.name), "globals");
+            emit_abx(c, VM_OP_GET_GLOBAL, temp_val, name_idx, line);
+
+            emit_3(c, VM_OP_INC_LOCAL, temp_val, (uint8_t)-1, line);
+            emit_abx(c, VM_OP_SET_GLOBAL, temp_val, name_idx, line);
 
             c->next_reg = old_reg;
             if (target_reg != -1) {
@@ -516,11 +862,8 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
             int target = compile_expr_to_any_reg(c, n->field.target);
             c->next_reg = old_reg;
             int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
-            Value name_val = value_string(n->field.field);
-            int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-            emit_2(c, VM_OP_FIELD_GET, dst, line);
-            emit_byte(c, target, line);
-            emit_16(c, name_idx, line);
+            emit_3(c, VM_OP_FIELD_GET, dst, target, line);
+            emit_word(c, (LunaInsn)luna_chunk_add_field_cache(c->chunk, intern_string(n->field.field)), line);
             if (target_reg == -1) {
                 c->next_reg = dst + 1;
             }
@@ -533,44 +876,19 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
                 int val = compile_expr_to_any_reg(c, n->map.values[i]);
                 Value key_val = value_string(n->map.keys[i]);
                 int key_idx = luna_chunk_add_constant(c->chunk, key_val);
-                emit_2(c, VM_OP_MAP_SET, dst, line);
-                emit_16(c, key_idx, line);
-                emit_byte(c, (uint8_t)val, line);
-                c->next_reg = old_reg + 1; /* keep dst alive */
-            }
-            c->next_reg = old_reg;
-            return dst;
-        }
-        case NODE_TEMPLATE: {
-            /* String interpolation compiled as a chain of string concats. */
-            int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
-            Value head = value_string(n->template_string.chunks[0] ?
-                                       n->template_string.chunks[0] : "");
-            int head_idx = luna_chunk_add_constant(c->chunk, head);
-            emit_2(c, VM_OP_LOAD_CONST, dst, line);
-            emit_16(c, head_idx, line);
-            for (int i = 0; i < n->template_string.expr_count; i++) {
-                int part = compile_expr_to_any_reg(c, n->template_string.exprs[i]);
-                emit_4(c, VM_OP_ADD, dst, dst, part, line);
-                const char *chunk = n->template_string.chunks[i + 1] ?
-                                    n->template_string.chunks[i + 1] : "";
-                Value cv = value_string(chunk);
-                int c_idx = luna_chunk_add_constant(c->chunk, cv);
-                int c_reg = allocate_reg(c);
-                emit_2(c, VM_OP_LOAD_CONST, c_reg, line);
-                emit_16(c, c_idx, line);
-                emit_4(c, VM_OP_ADD, dst, dst, c_reg, line);
+                emit_3(c, VM_OP_MAP_SET, dst, (uint8_t)val, line);
+                emit_word(c, (LunaInsn)key_idx, line);
                 c->next_reg = old_reg + 1; /* keep dst alive */
             }
             c->next_reg = old_reg;
             return dst;
         }
+        case NODE_TEMPLATE:
+            return compile_concat(c, n, target_reg);
         case NODE_TYPED_INIT: {
             int callee = allocate_reg(c);
-            Value name_val = value_string(n->typed_init.name);
-            int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-            emit_2(c, VM_OP_GET_GLOBAL, callee, line);
-            emit_16(c, name_idx, line);
+            int name_idx = add_global_cache(c, n->typed_init.name);
+            emit_abx(c, VM_OP_GET_GLOBAL, callee, index_operand(name_idx, "globals"), line);
             for (int i = 0; i < n->typed_init.args.count; i++) {
                 compile_expr(c, n->typed_init.args.items[i], allocate_reg(c));
             }
@@ -594,15 +912,12 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
         }
         case NODE_INPUT: {
             int callee = allocate_reg(c);
-            Value name_val = value_string("input");
-            int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-            emit_2(c, VM_OP_GET_GLOBAL, callee, line);
-            emit_16(c, name_idx, line);
+            int name_idx = add_global_cache(c, "input");
+            emit_abx(c, VM_OP_GET_GLOBAL, callee, index_operand(name_idx, "globals"), line);
             int arg = allocate_reg(c);
             Value prompt = value_string(n->input.prompt ? n->input.prompt : "");
             int prompt_idx = luna_chunk_add_constant(c->chunk, prompt);
-            emit_2(c, VM_OP_LOAD_CONST, arg, line);
-            emit_16(c, prompt_idx, line);
+            emit_abx(c, VM_OP_LOAD_CONST, arg, index_operand(prompt_idx, "constants"), line);
             c->next_reg = old_reg;
             int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
             emit_4(c, VM_OP_CALL, dst, callee, 1, line);
@@ -645,8 +960,7 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
                     } else {
                         Value name_val = value_string(arg->ident.name);
                         int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-                        emit_2(c, VM_OP_ADDR_OF_GLOBAL, dst, line);
-                        emit_16(c, name_idx, line);
+                        emit_abx(c, VM_OP_ADDR_OF_GLOBAL, dst, index_operand(name_idx, "constants"), line);
                     }
                     if (target_reg == -1) {
                         c->next_reg = dst + 1;
@@ -674,8 +988,13 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
                 return dst;
             }
 
+            // A builtin leaves its callee register empty: CALL_NATIVE only
+            // loads the global into it when the name has been rebound.
+            int native = resolve_native(c, n);
             int callee = allocate_reg(c);
-            compile_expr(c, n->call.callee, callee);
+            if (native < 0) {
+                compile_expr(c, n->call.callee, callee);
+            }
             
             // Allocate sequential registers for arguments starting right after callee
             for (int i = 0; i < n->call.args.count; i++) {
@@ -684,11 +1003,18 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
 
             c->next_reg = old_reg;
             int dst = (target_reg != -1) ? target_reg : allocate_reg(c);
-            if (n->call.callee && n->call.callee->kind == NODE_IDENT) {
+            if (native >= 0) {
+                Value name_val = value_string(n->call.callee->ident.name);
+                int name_idx = luna_chunk_add_constant(c->chunk, name_val);
+                uint16_t cache_idx = index_operand(add_global_cache(c, n->call.callee->ident.name), "globals");
+                emit_4(c, VM_OP_CALL_NATIVE, dst, callee, (uint8_t)n->call.args.count, line);
+                emit_word(c, (LunaInsn)(uint16_t)native | (LunaInsn)cache_idx << 16, line);
+                emit_word(c, (LunaInsn)name_idx, line);
+            } else if (n->call.callee && n->call.callee->kind == NODE_IDENT) {
                 Value name_val = value_string(n->call.callee->ident.name);
                 int name_idx = luna_chunk_add_constant(c->chunk, name_val);
                 emit_4(c, VM_OP_CALL_NAMED, dst, callee, (uint8_t)n->call.args.count, line);
-                emit_16(c, name_idx, line);
+                emit_word(c, (LunaInsn)name_idx, line);
             } else {
                 emit_4(c, VM_OP_CALL, dst, callee, (uint8_t)n->call.args.count, line);
             }
@@ -711,6 +1037,166 @@ static int compile_expr(Compiler *c, AstNode *n, int target_reg) {
     return -1;
 }
 
+/* A switch whose cases are all int, char or string literals dispatches with
+ * one SWITCH_TABLE / SWITCH_HASH once it has SWITCH_MIN_CASES cases; shorter
+ * or mixed switches keep the EQ + JUMP_IF_TRUE chain. Int and char tables
+ * must be dense: at most SWITCH_MAX_SPAN slots and 4 per case. */
+#define SWITCH_MIN_CASES 4
+#define SWITCH_MAX_SPAN  1024
+#define SWITCH_MAX_HASH  254
+#define SWITCH_HASH_SEEDS 64
+
+static long long switch_case_int(AstNode *value) {
+    return value->kind == NODE_CHAR ? (unsigned char)value->character.value : value->number.value;
+}
+
+/* Lays the keys out in an open-addressed table of mask + 1 slots and returns
+ * the longest probe sequence. */
+static int switch_hash_layout(const char **keys, int count, uint32_t seed, uint32_t mask, uint8_t *slots) {
+    memset(slots, 0, mask + 1);
+    int worst = 0;
+    for (int k = 0; k < count; k++) {
+        uint32_t h = luna_switch_hash(keys[k], seed) & mask;
+        int probes = 1;
+        while (slots[h]) {
+            h = (h + 1) & mask;
+            probes++;
+        }
+        slots[h] = (uint8_t)(k + 1);
+        if (probes > worst) worst = probes;
+    }
+    return worst;
+}
+
+/* Emits the dispatch instruction for switch `n` with every offset pointing
+ * at the default body, and returns its offset (-1 when the switch does not
+ * qualify). slot[i] receives the entry case i jumps through, or -1 when an
+ * earlier case has the same value and wins. */
+static int emit_switch_dispatch(Compiler *c, AstNode *n, int val_reg, int *slot, int line) {
+    int count = n->switchstmt.cases.count;
+    AstNode **cases = n->switchstmt.cases.items;
+    if (count < SWITCH_MIN_CASES || !cases[0]->casestmt.value) return -1;
+    NodeKind kind = cases[0]->casestmt.value->kind;
+    if (kind != NODE_NUMBER && kind != NODE_CHAR && kind != NODE_STRING) return -1;
+    for (int i = 0; i < count; i++) {
+        AstNode *value = cases[i]->casestmt.value;
+        if (!value || value->kind != kind) return -1;
+    }
+    int at = (int)c->chunk->code_len;
+
+    if (kind != NODE_STRING) {
+        long long low = switch_case_int(cases[0]->casestmt.value);
+        long long high = low;
+        for (int i = 1; i < count; i++) {
+            long long v = switch_case_int(cases[i]->casestmt.value);
+            if (v < low) low = v;
+            if (v > high) high = v;
+        }
+        if (low < INT32_MIN || high > INT32_MAX) return -1;
+        long long span = high - low + 1;
+        if (span > SWITCH_MAX_SPAN || span > 4LL * count) return -1;
+
+        emit_3(c, VM_OP_SWITCH_TABLE, (uint8_t)val_reg,
+               kind == NODE_CHAR ? LUNA_SWITCH_CHAR : LUNA_SWITCH_INT, line);
+        emit_word(c, (LunaInsn)span, line);
+        emit_word(c, (LunaInsn)(int32_t)low, line);
+        for (long long k = 0; k <= span; k++) {
+            emit_word(c, 0, line);
+        }
+        char *taken = calloc((size_t)span, 1);
+        for (int i = 0; i < count; i++) {
+            int k = (int)(switch_case_int(cases[i]->casestmt.value) - low);
+            slot[i] = taken[k] ? -1 : k;
+            taken[k] = 1;
+        }
+        free(taken);
+        return at;
+    }
+
+    if (count > SWITCH_MAX_HASH) return -1;
+    const char **keys = malloc(sizeof(const char *) * (size_t)count);
+    int key_count = 0;
+    for (int i = 0; i < count; i++) {
+        const char *text = cases[i]->casestmt.value->string.text;
+        slot[i] = key_count;
+        for (int k = 0; k < key_count; k++) {
+            if (strcmp(keys[k], text) == 0) {
+                slot[i] = -1;
+                break;
+            }
+        }
+        if (slot[i] >= 0) keys[key_count++] = text;
+    }
+
+    /* Try a few seeds and keep the layout with the shortest worst probe;
+     * with the table at most half full one of them is nearly always 1. */
+    uint32_t size = 8;
+    while (size < 2u * (uint32_t)key_count) size <<= 1;
+    uint8_t *slots = malloc(size);
+    uint8_t *best = malloc(size);
+    uint32_t best_seed = 0;
+    int best_cost = 0;
+    for (uint32_t i = 0; i < SWITCH_HASH_SEEDS && best_cost != 1; i++) {
+        uint32_t seed = i * 0x9E3779B9u;
+        int cost = switch_hash_layout(keys, key_count, seed, size - 1, slots);
+        if (best_cost == 0 || cost < best_cost) {
+            best_cost = cost;
+            best_seed = seed;
+            memcpy(best, slots, size);
+        }
+    }
+
+    emit_abx(c, VM_OP_SWITCH_HASH, (uint8_t)val_reg, index_operand((int)size - 1, "switch cases"), line);
+    emit_word(c, (LunaInsn)key_count, line);
+    emit_word(c, best_seed, line);
+    emit_word(c, 0, line);
+    for (int k = 0; k < key_count; k++) {
+        emit_word(c, (LunaInsn)luna_chunk_add_constant(c->chunk, value_string(keys[k])), line);
+        emit_word(c, 0, line);
+    }
+    for (uint32_t h = 0; h < size; h++) {
+        emit_word(c, best[h], line);
+    }
+    free(slots);
+    free(best);
+    free(keys);
+    return at;
+}
+
+/* Points entry k of the dispatch instruction at `at` to the current position. */
+static void patch_switch(Compiler *c, int at, int k) {
+    LunaInsn *insn = c->chunk->code + at;
+    int pos = luna_switch_case_pos(insn, k);
+    int offset = (int)c->chunk->code_len - (at + luna_chunk_op_length(c->chunk, (size_t)at));
+    insn[pos] = (LunaInsn)(int32_t)offset;
+}
+
+/* `return f(...)` inside a function becomes TAIL_CALL + RETURN: the VM
+ * reuses the current frame when it can, otherwise the call returns its
+ * result through the RETURN. Only plain named calls qualify. */
+static int compile_tail_call(Compiler *c, AstNode *call, int line) {
+    if (!c->parent || !call || call->kind != NODE_CALL) return 0;
+    if (!call->call.callee || call->call.callee->kind != NODE_IDENT) return 0;
+    if (call->call.kind == CALL_APPEND || call->call.kind == CALL_ADDRESS_OF ||
+        call->call.kind == CALL_DEFER) {
+        return 0;
+    }
+    // Builtins never reuse the frame; CALL_NATIVE + RETURN is cheaper.
+    if (resolve_native(c, call) >= 0) return 0;
+
+    int callee = allocate_reg(c);
+    compile_expr(c, call->call.callee, callee);
+    for (int i = 0; i < call->call.args.count; i++) {
+        compile_expr(c, call->call.args.items[i], allocate_reg(c));
+    }
+    Value name_val = value_string(call->call.callee->ident.name);
+    int name_idx = luna_chunk_add_constant(c->chunk, name_val);
+    emit_3(c, VM_OP_TAIL_CALL, callee, (uint8_t)call->call.args.count, line);
+    emit_word(c, (LunaInsn)name_idx, line);
+    emit_2(c, VM_OP_RETURN, callee, line);
+    return 1;
+}
+
 static void compile_stmt(Compiler *c, AstNode *n) {
     if (!n) return;
     int line = n->line;
@@ -736,11 +1222,8 @@ static void compile_stmt(Compiler *c, AstNode *n) {
              * visible to imports, the REPL, and auto-call main(). */
             if (c->parent == NULL && c->scope_depth == 0) {
                 int val_reg = compile_expr_to_any_reg(c, n->let.expr);
-                Value name_val = value_string(n->let.name);
-                int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-                emit_opcode(c, VM_OP_SET_GLOBAL, line);
-                emit_16(c, name_idx, line);
-                emit_byte(c, val_reg, line);
+                int name_idx = add_global_cache(c, n->let.name);
+                emit_abx(c, VM_OP_SET_GLOBAL, val_reg, index_operand(name_idx, "globals"), line);
                 c->next_reg = old_reg;
                 break;
             }
@@ -764,17 +1247,24 @@ static void compile_stmt(Compiler *c, AstNode *n) {
                     emit_3(c, VM_OP_SET_UPVAL, (uint8_t)upval, val_reg, line);
                 } else {
                     int val_reg = compile_expr_to_any_reg(c, n->assign.expr);
-                    Value name_val = value_string(n->assign.name);
-                    int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-                    emit_opcode(c, VM_OP_SET_GLOBAL, line);
-                    emit_16(c, name_idx, line);
-                    emit_byte(c, val_reg, line);
+                    int name_idx = add_global_cache(c, n->assign.name);
+                    emit_abx(c, VM_OP_SET_GLOBAL, val_reg, index_operand(name_idx, "globals"), line);
                 }
             }
             c->next_reg = old_reg;
             break;
         }
         case NODE_ASSIGN_INDEX: {
+            /* `obj.name = v` parses as an index store with a string literal key. */
+            if (n->assign_index.index->kind == NODE_STRING) {
+                int target = compile_expr_to_any_reg(c, n->assign_index.list);
+                int val = compile_expr_to_any_reg(c, n->assign_index.value);
+                const char *field = intern_string(n->assign_index.index->string.text);
+                emit_3(c, VM_OP_FIELD_SET, target, val, line);
+                emit_word(c, (LunaInsn)luna_chunk_add_field_cache(c->chunk, field), line);
+                c->next_reg = old_reg;
+                break;
+            }
             int list = compile_expr_to_any_reg(c, n->assign_index.list);
             int index = compile_expr_to_any_reg(c, n->assign_index.index);
             int val = compile_expr_to_any_reg(c, n->assign_index.value);
@@ -791,8 +1281,7 @@ static void compile_stmt(Compiler *c, AstNode *n) {
             break;
         }
         case NODE_IF: {
-            int cond = compile_expr_to_any_reg(c, n->ifstmt.cond);
-            int else_jump = emit_jump_cond(c, VM_OP_JUMP_IF_FALSE, cond, line);
+            int else_jump = compile_jump_if_false(c, n->ifstmt.cond, line);
             c->next_reg = old_reg;
 
             begin_scope(c, line);
@@ -814,22 +1303,20 @@ static void compile_stmt(Compiler *c, AstNode *n) {
             break;
         }
         case NODE_WHILE: {
+            /* Relational conditions are rotated: one entry test, then a single
+             * LOOP_IF_<cmp> at the bottom that branches back to the body and
+             * polls the safepoint. Other conditions keep the top-tested form. */
+            AstNode *cond = n->whilestmt.cond;
+            Opcode back_op = loop_branch_op(cond);
             int start_ip = (int)c->chunk->code_len;
-            emit_opcode(c, VM_OP_SAFEPOINT, line);
+            if (back_op == VM_OP_HALT) emit_opcode(c, VM_OP_SAFEPOINT, line);
 
-            int cond = compile_expr_to_any_reg(c, n->whilestmt.cond);
-            int exit_jump = emit_jump_cond(c, VM_OP_JUMP_IF_FALSE, cond, line);
+            int exit_jump = compile_jump_if_false(c, cond, line);
             c->next_reg = old_reg;
 
             Loop loop;
-            loop.start_ip = start_ip;
-            loop.scope_depth = c->scope_depth;
-            loop.break_jumps = NULL;
-            loop.break_count = 0;
-            loop.break_cap = 0;
-            loop.is_switch = 0;
-            loop.outer = c->current_loop;
-            c->current_loop = &loop;
+            loop_begin(c, &loop, start_ip, 0, back_op != VM_OP_HALT);
+            int body_ip = (int)c->chunk->code_len;
 
             begin_scope(c, line);
             for (int i = 0; i < n->whilestmt.body.count; i++) {
@@ -837,16 +1324,17 @@ static void compile_stmt(Compiler *c, AstNode *n) {
             }
             end_scope(c, line);
 
-            emit_loop_jump(c, start_ip, line);
-            patch_jump(c, exit_jump);
-
-            // Patch all break jumps
-            for (int i = 0; i < loop.break_count; i++) {
-                patch_jump(c, loop.break_jumps[i]);
+            if (back_op != VM_OP_HALT) {
+                loop_patch_continues(c, &loop);
+                int lhs = compile_expr_to_any_reg(c, cond->binop.left);
+                int rhs = compile_expr_to_any_reg(c, cond->binop.right);
+                emit_loop_branch(c, back_op, lhs, rhs, body_ip, line);
+                c->next_reg = old_reg;
+            } else {
+                emit_loop_jump(c, start_ip, line);
             }
-            if (loop.break_jumps) free(loop.break_jumps);
-
-            c->current_loop = loop.outer;
+            patch_jump(c, exit_jump);
+            loop_end(c, &loop);
             break;
         }
         case NODE_FOR: {
@@ -856,25 +1344,21 @@ static void compile_stmt(Compiler *c, AstNode *n) {
                 compile_stmt(c, n->forstmt.init);
             }
 
+            AstNode *cond = n->forstmt.cond;
+            Opcode back_op = loop_branch_op(cond);
             int start_ip = (int)c->chunk->code_len;
-            emit_opcode(c, VM_OP_SAFEPOINT, line);
+            if (back_op == VM_OP_HALT) emit_opcode(c, VM_OP_SAFEPOINT, line);
 
             int exit_jump = -1;
-            if (n->forstmt.cond) {
-                int cond = compile_expr_to_any_reg(c, n->forstmt.cond);
-                exit_jump = emit_jump_cond(c, VM_OP_JUMP_IF_FALSE, cond, line);
+            if (cond) {
+                exit_jump = compile_jump_if_false(c, cond, line);
                 c->next_reg = c->local_count; // preserve loop locals only
             }
 
+            /* `continue` always lands on the increment. */
             Loop loop;
-            loop.start_ip = start_ip;
-            loop.scope_depth = c->scope_depth;
-            loop.break_jumps = NULL;
-            loop.break_count = 0;
-            loop.break_cap = 0;
-            loop.is_switch = 0;
-            loop.outer = c->current_loop;
-            c->current_loop = &loop;
+            loop_begin(c, &loop, start_ip, 0, 1);
+            int body_ip = (int)c->chunk->code_len;
 
             // Body
             begin_scope(c, line);
@@ -884,24 +1368,25 @@ static void compile_stmt(Compiler *c, AstNode *n) {
             end_scope(c, line);
 
             // Increment
+            loop_patch_continues(c, &loop);
             if (n->forstmt.incr) {
                 compile_expr_to_any_reg(c, n->forstmt.incr);
                 c->next_reg = c->local_count;
             }
 
-            emit_loop_jump(c, start_ip, line);
+            if (back_op != VM_OP_HALT) {
+                int lhs = compile_expr_to_any_reg(c, cond->binop.left);
+                int rhs = compile_expr_to_any_reg(c, cond->binop.right);
+                emit_loop_branch(c, back_op, lhs, rhs, body_ip, line);
+                c->next_reg = c->local_count;
+            } else {
+                emit_loop_jump(c, start_ip, line);
+            }
             
             if (exit_jump != -1) {
                 patch_jump(c, exit_jump);
             }
-
-            // Patch breaks
-            for (int i = 0; i < loop.break_count; i++) {
-                patch_jump(c, loop.break_jumps[i]);
-            }
-            if (loop.break_jumps) free(loop.break_jumps);
-
-            c->current_loop = loop.outer;
+            loop_end(c, &loop);
             end_scope(c, line); // pops loop variable
             break;
         }
@@ -913,70 +1398,32 @@ static void compile_stmt(Compiler *c, AstNode *n) {
             int var_reg = c->locals[c->local_count - 1].reg;
             add_local(c, NULL, line); /* iter_reg */
             int iter_reg = c->locals[c->local_count - 1].reg;
-            add_local(c, NULL, line); /* count_reg */
-            int count_reg = c->locals[c->local_count - 1].reg;
-            add_local(c, NULL, line); /* i_reg */
-            int i_reg = c->locals[c->local_count - 1].reg;
+            add_local(c, NULL, line); /* state_reg */
+            int state_reg = c->locals[c->local_count - 1].reg;
 
             compile_expr(c, n->forin.iterable, iter_reg);
 
-            /* count = len(iterable) */
-            int callee = allocate_reg(c);
-            Value len_val = value_string("len");
-            int len_idx = luna_chunk_add_constant(c->chunk, len_val);
-            emit_2(c, VM_OP_GET_GLOBAL, callee, line);
-            emit_16(c, len_idx, line);
-            int arg_reg = allocate_reg(c);
-            emit_3(c, VM_OP_MOVE, arg_reg, iter_reg, line);
-            emit_4(c, VM_OP_CALL_NAMED, count_reg, callee, 1, line);
-            emit_16(c, len_idx, line);
-
-            emit_opcode(c, VM_OP_LOAD_INT, line);
-            emit_byte(c, i_reg, line);
-            long long zero = 0;
-            for (int b = 0; b < 8; b++) emit_byte(c, (uint8_t)((zero >> (b * 8)) & 0xFF), line);
-
-            Loop loop;
-            loop.start_ip = 0;
-            loop.scope_depth = c->scope_depth;
-            loop.break_jumps = NULL;
-            loop.break_count = 0;
-            loop.break_cap = 0;
-            loop.is_switch = 0;
-            loop.outer = c->current_loop;
-            c->current_loop = &loop;
-
-            int start_ip = (int)c->chunk->code_len;
-            loop.start_ip = start_ip;
-            emit_opcode(c, VM_OP_SAFEPOINT, line);
+            emit_load_int(c, (uint8_t)state_reg, 0, line);
 
-            int cmp = allocate_reg(c);
-            emit_4(c, VM_OP_LT, cmp, i_reg, count_reg, line);
-            int exit_jump = emit_jump_cond(c, VM_OP_JUMP_IF_FALSE, cmp, line);
+            /* Rotated: jump to FOR_ITER at the bottom, which fetches each item
+             * and branches back to the body until the iterable runs out. */
+            int entry_jump = emit_jump(c, VM_OP_JUMP, line);
 
-            emit_4(c, VM_OP_INDEX_GET, var_reg, iter_reg, i_reg, line);
+            Loop loop;
+            loop_begin(c, &loop, 0, 0, 1);
+            int body_ip = (int)c->chunk->code_len;
+            loop.start_ip = body_ip;
 
             for (int j = 0; j < n->forin.body.count; j++) {
                 compile_stmt(c, n->forin.body.items[j]);
             }
 
-            /* i = i + 1 */
-            int one_reg = allocate_reg(c);
-            emit_opcode(c, VM_OP_LOAD_INT, line);
-            emit_byte(c, one_reg, line);
-            long long one = 1;
-            for (int b = 0; b < 8; b++) emit_byte(c, (uint8_t)((one >> (b * 8)) & 0xFF), line);
-            emit_4(c, VM_OP_ADD, i_reg, i_reg, one_reg, line);
-
-            emit_loop_jump(c, start_ip, line);
-            patch_jump(c, exit_jump);
-
-            for (int j = 0; j < loop.break_count; j++) {
-                patch_jump(c, loop.break_jumps[j]);
-            }
-            if (loop.break_jumps) free(loop.break_jumps);
+            loop_patch_continues(c, &loop);
+            patch_jump(c, entry_jump);
+            emit_4(c, VM_OP_FOR_ITER, var_reg, iter_reg, state_reg, line);
+            emit_word(c, (LunaInsn)(int32_t)(body_ip - ((int)c->chunk->code_len + 1)), line);
 
-            c->current_loop = loop.outer;
+            loop_end(c, &loop);
             end_scope(c, line);
             break;
         }
@@ -987,19 +1434,14 @@ static void compile_stmt(Compiler *c, AstNode *n) {
 
             /* Register a pseudo-loop so `break` inside switch jumps to the end. */
             Loop sw;
-            sw.start_ip = 0;
-            sw.scope_depth = c->scope_depth;
-            sw.break_jumps = NULL;
-            sw.break_count = 0;
-            sw.break_cap = 0;
-            sw.is_switch = 1;
-            sw.outer = c->current_loop;
-            c->current_loop = &sw;
+            loop_begin(c, &sw, 0, 1, 0);
 
             int case_count = n->switchstmt.cases.count;
             int *case_jumps = case_count > 0 ? malloc(sizeof(int) * (size_t)case_count) : NULL;
+            int *case_slots = case_count > 0 ? malloc(sizeof(int) * (size_t)case_count) : NULL;
 
-            for (int i = 0; i < case_count; i++) {
+            int dispatch = emit_switch_dispatch(c, n, val_reg, case_slots, line);
+            for (int i = 0; dispatch < 0 && i < case_count; i++) {
                 AstNode *cn = n->switchstmt.cases.items[i];
                 c->next_reg = c->local_count + 1; /* keep val_reg alive */
                 int cval = compile_expr_to_any_reg(c, cn->casestmt.value);
@@ -1019,7 +1461,11 @@ static void compile_stmt(Compiler *c, AstNode *n) {
             int end_jump = emit_jump(c, VM_OP_JUMP, line);
 
             for (int i = 0; i < case_count; i++) {
-                patch_jump(c, case_jumps[i]);
+                if (dispatch < 0) {
+                    patch_jump(c, case_jumps[i]);
+                } else if (case_slots[i] >= 0) {
+                    patch_switch(c, dispatch, case_slots[i]);
+                }
                 AstNode *cn = n->switchstmt.cases.items[i];
                 begin_scope(c, line);
                 for (int j = 0; j < cn->casestmt.body.count; j++) {
@@ -1033,30 +1479,24 @@ static void compile_stmt(Compiler *c, AstNode *n) {
                     patch_jump(c, case_jumps[i]);
                 }
                 free(case_jumps);
+                free(case_slots);
             }
             patch_jump(c, end_jump);
 
-            for (int j = 0; j < sw.break_count; j++) {
-                patch_jump(c, sw.break_jumps[j]);
-            }
-            if (sw.break_jumps) free(sw.break_jumps);
-
-            c->current_loop = sw.outer;
+            loop_end(c, &sw);
             c->next_reg = c->local_count;
             break;
         }
         case NODE_IMPORT: {
             Value path_val = value_string(n->import_stmt.path);
             int path_idx = luna_chunk_add_constant(c->chunk, path_val);
-            emit_opcode(c, VM_OP_IMPORT, line);
-            emit_16(c, path_idx, line);
-            emit_byte(c, (uint8_t)n->import_stmt.name_count, line);
+            emit_3(c, VM_OP_IMPORT, (uint8_t)n->import_stmt.name_count,
+                   n->import_stmt.is_module_use ? 1 : 0, line);
+            emit_word(c, (LunaInsn)path_idx, line);
             for (int i = 0; i < n->import_stmt.name_count; i++) {
                 Value name_val = value_string(n->import_stmt.names[i]);
-                int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-                emit_16(c, name_idx, line);
+                emit_word(c, (LunaInsn)luna_chunk_add_constant(c->chunk, name_val), line);
             }
-            emit_byte(c, n->import_stmt.is_module_use ? 1 : 0, line);
             break;
         }
         case NODE_UNSAFE: {
@@ -1091,10 +1531,23 @@ static void compile_stmt(Compiler *c, AstNode *n) {
                 fprintf(stderr, "Compile error: continue statement outside loop\n");
                 abort();
             }
-            emit_loop_jump(c, target->start_ip, line);
+            if (target->continue_forward) {
+                int jump = emit_jump(c, VM_OP_JUMP, line);
+                if (target->continue_count >= target->continue_cap) {
+                    target->continue_cap = target->continue_cap ? target->continue_cap * 2 : 4;
+                    target->continue_jumps = realloc(target->continue_jumps, target->continue_cap * sizeof(int));
+                }
+                target->continue_jumps[target->continue_count++] = jump;
+            } else {
+                emit_loop_jump(c, target->start_ip, line);
+            }
             break;
         }
         case NODE_RETURN: {
+            if (compile_tail_call(c, n->ret.expr, line)) {
+                c->next_reg = old_reg;
+                break;
+            }
             int val_reg = compile_expr_to_any_reg(c, n->ret.expr);
             emit_2(c, VM_OP_RETURN, val_reg, line);
             c->next_reg = old_reg;
@@ -1106,11 +1559,8 @@ static void compile_stmt(Compiler *c, AstNode *n) {
             if (n->funcdef.name) {
                 if (c->parent == NULL && c->scope_depth == 0) {
                     /* Top-level function: define a global. */
-                    Value name_val = value_string(n->funcdef.name);
-                    int name_idx = luna_chunk_add_constant(c->chunk, name_val);
-                    emit_opcode(c, VM_OP_SET_GLOBAL, line);
-                    emit_16(c, name_idx, line);
-                    emit_byte(c, (uint8_t)dst, line);
+                    int name_idx = add_global_cache(c, n->funcdef.name);
+                    emit_abx(c, VM_OP_SET_GLOBAL, (uint8_t)dst, index_operand(name_idx, "globals"), line);
                 } else {
                     // Define function name in current scope
                     add_local(c, n->funcdef.name, line);
@@ -1142,7 +1592,8 @@ static void compile_stmt(Compiler *c, AstNode *n) {
 LunaChunk *luna_compile_program(AstNode *program_ast) {
     Compiler c;
     compiler_init(&c, NULL, "<main>");
-    
+    collect_assigned(&c.assigned, program_ast);
+
     if (program_ast->kind == NODE_BLOCK) {
         for (int i = 0; i < program_ast->block.items.count; i++) {
             compile_stmt(&c, program_ast->block.items.items[i]);
@@ -1155,8 +1606,10 @@ LunaChunk *luna_compile_program(AstNode *program_ast) {
     emit_opcode(&c, VM_OP_HALT, program_ast->line);
 
     c.chunk->reg_count = c.max_regs;
+    free(c.assigned.names);
+    luna_optimize_chunk(c.chunk, luna_optimizer_level());
     #ifdef LUNA_VM_DEBUG
-    printf("[COMPILER] Compiled chunk %s: %zu bytes of bytecode, %zu constants, %d registers\n",
+    printf("[COMPILER] Compiled chunk %s: %zu words of bytecode, %zu constants, %d registers\n",
            c.chunk->name, c.chunk->code_len, c.chunk->const_len, c.chunk->reg_count);
     #endif
     return c.chunk;
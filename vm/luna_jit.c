@@ -0,0 +1,904 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "luna_jit.h"
+#include "luna_opcode.h"
+#include "luna_vm.h"
+#include "gc.h"
+
+// The templates read and write the 16-byte tag + payload Value; NaN-boxed
+// builds (LUNA_NANBOX) interpret every loop.
+#if defined(__x86_64__) && defined(__linux__) && !defined(LUNA_NANBOX)
+#define LUNA_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#else
+#define LUNA_JIT_SUPPORTED 0
+#endif
+
+#define JIT_HOT_LOOP       64    // backward branches before a loop is compiled
+#define JIT_MAX_SIDE_EXITS 64    // failed guards before a loop is handed back for good
+#define JIT_MAX_LOOP_WORDS 1024  // larger loop bodies stay interpreted
+
+typedef uint32_t (*LunaJitFn)(Value *slots);
+
+typedef enum {
+    JIT_COUNTING,
+    JIT_COMPILED,
+    JIT_REJECTED
+} LunaJitState;
+
+/* Where native code hands control back: resume at offset with scopes
+ * SCOPE_BEGINs still to replay. side is set for failed type guards. */
+typedef struct {
+    uint32_t offset;
+    int      scopes;
+    int      side;
+} LunaJitExit;
+
+typedef struct LunaJitLoop {
+    uint32_t     head, end;
+    uint32_t     hits;
+    uint32_t     side_exits;
+    LunaJitState state;
+    LunaJitFn    fn;
+    void        *code;
+    size_t       code_size;
+    LunaJitExit *exits;
+    int          exit_count;
+    struct LunaJitLoop *next;
+} LunaJitLoop;
+
+static int jit_enabled = -1;
+
+int luna_jit_enabled(void) {
+    if (jit_enabled < 0) {
+        const char *raw = getenv("LUNA_JIT");
+        jit_enabled = LUNA_JIT_SUPPORTED && raw && strcmp(raw, "0") != 0;
+    }
+    return jit_enabled;
+}
+
+static void jit_loop_release(LunaJitLoop *loop) {
+#if LUNA_JIT_SUPPORTED
+    if (loop->code) munmap(loop->code, loop->code_size);
+#endif
+    free(loop->exits);
+    loop->code = NULL;
+    loop->code_size = 0;
+    loop->fn = NULL;
+    loop->exits = NULL;
+    loop->exit_count = 0;
+}
+
+void luna_jit_chunk_free(LunaChunk *chunk) {
+    LunaJitLoop *loop = chunk->jit_loops;
+    while (loop) {
+        LunaJitLoop *next = loop->next;
+        jit_loop_release(loop);
+        free(loop);
+        loop = next;
+    }
+    chunk->jit_loops = NULL;
+}
+
+#if LUNA_JIT_SUPPORTED
+
+/* ---- Decoding ----------------------------------------------------------- */
+
+typedef struct {
+    uint32_t off;
+    uint8_t  op;
+    uint16_t len;
+    uint8_t  a, b, c;     // A, B, C fields of the first word
+    int64_t  target;      // branch target offset, -1 for straight-line ops
+    uint64_t imm;         // LOAD_INT / LOAD_FLOAT bits, ADDI / INC_LOCAL step
+    int      depth;       // scopes opened since the loop head, -1 if unreached
+    int      leaves;      // no template: always hands the op to the interpreter
+} JitOp;
+
+static int jit_decode_op(LunaChunk *chunk, uint32_t off, JitOp *op) {
+    const LunaInsn *ip = chunk->code + off;
+    LunaInsn w = ip[0];
+    memset(op, 0, sizeof(*op));
+    op->off = off;
+    op->op = LUNA_OP(w);
+    op->a = LUNA_A(w);
+    op->b = LUNA_B(w);
+    op->c = LUNA_C(w);
+    op->len = 1;
+    op->target = -1;
+    op->depth = -1;
+    switch (op->op) {
+        case VM_OP_LOAD_INT:
+            op->imm = (uint64_t)(int64_t)LUNA_SBX(w);
+            return 1;
+        case VM_OP_LOAD_FLOAT: {
+            double f = LUNA_SBX(w);
+            memcpy(&op->imm, &f, sizeof(op->imm));
+            return 1;
+        }
+        case VM_OP_LOAD_INT64:
+        case VM_OP_LOAD_FLOAT64:
+            op->imm = luna_insn_imm64(ip + 1);
+            op->op = op->op == VM_OP_LOAD_INT64 ? VM_OP_LOAD_INT : VM_OP_LOAD_FLOAT;
+            op->len = 3;
+            return 1;
+        case VM_OP_LOAD_CONST: {
+            // Number constants only; anything else is a heap value or rare.
+            Value k = chunk->constants[LUNA_BX(w)];
+            if (VALUE_TYPE(k) != VAL_INT && VALUE_TYPE(k) != VAL_FLOAT) goto leave;
+            op->op = VALUE_TYPE(k) == VAL_INT ? VM_OP_LOAD_INT : VM_OP_LOAD_FLOAT;
+            memcpy(&op->imm, &k.i, sizeof(op->imm));
+            return 1;
+        }
+        case VM_OP_LOAD_TRUE:
+        case VM_OP_LOAD_FALSE:
+        case VM_OP_LOAD_NULL:
+        case VM_OP_MOVE:
+        case VM_OP_NOT:
+        case VM_OP_NEG:
+        case VM_OP_ADD: case VM_OP_SUB: case VM_OP_MUL: case VM_OP_DIV: case VM_OP_MOD:
+        case VM_OP_EQ: case VM_OP_NEQ: case VM_OP_LT: case VM_OP_LTE: case VM_OP_GT: case VM_OP_GTE:
+        case VM_OP_ADD_II: case VM_OP_ADD_FF: case VM_OP_SUB_II: case VM_OP_SUB_FF:
+        case VM_OP_MUL_II: case VM_OP_MUL_FF: case VM_OP_EQ_II: case VM_OP_NEQ_II:
+        case VM_OP_LT_II: case VM_OP_LT_FF: case VM_OP_LTE_II: case VM_OP_LTE_FF:
+        case VM_OP_GT_II: case VM_OP_GT_FF: case VM_OP_GTE_II: case VM_OP_GTE_FF:
+        case VM_OP_SAFEPOINT:
+        case VM_OP_SCOPE_BEGIN:
+        case VM_OP_SCOPE_EXIT:
+            return 1;
+        case VM_OP_JUMP:
+        case VM_OP_JUMP_IF_TRUE:
+        case VM_OP_JUMP_IF_FALSE:
+            op->target = (int64_t)off + 1 + LUNA_SBX(w);
+            return 1;
+        case VM_OP_JUMP_IF_NOT_LT: case VM_OP_JUMP_IF_NOT_LTE:
+        case VM_OP_JUMP_IF_NOT_GT: case VM_OP_JUMP_IF_NOT_GTE:
+        case VM_OP_LOOP_IF_LT: case VM_OP_LOOP_IF_LTE:
+        case VM_OP_LOOP_IF_GT: case VM_OP_LOOP_IF_GTE:
+            op->len = 2;
+            op->target = (int64_t)off + 2 + (int32_t)ip[1];
+            return 1;
+        case VM_OP_ADDI:
+            op->imm = (uint64_t)(int64_t)(int8_t)LUNA_C(w);
+            return 1;
+        case VM_OP_INC_LOCAL:
+            op->imm = (uint64_t)(int64_t)(int8_t)LUNA_B(w);
+            return 1;
+        default:
+            goto leave;
+    }
+
+leave:
+    // Calls, globals, collections...: fine on a cold path (a `break` that
+    // returns, say) but the loop is dropped if the hot path keeps leaving.
+    op->leaves = 1;
+    op->len = (uint16_t)luna_chunk_op_length(chunk, off);
+    return op->len > 0;
+}
+
+static int jit_find_op(const JitOp *ops, int count, int64_t off) {
+    int lo = 0, hi = count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (ops[mid].off == off) return mid;
+        if (ops[mid].off < off) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+/* SCOPE_BEGIN / SCOPE_EXIT compile to nothing: the loop body cannot defer or
+ * allocate boxes, so only the scope depth matters, and that is fixed per
+ * instruction. Computes it and rejects loops where two paths disagree (or
+ * that close a scope opened outside the loop). */
+static int jit_scope_depths(JitOp *ops, int count) {
+    int *work = malloc(sizeof(int) * (size_t)count);
+    if (!work) return 0;
+    int top = 0, ok = 1;
+    ops[0].depth = 0;
+    work[top++] = 0;
+    while (ok && top > 0) {
+        int i = work[--top];
+        int depth = ops[i].depth;
+        if (ops[i].op == VM_OP_SCOPE_BEGIN) depth++;
+        else if (ops[i].op == VM_OP_SCOPE_EXIT) depth--;
+        if (depth < 0) { ok = 0; break; }
+        int succ[2], n = 0;
+        if (ops[i].leaves) continue;
+        if (ops[i].op != VM_OP_JUMP && i + 1 < count) succ[n++] = i + 1;
+        if (ops[i].target >= 0) {
+            int t = jit_find_op(ops, count, ops[i].target);
+            if (t >= 0) succ[n++] = t;
+        }
+        for (int k = 0; k < n; k++) {
+            if (ops[succ[k]].depth < 0) {
+                ops[succ[k]].depth = depth;
+                work[top++] = succ[k];
+            } else if (ops[succ[k]].depth != depth) {
+                ok = 0;
+            }
+        }
+    }
+    free(work);
+    return ok;
+}
+
+/* ---- Assembler ---------------------------------------------------------- */
+
+typedef struct {
+    uint8_t *code;
+    size_t   len, cap;
+    int      failed;
+    long    *labels;        // bound code offset, -1 while unbound
+    int      label_count, label_cap;
+    struct { size_t at; int label; } *fixups;
+    int      fixup_count, fixup_cap;
+} JitAsm;
+
+enum {
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5,
+    CC_A = 0x7, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF,
+    CC_ALWAYS = -1
+};
+
+enum { RAX = 0, RCX = 1, RDX = 2, XMM0 = 0, XMM1 = 1 };
+
+#define TY(r) ((int32_t)((size_t)(r) * sizeof(Value) + offsetof(Value, type)))
+#define PL(r) ((int32_t)((size_t)(r) * sizeof(Value) + offsetof(Value, i)))
+
+_Static_assert(sizeof(Value) == 16, "MOVE copies a Value with one 16-byte load/store");
+_Static_assert(sizeof(ValueType) == 4, "type guards compare a 32-bit tag");
+_Static_assert(VAL_RANGE == VAL_STRING + 8, "heap types other than bloc are VAL_STRING and up");
+
+static void jit_bytes(JitAsm *as, const uint8_t *bytes, size_t n) {
+    if (as->len + n > as->cap) {
+        size_t cap = as->cap ? as->cap * 2 : 4096;
+        while (cap < as->len + n) cap *= 2;
+        uint8_t *grown = realloc(as->code, cap);
+        if (!grown) { as->failed = 1; return; }
+        as->code = grown;
+        as->cap = cap;
+    }
+    memcpy(as->code + as->len, bytes, n);
+    as->len += n;
+}
+
+#define EMIT(as, ...) \
+    jit_bytes((as), (const uint8_t[]){__VA_ARGS__}, sizeof((const uint8_t[]){__VA_ARGS__}))
+
+static void jit_u32(JitAsm *as, uint32_t v) {
+    uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+    jit_bytes(as, b, 4);
+}
+
+static void jit_u64(JitAsm *as, uint64_t v) {
+    jit_u32(as, (uint32_t)v);
+    jit_u32(as, (uint32_t)(v >> 32));
+}
+
+/* Instruction bytes followed by a [rbx + disp32] operand; rbx holds the
+ * frame's register base for the whole loop. */
+static void jit_mem(JitAsm *as, const uint8_t *op, size_t n, int reg, int32_t disp) {
+    jit_bytes(as, op, n);
+    EMIT(as, (uint8_t)(0x80 | (reg << 3) | 3));
+    jit_u32(as, (uint32_t)disp);
+}
+
+#define MEM(as, reg, disp, ...) \
+    jit_mem((as), (const uint8_t[]){__VA_ARGS__}, sizeof((const uint8_t[]){__VA_ARGS__}), (reg), (disp))
+
+static int jit_label(JitAsm *as) {
+    if (as->label_count == as->label_cap) {
+        int cap = as->label_cap ? as->label_cap * 2 : 64;
+        long *grown = realloc(as->labels, sizeof(long) * (size_t)cap);
+        if (!grown) { as->failed = 1; return 0; }
+        as->labels = grown;
+        as->label_cap = cap;
+    }
+    as->labels[as->label_count] = -1;
+    return as->label_count++;
+}
+
+static void jit_bind(JitAsm *as, int label) {
+    if (!as->failed) as->labels[label] = (long)as->len;
+}
+
+static void jit_rel32(JitAsm *as, int label) {
+    if (as->failed) return;
+    if (as->fixup_count == as->fixup_cap) {
+        int cap = as->fixup_cap ? as->fixup_cap * 2 : 64;
+        void *grown = realloc(as->fixups, sizeof(*as->fixups) * (size_t)cap);
+        if (!grown) { as->failed = 1; return; }
+        as->fixups = grown;
+        as->fixup_cap = cap;
+    }
+    as->fixups[as->fixup_count].at = as->len;
+    as->fixups[as->fixup_count].label = label;
+    as->fixup_count++;
+    jit_u32(as, 0);
+}
+
+static void jit_jump(JitAsm *as, int cc, int label) {
+    if (cc == CC_ALWAYS) EMIT(as, 0xE9);
+    else EMIT(as, 0x0F, (uint8_t)(0x80 | cc));
+    jit_rel32(as, label);
+}
+
+static int jit_resolve(JitAsm *as) {
+    if (as->failed) return 0;
+    for (int i = 0; i < as->fixup_count; i++) {
+        long target = as->labels[as->fixups[i].label];
+        if (target < 0) return 0;
+        int32_t rel = (int32_t)(target - (long)(as->fixups[i].at + 4));
+        memcpy(as->code + as->fixups[i].at, &rel, 4);
+    }
+    return 1;
+}
+
+/* ---- Templates ---------------------------------------------------------- */
+
+typedef struct {
+    JitAsm       as;
+    JitOp       *ops;
+    int          count;
+    LunaJitExit *exits;
+    int         *exit_labels;
+    int          exit_count, exit_cap;
+} JitCompiler;
+
+static int jit_exit(JitCompiler *jc, uint32_t offset, int scopes, int side) {
+    if (scopes < 0) scopes = 0;  // unreachable op
+    for (int i = 0; i < jc->exit_count; i++) {
+        LunaJitExit *e = &jc->exits[i];
+        if (e->offset == offset && e->scopes == scopes && e->side == side) return jc->exit_labels[i];
+    }
+    if (jc->exit_count == jc->exit_cap) {
+        int cap = jc->exit_cap ? jc->exit_cap * 2 : 16;
+        LunaJitExit *exits = realloc(jc->exits, sizeof(LunaJitExit) * (size_t)cap);
+        if (exits) jc->exits = exits;
+        int *labels = realloc(jc->exit_labels, sizeof(int) * (size_t)cap);
+        if (labels) jc->exit_labels = labels;
+        if (!exits || !labels) { jc->as.failed = 1; return 0; }
+        jc->exit_cap = cap;
+    }
+    jc->exits[jc->exit_count] = (LunaJitExit){offset, scopes, side};
+    jc->exit_labels[jc->exit_count] = jit_label(&jc->as);
+    return jc->exit_labels[jc->exit_count++];
+}
+
+/* Exit taken when op i meets operands its template does not handle: the
+ * interpreter re-executes op i from scratch, so guards precede all stores. */
+static int jit_side_exit(JitCompiler *jc, int i) {
+    return jit_exit(jc, jc->ops[i].off, jc->ops[i].depth, 1);
+}
+
+static void jit_cmp_type(JitAsm *as, int reg, ValueType type) {
+    MEM(as, 7, TY(reg), 0x83);
+    EMIT(as, (uint8_t)type);
+}
+
+static void jit_guard_type(JitAsm *as, int reg, ValueType type, int fail) {
+    jit_cmp_type(as, reg, type);
+    jit_jump(as, CC_NE, fail);
+}
+
+static void jit_set_type(JitAsm *as, int reg, ValueType type) {
+    MEM(as, 0, TY(reg), 0xC7);
+    jit_u32(as, (uint32_t)type);
+}
+
+/* Registers written natively must not hold a ref-counted value: the VM would
+ * value_free it first. Same test as VALUE_IS_HEAP. */
+static void jit_guard_scalar(JitAsm *as, int reg, int fail) {
+    MEM(as, RAX, TY(reg), 0x8B);            // mov eax, [type]
+    EMIT(as, 0x83, 0xF8, VAL_BLOC);         // cmp eax, VAL_BLOC
+    jit_jump(as, CC_E, fail);
+    EMIT(as, 0x83, 0xF8, VAL_STRING);       // cmp eax, VAL_STRING
+    jit_jump(as, CC_AE, fail);
+}
+
+/* xmm = value_to_double(reg) for an int or float register. */
+static void jit_load_double(JitAsm *as, int xmm, int reg, int fail) {
+    int is_int = jit_label(as), done = jit_label(as);
+    jit_cmp_type(as, reg, VAL_FLOAT);
+    jit_jump(as, CC_NE, is_int);
+    MEM(as, xmm, PL(reg), 0xF2, 0x0F, 0x10);          // movsd xmm, [reg]
+    jit_jump(as, CC_ALWAYS, done);
+    jit_bind(as, is_int);
+    jit_guard_type(as, reg, VAL_INT, fail);
+    MEM(as, xmm, PL(reg), 0xF2, 0x48, 0x0F, 0x2A);    // cvtsi2sd xmm, [reg]
+    jit_bind(as, done);
+}
+
+static void jit_store_bool_al(JitAsm *as, int reg) {
+    EMIT(as, 0x0F, 0xB6, 0xC0);             // movzx eax, al
+    MEM(as, RAX, PL(reg), 0x89);
+    jit_set_type(as, reg, VAL_BOOL);
+}
+
+/* Every 1024 back edges, like the interpreter; r12d counts down. */
+static void jit_poll(JitAsm *as) {
+    int skip = jit_label(as);
+    EMIT(as, 0x41, 0xFF, 0xCC);             // dec r12d
+    jit_jump(as, CC_NE, skip);
+    EMIT(as, 0x41, 0xBC);                   // mov r12d, 1024
+    jit_u32(as, 1024);
+    EMIT(as, 0x48, 0xB8);                   // mov rax, luna_gc_runtime_safe_point
+    jit_u64(as, (uint64_t)(uintptr_t)&luna_gc_runtime_safe_point);
+    EMIT(as, 0xFF, 0xD0);                   // call rax
+    jit_bind(as, skip);
+}
+
+/* Branch of op i on the current flags. Back edges to an op inside the loop
+ * stay native; anything else leaves. */
+static void jit_branch(JitCompiler *jc, int i, int cc, int64_t target) {
+    JitAsm *as = &jc->as;
+    int t = jit_find_op(jc->ops, jc->count, target);
+    if (t >= 0 && target <= jc->ops[i].off) {
+        int skip = -1;
+        if (cc != CC_ALWAYS) {
+            skip = jit_label(as);
+            jit_jump(as, cc ^ 1, skip);
+        }
+        jit_poll(as);
+        jit_jump(as, CC_ALWAYS, t);
+        if (skip >= 0) jit_bind(as, skip);
+        return;
+    }
+    int label = t >= 0 ? t : jit_exit(jc, (uint32_t)target, jc->ops[i].depth, 0);
+    jit_jump(as, cc, label);
+}
+
+enum { ARITH_ADD, ARITH_SUB, ARITH_MUL };
+
+/* dst = lhs op rhs as vm_add_values & co: int/int stays an int, any other
+ * mix of ints and floats is computed in double. */
+static void jit_arith(JitCompiler *jc, int i, int kind, int ints, int floats) {
+    JitAsm *as = &jc->as;
+    JitOp *op = &jc->ops[i];
+    int side = jit_side_exit(jc, i);
+    int fl = jit_label(as), done = jit_label(as);
+    jit_guard_scalar(as, op->a, side);
+    if (ints) {
+        jit_cmp_type(as, op->b, VAL_INT);
+        jit_jump(as, CC_NE, floats ? fl : side);
+        jit_cmp_type(as, op->c, VAL_INT);
+        jit_jump(as, CC_NE, floats ? fl : side);
+        MEM(as, RAX, PL(op->b), 0x48, 0x8B);
+        if (kind == ARITH_ADD) MEM(as, RAX, PL(op->c), 0x48, 0x03);
+        else if (kind == ARITH_SUB) MEM(as, RAX, PL(op->c), 0x48, 0x2B);
+        else MEM(as, RAX, PL(op->c), 0x48, 0x0F, 0xAF);
+        MEM(as, RAX, PL(op->a), 0x48, 0x89);
+        jit_set_type(as, op->a, VAL_INT);
+        if (floats) jit_jump(as, CC_ALWAYS, done);
+    }
+    jit_bind(as, fl);
+    if (floats) {
+        jit_load_double(as, XMM0, op->b, side);
+        jit_load_double(as, XMM1, op->c, side);
+        uint8_t sse = kind == ARITH_ADD ? 0x58 : kind == ARITH_SUB ? 0x5C : 0x59;
+        EMIT(as, 0xF2, 0x0F, sse, 0xC1);    // addsd/subsd/mulsd xmm0, xmm1
+        MEM(as, XMM0, PL(op->a), 0xF2, 0x0F, 0x11);
+        jit_set_type(as, op->a, VAL_FLOAT);
+    }
+    jit_bind(as, done);
+}
+
+/* Integer DIV stays an int when exact, else becomes a float; division by
+ * zero and int x / -1 (INT64_MIN traps) go back to the interpreter. */
+static void jit_div(JitCompiler *jc, int i) {
+    JitAsm *as = &jc->as;
+    JitOp *op = &jc->ops[i];
+    int side = jit_side_exit(jc, i);
+    int fl = jit_label(as), frac = jit_label(as), done = jit_label(as);
+    jit_guard_scalar(as, op->a, side);
+    jit_cmp_type(as, op->b, VAL_INT);
+    jit_jump(as, CC_NE, fl);
+    jit_cmp_type(as, op->c, VAL_INT);
+    jit_jump(as, CC_NE, fl);
+    MEM(as, RCX, PL(op->c), 0x48, 0x8B);
+    EMIT(as, 0x48, 0x85, 0xC9);             // test rcx, rcx
+    jit_jump(as, CC_E, side);
+    EMIT(as, 0x48, 0x83, 0xF9, 0xFF);       // cmp rcx, -1
+    jit_jump(as, CC_E, side);
+    MEM(as, RAX, PL(op->b), 0x48, 0x8B);
+    EMIT(as, 0x48, 0x99, 0x48, 0xF7, 0xF9); // cqo; idiv rcx
+    EMIT(as, 0x48, 0x85, 0xD2);             // test rdx, rdx
+    jit_jump(as, CC_NE, frac);
+    MEM(as, RAX, PL(op->a), 0x48, 0x89);
+    jit_set_type(as, op->a, VAL_INT);
+    jit_jump(as, CC_ALWAYS, done);
+    jit_bind(as, frac);
+    MEM(as, XMM0, PL(op->b), 0xF2, 0x48, 0x0F, 0x2A);  // cvtsi2sd xmm0, [lhs]
+    EMIT(as, 0xF2, 0x48, 0x0F, 0x2A, 0xC9);            // cvtsi2sd xmm1, rcx
+    EMIT(as, 0xF2, 0x0F, 0x5E, 0xC1);                  // divsd xmm0, xmm1
+    MEM(as, XMM0, PL(op->a), 0xF2, 0x0F, 0x11);
+    jit_set_type(as, op->a, VAL_FLOAT);
+    jit_jump(as, CC_ALWAYS, done);
+    jit_bind(as, fl);
+    jit_load_double(as, XMM1, op->c, side);
+    EMIT(as, 0x66, 0x0F, 0x57, 0xD2);       // xorpd xmm2, xmm2
+    EMIT(as, 0x66, 0x0F, 0x2E, 0xCA);       // ucomisd xmm1, xmm2 (zero or NaN: exit)
+    jit_jump(as, CC_E, side);
+    jit_load_double(as, XMM0, op->b, side);
+    EMIT(as, 0xF2, 0x0F, 0x5E, 0xC1);       // divsd xmm0, xmm1
+    MEM(as, XMM0, PL(op->a), 0xF2, 0x0F, 0x11);
+    jit_set_type(as, op->a, VAL_FLOAT);
+    jit_bind(as, done);
+}
+
+static void jit_mod(JitCompiler *jc, int i) {
+    JitAsm *as = &jc->as;
+    JitOp *op = &jc->ops[i];
+    int side = jit_side_exit(jc, i);
+    jit_guard_scalar(as, op->a, side);
+    jit_guard_type(as, op->b, VAL_INT, side);
+    jit_guard_type(as, op->c, VAL_INT, side);
+    MEM(as, RCX, PL(op->c), 0x48, 0x8B);
+    EMIT(as, 0x48, 0x85, 0xC9);             // test rcx, rcx
+    jit_jump(as, CC_E, side);
+    EMIT(as, 0x48, 0x83, 0xF9, 0xFF);       // cmp rcx, -1
+    jit_jump(as, CC_E, side);
+    MEM(as, RAX, PL(op->b), 0x48, 0x8B);
+    EMIT(as, 0x48, 0x99, 0x48, 0xF7, 0xF9); // cqo; idiv rcx
+    MEM(as, RDX, PL(op->a), 0x48, 0x89);
+    jit_set_type(as, op->a, VAL_INT);
+}
+
+enum { CMP_LT, CMP_LTE, CMP_GT, CMP_GTE, CMP_EQ, CMP_NEQ };
+
+/* al = lhs cmp rhs; mixed int/float operands compare as doubles. Doubles
+ * use ucomisd with the operands ordered so that NaN compares false. */
+static void jit_compare(JitCompiler *jc, int i, int cmp, int l, int r, int ints, int floats) {
+    static const uint8_t int_cc[] = {CC_L, CC_LE, CC_G, CC_GE, CC_E, CC_NE};
+    JitAsm *as = &jc->as;
+    int side = jit_side_exit(jc, i);
+    int fl = jit_label(as), done = jit_label(as);
+    if (ints) {
+        jit_cmp_type(as, l, VAL_INT);
+        jit_jump(as, CC_NE, floats ? fl : side);
+        jit_cmp_type(as, r, VAL_INT);
+        jit_jump(as, CC_NE, floats ? fl : side);
+        MEM(as, RAX, PL(l), 0x48, 0x8B);
+        MEM(as, RAX, PL(r), 0x48, 0x3B);    // cmp rax, [rhs]
+        EMIT(as, 0x0F, (uint8_t)(0x90 | int_cc[cmp]), 0xC0);
+        if (floats) jit_jump(as, CC_ALWAYS, done);
+    }
+    jit_bind(as, fl);
+    if (floats) {
+        jit_load_double(as, XMM0, l, side);
+        jit_load_double(as, XMM1, r, side);
+        if (cmp == CMP_LT || cmp == CMP_LTE) EMIT(as, 0x66, 0x0F, 0x2E, 0xC8);  // ucomisd xmm1, xmm0
+        else EMIT(as, 0x66, 0x0F, 0x2E, 0xC1);                                  // ucomisd xmm0, xmm1
+        uint8_t cc = (cmp == CMP_LT || cmp == CMP_GT) ? CC_A : CC_AE;
+        EMIT(as, 0x0F, (uint8_t)(0x90 | cc), 0xC0);
+    }
+    jit_bind(as, done);
+}
+
+/* Sets ZF from the truthiness of a bool or int register. */
+static void jit_test_truthy(JitCompiler *jc, int i, int reg) {
+    JitAsm *as = &jc->as;
+    int side = jit_side_exit(jc, i);
+    int is_int = jit_label(as), done = jit_label(as);
+    jit_cmp_type(as, reg, VAL_BOOL);
+    jit_jump(as, CC_NE, is_int);
+    MEM(as, 7, PL(reg), 0x83);              // cmp dword [payload], 0
+    EMIT(as, 0x00);
+    jit_jump(as, CC_ALWAYS, done);
+    jit_bind(as, is_int);
+    jit_guard_type(as, reg, VAL_INT, side);
+    MEM(as, 7, PL(reg), 0x48, 0x83);        // cmp qword [payload], 0
+    EMIT(as, 0x00);
+    jit_bind(as, done);
+}
+
+static void jit_int_or_float_step(JitCompiler *jc, int i, int dst, int src) {
+    JitAsm *as = &jc->as;
+    JitOp *op = &jc->ops[i];
+    int side = jit_side_exit(jc, i);
+    int fl = jit_label(as), done = jit_label(as);
+    int32_t step = (int32_t)(int64_t)op->imm;
+    if (dst != src) jit_guard_scalar(as, dst, side);
+    jit_cmp_type(as, src, VAL_INT);
+    jit_jump(as, CC_NE, fl);
+    if (dst == src) {
+        MEM(as, 0, PL(dst), 0x48, 0x83);    // add qword [dst], imm8
+        EMIT(as, (uint8_t)(int8_t)step);
+    } else {
+        MEM(as, RAX, PL(src), 0x48, 0x8B);
+        EMIT(as, 0x48, 0x05);               // add rax, imm32
+        jit_u32(as, (uint32_t)step);
+        MEM(as, RAX, PL(dst), 0x48, 0x89);
+        jit_set_type(as, dst, VAL_INT);
+    }
+    jit_jump(as, CC_ALWAYS, done);
+    jit_bind(as, fl);
+    jit_guard_type(as, src, VAL_FLOAT, side);
+    MEM(as, XMM0, PL(src), 0xF2, 0x0F, 0x10);
+    EMIT(as, 0x48, 0xC7, 0xC0);             // mov rax, imm32
+    jit_u32(as, (uint32_t)step);
+    EMIT(as, 0xF2, 0x48, 0x0F, 0x2A, 0xC8); // cvtsi2sd xmm1, rax
+    EMIT(as, 0xF2, 0x0F, 0x58, 0xC1);       // addsd xmm0, xmm1
+    MEM(as, XMM0, PL(dst), 0xF2, 0x0F, 0x11);
+    if (dst != src) jit_set_type(as, dst, VAL_FLOAT);
+    jit_bind(as, done);
+}
+
+static int jit_emit_op(JitCompiler *jc, int i) {
+    JitAsm *as = &jc->as;
+    JitOp *op = &jc->ops[i];
+    if (op->leaves) {
+        jit_jump(as, CC_ALWAYS, jit_side_exit(jc, i));
+        return 1;
+    }
+    switch (op->op) {
+        case VM_OP_LOAD_INT:
+        case VM_OP_LOAD_FLOAT:
+            jit_guard_scalar(as, op->a, jit_side_exit(jc, i));
+            EMIT(as, 0x48, 0xB8);           // mov rax, imm64
+            jit_u64(as, op->imm);
+            MEM(as, RAX, PL(op->a), 0x48, 0x89);
+            jit_set_type(as, op->a, op->op == VM_OP_LOAD_INT ? VAL_INT : VAL_FLOAT);
+            return 1;
+        case VM_OP_LOAD_TRUE:
+        case VM_OP_LOAD_FALSE:
+            jit_guard_scalar(as, op->a, jit_side_exit(jc, i));
+            MEM(as, 0, PL(op->a), 0xC7);
+            jit_u32(as, op->op == VM_OP_LOAD_TRUE ? 1 : 0);
+            jit_set_type(as, op->a, VAL_BOOL);
+            return 1;
+        case VM_OP_LOAD_NULL:
+            jit_guard_scalar(as, op->a, jit_side_exit(jc, i));
+            jit_set_type(as, op->a, VAL_NULL);
+            return 1;
+        case VM_OP_MOVE: {
+            int side = jit_side_exit(jc, i);
+            jit_guard_scalar(as, op->a, side);
+            jit_guard_scalar(as, op->b, side);
+            if (op->a != op->b) {
+                MEM(as, XMM0, TY(op->b), 0xF3, 0x0F, 0x6F);  // movdqu xmm0, [src]
+                MEM(as, XMM0, TY(op->a), 0xF3, 0x0F, 0x7F);  // movdqu [dst], xmm0
+            }
+            return 1;
+        }
+        case VM_OP_ADD: jit_arith(jc, i, ARITH_ADD, 1, 1); return 1;
+        case VM_OP_SUB: jit_arith(jc, i, ARITH_SUB, 1, 1); return 1;
+        case VM_OP_MUL: jit_arith(jc, i, ARITH_MUL, 1, 1); return 1;
+        case VM_OP_ADD_II: jit_arith(jc, i, ARITH_ADD, 1, 0); return 1;
+        case VM_OP_SUB_II: jit_arith(jc, i, ARITH_SUB, 1, 0); return 1;
+        case VM_OP_MUL_II: jit_arith(jc, i, ARITH_MUL, 1, 0); return 1;
+        case VM_OP_ADD_FF: jit_arith(jc, i, ARITH_ADD, 0, 1); return 1;
+        case VM_OP_SUB_FF: jit_arith(jc, i, ARITH_SUB, 0, 1); return 1;
+        case VM_OP_MUL_FF: jit_arith(jc, i, ARITH_MUL, 0, 1); return 1;
+        case VM_OP_DIV: jit_div(jc, i); return 1;
+        case VM_OP_MOD: jit_mod(jc, i); return 1;
+        case VM_OP_EQ: case VM_OP_NEQ: case VM_OP_EQ_II: case VM_OP_NEQ_II:
+        case VM_OP_LT: case VM_OP_LTE: case VM_OP_GT: case VM_OP_GTE:
+        case VM_OP_LT_II: case VM_OP_LTE_II: case VM_OP_GT_II: case VM_OP_GTE_II:
+        case VM_OP_LT_FF: case VM_OP_LTE_FF: case VM_OP_GT_FF: case VM_OP_GTE_FF: {
+            int cmp, ints = 1, floats = 1;
+            switch (op->op) {
+                case VM_OP_EQ: case VM_OP_EQ_II: cmp = CMP_EQ; floats = 0; break;
+                case VM_OP_NEQ: case VM_OP_NEQ_II: cmp = CMP_NEQ; floats = 0; break;
+                case VM_OP_LT: cmp = CMP_LT; break;
+                case VM_OP_LTE: cmp = CMP_LTE; break;
+                case VM_OP_GT: cmp = CMP_GT; break;
+                case VM_OP_GTE: cmp = CMP_GTE; break;
+                case VM_OP_LT_II: cmp = CMP_LT; floats = 0; break;
+                case VM_OP_LTE_II: cmp = CMP_LTE; floats = 0; break;
+                case VM_OP_GT_II: cmp = CMP_GT; floats = 0; break;
+                case VM_OP_GTE_II: cmp = CMP_GTE; floats = 0; break;
+                case VM_OP_LT_FF: cmp = CMP_LT; ints = 0; break;
+                case VM_OP_LTE_FF: cmp = CMP_LTE; ints = 0; break;
+                case VM_OP_GT_FF: cmp = CMP_GT; ints = 0; break;
+                default: cmp = CMP_GTE; ints = 0; break;
+            }
+            jit_guard_scalar(as, op->a, jit_side_exit(jc, i));
+            jit_compare(jc, i, cmp, op->b, op->c, ints, floats);
+            jit_store_bool_al(as, op->a);
+            return 1;
+        }
+        case VM_OP_NOT:
+            jit_guard_scalar(as, op->a, jit_side_exit(jc, i));
+            jit_test_truthy(jc, i, op->b);
+            EMIT(as, 0x0F, 0x94, 0xC0);     // sete al
+            jit_store_bool_al(as, op->a);
+            return 1;
+        case VM_OP_NEG: {
+            int side = jit_side_exit(jc, i);
+            int fl = jit_label(as), done = jit_label(as);
+            jit_guard_scalar(as, op->a, side);
+            jit_cmp_type(as, op->b, VAL_INT);
+            jit_jump(as, CC_NE, fl);
+            MEM(as, RAX, PL(op->b), 0x48, 0x8B);
+            EMIT(as, 0x48, 0xF7, 0xD8);     // neg rax
+            MEM(as, RAX, PL(op->a), 0x48, 0x89);
+            jit_set_type(as, op->a, VAL_INT);
+            jit_jump(as, CC_ALWAYS, done);
+            jit_bind(as, fl);
+            jit_guard_type(as, op->b, VAL_FLOAT, side);
+            MEM(as, RAX, PL(op->b), 0x48, 0x8B);
+            EMIT(as, 0x48, 0x0F, 0xBA, 0xF8, 0x3F);  // btc rax, 63
+            MEM(as, RAX, PL(op->a), 0x48, 0x89);
+            jit_set_type(as, op->a, VAL_FLOAT);
+            jit_bind(as, done);
+            return 1;
+        }
+        case VM_OP_JUMP:
+            jit_branch(jc, i, CC_ALWAYS, op->target);
+            return 1;
+        case VM_OP_JUMP_IF_TRUE:
+        case VM_OP_JUMP_IF_FALSE:
+            jit_test_truthy(jc, i, op->a);
+            jit_branch(jc, i, op->op == VM_OP_JUMP_IF_TRUE ? CC_NE : CC_E, op->target);
+            return 1;
+        case VM_OP_JUMP_IF_NOT_LT: case VM_OP_JUMP_IF_NOT_LTE:
+        case VM_OP_JUMP_IF_NOT_GT: case VM_OP_JUMP_IF_NOT_GTE:
+        case VM_OP_LOOP_IF_LT: case VM_OP_LOOP_IF_LTE:
+        case VM_OP_LOOP_IF_GT: case VM_OP_LOOP_IF_GTE: {
+            int loop = op->op >= VM_OP_LOOP_IF_LT;
+            int cmp = op->op - (loop ? VM_OP_LOOP_IF_LT : VM_OP_JUMP_IF_NOT_LT);  // LT, LTE, GT, GTE
+            jit_compare(jc, i, cmp, op->a, op->b, 1, 1);
+            EMIT(as, 0x84, 0xC0);           // test al, al
+            jit_branch(jc, i, loop ? CC_NE : CC_E, op->target);
+            return 1;
+        }
+        case VM_OP_ADDI:
+            jit_int_or_float_step(jc, i, op->a, op->b);
+            return 1;
+        case VM_OP_INC_LOCAL:
+            jit_int_or_float_step(jc, i, op->a, op->a);
+            return 1;
+        case VM_OP_SAFEPOINT:
+            jit_poll(as);
+            return 1;
+        case VM_OP_SCOPE_BEGIN:
+        case VM_OP_SCOPE_EXIT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int jit_compile(LunaChunk *chunk, LunaJitLoop *loop) {
+    if (loop->end <= loop->head || loop->end > chunk->code_len ||
+        loop->end - loop->head > JIT_MAX_LOOP_WORDS) {
+        return 0;
+    }
+
+    JitCompiler jc;
+    memset(&jc, 0, sizeof(jc));
+    jc.ops = malloc(sizeof(JitOp) * (loop->end - loop->head));
+    if (!jc.ops) return 0;
+
+    int ok = 1;
+    uint32_t off = loop->head;
+    while (ok && off < loop->end) {
+        JitOp *op = &jc.ops[jc.count];
+        ok = jit_decode_op(chunk, off, op) && off + op->len <= loop->end;
+        off += op->len;
+        jc.count++;
+    }
+    if (ok) ok = jit_scope_depths(jc.ops, jc.count);
+
+    JitAsm *as = &jc.as;
+    if (ok) {
+        for (int i = 0; i < jc.count; i++) jit_label(as);  // label i = op i
+        EMIT(as, 0x53);                     // push rbx
+        EMIT(as, 0x41, 0x54);               // push r12
+        EMIT(as, 0x48, 0x83, 0xEC, 0x08);   // sub rsp, 8 (align for calls)
+        EMIT(as, 0x48, 0x89, 0xFB);         // mov rbx, rdi
+        EMIT(as, 0x41, 0xBC);               // mov r12d, 1024
+        jit_u32(as, 1024);
+        for (int i = 0; ok && i < jc.count; i++) {
+            jit_bind(as, i);
+            ok = jit_emit_op(&jc, i);
+        }
+    }
+    if (ok) {
+        // Falling off the end is the loop's normal exit.
+        JitOp *last = &jc.ops[jc.count - 1];
+        int depth = last->depth;
+        if (last->op == VM_OP_SCOPE_BEGIN) depth++;
+        else if (last->op == VM_OP_SCOPE_EXIT) depth--;
+        jit_jump(as, CC_ALWAYS, jit_exit(&jc, loop->end, depth, 0));
+
+        int epilogue = jit_label(as);
+        for (int k = 0; k < jc.exit_count; k++) {
+            jit_bind(as, jc.exit_labels[k]);
+            EMIT(as, 0xB8);                 // mov eax, exit index
+            jit_u32(as, (uint32_t)k);
+            jit_jump(as, CC_ALWAYS, epilogue);
+        }
+        jit_bind(as, epilogue);
+        EMIT(as, 0x48, 0x83, 0xC4, 0x08);   // add rsp, 8
+        EMIT(as, 0x41, 0x5C);               // pop r12
+        EMIT(as, 0x5B);                     // pop rbx
+        EMIT(as, 0xC3);                     // ret
+        ok = jit_resolve(as);
+    }
+
+    if (ok) {
+        size_t size = (as->len + 4095) & ~(size_t)4095;
+        void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            ok = 0;
+        } else {
+            memcpy(mem, as->code, as->len);
+            if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+                munmap(mem, size);
+                ok = 0;
+            } else {
+                loop->code = mem;
+                loop->code_size = size;
+                loop->fn = (LunaJitFn)mem;
+                loop->exits = jc.exits;
+                loop->exit_count = jc.exit_count;
+                jc.exits = NULL;
+            }
+        }
+    }
+
+    free(jc.ops);
+    free(jc.exits);
+    free(jc.exit_labels);
+    free(as->code);
+    free(as->labels);
+    free(as->fixups);
+    return ok;
+}
+
+long luna_jit_loop(LunaChunk *chunk, size_t head, size_t end, Value *slots, int *scopes_open) {
+    LunaJitLoop *loop = chunk->jit_loops;
+    while (loop && (loop->head != head || loop->end != end)) loop = loop->next;
+    if (!loop) {
+        loop = calloc(1, sizeof(LunaJitLoop));
+        if (!loop) return -1;
+        loop->head = (uint32_t)head;
+        loop->end = (uint32_t)end;
+        loop->state = JIT_COUNTING;
+        loop->next = chunk->jit_loops;
+        chunk->jit_loops = loop;
+    }
+
+    if (loop->state != JIT_COMPILED) {
+        if (loop->state == JIT_REJECTED || ++loop->hits < JIT_HOT_LOOP) return -1;
+        if (!jit_compile(chunk, loop)) {
+            loop->state = JIT_REJECTED;
+            luna_vm_stats.jit_rejected++;
+            return -1;
+        }
+        loop->state = JIT_COMPILED;
+        luna_vm_stats.jit_loops++;
+    }
+
+    luna_vm_stats.jit_entries++;
+    LunaJitExit exit = loop->exits[loop->fn(slots)];
+    if (exit.side) {
+        luna_vm_stats.jit_side_exits++;
+        // Types in the loop changed for good; stop bouncing in and out.
+        if (++loop->side_exits >= JIT_MAX_SIDE_EXITS) {
+            jit_loop_release(loop);
+            loop->state = JIT_REJECTED;
+        }
+    }
+    *scopes_open = exit.scopes;
+    return (long)exit.offset;
+}
+
+#else
+
+long luna_jit_loop(LunaChunk *chunk, size_t head, size_t end, Value *slots, int *scopes_open) {
+    (void)chunk; (void)head; (void)end; (void)slots; (void)scopes_open;
+    return -1;
+}
+
+#endif // LUNA_JIT_SUPPORTED
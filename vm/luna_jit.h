@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#ifndef LUNA_JIT_H
+#define LUNA_JIT_H
+
+#include <stddef.h>
+#include "luna_chunk.h"
+
+/* Baseline loop JIT, enabled with LUNA_JIT=1 on x86-64 Linux (elsewhere it
+ * stays off). The VM reports every taken backward branch; once a loop has
+ * branched back often enough, its bytecode [head, end) is translated op by
+ * op into native code that works directly on the frame's registers. Each op
+ * is a fixed machine-code template with its register offsets and constants
+ * patched in. Type guards that fail, and branches that leave the loop, return
+ * to the interpreter. Loops containing an op without a template (calls,
+ * globals, heap values...) are left to the interpreter. */
+int luna_jit_enabled(void);
+
+/* Called on a taken backward branch to head; end is the offset just past the
+ * branch. Runs the loop natively if it is compiled (compiling it first when
+ * it just became hot) and returns the offset to resume interpreting at, with
+ * *scopes_open set to the number of SCOPE_BEGINs the native code passed
+ * without leaving again. Returns -1 when the interpreter should carry on. */
+long luna_jit_loop(LunaChunk *chunk, size_t head, size_t end, Value *slots, int *scopes_open);
+
+/* Releases the native code of every loop compiled from chunk. */
+void luna_jit_chunk_free(LunaChunk *chunk);
+
+#endif // LUNA_JIT_H
@@ -4,11 +4,15 @@
 #ifndef LUNA_OPCODE_H
 #define LUNA_OPCODE_H
 
+/* Instruction words (see luna_chunk.h): plain 8-bit operands listed in order
+ * fill A, B and C; `+ word` operands follow in trailing 32-bit words. */
 typedef enum {
     VM_OP_HALT = 0,
-    VM_OP_LOAD_INT,       // VM_OP_LOAD_INT dst_reg, int_val_64bit
-    VM_OP_LOAD_FLOAT,     // VM_OP_LOAD_FLOAT dst_reg, double_val_64bit
-    VM_OP_LOAD_CONST,     // VM_OP_LOAD_CONST dst_reg, const_idx_16bit
+    VM_OP_LOAD_INT,       // VM_OP_LOAD_INT A=dst_reg, sBx=int_val (wider ints use LOAD_INT64)
+    VM_OP_LOAD_FLOAT,     // VM_OP_LOAD_FLOAT A=dst_reg, sBx=integral float value (others use LOAD_FLOAT64)
+    VM_OP_LOAD_CONST,     // VM_OP_LOAD_CONST A=dst_reg, Bx=const_idx
+    VM_OP_LOAD_INT64,     // VM_OP_LOAD_INT64 dst_reg + 2 words int64 (low word first)
+    VM_OP_LOAD_FLOAT64,   // VM_OP_LOAD_FLOAT64 dst_reg + 2 words double bits (low word first)
     VM_OP_LOAD_TRUE,      // VM_OP_LOAD_TRUE dst_reg
     VM_OP_LOAD_FALSE,     // VM_OP_LOAD_FALSE dst_reg
     VM_OP_LOAD_NULL,      // VM_OP_LOAD_NULL dst_reg
@@ -33,18 +37,18 @@ typedef enum {
     VM_OP_NOT,            // VM_OP_NOT dst_reg, src_reg
     VM_OP_NEG,            // VM_OP_NEG dst_reg, src_reg
 
-    // Control flow (16-bit signed offsets)
-    VM_OP_JUMP,           // VM_OP_JUMP offset_16bit
-    VM_OP_JUMP_IF_TRUE,   // VM_OP_JUMP_IF_TRUE cond_reg, offset_16bit
-    VM_OP_JUMP_IF_FALSE,  // VM_OP_JUMP_IF_FALSE cond_reg, offset_16bit
+    // Control flow (signed offsets in words, from the end of the instruction)
+    VM_OP_JUMP,           // VM_OP_JUMP sBx=offset
+    VM_OP_JUMP_IF_TRUE,   // VM_OP_JUMP_IF_TRUE A=cond_reg, sBx=offset
+    VM_OP_JUMP_IF_FALSE,  // VM_OP_JUMP_IF_FALSE A=cond_reg, sBx=offset
 
-    // Global variables
-    VM_OP_GET_GLOBAL,     // VM_OP_GET_GLOBAL dst_reg, name_const_idx_16bit
-    VM_OP_SET_GLOBAL,     // VM_OP_SET_GLOBAL name_const_idx_16bit, src_reg
+    // Global variables (operand indexes the chunk's inline-cache side table)
+    VM_OP_GET_GLOBAL,     // VM_OP_GET_GLOBAL A=dst_reg, Bx=global_cache_idx
+    VM_OP_SET_GLOBAL,     // VM_OP_SET_GLOBAL A=src_reg, Bx=global_cache_idx
 
     // Local / upvalues
-    VM_OP_GET_UPVAL,      // VM_OP_GET_UPVAL dst_reg, upval_idx_8bit
-    VM_OP_SET_UPVAL,      // VM_OP_SET_UPVAL upval_idx_8bit, src_reg
+    VM_OP_GET_UPVAL,      // VM_OP_GET_UPVAL A=dst_reg, B=upval_idx
+    VM_OP_SET_UPVAL,      // VM_OP_SET_UPVAL A=upval_idx, B=src_reg
 
     // Collection ops
     VM_OP_NEW_LIST,       // VM_OP_NEW_LIST dst_reg
@@ -52,22 +56,24 @@ typedef enum {
     VM_OP_INDEX_GET,      // VM_OP_INDEX_GET dst_reg, target_reg, idx_reg
     VM_OP_INDEX_SET,      // VM_OP_INDEX_SET target_reg, idx_reg, val_reg
     VM_OP_NEW_MAP,        // VM_OP_NEW_MAP dst_reg
-    VM_OP_MAP_SET,        // VM_OP_MAP_SET map_reg, key_const_idx_16bit, val_reg
+    VM_OP_MAP_SET,        // VM_OP_MAP_SET map_reg, val_reg + word key_const_idx
     VM_OP_BOX_ALLOC,      // VM_OP_BOX_ALLOC dst_reg, size_reg
     VM_OP_ADDR_OF,        // VM_OP_ADDR_OF dst_reg, src_reg (address of local register)
-    VM_OP_ADDR_OF_GLOBAL, // VM_OP_ADDR_OF_GLOBAL dst_reg, name_const_idx_16bit
+    VM_OP_ADDR_OF_GLOBAL, // VM_OP_ADDR_OF_GLOBAL A=dst_reg, Bx=name_const_idx
 
     // Fields / Properties
-    VM_OP_FIELD_GET,      // VM_OP_FIELD_GET dst_reg, target_reg, name_const_idx_16bit
-    VM_OP_FIELD_SET,      // VM_OP_FIELD_SET target_reg, name_const_idx_16bit, val_reg
+    VM_OP_FIELD_GET,      // VM_OP_FIELD_GET dst_reg, target_reg + word field_cache_idx
+    VM_OP_FIELD_SET,      // VM_OP_FIELD_SET target_reg, val_reg + word field_cache_idx
 
     // Functions
-    VM_OP_CALL,           // VM_OP_CALL dst_reg, func_reg, argc_8bit
-    VM_OP_CALL_NAMED,     // VM_OP_CALL_NAMED dst_reg, func_reg, argc_8bit, name_const_idx_16bit
-    VM_OP_DEFER,          // VM_OP_DEFER func_reg, argc_8bit (args in following registers)
-    VM_OP_HAS_ARG,        // VM_OP_HAS_ARG dst_reg, arg_idx_8bit (1 if caller passed arg)
+    VM_OP_CALL,           // VM_OP_CALL dst_reg, func_reg, argc
+    VM_OP_CALL_NAMED,     // VM_OP_CALL_NAMED dst_reg, func_reg, argc + word name_const_idx
+    VM_OP_CALL_NATIVE,    // VM_OP_CALL_NATIVE CALL_NAMED's A/B/C + word native_idx | global_cache_idx << 16 + word name_const_idx
+    VM_OP_TAIL_CALL,      // VM_OP_TAIL_CALL func_reg, argc + word name_const_idx (then RETURN func_reg)
+    VM_OP_DEFER,          // VM_OP_DEFER func_reg, argc (args in following registers)
+    VM_OP_HAS_ARG,        // VM_OP_HAS_ARG dst_reg, arg_idx (1 if caller passed arg)
     VM_OP_RETURN,         // VM_OP_RETURN val_reg
-    VM_OP_CLOSURE,        // VM_OP_CLOSURE dst_reg, subchunk_idx_16bit
+    VM_OP_CLOSURE,        // VM_OP_CLOSURE A=dst_reg, Bx=subchunk_idx + [word capture_flags | index << 8]*
 
     // Scopes (box lifetime), unsafe blocks
     VM_OP_SCOPE_BEGIN,    // VM_OP_SCOPE_BEGIN
@@ -76,10 +82,50 @@ typedef enum {
     VM_OP_UNSAFE_END,     // VM_OP_UNSAFE_END
 
     // Imports
-    VM_OP_IMPORT,         // VM_OP_IMPORT path_const_idx_16bit, name_count_8bit, [name_const_idx_16bit]*, is_module_use_8bit
+    VM_OP_IMPORT,         // VM_OP_IMPORT name_count, is_module_use + word path_const_idx + [word name_const_idx]*
 
     VM_OP_PRINT,          // VM_OP_PRINT src_reg
-    VM_OP_SAFEPOINT       // VM_OP_SAFEPOINT
+    VM_OP_SAFEPOINT,      // VM_OP_SAFEPOINT
+
+    // Superinstructions emitted by the compiler for loop headers and counters
+    VM_OP_JUMP_IF_NOT_LT,  // VM_OP_JUMP_IF_NOT_LT lhs_reg, rhs_reg + word offset
+    VM_OP_JUMP_IF_NOT_LTE, // VM_OP_JUMP_IF_NOT_LTE lhs_reg, rhs_reg + word offset
+    VM_OP_JUMP_IF_NOT_GT,  // VM_OP_JUMP_IF_NOT_GT lhs_reg, rhs_reg + word offset
+    VM_OP_JUMP_IF_NOT_GTE, // VM_OP_JUMP_IF_NOT_GTE lhs_reg, rhs_reg + word offset
+    VM_OP_LOOP_IF_LT,      // VM_OP_LOOP_IF_LT lhs_reg, rhs_reg + word offset (jump + safepoint poll if true)
+    VM_OP_LOOP_IF_LTE,     // VM_OP_LOOP_IF_LTE lhs_reg, rhs_reg + word offset
+    VM_OP_LOOP_IF_GT,      // VM_OP_LOOP_IF_GT lhs_reg, rhs_reg + word offset
+    VM_OP_LOOP_IF_GTE,     // VM_OP_LOOP_IF_GTE lhs_reg, rhs_reg + word offset
+    VM_OP_ADDI,            // VM_OP_ADDI dst_reg, src_reg, imm_s8
+    VM_OP_INC_LOCAL,       // VM_OP_INC_LOCAL reg, imm_s8 (++ / -- on a local)
+    VM_OP_FOR_ITER,        // VM_OP_FOR_ITER var_reg, iter_reg, state_reg + word offset (next item into var, jump back if any)
+    VM_OP_SWITCH_TABLE,    // VM_OP_SWITCH_TABLE A=val_reg, B=kind + words count, low_i32, default_off, [off]*count
+    VM_OP_SWITCH_HASH,     // VM_OP_SWITCH_HASH A=val_reg, Bx=mask + words count, seed, default_off, [const_idx, off]*count, [slot]*(mask+1)
+    VM_OP_CONCAT_N,        // VM_OP_CONCAT_N dst_reg, first_reg, count (string forms of count registers, joined)
+
+    // Quickened forms: never emitted by the compiler. The generic opcode rewrites
+    // itself into one of these after seeing int/int (II) or float/float (FF)
+    // operands; a failed type guard rewrites it back. Same operands as the generic op.
+    VM_OP_ADD_II,         // VM_OP_ADD_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_ADD_FF,         // VM_OP_ADD_FF dst_reg, lhs_reg, rhs_reg
+    VM_OP_SUB_II,         // VM_OP_SUB_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_SUB_FF,         // VM_OP_SUB_FF dst_reg, lhs_reg, rhs_reg
+    VM_OP_MUL_II,         // VM_OP_MUL_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_MUL_FF,         // VM_OP_MUL_FF dst_reg, lhs_reg, rhs_reg
+    VM_OP_EQ_II,          // VM_OP_EQ_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_NEQ_II,         // VM_OP_NEQ_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_LT_II,          // VM_OP_LT_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_LT_FF,          // VM_OP_LT_FF dst_reg, lhs_reg, rhs_reg
+    VM_OP_LTE_II,         // VM_OP_LTE_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_LTE_FF,         // VM_OP_LTE_FF dst_reg, lhs_reg, rhs_reg
+    VM_OP_GT_II,          // VM_OP_GT_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_GT_FF,          // VM_OP_GT_FF dst_reg, lhs_reg, rhs_reg
+    VM_OP_GTE_II,         // VM_OP_GTE_II dst_reg, lhs_reg, rhs_reg
+    VM_OP_GTE_FF          // VM_OP_GTE_FF dst_reg, lhs_reg, rhs_reg
 } Opcode;
 
+// VM_OP_CLOSURE capture flags, in the low byte of each capture word.
+#define VM_CAPTURE_LOCAL 0x01 // index is a register of the enclosing frame, else one of its upvalues
+#define VM_CAPTURE_VALUE 0x02 // never reassigned: the closure keeps its own copy of the value
+
 #endif // LUNA_OPCODE_H
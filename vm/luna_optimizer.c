@@ -0,0 +1,1073 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "luna_optimizer.h"
+#include "luna_opcode.h"
+#include "luna_vm.h"
+
+/*
+ * Bytecode optimizer. The chunk is decoded into an instruction array whose
+ * jumps refer to instruction indexes, rewritten in place (instructions are
+ * only ever marked dead or replaced), then laid out again with fresh jump
+ * offsets and line map. Analyses are deliberately conservative:
+ *
+ *  - constant and copy facts live within one basic block and are dropped at
+ *    CALL, whose callee frame reuses the registers above the callee;
+ *  - registers captured by a closure or address-taken (`&x`) are "pinned"
+ *    and never folded, propagated, coalesced or dead-store eliminated, so
+ *    code run elsewhere (closures, defers, stores through pointers) can only
+ *    ever touch registers the optimizer does not reason about;
+ *  - only side-effect-free instructions (loads, MOVE, NOT, ...) are removed
+ *    as dead stores, so runtime type errors are still raised where they were.
+ */
+
+typedef struct { uint64_t w[4]; } RegSet;
+
+static inline void regset_add(RegSet *s, int r) { s->w[r >> 6] |= 1ULL << (r & 63); }
+static inline void regset_del(RegSet *s, int r) { s->w[r >> 6] &= ~(1ULL << (r & 63)); }
+static inline int  regset_has(const RegSet *s, int r) { return (int)((s->w[r >> 6] >> (r & 63)) & 1); }
+
+typedef struct {
+    LunaInsn *words;  // instruction words: into the work copy, or inl once rewritten
+    int      len;
+    int      line;
+    int      old_off;
+    int      target;  // instruction a jump lands on, -1 if not a jump
+    int     *targets; // SWITCH_*: the default, then one per case
+    int      ntargets;
+    int      dead;
+    LunaInsn inl[3];
+} OptInsn;
+
+typedef struct {
+    LunaChunk *chunk;
+    OptInsn   *insns;
+    int        count;
+    LunaInsn  *work;
+    int       *leader;
+    RegSet    *live_out;
+    RegSet     pinned;
+    int        changed;
+} Optimizer;
+
+/* Register operands of one instruction, as operand fields of its first word
+ * (1 = A, 2 = B, 3 = C; 0 = none). */
+typedef struct {
+    int reads[3];   // plain reads; copy propagation may rename these
+    int nreads;
+    int rw;         // register read and written in place (INC_LOCAL, INDEX_SET target, ...)
+    int def;        // register written
+    int arg_base;   // CALL/DEFER: callee register, followed by arg_count args;
+                    // CONCAT_N: first of arg_count + 1 registers read
+    int arg_count;
+    int barrier;    // VM call: the callee's frame overlaps registers above it
+    int pure;       // no effect other than writing def
+} InsnInfo;
+
+static int opt_level = -1;
+
+int luna_optimizer_level(void) {
+    if (opt_level < 0) {
+        const char *raw = getenv("LUNA_VM_OPT");
+        opt_level = LUNA_OPT_DEFAULT_LEVEL;
+        if (raw && raw[0]) {
+            opt_level = atoi(raw);
+            if (opt_level < 0) opt_level = 0;
+        }
+    }
+    return opt_level;
+}
+
+/* Register in operand field pos (1 = A, 2 = B, 3 = C) of the first word. */
+static inline int insn_reg(const OptInsn *in, int pos) {
+    return (int)((in->words[0] >> (8 * pos)) & 0xFF);
+}
+
+static inline void insn_set_reg(OptInsn *in, int pos, int reg) {
+    in->words[0] = (in->words[0] & ~((LunaInsn)0xFF << (8 * pos))) | (LunaInsn)(uint8_t)reg << (8 * pos);
+}
+
+static inline uint8_t insn_op(const OptInsn *in) {
+    return (uint8_t)LUNA_OP(in->words[0]);
+}
+
+static int is_binary_op(uint8_t op) {
+    return (op >= VM_OP_ADD && op <= VM_OP_GTE) ||
+           (op >= VM_OP_ADD_II && op <= VM_OP_GTE_FF);
+}
+
+/* Where a jump keeps its offset: 1 for sBx of the first word (16 bits), 2
+ * for the trailing word, 0 if op is not a jump. */
+static int jump_operand(uint8_t op) {
+    switch (op) {
+        case VM_OP_JUMP:
+        case VM_OP_JUMP_IF_TRUE:
+        case VM_OP_JUMP_IF_FALSE:
+            return 1;
+        case VM_OP_JUMP_IF_NOT_LT:
+        case VM_OP_JUMP_IF_NOT_LTE:
+        case VM_OP_JUMP_IF_NOT_GT:
+        case VM_OP_JUMP_IF_NOT_GTE:
+        case VM_OP_LOOP_IF_LT:
+        case VM_OP_LOOP_IF_LTE:
+        case VM_OP_LOOP_IF_GT:
+        case VM_OP_LOOP_IF_GTE:
+        case VM_OP_FOR_ITER:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static int read_jump(const OptInsn *in, int pos) {
+    return pos == 1 ? LUNA_SBX(in->words[0]) : (int32_t)in->words[1];
+}
+
+static int is_switch(uint8_t op) {
+    return op == VM_OP_SWITCH_TABLE || op == VM_OP_SWITCH_HASH;
+}
+
+/* Word holding the k-th offset of a switch (k = 0 is the default). */
+static int switch_operand(const LunaInsn *w, int k) {
+    return k == 0 ? LUNA_SWITCH_DEFAULT_POS : luna_switch_case_pos(w, k - 1);
+}
+
+static int falls_through(uint8_t op) {
+    return op != VM_OP_JUMP && op != VM_OP_RETURN && op != VM_OP_HALT && !is_switch(op);
+}
+
+static void insn_info(const OptInsn *in, InsnInfo *info) {
+    uint8_t op = insn_op(in);
+    memset(info, 0, sizeof(*info));
+    info->arg_base = -1;
+
+    if (is_binary_op(op)) {
+        info->def = 1;
+        info->reads[0] = 2;
+        info->reads[1] = 3;
+        info->nreads = 2;
+        return;
+    }
+    switch ((Opcode)op) {
+        case VM_OP_LOAD_INT:
+        case VM_OP_LOAD_FLOAT:
+        case VM_OP_LOAD_CONST:
+        case VM_OP_LOAD_INT64:
+        case VM_OP_LOAD_FLOAT64:
+        case VM_OP_LOAD_TRUE:
+        case VM_OP_LOAD_FALSE:
+        case VM_OP_LOAD_NULL:
+        case VM_OP_NEW_LIST:
+        case VM_OP_NEW_MAP:
+        case VM_OP_HAS_ARG:
+        case VM_OP_GET_UPVAL:
+            info->def = 1;
+            info->pure = 1;
+            break;
+        case VM_OP_MOVE:
+        case VM_OP_NOT:
+            info->def = 1;
+            info->reads[info->nreads++] = 2;
+            info->pure = 1;
+            break;
+        case VM_OP_NEG:
+        case VM_OP_BOX_ALLOC:
+        case VM_OP_ADDI:
+        case VM_OP_FIELD_GET:
+            info->def = 1;
+            info->reads[info->nreads++] = 2;
+            break;
+        case VM_OP_INDEX_GET:
+            info->def = 1;
+            info->reads[info->nreads++] = 2;
+            info->reads[info->nreads++] = 3;
+            break;
+        case VM_OP_GET_GLOBAL:
+        case VM_OP_ADDR_OF_GLOBAL:
+            info->def = 1;
+            break;
+        case VM_OP_ADDR_OF:
+            info->def = 1;
+            info->rw = 2;
+            break;
+        case VM_OP_JUMP_IF_TRUE:
+        case VM_OP_JUMP_IF_FALSE:
+        case VM_OP_SWITCH_TABLE:
+        case VM_OP_SWITCH_HASH:
+        case VM_OP_RETURN:
+        case VM_OP_PRINT:
+            info->reads[info->nreads++] = 1;
+            break;
+        case VM_OP_JUMP_IF_NOT_LT:
+        case VM_OP_JUMP_IF_NOT_LTE:
+        case VM_OP_JUMP_IF_NOT_GT:
+        case VM_OP_JUMP_IF_NOT_GTE:
+        case VM_OP_LOOP_IF_LT:
+        case VM_OP_LOOP_IF_LTE:
+        case VM_OP_LOOP_IF_GT:
+        case VM_OP_LOOP_IF_GTE:
+            info->reads[info->nreads++] = 1;
+            info->reads[info->nreads++] = 2;
+            break;
+        case VM_OP_SET_GLOBAL:
+            info->reads[info->nreads++] = 1;
+            break;
+        case VM_OP_SET_UPVAL:
+            info->reads[info->nreads++] = 2;
+            break;
+        case VM_OP_LIST_APPEND:
+            info->rw = 1;
+            info->reads[info->nreads++] = 2;
+            break;
+        case VM_OP_INDEX_SET:
+            info->rw = 1;
+            info->reads[info->nreads++] = 2;
+            info->reads[info->nreads++] = 3;
+            break;
+        case VM_OP_MAP_SET:
+        case VM_OP_FIELD_SET:
+            info->rw = 1;
+            info->reads[info->nreads++] = 2;
+            break;
+        case VM_OP_INC_LOCAL:
+            info->rw = 1;
+            break;
+        case VM_OP_FOR_ITER:
+            info->def = 1;
+            info->reads[info->nreads++] = 2;
+            info->rw = 3;
+            break;
+        case VM_OP_CALL:
+        case VM_OP_CALL_NAMED:
+        case VM_OP_CALL_NATIVE:
+            info->def = 1;
+            info->arg_base = insn_reg(in, 2);
+            info->arg_count = insn_reg(in, 3);
+            info->barrier = 1;
+            break;
+        case VM_OP_TAIL_CALL:
+            info->def = 1;
+            info->arg_base = insn_reg(in, 1);
+            info->arg_count = insn_reg(in, 2);
+            info->barrier = 1;
+            break;
+        case VM_OP_DEFER:
+            info->arg_base = insn_reg(in, 1);
+            info->arg_count = insn_reg(in, 2);
+            break;
+        case VM_OP_CONCAT_N:
+            info->def = 1;
+            info->arg_base = insn_reg(in, 2);
+            info->arg_count = insn_reg(in, 3) - 1;
+            break;
+        case VM_OP_CLOSURE:
+            info->def = 1;
+            break;
+        case VM_OP_IMPORT:
+            info->barrier = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+/* First live instruction at or after i (count if none). */
+static int next_live(const Optimizer *o, int i) {
+    while (i < o->count && o->insns[i].dead) i++;
+    return i;
+}
+
+/* ---- decoding / layout ---- */
+
+static int opt_decode(Optimizer *o) {
+    LunaChunk *chunk = o->chunk;
+    size_t len = chunk->code_len;
+    int *index_of = malloc((len + 1) * sizeof(int));
+    o->work = malloc((len ? len : 1) * sizeof(LunaInsn));
+    o->insns = malloc((len ? len : 1) * sizeof(OptInsn));
+    memcpy(o->work, chunk->code, len * sizeof(LunaInsn));
+    for (size_t i = 0; i <= len; i++) index_of[i] = -1;
+
+    o->count = 0;
+    size_t off = 0;
+    while (off < len) {
+        int n = luna_chunk_op_length(chunk, off);
+        if (off + (size_t)n > len) {
+            free(index_of);
+            return 0;
+        }
+        OptInsn *in = &o->insns[o->count];
+        in->words = o->work + off;
+        in->len = n;
+        in->line = luna_chunk_line_at(chunk, off);
+        in->old_off = (int)off;
+        in->target = -1;
+        in->targets = NULL;
+        in->ntargets = 0;
+        in->dead = 0;
+        index_of[off] = o->count++;
+        off += (size_t)n;
+    }
+
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (is_switch(insn_op(in))) {
+            in->ntargets = 1 + luna_switch_case_count(in->words);
+            in->targets = malloc((size_t)in->ntargets * sizeof(int));
+            for (int k = 0; k < in->ntargets; k++) {
+                int32_t rel = (int32_t)in->words[switch_operand(in->words, k)];
+                long dest = (long)in->old_off + in->len + rel;
+                if (dest < 0 || dest >= (long)len || index_of[dest] < 0) {
+                    free(index_of);
+                    return 0;
+                }
+                in->targets[k] = index_of[dest];
+            }
+            continue;
+        }
+        int pos = jump_operand(insn_op(in));
+        if (!pos) continue;
+        long dest = (long)in->old_off + in->len + read_jump(in, pos);
+        if (dest < 0 || dest >= (long)len || index_of[dest] < 0) {
+            free(index_of);
+            return 0;
+        }
+        in->target = index_of[dest];
+    }
+    free(index_of);
+
+    memset(&o->pinned, 0, sizeof(o->pinned));
+    for (int i = 0; i < o->count; i++) {
+        const OptInsn *in = &o->insns[i];
+        if (insn_op(in) == VM_OP_ADDR_OF) {
+            regset_add(&o->pinned, insn_reg(in, 2));
+        } else if (insn_op(in) == VM_OP_CLOSURE) {
+            for (int k = 1; k < in->len; k++) {
+                if (in->words[k] & VM_CAPTURE_LOCAL) regset_add(&o->pinned, (in->words[k] >> 8) & 0xFF);
+            }
+        }
+    }
+
+    o->leader = malloc((size_t)(o->count + 1) * sizeof(int));
+    o->live_out = malloc((size_t)(o->count + 1) * sizeof(RegSet));
+    return 1;
+}
+
+/* Lays the live instructions out again. Fails (leaving the chunk untouched)
+ * if a folded instruction pushed an sBx jump out of 16-bit range. */
+static int opt_emit(Optimizer *o) {
+    int *new_off = malloc((size_t)(o->count + 1) * sizeof(int));
+    size_t len = 0;
+    for (int i = 0; i < o->count; i++) {
+        new_off[i] = (int)len;
+        if (!o->insns[i].dead) len += (size_t)o->insns[i].len;
+    }
+    new_off[o->count] = (int)len;
+
+    LunaInsn *code = malloc((len ? len : 1) * sizeof(LunaInsn));
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (in->dead) continue;
+        LunaInsn *dst = code + new_off[i];
+        memcpy(dst, in->words, (size_t)in->len * sizeof(LunaInsn));
+        for (int k = 0; k < in->ntargets; k++) {
+            int t = next_live(o, in->targets[k]);
+            if (t >= o->count) {
+                free(new_off);
+                free(code);
+                return 0;
+            }
+            dst[switch_operand(dst, k)] = (LunaInsn)(int32_t)(new_off[t] - (new_off[i] + in->len));
+        }
+        int pos = jump_operand(insn_op(in));
+        if (!pos) continue;
+        int t = next_live(o, in->target);
+        int rel = new_off[t] - (new_off[i] + in->len);
+        if (t >= o->count || (pos == 1 && (rel < -32768 || rel > 32767))) {
+            free(new_off);
+            free(code);
+            return 0;
+        }
+        if (pos == 1) dst[0] = luna_insn_with_bx(dst[0], (uint16_t)rel);
+        else dst[1] = (LunaInsn)(int32_t)rel;
+    }
+
+    LunaChunk *chunk = o->chunk;
+    free(chunk->code);
+    chunk->code = code;
+    chunk->code_len = len;
+    chunk->code_cap = len;
+    chunk->line_len = 0;
+    for (int i = 0; i < o->count; i++) {
+        if (!o->insns[i].dead) luna_chunk_add_line(chunk, (size_t)new_off[i], o->insns[i].line);
+    }
+    free(new_off);
+    return 1;
+}
+
+/* ---- control flow ---- */
+
+static void mark_leaders(Optimizer *o) {
+    memset(o->leader, 0, (size_t)(o->count + 1) * sizeof(int));
+    o->leader[next_live(o, 0)] = 1;
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (in->dead) continue;
+        for (int k = 0; k < in->ntargets; k++) {
+            o->leader[next_live(o, in->targets[k])] = 1;
+        }
+        if (in->target >= 0) {
+            o->leader[next_live(o, in->target)] = 1;
+            o->leader[next_live(o, i + 1)] = 1;
+        } else if (!falls_through(insn_op(in))) {
+            o->leader[next_live(o, i + 1)] = 1;
+        }
+    }
+}
+
+static void remove_unreachable(Optimizer *o) {
+    int *reach = calloc((size_t)o->count + 1, sizeof(int));
+    int *work = malloc((size_t)(o->count + 1) * sizeof(int));
+    int top = 0;
+    int start = next_live(o, 0);
+    if (start < o->count) {
+        reach[start] = 1;
+        work[top++] = start;
+    }
+    while (top > 0) {
+        int i = work[--top];
+        OptInsn *in = &o->insns[i];
+        int succ[2], ns = 0;
+        if (falls_through(insn_op(in))) succ[ns++] = next_live(o, i + 1);
+        if (in->target >= 0) succ[ns++] = next_live(o, in->target);
+        for (int k = 0; k < ns + in->ntargets; k++) {
+            int s = k < ns ? succ[k] : next_live(o, in->targets[k - ns]);
+            if (s < o->count && !reach[s]) {
+                reach[s] = 1;
+                work[top++] = s;
+            }
+        }
+    }
+    for (int i = 0; i < o->count; i++) {
+        if (!o->insns[i].dead && !reach[i]) {
+            o->insns[i].dead = 1;
+            o->changed = 1;
+        }
+    }
+    free(reach);
+    free(work);
+}
+
+/* Follows a chain of unconditional JUMPs starting at `target`. */
+static int jump_chain_end(const Optimizer *o, int i, int target) {
+    int t = next_live(o, target);
+    for (int hops = 0; hops < 8 && t < o->count &&
+         insn_op(&o->insns[t]) == VM_OP_JUMP && t != i; hops++) {
+        t = next_live(o, o->insns[t].target);
+    }
+    return t;
+}
+
+/* Retargets jumps (and switch entries) that land on an unconditional JUMP,
+ * and replaces a JUMP to a RETURN/HALT with a copy of it. */
+static void thread_jumps(Optimizer *o) {
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (in->dead) continue;
+        for (int k = 0; k < in->ntargets; k++) {
+            int t = jump_chain_end(o, i, in->targets[k]);
+            if (t < o->count && t != next_live(o, in->targets[k])) {
+                in->targets[k] = t;
+                o->changed = 1;
+            }
+        }
+        if (in->target < 0) continue;
+        int t = jump_chain_end(o, i, in->target);
+        if (t < o->count && t != next_live(o, in->target)) {
+            in->target = t;
+            o->changed = 1;
+        }
+        if (insn_op(in) == VM_OP_JUMP && t < o->count &&
+            (insn_op(&o->insns[t]) == VM_OP_RETURN || insn_op(&o->insns[t]) == VM_OP_HALT)) {
+            memcpy(in->inl, o->insns[t].words, (size_t)o->insns[t].len * sizeof(LunaInsn));
+            in->words = in->inl;
+            in->len = o->insns[t].len;
+            in->target = -1;
+            o->changed = 1;
+        }
+    }
+}
+
+/* MOVE r, r; jumps to the next instruction. */
+static void remove_nops(Optimizer *o) {
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (in->dead) continue;
+        uint8_t op = insn_op(in);
+        int nop = 0;
+        if (op == VM_OP_MOVE && insn_reg(in, 1) == insn_reg(in, 2)) {
+            nop = 1;
+        } else if ((op == VM_OP_JUMP || op == VM_OP_JUMP_IF_TRUE || op == VM_OP_JUMP_IF_FALSE) &&
+                   next_live(o, in->target) == next_live(o, i + 1)) {
+            nop = 1;
+        }
+        if (nop) {
+            in->dead = 1;
+            o->changed = 1;
+        }
+    }
+}
+
+/* ---- constant folding ---- */
+
+enum { K_NONE = 0, K_INT, K_FLOAT, K_BOOL };
+
+typedef struct {
+    int kind;
+    long long i;
+    double f;
+} Known;
+
+static double known_num(const Known *k) {
+    return k->kind == K_INT ? (double)k->i : k->f;
+}
+
+static int known_numeric(const Known *k) {
+    return k->kind == K_INT || k->kind == K_FLOAT;
+}
+
+/* Replaces in with a load of k into dst: an sBx immediate when the value
+ * fits, otherwise a LOAD_INT64 / LOAD_FLOAT64 with the bits inline. */
+static void rewrite_load(OptInsn *in, uint8_t dst, const Known *k) {
+    in->len = 1;
+    if (k->kind == K_BOOL) {
+        in->inl[0] = LUNA_ABC(k->i ? VM_OP_LOAD_TRUE : VM_OP_LOAD_FALSE, dst, 0, 0);
+    } else if (k->kind == K_INT && k->i >= INT16_MIN && k->i <= INT16_MAX) {
+        in->inl[0] = LUNA_ABX(VM_OP_LOAD_INT, dst, (uint16_t)(int16_t)k->i);
+    } else if (k->kind == K_FLOAT && luna_float_fits_sbx(k->f)) {
+        in->inl[0] = LUNA_ABX(VM_OP_LOAD_FLOAT, dst, (uint16_t)(int16_t)k->f);
+    } else {
+        uint64_t bits = (uint64_t)k->i;
+        if (k->kind == K_FLOAT) memcpy(&bits, &k->f, sizeof(bits));
+        in->inl[0] = LUNA_ABC(k->kind == K_INT ? VM_OP_LOAD_INT64 : VM_OP_LOAD_FLOAT64, dst, 0, 0);
+        in->inl[1] = (LunaInsn)bits;
+        in->inl[2] = (LunaInsn)(bits >> 32);
+        in->len = 3;
+    }
+    in->words = in->inl;
+    in->target = -1;
+}
+
+/* Mirrors the VM's int/float semantics for the folded operators. */
+static int fold_binary(uint8_t op, const Known *l, const Known *r, Known *out) {
+    int ints = l->kind == K_INT && r->kind == K_INT;
+    if (!ints && !(known_numeric(l) && known_numeric(r))) {
+        if ((op == VM_OP_EQ || op == VM_OP_NEQ) && l->kind == K_BOOL && r->kind == K_BOOL) {
+            out->kind = K_BOOL;
+            out->i = (l->i == r->i) == (op == VM_OP_EQ);
+            return 1;
+        }
+        return 0;
+    }
+    double dl = known_num(l), dr = known_num(r);
+    switch (op) {
+        case VM_OP_ADD:
+        case VM_OP_SUB:
+        case VM_OP_MUL:
+            if (ints) {
+                uint64_t a = (uint64_t)l->i, b = (uint64_t)r->i;
+                out->kind = K_INT;
+                out->i = (long long)(op == VM_OP_ADD ? a + b : op == VM_OP_SUB ? a - b : a * b);
+            } else {
+                out->kind = K_FLOAT;
+                out->f = op == VM_OP_ADD ? dl + dr : op == VM_OP_SUB ? dl - dr : dl * dr;
+            }
+            return 1;
+        case VM_OP_DIV:
+            if (ints) {
+                if (r->i == -1) return 0;
+                if (r->i == 0) { out->kind = K_INT; out->i = 0; }
+                else if (l->i % r->i == 0) { out->kind = K_INT; out->i = l->i / r->i; }
+                else { out->kind = K_FLOAT; out->f = (double)l->i / (double)r->i; }
+            } else {
+                out->kind = K_FLOAT;
+                out->f = dr == 0.0 ? 0.0 : dl / dr;
+            }
+            return 1;
+        case VM_OP_MOD:
+            if (!ints || r->i == -1) return 0;
+            out->kind = K_INT;
+            out->i = r->i == 0 ? 0 : l->i % r->i;
+            return 1;
+        case VM_OP_EQ:
+        case VM_OP_NEQ:
+            if (l->kind != r->kind) return 0;
+            out->kind = K_BOOL;
+            out->i = (ints ? l->i == r->i : dl == dr) == (op == VM_OP_EQ);
+            return 1;
+        case VM_OP_LT:  out->kind = K_BOOL; out->i = ints ? l->i <  r->i : dl <  dr; return 1;
+        case VM_OP_LTE: out->kind = K_BOOL; out->i = ints ? l->i <= r->i : dl <= dr; return 1;
+        case VM_OP_GT:  out->kind = K_BOOL; out->i = ints ? l->i >  r->i : dl >  dr; return 1;
+        case VM_OP_GTE: out->kind = K_BOOL; out->i = ints ? l->i >= r->i : dl >= dr; return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Result of a fused compare-and-branch's comparison, or -1 if unknown. */
+static int fold_branch_compare(uint8_t op, const Known *l, const Known *r) {
+    static const uint8_t cmp_of[] = { VM_OP_LT, VM_OP_LTE, VM_OP_GT, VM_OP_GTE };
+    int idx = op >= VM_OP_LOOP_IF_LT ? op - VM_OP_LOOP_IF_LT : op - VM_OP_JUMP_IF_NOT_LT;
+    if (!known_numeric(l) || !known_numeric(r)) return -1;
+    Known res;
+    if (!fold_binary(cmp_of[idx], l, r, &res)) return -1;
+    return (int)res.i;
+}
+
+/* Known value of a pool constant, K_NONE unless it is an int or float. */
+static Known known_const(const LunaChunk *chunk, int idx) {
+    Known k = { K_NONE, 0, 0.0 };
+    if ((size_t)idx >= chunk->const_len) return k;
+    Value v = chunk->constants[idx];
+    if (VALUE_TYPE(v) == VAL_INT) {
+        k.kind = K_INT;
+        k.i = VALUE_AS_INT(v);
+    } else if (VALUE_TYPE(v) == VAL_FLOAT) {
+        k.kind = K_FLOAT;
+        k.f = VALUE_AS_FLOAT(v);
+    }
+    return k;
+}
+
+/* A taken branch keeps its target as a plain JUMP. */
+static void rewrite_jump(OptInsn *in) {
+    in->inl[0] = LUNA_ABX(VM_OP_JUMP, 0, 0);
+    in->words = in->inl;
+    in->len = 1;
+}
+
+static void fold_constants(Optimizer *o) {
+    Known known[256];
+    memset(known, 0, sizeof(known));
+
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (in->dead) continue;
+        if (o->leader[i]) memset(known, 0, sizeof(known));
+        LunaInsn w = in->words[0];
+        uint8_t op = insn_op(in);
+        uint8_t a = LUNA_A(w), b = LUNA_B(w), c = LUNA_C(w);
+        Known res = { K_NONE, 0, 0.0 };
+        int dst = -1;
+
+        switch (op) {
+            case VM_OP_LOAD_INT:
+                res.kind = K_INT;
+                res.i = LUNA_SBX(w);
+                dst = a;
+                break;
+            case VM_OP_LOAD_FLOAT:
+                res.kind = K_FLOAT;
+                res.f = LUNA_SBX(w);
+                dst = a;
+                break;
+            case VM_OP_LOAD_CONST:
+                res = known_const(o->chunk, LUNA_BX(w));
+                dst = a;
+                break;
+            case VM_OP_LOAD_INT64:
+                res.kind = K_INT;
+                res.i = (long long)luna_insn_imm64(in->words + 1);
+                dst = a;
+                break;
+            case VM_OP_LOAD_FLOAT64: {
+                uint64_t bits = luna_insn_imm64(in->words + 1);
+                res.kind = K_FLOAT;
+                memcpy(&res.f, &bits, sizeof(res.f));
+                dst = a;
+                break;
+            }
+            case VM_OP_LOAD_TRUE:
+            case VM_OP_LOAD_FALSE:
+                res.kind = K_BOOL;
+                res.i = op == VM_OP_LOAD_TRUE;
+                dst = a;
+                break;
+            case VM_OP_MOVE:
+                res = known[b];
+                dst = a;
+                break;
+            case VM_OP_ADD: case VM_OP_SUB: case VM_OP_MUL: case VM_OP_DIV: case VM_OP_MOD:
+            case VM_OP_EQ: case VM_OP_NEQ: case VM_OP_LT: case VM_OP_LTE: case VM_OP_GT: case VM_OP_GTE:
+                dst = a;
+                if (fold_binary(op, &known[b], &known[c], &res) && !regset_has(&o->pinned, dst)) {
+                    rewrite_load(in, a, &res);
+                    o->changed = 1;
+                }
+                break;
+            case VM_OP_ADDI: {
+                Known imm = { K_INT, (int8_t)c, 0.0 };
+                dst = a;
+                if (known_numeric(&known[b]) && fold_binary(VM_OP_ADD, &known[b], &imm, &res) &&
+                    !regset_has(&o->pinned, dst)) {
+                    rewrite_load(in, a, &res);
+                    o->changed = 1;
+                }
+                break;
+            }
+            case VM_OP_NEG:
+                dst = a;
+                if (known_numeric(&known[b]) && !regset_has(&o->pinned, dst)) {
+                    res = known[b];
+                    res.i = (long long)(0 - (uint64_t)res.i);
+                    res.f = -res.f;
+                    rewrite_load(in, a, &res);
+                    o->changed = 1;
+                }
+                break;
+            case VM_OP_NOT:
+                dst = a;
+                if ((known[b].kind == K_BOOL || known[b].kind == K_INT) &&
+                    !regset_has(&o->pinned, dst)) {
+                    res.kind = K_BOOL;
+                    res.i = known[b].i == 0;
+                    rewrite_load(in, a, &res);
+                    o->changed = 1;
+                }
+                break;
+            case VM_OP_INC_LOCAL:
+                dst = a;
+                res = known[a];
+                if (!known_numeric(&res)) res.kind = K_NONE;
+                res.i = (long long)((uint64_t)res.i + (uint64_t)(long long)(int8_t)b);
+                res.f += (int8_t)b;
+                break;
+            case VM_OP_JUMP_IF_TRUE:
+            case VM_OP_JUMP_IF_FALSE: {
+                const Known *k = &known[a];
+                if (k->kind == K_BOOL || k->kind == K_INT) {
+                    int taken = (k->i != 0) == (op == VM_OP_JUMP_IF_TRUE);
+                    if (taken) {
+                        rewrite_jump(in);
+                    } else {
+                        in->dead = 1;
+                    }
+                    o->changed = 1;
+                }
+                continue;
+            }
+            case VM_OP_JUMP_IF_NOT_LT: case VM_OP_JUMP_IF_NOT_LTE:
+            case VM_OP_JUMP_IF_NOT_GT: case VM_OP_JUMP_IF_NOT_GTE: {
+                int cmp = fold_branch_compare(op, &known[a], &known[b]);
+                if (cmp == 0) {
+                    rewrite_jump(in);
+                    o->changed = 1;
+                } else if (cmp == 1) {
+                    in->dead = 1;
+                    o->changed = 1;
+                }
+                continue;
+            }
+            case VM_OP_LOOP_IF_LT: case VM_OP_LOOP_IF_LTE:
+            case VM_OP_LOOP_IF_GT: case VM_OP_LOOP_IF_GTE:
+                /* A constantly-taken back-edge keeps its safepoint poll. */
+                if (fold_branch_compare(op, &known[a], &known[b]) == 0) {
+                    in->dead = 1;
+                    o->changed = 1;
+                }
+                continue;
+            default:
+                break;
+        }
+
+        InsnInfo info;
+        insn_info(in, &info);
+        if (info.barrier) memset(known, 0, sizeof(known));
+        if (info.rw) known[insn_reg(in, info.rw)].kind = K_NONE;
+        if (info.def) known[insn_reg(in, info.def)].kind = K_NONE;
+        if (dst >= 0 && res.kind != K_NONE && !regset_has(&o->pinned, dst)) {
+            known[dst] = res;
+        }
+    }
+}
+
+/* ---- copy propagation ---- */
+
+static void kill_copies(int16_t *copy_of, int reg) {
+    copy_of[reg] = -1;
+    for (int r = 0; r < 256; r++) {
+        if (copy_of[r] == reg) copy_of[r] = -1;
+    }
+}
+
+/* Within a block, after `MOVE t, s` later plain reads of t read s instead, so
+ * the MOVE usually becomes a dead store. */
+static void propagate_copies(Optimizer *o) {
+    int16_t copy_of[256];
+    memset(copy_of, 0xFF, sizeof(copy_of));
+
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (in->dead) continue;
+        if (o->leader[i]) memset(copy_of, 0xFF, sizeof(copy_of));
+        InsnInfo info;
+        insn_info(in, &info);
+
+        for (int k = 0; k < info.nreads; k++) {
+            int r = insn_reg(in, info.reads[k]);
+            if (copy_of[r] >= 0) {
+                insn_set_reg(in, info.reads[k], copy_of[r]);
+                o->changed = 1;
+            }
+        }
+        if (info.barrier) memset(copy_of, 0xFF, sizeof(copy_of));
+        if (info.rw) kill_copies(copy_of, insn_reg(in, info.rw));
+        if (info.def) kill_copies(copy_of, insn_reg(in, info.def));
+        if (insn_op(in) == VM_OP_MOVE && insn_reg(in, 1) != insn_reg(in, 2) &&
+            !regset_has(&o->pinned, insn_reg(in, 1)) && !regset_has(&o->pinned, insn_reg(in, 2))) {
+            copy_of[insn_reg(in, 1)] = (int16_t)insn_reg(in, 2);
+        }
+    }
+}
+
+/* ---- liveness, dead stores, MOVE coalescing ---- */
+
+static void insn_uses_defs(const OptInsn *in, RegSet *uses, int *def) {
+    InsnInfo info;
+    insn_info(in, &info);
+    memset(uses, 0, sizeof(*uses));
+    for (int k = 0; k < info.nreads; k++) regset_add(uses, insn_reg(in, info.reads[k]));
+    if (info.rw) regset_add(uses, insn_reg(in, info.rw));
+    if (info.arg_base >= 0) {
+        for (int r = info.arg_base; r <= info.arg_base + info.arg_count && r < 256; r++) {
+            regset_add(uses, r);
+        }
+    }
+    *def = info.def ? insn_reg(in, info.def) : -1;
+}
+
+static void compute_liveness(Optimizer *o) {
+    RegSet *live_in = calloc((size_t)o->count + 1, sizeof(RegSet));
+    memset(o->live_out, 0, (size_t)(o->count + 1) * sizeof(RegSet));
+    int dirty = 1;
+    while (dirty) {
+        dirty = 0;
+        for (int i = o->count - 1; i >= 0; i--) {
+            OptInsn *in = &o->insns[i];
+            if (in->dead) continue;
+            RegSet out = {{0, 0, 0, 0}};
+            if (falls_through(insn_op(in))) {
+                int s = next_live(o, i + 1);
+                for (int w = 0; w < 4; w++) out.w[w] |= live_in[s].w[w];
+            }
+            if (in->target >= 0) {
+                int s = next_live(o, in->target);
+                for (int w = 0; w < 4; w++) out.w[w] |= live_in[s].w[w];
+            }
+            for (int k = 0; k < in->ntargets; k++) {
+                int s = next_live(o, in->targets[k]);
+                for (int w = 0; w < 4; w++) out.w[w] |= live_in[s].w[w];
+            }
+            RegSet uses;
+            int def;
+            insn_uses_defs(in, &uses, &def);
+            RegSet inset = out;
+            if (def >= 0) regset_del(&inset, def);
+            for (int w = 0; w < 4; w++) inset.w[w] |= uses.w[w];
+            o->live_out[i] = out;
+            if (memcmp(&inset, &live_in[i], sizeof(RegSet)) != 0) {
+                live_in[i] = inset;
+                dirty = 1;
+            }
+        }
+    }
+    free(live_in);
+}
+
+static void eliminate_dead_stores(Optimizer *o) {
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (in->dead) continue;
+        InsnInfo info;
+        insn_info(in, &info);
+        if (!info.pure || !info.def) continue;
+        int r = insn_reg(in, info.def);
+        if (!regset_has(&o->pinned, r) && !regset_has(&o->live_out[i], r)) {
+            in->dead = 1;
+            o->changed = 1;
+        }
+    }
+}
+
+/* `op t, ...; MOVE d, t` with t dead afterwards becomes `op d, ...`. */
+static void coalesce_moves(Optimizer *o) {
+    int prev = -1;
+    for (int i = 0; i < o->count; i++) {
+        OptInsn *in = &o->insns[i];
+        if (in->dead) continue;
+        int p = prev;
+        prev = i;
+        if (insn_op(in) != VM_OP_MOVE || p < 0 || o->leader[i]) continue;
+        int d = insn_reg(in, 1), t = insn_reg(in, 2);
+        if (d == t || regset_has(&o->pinned, d) || regset_has(&o->pinned, t)) continue;
+        if (regset_has(&o->live_out[i], t)) continue;
+
+        OptInsn *pin = &o->insns[p];
+        InsnInfo info;
+        insn_info(pin, &info);
+        if (!info.def || info.rw || info.barrier || info.arg_base >= 0) continue;
+        if (insn_reg(pin, info.def) != t) continue;
+        int reads_d = 0;
+        for (int k = 0; k < info.nreads; k++) {
+            if (insn_reg(pin, info.reads[k]) == d) reads_d = 1;
+        }
+        if (reads_d) continue;
+
+        insn_set_reg(pin, info.def, d);
+        in->dead = 1;
+        o->changed = 1;
+        prev = p;
+    }
+}
+
+/* ---- constant pool ---- */
+
+/* Constant-index operands of an instruction: 0 is the Bx field of the first
+ * word, k > 0 the whole trailing word k. */
+static int const_operands(const LunaInsn *w, int len, int *pos) {
+    switch (LUNA_OP(w[0])) {
+        case VM_OP_LOAD_CONST:
+        case VM_OP_ADDR_OF_GLOBAL:
+            pos[0] = 0;
+            return 1;
+        case VM_OP_MAP_SET:
+        case VM_OP_CALL_NAMED:
+        case VM_OP_TAIL_CALL:
+            pos[0] = 1;
+            return 1;
+        case VM_OP_CALL_NATIVE:
+            pos[0] = 2;
+            return 1;
+        case VM_OP_SWITCH_HASH: {
+            int n = (int)luna_switch_case_count(w);
+            for (int k = 0; k < n; k++) pos[k] = 4 + 2 * k;
+            return n;
+        }
+        case VM_OP_IMPORT: {
+            int n = 0;
+            for (int k = 1; k < len; k++) pos[n++] = k;
+            return n;
+        }
+        default:
+            return 0;
+    }
+}
+
+static int constants_equal(Value a, Value b) {
+    if (VALUE_TYPE(a) != VALUE_TYPE(b)) return 0;
+    switch (VALUE_TYPE(a)) {
+        case VAL_INT:    return VALUE_AS_INT(a) == VALUE_AS_INT(b);
+        case VAL_FLOAT: {
+            double x = VALUE_AS_FLOAT(a), y = VALUE_AS_FLOAT(b);
+            return memcmp(&x, &y, sizeof(double)) == 0;
+        }
+        case VAL_BOOL:   return VALUE_AS_BOOL(a) == VALUE_AS_BOOL(b);
+        case VAL_CHAR:   return VALUE_AS_CHAR(a) == VALUE_AS_CHAR(b);
+        case VAL_STRING: return strcmp(VALUE_AS_STRING(a)->chars, VALUE_AS_STRING(b)->chars) == 0;
+        default:         return 0;
+    }
+}
+
+/* Drops constants no surviving instruction references and merges duplicates,
+ * renumbering operands in the laid-out code. */
+static void compact_constants(LunaChunk *chunk) {
+    if (chunk->const_len == 0) return;
+    int *remap = malloc(chunk->const_len * sizeof(int));
+    for (size_t i = 0; i < chunk->const_len; i++) remap[i] = -1;
+    Value *kept = malloc(chunk->const_len * sizeof(Value));
+    size_t *kept_src = malloc(chunk->const_len * sizeof(size_t));
+    size_t kept_len = 0;
+
+    int pos[260];
+    for (size_t off = 0; off < chunk->code_len; ) {
+        int len = luna_chunk_op_length(chunk, off);
+        LunaInsn *w = chunk->code + off;
+        int n = const_operands(w, len, pos);
+        for (int k = 0; k < n; k++) {
+            uint32_t idx = pos[k] ? w[pos[k]] : LUNA_BX(w[0]);
+            if (remap[idx] < 0) {
+                Value v = chunk->constants[idx];
+                size_t j = 0;
+                while (j < kept_len && !constants_equal(kept[j], v)) j++;
+                if (j == kept_len) {
+                    kept_src[kept_len] = idx;
+                    kept[kept_len++] = v;
+                }
+                remap[idx] = (int)j;
+            }
+            if (pos[k]) w[pos[k]] = (LunaInsn)remap[idx];
+            else w[0] = luna_insn_with_bx(w[0], (uint16_t)remap[idx]);
+        }
+        off += (size_t)len;
+    }
+
+    for (size_t i = 0; i < chunk->const_len; i++) {
+        if (remap[i] < 0 || kept_src[remap[i]] != i) value_free(chunk->constants[i]);
+    }
+    free(kept_src);
+    free(remap);
+    free(chunk->constants);
+    chunk->constants = kept;
+    chunk->const_len = kept_len;
+    chunk->const_cap = chunk->const_len ? chunk->const_len : 1;
+}
+
+void luna_optimize_chunk(LunaChunk *chunk, int level) {
+    if (!chunk) return;
+    for (int i = 0; i < chunk->subchunk_len; i++) {
+        luna_optimize_chunk(chunk->subchunks[i], level);
+    }
+    luna_vm_stats.opt_bytes_in += chunk->code_len * sizeof(LunaInsn);
+    if (level <= 0 || chunk->code_len == 0) {
+        luna_vm_stats.opt_bytes_out += chunk->code_len * sizeof(LunaInsn);
+        return;
+    }
+
+    Optimizer o;
+    memset(&o, 0, sizeof(o));
+    o.chunk = chunk;
+    if (opt_decode(&o)) {
+        for (int round = 0; round < 8; round++) {
+            o.changed = 0;
+            if (level >= 2) {
+                mark_leaders(&o);
+                fold_constants(&o);
+                mark_leaders(&o);
+                propagate_copies(&o);
+            }
+            thread_jumps(&o);
+            remove_unreachable(&o);
+            remove_nops(&o);
+            if (level >= 2) {
+                mark_leaders(&o);
+                compute_liveness(&o);
+                eliminate_dead_stores(&o);
+                mark_leaders(&o);
+                coalesce_moves(&o);
+            }
+            if (!o.changed) break;
+        }
+        if (opt_emit(&o)) compact_constants(chunk);
+    }
+    luna_vm_stats.opt_bytes_out += chunk->code_len * sizeof(LunaInsn);
+
+    for (int i = 0; i < o.count; i++) free(o.insns[i].targets);
+    free(o.insns);
+    free(o.work);
+    free(o.leader);
+    free(o.live_out);
+}
@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#ifndef LUNA_OPTIMIZER_H
+#define LUNA_OPTIMIZER_H
+
+#include "luna_chunk.h"
+
+/* Bytecode optimization levels, selected with LUNA_VM_OPT (default 2):
+ *   0  off: run the code exactly as the compiler emitted it
+ *   1  jump threading, unreachable-code removal, no-op MOVE/JUMP removal,
+ *      constant-pool deduplication
+ *   2  level 1 plus constant folding (including constant branches), copy
+ *      propagation, MOVE coalescing and dead-store elimination */
+#define LUNA_OPT_DEFAULT_LEVEL 2
+
+int  luna_optimizer_level(void);
+
+/* Rewrites chunk and all of its subchunks in place. Must run before the chunk
+ * is first executed (quickening and inline caches assume stable offsets). */
+void luna_optimize_chunk(LunaChunk *chunk, int level);
+
+#endif // LUNA_OPTIMIZER_H
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#include <stdlib.h>
+#include <string.h>
+#include "luna_prefetch.h"
+#include "luna_optimizer.h"
+#include "luna_vm.h"
+#include "luna_error.h"
+#include "module_cache.h"
+#include "arena.h"
+#include "util.h"
+#include "gc.h"
+
+typedef struct {
+    const char  *key;   // module_cache_key(path)
+    const char  *path;  // as written in the first import that reached it
+    char        *src;
+    LunaUnit    *unit;  // NULL once taken, or if the module failed
+    LunaVMStats  stats; // front-end counters gathered by the worker
+} PrefetchEntry;
+
+static PrefetchEntry *entries = NULL;
+static int entry_count = 0;
+static int entry_capacity = 0;
+
+static int prefetch_enabled = -1;
+
+static int import_prefetch_enabled(void) {
+    if (prefetch_enabled < 0) {
+        const char *raw = getenv("LUNA_IMPORT_PREFETCH");
+        prefetch_enabled = !(raw && strcmp(raw, "0") == 0);
+    }
+    return prefetch_enabled;
+}
+
+static PrefetchEntry *prefetch_find(const char *key) {
+    for (int i = 0; i < entry_count; i++) {
+        if (entries[i].key == key) return &entries[i];
+    }
+    return NULL;
+}
+
+static void prefetch_add(const char *path) {
+    const char *key = module_cache_key(path);
+    if (prefetch_find(key)) return;
+    if (entry_count == entry_capacity) {
+        entry_capacity = entry_capacity < 8 ? 8 : entry_capacity * 2;
+        entries = realloc(entries, sizeof(PrefetchEntry) * (size_t)entry_capacity);
+        if (!entries) abort();
+    }
+    memset(&entries[entry_count], 0, sizeof(PrefetchEntry));
+    entries[entry_count].key = key;
+    entries[entry_count].path = path;
+    entry_count++;
+}
+
+static void unit_discard(LunaUnit *unit) {
+    if (!unit) return;
+    if (unit->chunk) {
+        luna_chunk_free(unit->chunk);
+        free(unit->chunk);
+    }
+    luna_unit_free(unit);
+}
+
+/* Runs on a pool thread: the usual front end, with errors kept quiet and
+ * nodes in an arena of the module's own. */
+static void prefetch_build(PrefetchEntry *e) {
+    char *src = read_file(e->path);
+    if (!src) return;
+
+    LunaVMStats before = luna_vm_stats;
+    error_set_quiet(1);
+    Arena *prev = ast_use_new_arena();
+    LunaUnit *unit = luna_unit_from_source(src);
+    ast_restore_arena(prev);
+    int failed = !unit || error_failed();
+    error_clear_last();
+    error_set_quiet(0);
+
+    // The counters travel back in the entry; this thread's are left as found
+    e->stats.opt_bytes_in = luna_vm_stats.opt_bytes_in - before.opt_bytes_in;
+    e->stats.opt_bytes_out = luna_vm_stats.opt_bytes_out - before.opt_bytes_out;
+    e->stats.cache_hits = luna_vm_stats.cache_hits - before.cache_hits;
+    e->stats.cache_misses = luna_vm_stats.cache_misses - before.cache_misses;
+    luna_vm_stats = before;
+
+    if (failed) {
+        unit_discard(unit);
+        free(src);
+        return;
+    }
+    e->src = src;
+    e->unit = unit;
+}
+
+void luna_prefetch_imports(const LunaUnit *entry) {
+    if (!entry || entry->import_count == 0 || luna_had_error) return;
+    if (!import_prefetch_enabled()) return;
+
+    // Settings read lazily by the front end, read here before any worker can
+    luna_unit_cache_enabled();
+    luna_optimizer_level();
+
+    int begin = entry_count;
+    for (int i = 0; i < entry->import_count; i++) {
+        prefetch_add(entry->imports[i]);
+    }
+
+    while (begin < entry_count) {
+        int end = entry_count;
+        luna_gc_runtime_set_shared(1);
+        #pragma omp parallel for schedule(dynamic, 1) if (end - begin > 1)
+        for (int i = begin; i < end; i++) {
+            prefetch_build(&entries[i]);
+        }
+        luna_gc_runtime_set_shared(0);
+
+        // The next level: what this one imports, in import order
+        for (int i = begin; i < end; i++) {
+            LunaUnit *unit = entries[i].unit;
+            luna_vm_stats.opt_bytes_in += entries[i].stats.opt_bytes_in;
+            luna_vm_stats.opt_bytes_out += entries[i].stats.opt_bytes_out;
+            luna_vm_stats.cache_hits += entries[i].stats.cache_hits;
+            luna_vm_stats.cache_misses += entries[i].stats.cache_misses;
+            if (!unit) continue;
+            for (int k = 0; k < unit->import_count; k++) {
+                prefetch_add(unit->imports[k]);
+            }
+        }
+        begin = end;
+    }
+}
+
+LunaUnit *luna_prefetch_take(const char *path, char **src) {
+    if (entry_count == 0) return NULL;
+    PrefetchEntry *e = prefetch_find(module_cache_key(path));
+    if (!e || !e->unit) return NULL;
+
+    // The program may have rewritten the file since it was prefetched; the
+    // unit is only good for the exact text it was compiled from
+    char *current = read_file(path);
+    int fresh = current && strcmp(current, e->src) == 0;
+    free(current);
+    if (!fresh) {
+        unit_discard(e->unit);
+        free(e->src);
+        e->unit = NULL;
+        e->src = NULL;
+        return NULL;
+    }
+
+    LunaUnit *unit = e->unit;
+    *src = e->src;
+    e->unit = NULL;
+    e->src = NULL;
+    return unit;
+}
+
+void luna_prefetch_each_chunk(void (*fn)(LunaChunk *chunk, void *ctx), void *ctx) {
+    for (int i = 0; i < entry_count; i++) {
+        if (entries[i].unit) fn(entries[i].unit->chunk, ctx);
+    }
+}
+
+void luna_prefetch_clear(void) {
+    for (int i = 0; i < entry_count; i++) {
+        unit_discard(entries[i].unit);
+        free(entries[i].src);
+    }
+    free(entries);
+    entries = NULL;
+    entry_count = 0;
+    entry_capacity = 0;
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#ifndef LUNA_PREFETCH_H
+#define LUNA_PREFETCH_H
+
+#include "luna_unit.h"
+
+/* Import prefetch. Before the entry file runs, luna_prefetch_imports follows
+ * its static import graph (top-level `import` / `use` with literal paths,
+ * transitively) and reads, parses and compiles every module it reaches,
+ * one graph level at a time, the modules of a level in parallel on the
+ * OpenMP thread pool. Modules still run at their import statements, in
+ * program order; VM_OP_IMPORT just finds the unit ready. A module that fails
+ * to read, parse or compile is dropped and handled at the import as before,
+ * so diagnostics come out unchanged. LUNA_IMPORT_PREFETCH=0 turns it off;
+ * OMP_NUM_THREADS caps the workers. */
+void luna_prefetch_imports(const LunaUnit *entry);
+
+/* Hands over the prefetched unit for path and its source text (the caller
+ * frees both, as for luna_unit_from_source), or returns NULL. The file is
+ * read again first: if its text changed since the prefetch, the unit is
+ * dropped and NULL returned, so the import compiles what is there now. */
+LunaUnit *luna_prefetch_take(const char *path, char **src);
+
+/* Calls fn on every chunk still waiting for its import, so the GC keeps
+ * their constants alive. */
+void luna_prefetch_each_chunk(void (*fn)(LunaChunk *chunk, void *ctx), void *ctx);
+
+/* Frees the units that were never imported. */
+void luna_prefetch_clear(void);
+
+#endif // LUNA_PREFETCH_H
@@ -0,0 +1,822 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "luna_unit.h"
+#include "luna_compiler.h"
+#include "luna_optimizer.h"
+#include "luna_vm.h"
+#include "luna_error.h"
+#include "parser.h"
+#include "intern.h"
+#include "env.h"
+#include "library.h"
+
+/* .luc layout, all integers little-endian:
+ *   header  "LUC\0", u32 version, u64 key, u64 source length,
+ *           u64 FNV-1a hash of everything after the header
+ *   defs    u32 count, then per def: u8 is_bloc, u8 is_template, str name,
+ *           u32 field_count, str fields...
+ *   exports u32 count, str names...
+ *   imports u32 count, str paths...
+ *   chunk   str name, i32 reg_count/param_count/upvalue_count,
+ *           u32 code_len, code_len u32 instruction words, u32 line
+ *           run count, then per run u32 code offset + i32 line,
+ *           u32 const_len, per constant u8 type + payload,
+ *           u32 global cache names, u32 field cache names (str each),
+ *           u32 subchunk_len, subchunks (same layout, recursively)
+ * A str is u32 length + bytes. Inline-cache state is never stored: it is
+ * rebuilt on first execution like it is for freshly compiled chunks. */
+#define LUC_MAGIC "LUC"
+#define LUC_VERSION 8
+#define LUC_HEADER_SIZE 32
+
+static int cache_enabled = -1;
+
+int luna_unit_cache_enabled(void) {
+    if (cache_enabled < 0) {
+        const char *raw = getenv("LUNA_BYTECODE_CACHE");
+        cache_enabled = !(raw && strcmp(raw, "0") == 0);
+    }
+    return cache_enabled;
+}
+
+/* ---- metadata from the AST ---- */
+
+static void unit_add_export(LunaUnit *unit, const char *name) {
+    for (int i = 0; i < unit->export_count; i++) {
+        if (unit->exports[i] == name) return;
+    }
+    const char **grown = (const char **)realloc((void *)unit->exports,
+        sizeof(const char *) * (size_t)(unit->export_count + 1));
+    if (!grown) abort();
+    grown[unit->export_count++] = name;
+    unit->exports = grown;
+}
+
+static void unit_add_import(LunaUnit *unit, const char *path) {
+    for (int i = 0; i < unit->import_count; i++) {
+        if (unit->imports[i] == path) return;
+    }
+    const char **grown = (const char **)realloc((void *)unit->imports,
+        sizeof(const char *) * (size_t)(unit->import_count + 1));
+    if (!grown) abort();
+    grown[unit->import_count++] = path;
+    unit->imports = grown;
+}
+
+static void unit_add_def(LunaUnit *unit, const char *name, const char **fields,
+                         int field_count, int is_bloc, int is_template) {
+    LunaUnitDef *grown = (LunaUnitDef *)realloc(unit->defs,
+        sizeof(LunaUnitDef) * (size_t)(unit->def_count + 1));
+    if (!grown) abort();
+    unit->defs = grown;
+    LunaUnitDef *d = &unit->defs[unit->def_count++];
+    d->name = name;
+    d->field_count = field_count;
+    d->is_bloc = is_bloc;
+    d->is_template = is_template;
+    d->fields = field_count > 0 ? (const char **)malloc(sizeof(const char *) * (size_t)field_count) : NULL;
+    for (int i = 0; i < field_count; i++) {
+        d->fields[i] = fields[i];
+    }
+}
+
+static void unit_collect(LunaUnit *unit, AstNode *n) {
+    if (!n) return;
+    if (n->kind == NODE_BLOCK) {
+        for (int i = 0; i < n->block.items.count; i++) {
+            unit_collect(unit, n->block.items.items[i]);
+        }
+        return;
+    }
+    if (n->kind == NODE_DATA_DEF) {
+        unit_add_def(unit, n->data_def.name, n->data_def.fields, n->data_def.field_count,
+                     0, n->data_def.is_template);
+    } else if (n->kind == NODE_BLOC_DEF) {
+        unit_add_def(unit, n->bloc_def.name, n->bloc_def.fields, n->bloc_def.field_count, 1, 0);
+    } else if (n->kind == NODE_IMPORT) {
+        unit_add_import(unit, intern_string(n->import_stmt.path));
+    }
+
+    const char *name = NULL;
+    if (n->kind == NODE_LET && n->let.is_export) name = n->let.name;
+    else if (n->kind == NODE_FUNC_DEF && n->funcdef.is_export && n->funcdef.name) name = n->funcdef.name;
+    else if (n->kind == NODE_DATA_DEF && n->data_def.is_export) name = n->data_def.name;
+    else if (n->kind == NODE_BLOC_DEF && n->bloc_def.is_export) name = n->bloc_def.name;
+    if (name) unit_add_export(unit, name);
+}
+
+void luna_unit_define(LunaUnit *unit, Env *env) {
+    for (int i = 0; i < unit->def_count; i++) {
+        LunaUnitDef *d = &unit->defs[i];
+        if (d->is_bloc) {
+            Value btype = value_bloc_type(d->name, d->fields, d->field_count);
+            if (VALUE_TYPE(btype) != VAL_NULL) {
+                env_def_move(env, d->name, &btype);
+            }
+        } else {
+            Value dtype = value_data_type(d->name, d->fields, d->field_count, d->is_template);
+            env_def_move(env, d->name, &dtype);
+        }
+    }
+}
+
+void luna_unit_free(LunaUnit *unit) {
+    if (!unit) return;
+    for (int i = 0; i < unit->def_count; i++) {
+        free((void *)unit->defs[i].fields);
+    }
+    free(unit->defs);
+    free((void *)unit->exports);
+    free((void *)unit->imports);
+    free(unit);
+}
+
+/* ---- cache key and location ---- */
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* Covers the payload after the header, so a damaged file is recompiled
+ * instead of being read as bytecode. */
+static uint64_t luc_checksum(const uint8_t *data, size_t len) {
+    return fnv1a(14695981039346656037ULL, data, len);
+}
+
+/* Identifies the interpreter binary, so a rebuild (new opcodes, new layout)
+ * never reads bytecode written by another build. */
+static uint64_t build_id(void) {
+    static uint64_t id = 0;
+    if (id) return id;
+    uint64_t h = 14695981039346656037ULL;
+    uint32_t version = LUC_VERSION;
+    h = fnv1a(h, &version, sizeof(version));
+    struct stat st;
+    if (stat("/proc/self/exe", &st) == 0) {
+        int64_t parts[3] = { (int64_t)st.st_size, (int64_t)st.st_mtime, (int64_t)st.st_ino };
+        h = fnv1a(h, parts, sizeof(parts));
+    }
+    id = h;
+    return id;
+}
+
+static uint64_t cache_key(const char *src, size_t len) {
+    uint64_t h = build_id();
+    int level = luna_optimizer_level();
+    h = fnv1a(h, &level, sizeof(level));
+    return fnv1a(h, src, len);
+}
+
+static int cache_dir(char *out, size_t cap) {
+    const char *dir = getenv("LUNA_CACHE_DIR");
+    if (dir && dir[0]) {
+        snprintf(out, cap, "%s", dir);
+    } else if ((dir = getenv("XDG_CACHE_HOME")) && dir[0]) {
+        snprintf(out, cap, "%s/luna", dir);
+    } else if ((dir = getenv("HOME")) && dir[0]) {
+        snprintf(out, cap, "%s/.cache/luna", dir);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static int cache_path(uint64_t key, char *out, size_t cap) {
+    char dir[1024];
+    if (!cache_dir(dir, sizeof(dir))) return 0;
+    int n = snprintf(out, cap, "%s/%016llx.luc", dir, (unsigned long long)key);
+    return n > 0 && (size_t)n < cap;
+}
+
+/* mkdir -p for the cache directory; failures surface when the file is opened. */
+static void cache_mkdirs(void) {
+    char dir[1024];
+    if (!cache_dir(dir, sizeof(dir))) return;
+    for (char *p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(dir, 0755);
+        *p = '/';
+    }
+    mkdir(dir, 0755);
+}
+
+/* ---- writer ---- */
+
+typedef struct {
+    uint8_t *data;
+    size_t   len;
+    size_t   cap;
+    int      ok; // cleared when the chunk holds something that cannot be stored
+} LucWriter;
+
+static void w_bytes(LucWriter *w, const void *p, size_t n) {
+    if (w->len + n > w->cap) {
+        size_t cap = w->cap ? w->cap : 4096;
+        while (cap < w->len + n) cap *= 2;
+        uint8_t *grown = (uint8_t *)realloc(w->data, cap);
+        if (!grown) abort();
+        w->data = grown;
+        w->cap = cap;
+    }
+    memcpy(w->data + w->len, p, n);
+    w->len += n;
+}
+
+static void w_u8(LucWriter *w, uint8_t v) { w_bytes(w, &v, 1); }
+
+static void w_u32(LucWriter *w, uint32_t v) {
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    w_bytes(w, b, 4);
+}
+
+static void w_u64(LucWriter *w, uint64_t v) {
+    w_u32(w, (uint32_t)v);
+    w_u32(w, (uint32_t)(v >> 32));
+}
+
+static void w_str(LucWriter *w, const char *s) {
+    size_t n = s ? strlen(s) : 0;
+    w_u32(w, (uint32_t)n);
+    w_bytes(w, s, n);
+}
+
+static void w_chunk(LucWriter *w, const LunaChunk *chunk) {
+    w_str(w, chunk->name);
+    w_u32(w, (uint32_t)chunk->reg_count);
+    w_u32(w, (uint32_t)chunk->param_count);
+    w_u32(w, (uint32_t)chunk->upvalue_count);
+
+    w_u32(w, (uint32_t)chunk->code_len);
+    for (size_t i = 0; i < chunk->code_len; i++) w_u32(w, chunk->code[i]);
+    w_u32(w, (uint32_t)chunk->line_len);
+    for (size_t i = 0; i < chunk->line_len; i++) {
+        w_u32(w, chunk->lines[i].offset);
+        w_u32(w, (uint32_t)chunk->lines[i].line);
+    }
+
+    w_u32(w, (uint32_t)chunk->const_len);
+    for (size_t i = 0; i < chunk->const_len; i++) {
+        Value v = chunk->constants[i];
+        w_u8(w, (uint8_t)VALUE_TYPE(v));
+        switch (VALUE_TYPE(v)) {
+            case VAL_INT:    w_u64(w, (uint64_t)VALUE_AS_INT(v)); break;
+            case VAL_FLOAT: {
+                uint64_t bits;
+                double x = VALUE_AS_FLOAT(v);
+                memcpy(&bits, &x, sizeof(bits));
+                w_u64(w, bits);
+                break;
+            }
+            case VAL_STRING: w_str(w, VALUE_AS_STRING(v) ? VALUE_AS_STRING(v)->chars : ""); break;
+            case VAL_CHAR:   w_u8(w, (uint8_t)VALUE_AS_CHAR(v)); break;
+            case VAL_BOOL:   w_u8(w, (uint8_t)VALUE_AS_BOOL(v)); break;
+            case VAL_NULL:   break;
+            default:         w->ok = 0; break;
+        }
+    }
+
+    w_u32(w, (uint32_t)chunk->global_cache_len);
+    for (size_t i = 0; i < chunk->global_cache_len; i++) {
+        w_str(w, chunk->global_caches[i].name);
+    }
+    w_u32(w, (uint32_t)chunk->field_cache_len);
+    for (size_t i = 0; i < chunk->field_cache_len; i++) {
+        w_str(w, chunk->field_caches[i].name);
+    }
+
+    w_u32(w, (uint32_t)chunk->subchunk_len);
+    for (int i = 0; i < chunk->subchunk_len; i++) {
+        w_chunk(w, chunk->subchunks[i]);
+    }
+}
+
+/* Writes to a temporary name and renames it into place, so a concurrent run
+ * never maps a half-written file. The name includes the unit's address as
+ * well as the pid: prefetch workers may store two identical files at once. */
+static void cache_store(const char *src, size_t len, const LunaUnit *unit) {
+    char path[1100];
+    uint64_t key = cache_key(src, len);
+    if (!cache_path(key, path, sizeof(path))) return;
+
+    LucWriter w = { NULL, 0, 0, 1 };
+    w_bytes(&w, LUC_MAGIC, 4);
+    w_u32(&w, LUC_VERSION);
+    w_u64(&w, key);
+    w_u64(&w, (uint64_t)len);
+    w_u64(&w, 0); // checksum, filled in below
+
+    w_u32(&w, (uint32_t)unit->def_count);
+    for (int i = 0; i < unit->def_count; i++) {
+        const LunaUnitDef *d = &unit->defs[i];
+        w_u8(&w, (uint8_t)d->is_bloc);
+        w_u8(&w, (uint8_t)d->is_template);
+        w_str(&w, d->name);
+        w_u32(&w, (uint32_t)d->field_count);
+        for (int k = 0; k < d->field_count; k++) w_str(&w, d->fields[k]);
+    }
+    w_u32(&w, (uint32_t)unit->export_count);
+    for (int i = 0; i < unit->export_count; i++) w_str(&w, unit->exports[i]);
+    w_u32(&w, (uint32_t)unit->import_count);
+    for (int i = 0; i < unit->import_count; i++) w_str(&w, unit->imports[i]);
+    w_chunk(&w, unit->chunk);
+
+    uint64_t sum = luc_checksum(w.data + LUC_HEADER_SIZE, w.len - LUC_HEADER_SIZE);
+    for (int i = 0; i < 8; i++) w.data[LUC_HEADER_SIZE - 8 + i] = (uint8_t)(sum >> (8 * i));
+
+    if (w.ok) {
+        cache_mkdirs();
+        char tmp[1200];
+        snprintf(tmp, sizeof(tmp), "%s.%ld.%p.tmp", path, (long)getpid(), (const void *)unit);
+        FILE *f = fopen(tmp, "wb");
+        if (f) {
+            int good = fwrite(w.data, 1, w.len, f) == w.len;
+            good = (fclose(f) == 0) && good;
+            if (!good || rename(tmp, path) != 0) remove(tmp);
+        }
+    }
+    free(w.data);
+}
+
+/* ---- reader ---- */
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    int            ok; // cleared on any truncated or malformed field
+} LucReader;
+
+static const uint8_t *r_take(LucReader *r, size_t n) {
+    if (!r->ok || (size_t)(r->end - r->p) < n) {
+        r->ok = 0;
+        return NULL;
+    }
+    const uint8_t *at = r->p;
+    r->p += n;
+    return at;
+}
+
+static uint8_t r_u8(LucReader *r) {
+    const uint8_t *b = r_take(r, 1);
+    return b ? b[0] : 0;
+}
+
+static uint32_t r_u32(LucReader *r) {
+    const uint8_t *b = r_take(r, 4);
+    if (!b) return 0;
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint64_t r_u64(LucReader *r) {
+    uint64_t lo = r_u32(r);
+    uint64_t hi = r_u32(r);
+    return lo | (hi << 32);
+}
+
+/* Returns an interned copy of the next string. */
+static const char *r_str(LucReader *r) {
+    uint32_t n = r_u32(r);
+    const uint8_t *b = r_take(r, n);
+    if (!b) return NULL;
+    char small[256];
+    char *buf = n < sizeof(small) ? small : (char *)malloc(n + 1);
+    memcpy(buf, b, n);
+    buf[n] = '\0';
+    const char *s = intern_string(buf);
+    if (buf != small) free(buf);
+    return s;
+}
+
+static LunaChunk *r_chunk(LucReader *r, int depth) {
+    if (depth > 256) {
+        r->ok = 0;
+        return NULL;
+    }
+    LunaChunk *chunk = (LunaChunk *)malloc(sizeof(LunaChunk));
+    luna_chunk_init(chunk);
+    chunk->name = r_str(r);
+    chunk->reg_count = (int)r_u32(r);
+    chunk->param_count = (int)r_u32(r);
+    chunk->upvalue_count = (int)r_u32(r);
+
+    uint32_t code_len = r_u32(r);
+    if (r->ok && code_len > 0 && (size_t)(r->end - r->p) / 4 >= code_len) {
+        chunk->code = (LunaInsn *)malloc(code_len * sizeof(LunaInsn));
+        for (uint32_t i = 0; i < code_len; i++) chunk->code[i] = r_u32(r);
+        chunk->code_len = chunk->code_cap = code_len;
+    } else if (code_len > 0) {
+        r->ok = 0;
+    }
+    uint32_t run_count = r_u32(r);
+    for (uint32_t i = 0; i < run_count && r->ok; i++) {
+        uint32_t offset = r_u32(r);
+        int line = (int)r_u32(r);
+        if (r->ok) luna_chunk_add_line(chunk, offset, line);
+    }
+
+    uint32_t const_len = r_u32(r);
+    for (uint32_t i = 0; i < const_len && r->ok; i++) {
+        Value v = value_null();
+        switch ((ValueType)r_u8(r)) {
+            case VAL_INT:   v = value_int((long long)r_u64(r)); break;
+            case VAL_FLOAT: {
+                uint64_t bits = r_u64(r);
+                double d;
+                memcpy(&d, &bits, sizeof(d));
+                v = value_float(d);
+                break;
+            }
+            case VAL_STRING: {
+                const char *s = r_str(r);
+                if (s) v = value_string(s);
+                break;
+            }
+            case VAL_CHAR:  v = value_char((char)r_u8(r)); break;
+            case VAL_BOOL:  v = value_bool(r_u8(r)); break;
+            case VAL_NULL:  break;
+            default:        r->ok = 0; break;
+        }
+        /* Appended directly: luna_chunk_add_constant would merge duplicates
+         * and shift the indices the code refers to. */
+        if (chunk->const_len >= chunk->const_cap) {
+            chunk->const_cap = chunk->const_cap ? chunk->const_cap * 2 : 16;
+            chunk->constants = realloc(chunk->constants, chunk->const_cap * sizeof(Value));
+        }
+        chunk->constants[chunk->const_len++] = v;
+    }
+
+    uint32_t global_len = r_u32(r);
+    for (uint32_t i = 0; i < global_len && r->ok; i++) {
+        luna_chunk_add_global_cache(chunk, r_str(r));
+    }
+    uint32_t field_len = r_u32(r);
+    for (uint32_t i = 0; i < field_len && r->ok; i++) {
+        luna_chunk_add_field_cache(chunk, r_str(r));
+    }
+
+    uint32_t sub_len = r_u32(r);
+    for (uint32_t i = 0; i < sub_len && r->ok; i++) {
+        LunaChunk *sub = r_chunk(r, depth + 1);
+        if (sub) luna_chunk_add_subchunk(chunk, sub);
+    }
+    return chunk;
+}
+
+/* ---- verifier ----
+ *
+ * The VM trusts its code: registers, constant and cache indexes and jump
+ * offsets are used without bounds checks. The checksum catches a damaged
+ * file; this catches anything else that did not come out of this compiler,
+ * so a bad file costs a recompile rather than a stray read or write. */
+
+/* Not cached in a static: prefetch workers verify on their own threads. */
+static int native_count(void) {
+    int n = 0;
+    while (luna_native_defs[n].name) n++;
+    return n;
+}
+
+static int reg_ok(const LunaChunk *chunk, unsigned first, unsigned n) {
+    return first + n <= (unsigned)chunk->reg_count;
+}
+
+static int name_ok(const LunaChunk *chunk, uint32_t idx) {
+    return idx < chunk->const_len && VALUE_TYPE(chunk->constants[idx]) == VAL_STRING;
+}
+
+/* Length in words of the instruction at `off`, or 0 when it does not fit
+ * in the code. Checks the operands luna_chunk_op_length reads first. */
+static size_t verify_length(const LunaChunk *chunk, size_t off) {
+    const LunaInsn *ip = chunk->code + off;
+    size_t left = chunk->code_len - off;
+    size_t len;
+    switch (LUNA_OP(ip[0])) {
+        case VM_OP_CLOSURE:
+            if (LUNA_BX(ip[0]) >= (unsigned)chunk->subchunk_len) return 0;
+            if ((size_t)chunk->subchunks[LUNA_BX(ip[0])]->upvalue_count >= left) return 0;
+            len = (size_t)luna_chunk_op_length(chunk, off);
+            break;
+        case VM_OP_SWITCH_TABLE:
+            if (left < 2) return 0;
+            len = 4 + (size_t)ip[1];
+            break;
+        case VM_OP_SWITCH_HASH:
+            if (left < 2) return 0;
+            len = 4 + 2 * (size_t)ip[1] + LUNA_BX(ip[0]) + 1;
+            break;
+        default:
+            len = (size_t)luna_chunk_op_length(chunk, off);
+            break;
+    }
+    return len <= left ? len : 0;
+}
+
+static int verify_operands(const LunaChunk *chunk, const LunaInsn *ip) {
+    unsigned a = LUNA_A(ip[0]), b = LUNA_B(ip[0]), c = LUNA_C(ip[0]);
+    unsigned bx = LUNA_BX(ip[0]);
+    switch (LUNA_OP(ip[0])) {
+        case VM_OP_HALT:
+        case VM_OP_JUMP:
+        case VM_OP_SCOPE_BEGIN:
+        case VM_OP_SCOPE_EXIT:
+        case VM_OP_UNSAFE_BEGIN:
+        case VM_OP_UNSAFE_END:
+        case VM_OP_SAFEPOINT:
+            return 1;
+        case VM_OP_LOAD_INT:
+        case VM_OP_LOAD_FLOAT:
+        case VM_OP_LOAD_INT64:
+        case VM_OP_LOAD_FLOAT64:
+        case VM_OP_LOAD_TRUE:
+        case VM_OP_LOAD_FALSE:
+        case VM_OP_LOAD_NULL:
+        case VM_OP_NEW_LIST:
+        case VM_OP_NEW_MAP:
+        case VM_OP_RETURN:
+        case VM_OP_PRINT:
+        case VM_OP_JUMP_IF_TRUE:
+        case VM_OP_JUMP_IF_FALSE:
+        case VM_OP_INC_LOCAL:
+        case VM_OP_HAS_ARG:
+        case VM_OP_SWITCH_TABLE:
+            return reg_ok(chunk, a, 1);
+        case VM_OP_LOAD_CONST:
+            return reg_ok(chunk, a, 1) && bx < chunk->const_len;
+        case VM_OP_ADDR_OF_GLOBAL:
+            return reg_ok(chunk, a, 1) && name_ok(chunk, bx);
+        case VM_OP_GET_GLOBAL:
+        case VM_OP_SET_GLOBAL:
+            return reg_ok(chunk, a, 1) && bx < chunk->global_cache_len;
+        case VM_OP_GET_UPVAL:
+            return reg_ok(chunk, a, 1) && b < (unsigned)chunk->upvalue_count;
+        case VM_OP_SET_UPVAL:
+            return a < (unsigned)chunk->upvalue_count && reg_ok(chunk, b, 1);
+        case VM_OP_MOVE:
+        case VM_OP_NOT:
+        case VM_OP_NEG:
+        case VM_OP_LIST_APPEND:
+        case VM_OP_BOX_ALLOC:
+        case VM_OP_ADDR_OF:
+        case VM_OP_ADDI:
+        case VM_OP_JUMP_IF_NOT_LT:
+        case VM_OP_JUMP_IF_NOT_LTE:
+        case VM_OP_JUMP_IF_NOT_GT:
+        case VM_OP_JUMP_IF_NOT_GTE:
+        case VM_OP_LOOP_IF_LT:
+        case VM_OP_LOOP_IF_LTE:
+        case VM_OP_LOOP_IF_GT:
+        case VM_OP_LOOP_IF_GTE:
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, 1);
+        case VM_OP_MAP_SET:
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, 1) && name_ok(chunk, ip[1]);
+        case VM_OP_FIELD_GET:
+        case VM_OP_FIELD_SET:
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, 1) && ip[1] < chunk->field_cache_len;
+        case VM_OP_CALL:
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, c + 1);
+        case VM_OP_CALL_NAMED:
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, c + 1) && name_ok(chunk, ip[1]);
+        case VM_OP_CALL_NATIVE:
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, c + 1) &&
+                   (int)(uint16_t)ip[1] < native_count() &&
+                   (ip[1] >> 16) < chunk->global_cache_len && name_ok(chunk, ip[2]);
+        case VM_OP_TAIL_CALL:
+            return reg_ok(chunk, a, b + 1) && name_ok(chunk, ip[1]);
+        case VM_OP_DEFER:
+            return reg_ok(chunk, a, b + 1);
+        case VM_OP_CONCAT_N:
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, c);
+        case VM_OP_CLOSURE: {
+            if (!reg_ok(chunk, a, 1)) return 0;
+            int captures = chunk->subchunks[bx]->upvalue_count;
+            for (int i = 1; i <= captures; i++) {
+                unsigned index = ip[i] >> 8;
+                if ((ip[i] & VM_CAPTURE_LOCAL) ? !reg_ok(chunk, index, 1)
+                                               : index >= (unsigned)chunk->upvalue_count) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        case VM_OP_IMPORT:
+            for (unsigned i = 0; i <= a; i++) {
+                if (!name_ok(chunk, ip[1 + i])) return 0;
+            }
+            return 1;
+        case VM_OP_SWITCH_HASH: {
+            /* Lookups probe until an empty slot, so there has to be one. */
+            uint32_t count = ip[1];
+            const LunaInsn *slot = ip + 4 + 2 * (size_t)count;
+            int empty = 0;
+            if (!reg_ok(chunk, a, 1)) return 0;
+            for (uint32_t k = 0; k < count; k++) {
+                if (!name_ok(chunk, ip[4 + 2 * k])) return 0;
+            }
+            for (unsigned h = 0; h <= bx; h++) {
+                if (slot[h] > count) return 0;
+                if (slot[h] == 0) empty = 1;
+            }
+            return empty;
+        }
+        case VM_OP_ADD:
+        case VM_OP_SUB:
+        case VM_OP_MUL:
+        case VM_OP_DIV:
+        case VM_OP_MOD:
+        case VM_OP_EQ:
+        case VM_OP_NEQ:
+        case VM_OP_LT:
+        case VM_OP_LTE:
+        case VM_OP_GT:
+        case VM_OP_GTE:
+        case VM_OP_INDEX_GET:
+        case VM_OP_INDEX_SET:
+        case VM_OP_FOR_ITER:
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, 1) && reg_ok(chunk, c, 1);
+        default:
+            /* Quickened forms have their generic op's three registers. */
+            if (LUNA_OP(ip[0]) < VM_OP_ADD_II || LUNA_OP(ip[0]) > VM_OP_GTE_FF) return 0;
+            return reg_ok(chunk, a, 1) && reg_ok(chunk, b, 1) && reg_ok(chunk, c, 1);
+    }
+}
+
+/* A branch from the instruction ending at `next` must land on the start of
+ * an instruction. */
+static int verify_target(const LunaChunk *chunk, const uint8_t *starts, size_t next, int32_t offset) {
+    int64_t target = (int64_t)next + offset;
+    return target >= 0 && (uint64_t)target < chunk->code_len && starts[target];
+}
+
+static int verify_chunk(const LunaChunk *chunk) {
+    if (chunk->reg_count < 0 || chunk->reg_count > 256 || chunk->param_count < 0 ||
+        chunk->param_count > chunk->reg_count || chunk->upvalue_count < 0 || chunk->code_len == 0) {
+        return 0;
+    }
+    uint8_t *starts = (uint8_t *)calloc(chunk->code_len, 1);
+    if (!starts) abort();
+    int ok = 1;
+    size_t off = 0, last = 0;
+    while (ok && off < chunk->code_len) {
+        size_t len = verify_length(chunk, off);
+        ok = len > 0 && verify_operands(chunk, chunk->code + off);
+        starts[off] = 1;
+        last = off;
+        off += len;
+    }
+    /* Falling off the end would run whatever follows the code array. */
+    Opcode end = LUNA_OP(chunk->code[last]);
+    ok = ok && (end == VM_OP_HALT || end == VM_OP_RETURN || end == VM_OP_JUMP);
+
+    for (off = 0; ok && off < chunk->code_len; off += verify_length(chunk, off)) {
+        const LunaInsn *ip = chunk->code + off;
+        size_t next = off + verify_length(chunk, off);
+        switch (LUNA_OP(ip[0])) {
+            case VM_OP_JUMP:
+            case VM_OP_JUMP_IF_TRUE:
+            case VM_OP_JUMP_IF_FALSE:
+                ok = verify_target(chunk, starts, next, LUNA_SBX(ip[0]));
+                break;
+            case VM_OP_JUMP_IF_NOT_LT:
+            case VM_OP_JUMP_IF_NOT_LTE:
+            case VM_OP_JUMP_IF_NOT_GT:
+            case VM_OP_JUMP_IF_NOT_GTE:
+            case VM_OP_LOOP_IF_LT:
+            case VM_OP_LOOP_IF_LTE:
+            case VM_OP_LOOP_IF_GT:
+            case VM_OP_LOOP_IF_GTE:
+            case VM_OP_FOR_ITER:
+                ok = verify_target(chunk, starts, next, (int32_t)ip[1]);
+                break;
+            case VM_OP_SWITCH_TABLE:
+            case VM_OP_SWITCH_HASH: {
+                ok = verify_target(chunk, starts, next, (int32_t)ip[LUNA_SWITCH_DEFAULT_POS]);
+                int count = luna_switch_case_count(ip);
+                for (int k = 0; ok && k < count; k++) {
+                    ok = verify_target(chunk, starts, next, (int32_t)ip[luna_switch_case_pos(ip, k)]);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    free(starts);
+
+    for (int i = 0; ok && i < chunk->subchunk_len; i++) {
+        ok = verify_chunk(chunk->subchunks[i]);
+    }
+    return ok;
+}
+
+static LunaUnit *cache_load(const char *src, size_t len) {
+    char path[1100];
+    uint64_t key = cache_key(src, len);
+    if (!cache_path(key, path, sizeof(path))) return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < LUC_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    LucReader r = { (const uint8_t *)map, (const uint8_t *)map + st.st_size, 1 };
+    const uint8_t *magic = r_take(&r, 4);
+    if (memcmp(magic, LUC_MAGIC, 4) != 0 || r_u32(&r) != LUC_VERSION ||
+        r_u64(&r) != key || r_u64(&r) != (uint64_t)len) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    uint64_t sum = r_u64(&r);
+    if (sum != luc_checksum(r.p, (size_t)(r.end - r.p))) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    LunaUnit *unit = (LunaUnit *)calloc(1, sizeof(LunaUnit));
+    uint32_t def_count = r_u32(&r);
+    for (uint32_t i = 0; i < def_count && r.ok; i++) {
+        int is_bloc = r_u8(&r);
+        int is_template = r_u8(&r);
+        const char *name = r_str(&r);
+        uint32_t field_count = r_u32(&r);
+        if (field_count > 4096) {
+            r.ok = 0;
+            break;
+        }
+        const char *fields[field_count ? field_count : 1];
+        for (uint32_t k = 0; k < field_count; k++) fields[k] = r_str(&r);
+        if (r.ok) unit_add_def(unit, name, fields, (int)field_count, is_bloc, is_template);
+    }
+    uint32_t export_count = r_u32(&r);
+    for (uint32_t i = 0; i < export_count && r.ok; i++) {
+        const char *name = r_str(&r);
+        if (name) unit_add_export(unit, name);
+    }
+    uint32_t import_count = r_u32(&r);
+    for (uint32_t i = 0; i < import_count && r.ok; i++) {
+        const char *path = r_str(&r);
+        if (path) unit_add_import(unit, path);
+    }
+    unit->chunk = r_chunk(&r, 0);
+    munmap(map, (size_t)st.st_size);
+
+    if (!r.ok || r.p != r.end || !unit->chunk || !verify_chunk(unit->chunk)) {
+        if (unit->chunk) {
+            luna_chunk_free(unit->chunk);
+            free(unit->chunk);
+        }
+        luna_unit_free(unit);
+        return NULL;
+    }
+    return unit;
+}
+
+/* ---- front end ---- */
+
+LunaUnit *luna_unit_from_source(const char *src) {
+    size_t len = strlen(src);
+    int use_cache = luna_unit_cache_enabled();
+    if (use_cache) {
+        LunaUnit *cached = cache_load(src, len);
+        if (cached) {
+            luna_vm_stats.cache_hits++;
+            return cached;
+        }
+        luna_vm_stats.cache_misses++;
+    }
+
+    Parser parser;
+    parser_init(&parser, src);
+    AstNode *prog = parser_parse_program(&parser);
+    parser_close(&parser);
+    if (!prog) return NULL;
+
+    LunaUnit *unit = (LunaUnit *)calloc(1, sizeof(LunaUnit));
+    unit->prog = prog;
+    unit_collect(unit, prog);
+    unit->chunk = luna_compile_program(prog);
+
+    if (use_cache && !error_failed()) {
+        cache_store(src, len, unit);
+    }
+    return unit;
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#ifndef LUNA_UNIT_H
+#define LUNA_UNIT_H
+
+#include "ast.h"
+#include "luna_chunk.h"
+
+struct Env;
+
+/* Top-level `data` / `bloc` declaration, registered before the chunk runs. */
+typedef struct {
+    const char  *name;   // interned
+    const char **fields; // interned
+    int          field_count;
+    int          is_bloc;
+    int          is_template;
+} LunaUnitDef;
+
+/* One source file ready to run on the VM: the compiled chunk plus the
+ * top-level metadata the runtime would otherwise read off the AST. Produced
+ * by the front end (lex, parse, compile) or loaded from the bytecode cache. */
+typedef struct {
+    LunaChunk    *chunk;
+    LunaUnitDef  *defs;
+    int           def_count;
+    const char  **exports;      // interned names of `export` declarations
+    int           export_count;
+    const char  **imports;      // interned paths of top-level import / use
+    int           import_count;
+    AstNode      *prog;         // NULL when the unit came from the cache
+} LunaUnit;
+
+/* Bytecode cache (.luc files). Enabled unless LUNA_BYTECODE_CACHE=0; files
+ * live in LUNA_CACHE_DIR, else $XDG_CACHE_HOME/luna, else ~/.cache/luna, and
+ * are named by a hash of the source text, the interpreter binary and the
+ * optimizer level, so edits and rebuilds simply miss. */
+int luna_unit_cache_enabled(void);
+
+/* Compiles src (a NUL-terminated file body), going through the cache when it
+ * is enabled. Returns NULL if parsing failed; errors are already reported. */
+LunaUnit *luna_unit_from_source(const char *src);
+
+/* Binds the unit's data and bloc types in env. */
+void luna_unit_define(LunaUnit *unit, struct Env *env);
+
+/* Frees the unit's metadata; the chunk and AST stay with the caller because
+ * closures and globals may still reference them. */
+void luna_unit_free(LunaUnit *unit);
+
+#endif // LUNA_UNIT_H
@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 // Copyright (c) 2026 Bharath
 
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS, MAP_NORESERVE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include "luna_vm.h"
 #include "luna_opcode.h"
 #include "env.h"
@@ -14,22 +16,245 @@
 #include "util.h"
 #include "unsafe_runtime.h"
 #include "luna_compiler.h"
+#include "luna_optimizer.h"
+#include "luna_jit.h"
+#include "luna_vm_profile.h"
+#include "luna_unit.h"
+#include "luna_prefetch.h"
+#include "module_cache.h"
 #include "vec_lib.h"
+#include "library.h"
+
+// LUNA_JIT, cached by luna_vm_init; checked on every taken back edge.
+static int vm_jit_on = 0;
 
 void luna_vm_init(LunaVM *vm, GCHeap *heap) {
+    vm->frames = (VMCallFrame *)malloc(sizeof(VMCallFrame) * VM_FRAMES_INIT);
+    vm->stack = (Value *)malloc(sizeof(Value) * VM_STACK_INIT);
+    if (!vm->frames || !vm->stack) abort();
+    for (int i = 0; i < VM_STACK_INIT; i++) {
+        vm->stack[i] = value_null();
+    }
     vm->frame_count = 0;
+    vm->frame_capacity = VM_FRAMES_INIT;
     vm->stack_top = vm->stack;
+    vm->stack_end = vm->stack + VM_STACK_INIT;
+    vm->stack_reserved = 0;
     vm->open_upvalues = NULL;
     vm->heap = heap;
     vm->env = NULL;
     vm->next_scope_id = 0;
     vm->scope_depth = 0;
     vm->deferred_count = 0;
+    vm_jit_on = luna_jit_enabled();
+    VM_PROFILE_INIT();
 }
 
 void luna_vm_free(LunaVM *vm) {
     // Free open upvalues
     vm->open_upvalues = NULL;
+    free(vm->frames);
+    if (vm->stack_reserved) {
+        munmap(vm->stack, sizeof(Value) * vm->stack_reserved);
+    } else {
+        free(vm->stack);
+    }
+    vm->stack_reserved = 0;
+    vm->frames = NULL;
+    vm->stack = vm->stack_top = vm->stack_end = NULL;
+    vm->frame_count = vm->frame_capacity = 0;
+}
+
+static int max_frames = -1;
+
+int luna_vm_max_frames(void) {
+    if (max_frames < 0) {
+        const char *raw = getenv("LUNA_VM_MAX_FRAMES");
+        max_frames = VM_FRAMES_LIMIT_DEFAULT;
+        if (raw && raw[0]) {
+            max_frames = atoi(raw);
+            if (max_frames < 1) max_frames = 1;
+        }
+    }
+    return max_frames;
+}
+
+/* Points frame slots and open upvalues at the stack's new home. */
+static void vm_rebase_stack(LunaVM *vm, Value *old, Value *moved) {
+    for (int i = 0; i < vm->frame_count; i++) {
+        vm->frames[i].slots = moved + (vm->frames[i].slots - old);
+    }
+    for (VMUpvalue *up = vm->open_upvalues; up; up = up->next) {
+        up->location = moved + (up->location - old);
+    }
+}
+
+/* Grows the value stack so it holds at least `needed` slots. Until the stack
+ * is pinned it may move: frame slots and open upvalues are rebased, and
+ * callers must reload any Value* they hold into the stack. */
+static void vm_grow_stack(LunaVM *vm, size_t needed) {
+    size_t old_cap = (size_t)(vm->stack_end - vm->stack);
+    size_t cap = old_cap;
+    while (cap < needed) cap *= 2;
+
+    if (vm->stack_reserved) {
+        // Pinned: the pages are already mapped, only the bound moves
+        if (cap > vm->stack_reserved) cap = vm->stack_reserved;
+        if (needed > cap) abort();
+        for (size_t i = old_cap; i < cap; i++) {
+            vm->stack[i] = value_null();
+        }
+        vm->stack_end = vm->stack + cap;
+        return;
+    }
+
+    Value *old = vm->stack;
+    size_t top = (size_t)(vm->stack_top - old);
+    Value *grown = (Value *)realloc(old, sizeof(Value) * cap);
+    if (!grown) abort();
+    for (size_t i = old_cap; i < cap; i++) {
+        grown[i] = value_null();
+    }
+    vm->stack = grown;
+    vm->stack_top = grown + top;
+    vm->stack_end = grown + cap;
+    if (grown != old) vm_rebase_stack(vm, old, grown);
+}
+
+/* Moves the stack into a mapping sized for luna_vm_max_frames() frames of
+ * 256 registers, so it never moves again: an address_of pointer into it can
+ * be stored anywhere (a list, a map, a global) and stay valid. Pages are only
+ * backed once a frame reaches them. */
+static void vm_pin_stack(LunaVM *vm) {
+    if (vm->stack_reserved) return;
+    size_t reserved = ((size_t)luna_vm_max_frames() + 1) * 256;
+    size_t cap = (size_t)(vm->stack_end - vm->stack);
+    if (reserved < cap) reserved = cap;
+
+    void *map = mmap(NULL, sizeof(Value) * reserved, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) abort();
+    Value *old = vm->stack;
+    Value *pinned = (Value *)map;
+    memcpy(pinned, old, sizeof(Value) * cap);
+    vm->stack = pinned;
+    vm->stack_top = pinned + (vm->stack_top - old);
+    vm->stack_end = pinned + cap;
+    vm->stack_reserved = reserved;
+    vm_rebase_stack(vm, old, pinned);
+    free(old);
+}
+
+// Source line of the instruction ending just before ip, from the run table.
+static int vm_op_line(LunaChunk *chunk, LunaInsn *ip) {
+    size_t off = (size_t)(ip - chunk->code);
+    if (off == 0 || chunk->line_len == 0) return 1;
+    return luna_chunk_line_at(chunk, off - 1);
+}
+
+/* Pushes a frame whose registers are stack[base, base + reg_count), growing
+ * the frame array and value stack as needed. Both may move, so the caller
+ * re-derives its frame and slot pointers. Exceeding luna_vm_max_frames() is
+ * fatal, like the native stack overflowing. */
+static VMCallFrame *vm_push_frame(LunaVM *vm, size_t base, int reg_count) {
+    if (vm->frame_count >= vm->frame_capacity) {
+        int limit = luna_vm_max_frames();
+        if (vm->frame_count >= limit) {
+            // The caller saved its ip before pushing; the overflow is
+            // reported at its call site.
+            VMCallFrame *caller = &vm->frames[vm->frame_count - 1];
+            int line = vm_op_line(caller->chunk, caller->ip);
+            char msg[128];
+            snprintf(msg, sizeof(msg), "Stack overflow: call depth exceeded %d frames", limit);
+            error_report_with_context(ERR_RUNTIME, line, 0, msg,
+                "Check for unbounded recursion, or raise the limit with LUNA_VM_MAX_FRAMES");
+            exit(1);
+        }
+        int cap = vm->frame_capacity * 2;
+        if (cap > limit) cap = limit;
+        VMCallFrame *grown = (VMCallFrame *)realloc(vm->frames, sizeof(VMCallFrame) * (size_t)cap);
+        if (!grown) abort();
+        vm->frames = grown;
+        vm->frame_capacity = cap;
+    }
+    if (base + (size_t)reg_count > (size_t)(vm->stack_end - vm->stack)) {
+        vm_grow_stack(vm, base + (size_t)reg_count);
+    }
+    VMCallFrame *frame = &vm->frames[vm->frame_count++];
+    frame->slots = vm->stack + base;
+    frame->closure = NULL;
+    frame->pinned = 0;
+    return frame;
+}
+
+_Thread_local LunaVMStats luna_vm_stats;
+
+/* Built with `make DISPATCH_COUNT=1`, every opcode dispatch and inline-cache
+ * hit or miss is counted so instruction-set changes can be compared by work
+ * done, not just time. Release builds do no counting on the hot path. */
+#ifdef LUNA_VM_COUNT_DISPATCH
+#define VM_COUNT_DISPATCH() (luna_vm_stats.dispatches++)
+#define VM_COUNT(counter) (luna_vm_stats.counter++)
+#else
+#define VM_COUNT_DISPATCH() ((void)0)
+#define VM_COUNT(counter) ((void)0)
+#endif
+
+void luna_vm_stats_print(FILE *out) {
+#ifdef LUNA_VM_COUNT_DISPATCH
+    fprintf(out, "[vm-stats] global ic: %llu hits, %llu misses\n",
+            (unsigned long long)luna_vm_stats.global_ic_hits,
+            (unsigned long long)luna_vm_stats.global_ic_misses);
+    fprintf(out, "[vm-stats] field ic:  %llu hits, %llu misses\n",
+            (unsigned long long)luna_vm_stats.field_ic_hits,
+            (unsigned long long)luna_vm_stats.field_ic_misses);
+    fprintf(out, "[vm-stats] map ic:    %llu hits, %llu misses\n",
+            (unsigned long long)luna_vm_stats.map_ic_hits,
+            (unsigned long long)luna_vm_stats.map_ic_misses);
+#endif
+    fprintf(out, "[vm-stats] bytecode:  %llu bytes compiled, %llu after optimizer (LUNA_VM_OPT=%d)\n",
+            (unsigned long long)luna_vm_stats.opt_bytes_in,
+            (unsigned long long)luna_vm_stats.opt_bytes_out,
+            luna_optimizer_level());
+    fprintf(out, "[vm-stats] .luc cache: %llu hits, %llu misses\n",
+            (unsigned long long)luna_vm_stats.cache_hits,
+            (unsigned long long)luna_vm_stats.cache_misses);
+    if (luna_jit_enabled()) {
+        fprintf(out, "[vm-stats] jit:       %llu loops compiled, %llu rejected, %llu entries, %llu side exits\n",
+                (unsigned long long)luna_vm_stats.jit_loops,
+                (unsigned long long)luna_vm_stats.jit_rejected,
+                (unsigned long long)luna_vm_stats.jit_entries,
+                (unsigned long long)luna_vm_stats.jit_side_exits);
+    }
+#ifdef LUNA_VM_COUNT_DISPATCH
+    fprintf(out, "[vm-stats] dispatches: %llu\n",
+            (unsigned long long)luna_vm_stats.dispatches);
+#endif
+}
+
+/* Resolves fc->name on a template/bloc through the instruction's shape cache.
+ * Returns -1 for other values and for missing fields (which are not cached). */
+static inline int vm_field_index(LunaFieldCache *fc, Value target) {
+    const void *shape = value_field_shape(target);
+    if (!shape) return -1;
+    if (fc->epoch != value_shape_epoch) {
+        fc->epoch = value_shape_epoch;
+        fc->count = 0;
+    }
+    for (int i = 0; i < fc->count; i++) {
+        if (fc->ways[i].shape == shape) {
+            VM_COUNT(field_ic_hits);
+            return fc->ways[i].index;
+        }
+    }
+    VM_COUNT(field_ic_misses);
+    int idx = value_field_index(target, fc->name);
+    if (idx >= 0 && fc->count < LUNA_FIELD_IC_WAYS) {
+        fc->ways[fc->count].shape = shape;
+        fc->ways[fc->count].index = idx;
+        fc->count++;
+    }
+    return idx;
 }
 
 static void close_upvalues(LunaVM *vm, Value *last) {
@@ -68,34 +293,111 @@ static VMUpvalue *capture_upvalue(LunaVM *vm, Value *local) {
 }
 
 static double value_to_double(Value v) {
-    if (v.type == VAL_INT) return (double)v.i;
-    if (v.type == VAL_FLOAT) return v.f;
+    if (VALUE_TYPE(v) == VAL_INT) return (double)VALUE_AS_INT(v);
+    if (VALUE_TYPE(v) == VAL_FLOAT) return VALUE_AS_FLOAT(v);
     return 0.0;
 }
 
 /* Inside an unsafe block, pointers may not be stored into GC containers. */
-static int vm_ptr_store_ok(Value v, int line) {
+static int vm_ptr_store_ok(Value v, LunaChunk *chunk, LunaInsn *ip) {
     if (!unsafe_runtime_inside_block()) return 1;
     if (!unsafe_runtime_is_pointer(v)) return 1;
-    return unsafe_runtime_check_gc_store(v, line);
+    return unsafe_runtime_check_gc_store(v, vm_op_line(chunk, ip));
+}
+
+/* Generic `+` / `-` (vector, int, string-concat, float), shared by the plain
+ * opcodes and the slow path of the immediate-operand superinstructions. */
+static Value vm_add_values(Value l, Value r) {
+    if (VEC_IS_OPERAND(l) && VEC_IS_OPERAND(r)) {
+        return vec_add_values(l, r);
+    } else if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+        return value_int(VALUE_AS_INT(l) + VALUE_AS_INT(r));
+    } else if (VALUE_TYPE(l) == VAL_STRING || VALUE_TYPE(r) == VAL_STRING) {
+        char scratch_l[VALUE_SCRATCH_LEN], scratch_r[VALUE_SCRATCH_LEN];
+        char *owned_l, *owned_r;
+        size_t len_l, len_r;
+        const char *sl = value_string_view(l, scratch_l, &len_l, &owned_l);
+        const char *sr = value_string_view(r, scratch_r, &len_r, &owned_r);
+        Value res = value_string_concat_raw(sl, len_l, sr, len_r);
+        free(owned_l);
+        free(owned_r);
+        return res;
+    }
+    return value_float(value_to_double(l) + value_to_double(r));
+}
+
+/* CONCAT_N: the string forms of count registers, measured first and then
+ * copied into a single allocation. */
+#define VM_CONCAT_INLINE 8
+
+static Value vm_concat_values(const Value *vals, int count) {
+    const char *parts_buf[VM_CONCAT_INLINE];
+    size_t lens_buf[VM_CONCAT_INLINE];
+    char *owned_buf[VM_CONCAT_INLINE];
+    char scratch_buf[VM_CONCAT_INLINE][VALUE_SCRATCH_LEN];
+    const char **parts = parts_buf;
+    size_t *lens = lens_buf;
+    char **owned = owned_buf;
+    char (*scratch)[VALUE_SCRATCH_LEN] = scratch_buf;
+    if (count > VM_CONCAT_INLINE) {
+        parts = malloc(sizeof(*parts) * (size_t)count);
+        lens = malloc(sizeof(*lens) * (size_t)count);
+        owned = malloc(sizeof(*owned) * (size_t)count);
+        scratch = malloc(sizeof(*scratch) * (size_t)count);
+    }
+    for (int i = 0; i < count; i++) {
+        parts[i] = value_string_view(vals[i], scratch[i], &lens[i], &owned[i]);
+    }
+    Value res = value_string_join_raw(parts, lens, count);
+    for (int i = 0; i < count; i++) free(owned[i]);
+    if (count > VM_CONCAT_INLINE) {
+        free(parts);
+        free(lens);
+        free(owned);
+        free(scratch);
+    }
+    return res;
+}
+
+static Value vm_sub_values(Value l, Value r) {
+    if (VEC_IS_OPERAND(l) && VEC_IS_OPERAND(r)) {
+        return vec_sub_values(l, r);
+    } else if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+        return value_int(VALUE_AS_INT(l) - VALUE_AS_INT(r));
+    }
+    return value_float(value_to_double(l) - value_to_double(r));
+}
+
+/* Shared by SAFEPOINT and the LOOP_IF_* back-edges: the GC is polled every
+ * 1024 loop iterations. */
+static _Thread_local int vm_safepoint_counter = 0;
+
+static void vm_scope_begin(LunaVM *vm) {
+    vm->next_scope_id++;
+    if (vm->scope_depth < VM_SCOPE_MAX) {
+        vm->scope_stack[vm->scope_depth] = vm->next_scope_id;
+        vm->defer_base_stack[vm->scope_depth] = vm->deferred_count;
+        vm->scope_depth++;
+    }
 }
 
 static int vm_is_truthy(Value v) {
-    switch (v.type) {
-        case VAL_BOOL: return v.b;
-        case VAL_INT: return v.i != 0;
-        case VAL_FLOAT: return v.f != 0.0;
-        case VAL_POINTER: return v.ptr != 0;
-        case VAL_STRING: return v.string && v.string->chars && v.string->chars[0] != '\0';
+    switch (VALUE_TYPE(v)) {
+        case VAL_BOOL: return VALUE_AS_BOOL(v);
+        case VAL_INT: return VALUE_AS_INT(v) != 0;
+        case VAL_FLOAT: return VALUE_AS_FLOAT(v) != 0.0;
+        case VAL_POINTER: return VALUE_AS_PTR(v) != 0;
+        case VAL_STRING: return VALUE_AS_STRING(v) && VALUE_AS_STRING(v)->chars && VALUE_AS_STRING(v)->chars[0] != '\0';
         case VAL_NULL: return 0;
-        case VAL_CHAR: return v.c != 0;
-        case VAL_FILE: return v.file != NULL;
+        case VAL_CHAR: return VALUE_AS_CHAR(v) != 0;
+        case VAL_FILE: return VALUE_AS_FILE(v) != NULL;
         case VAL_BLOC:
         case VAL_BLOC_TYPE:
         case VAL_BOX:
         case VAL_TEMPLATE:
         case VAL_LIST:
         case VAL_DENSE_LIST:
+        case VAL_RANGE:
         case VAL_MAP:
         case VAL_NATIVE:
         case VAL_CLOSURE:
@@ -125,6 +427,7 @@ static void vm_run_defers_since(LunaVM *vm, int base) {
     if (!vm) return;
     while (vm->deferred_count > base) {
         VMDeferred *d = &vm->deferred[--vm->deferred_count];
+        luna_current_line = d->line;
         Value ret = luna_call_value(vm->env, d->callee, d->argc, d->argv, d->line);
         value_free(ret);
         for (int i = 0; i < d->argc; i++) value_free(d->argv[i]);
@@ -151,31 +454,6 @@ void vm_gc_mark_defer_roots(LunaVM *vm, void *ctx) {
     vm_mark_defers(vm, ctx);
 }
 
-static void vm_collect_exports(AstNode *n, const char ***names, int *count) {
-    if (!n) return;
-    if (n->kind == NODE_BLOCK) {
-        for (int i = 0; i < n->block.items.count; i++) {
-            vm_collect_exports(n->block.items.items[i], names, count);
-        }
-        return;
-    }
-    const char *name = NULL;
-    if (n->kind == NODE_LET && n->let.is_export) name = n->let.name;
-    else if (n->kind == NODE_FUNC_DEF && n->funcdef.is_export && n->funcdef.name) name = n->funcdef.name;
-    else if (n->kind == NODE_DATA_DEF && n->data_def.is_export) name = n->data_def.name;
-    else if (n->kind == NODE_BLOC_DEF && n->bloc_def.is_export) name = n->bloc_def.name;
-    if (!name) return;
-
-    for (int i = 0; i < *count; i++) {
-        if ((*names)[i] == name) return;
-    }
-    const char **grown = (const char **)realloc((void *)*names, sizeof(const char *) * (size_t)(*count + 1));
-    if (!grown) abort();
-    grown[*count] = name;
-    *names = grown;
-    (*count)++;
-}
-
 static int vm_name_in_list(const char *name, const char **names, int count) {
     for (int i = 0; i < count; i++) {
         if (names[i] == name) return 1;
@@ -183,99 +461,141 @@ static int vm_name_in_list(const char *name, const char **names, int count) {
     return 0;
 }
 
-static int vm_op_line(LunaChunk *chunk, uint8_t *ip) {
-    size_t off = (size_t)(ip - chunk->code);
-    if (off == 0 || chunk->line_len == 0) return 1;
-    return chunk->line_map[off - 1];
-}
-
-static void vm_run_import(LunaVM *vm, uint16_t path_idx, const uint16_t *name_idxs,
-                          uint8_t name_count, int line) {
-    LunaChunk *chunk = vm->frames[vm->frame_count - 1].chunk;
-    Value path_val = chunk->constants[path_idx];
-    const char *path = path_val.type == VAL_STRING ? path_val.string->chars : NULL;
-    if (!path) return;
-
-    char *src = read_file(path);
+/* Reads, compiles and runs the module at path in a fresh env below the
+ * globals, registering it first so later imports (and import cycles) reuse
+ * it. The unit is usually ready from the import prefetch. Returns NULL if
+ * the module failed to load or run. */
+static LunaModule *vm_load_module(LunaVM *vm, const char *path, int line) {
+    char *src = NULL;
+    LunaUnit *unit = luna_prefetch_take(path, &src);
+    if (!unit) src = read_file(path);
     if (!src) {
         char msg[256];
         snprintf(msg, sizeof(msg), "Could not import file '%s'", path);
         error_report_with_context(ERR_NAME, line, 0, msg,
             "Check that the import path exists and ends with .lu");
-        return;
+        return NULL;
     }
 
     error_init(src, path);
-    Parser parser;
-    parser_init(&parser, src);
-    AstNode *prog = parser_parse_program(&parser);
-    parser_close(&parser);
-
-    if (!prog) {
+    if (!unit) unit = luna_unit_from_source(src);
+    if (!unit) {
         free(src);
-        return;
+        return NULL;
     }
 
-    const char **exported = NULL;
-    int exported_count = 0;
-    vm_collect_exports(prog, &exported, &exported_count);
-
     Env *module_env = env_create(env_root(vm->env));
-    LunaChunk *module_chunk = luna_compile_program(prog);
-
-    LunaVM module_vm;
-    luna_vm_init(&module_vm, vm->heap);
-    module_vm.env = module_env;
-    luna_vm_run(&module_vm, module_chunk);
-
-    if (!luna_had_error) {
-        if (name_count > 0) {
-            for (int i = 0; i < name_count; i++) {
-                Value name_val = chunk->constants[name_idxs[i]];
-                const char *name = intern_string(name_val.string->chars);
-                if (!vm_name_in_list(name, exported, exported_count)) {
-                    char msg[256];
-                    snprintf(msg, sizeof(msg), "Module '%s' does not export '%s'", path, name);
-                    error_report_with_context(ERR_NAME, line, 0, msg,
-                        "Export names explicitly in the module before using them");
-                    break;
-                }
-                Value *slot = env_get_local(module_env, name);
-                if (!slot) {
-                    char msg[256];
-                    snprintf(msg, sizeof(msg), "Export '%s' is missing from module '%s'", name, path);
-                    error_report_with_context(ERR_NAME, line, 0, msg,
-                        "Make sure the exported value is defined at module top level");
-                    break;
-                }
-                env_def(vm->env, name, *slot);
-            }
-        } else {
-            for (int i = 0; i < exported_count; i++) {
-                Value *slot = env_get_local(module_env, exported[i]);
-                if (slot) env_def(vm->env, exported[i], *slot);
-            }
+    LunaModule *module = module_cache_add(path, module_env, unit->exports, unit->export_count);
+    if (module) {
+        LunaVM module_vm;
+        luna_vm_init(&module_vm, vm->heap);
+        module_vm.env = module_env;
+        luna_vm_run(&module_vm, unit->chunk);
+        luna_vm_free(&module_vm);
+        if (luna_had_error) {
+            module_cache_remove(module);
+            module = NULL;
         }
     }
 
-    free((void *)exported);
-    if (prog->kind == NODE_BLOCK) nodelist_free(&prog->block.items);
+    if (unit->prog && unit->prog->kind == NODE_BLOCK) nodelist_free(&unit->prog->block.items);
+    luna_unit_free(unit);
     free(src);
-    /* module_chunk intentionally leaked: closures exported from the module
-     * still reference its subchunks. */
+    /* The chunk and module env are intentionally kept: closures exported
+     * from the module still reference its subchunks and globals. */
+    return module;
 }
 
-Value luna_vm_run(LunaVM *vm, LunaChunk *chunk) {
-    if (vm->frame_count >= FRAMES_MAX) {
-        fprintf(stderr, "VM Error: stack overflow\n");
-        abort();
+static void vm_run_import(LunaVM *vm, uint32_t path_idx, const LunaInsn *name_idxs,
+                          uint8_t name_count, int line) {
+    LunaChunk *chunk = vm->frames[vm->frame_count - 1].chunk;
+    Value path_val = chunk->constants[path_idx];
+    const char *path = VALUE_TYPE(path_val) == VAL_STRING ? VALUE_AS_STRING(path_val)->chars : NULL;
+    if (!path) return;
+
+    LunaModule *module = module_cache_get(path);
+    if (!module) module = vm_load_module(vm, path, line);
+    if (!module) return;
+
+    Env *module_env = module->env;
+    const char **exported = module->exports;
+    int exported_count = module->export_count;
+    if (name_count > 0) {
+        for (int i = 0; i < name_count; i++) {
+            Value name_val = chunk->constants[name_idxs[i]];
+            const char *name = intern_string(VALUE_AS_STRING(name_val)->chars);
+            if (!vm_name_in_list(name, exported, exported_count)) {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "Module '%s' does not export '%s'", path, name);
+                error_report_with_context(ERR_NAME, line, 0, msg,
+                    "Export names explicitly in the module before using them");
+                break;
+            }
+            Value *slot = env_get_local(module_env, name);
+            if (!slot) {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "Export '%s' is missing from module '%s'", name, path);
+                error_report_with_context(ERR_NAME, line, 0, msg,
+                    "Make sure the exported value is defined at module top level");
+                break;
+            }
+            env_def(vm->env, name, *slot);
+        }
+    } else {
+        for (int i = 0; i < exported_count; i++) {
+            Value *slot = env_get_local(module_env, exported[i]);
+            if (slot) env_def(vm->env, exported[i], *slot);
+        }
+    }
+}
+
+/* Calls a callee that does not get a VM frame: data types and blocs are
+ * constructed inline, natives and interpreter closures go through
+ * luna_call_value. The VM does not track luna_current_line per instruction,
+ * so it is set here for errors raised inside the callee. */
+static Value vm_call_inline(LunaVM *vm, Value callee, int argc, Value *args, int line) {
+    // Natives report errors without a line; this is where they find it.
+    luna_current_line = line;
+    if (VALUE_TYPE(callee) == VAL_DATA_TYPE) {
+        return instantiate_data_type(callee, argc, args, line);
+    }
+    if (VALUE_TYPE(callee) == VAL_BLOC_TYPE) {
+        char msg[256];
+        if (!value_bloc_check_construct(callee, argc, args, msg, sizeof(msg))) {
+            error_report_with_context(ERR_TYPE, line, 0, msg,
+                "Bloc values must stay inline and only use int, float, bool, char, or nested blocs");
+            return value_null();
+        }
+        return value_bloc_construct(callee, argc, args);
     }
+    VM_PROFILE_FALLBACK_BEGIN(prof);
+    Value ret = luna_call_value(vm->env, callee, argc, args, line);
+    VM_PROFILE_FALLBACK_END(prof);
+    return ret;
+}
+
+static int vm_is_callable(Value v) {
+    return VALUE_TYPE(v) == VAL_VM_CLOSURE || VALUE_TYPE(v) == VAL_DATA_TYPE ||
+           VALUE_TYPE(v) == VAL_BLOC_TYPE || VALUE_TYPE(v) == VAL_NATIVE ||
+           VALUE_TYPE(v) == VAL_CLOSURE || VALUE_TYPE(v) == VAL_FUNCTION;
+}
 
+/* CALL_NAMED / TAIL_CALL on a non-callable value. */
+static void vm_report_not_callable(LunaChunk *chunk, uint16_t name_idx, int line) {
+    Value name_val = chunk->constants[name_idx];
+    const char *nm = VALUE_TYPE(name_val) == VAL_STRING ? VALUE_AS_STRING(name_val)->chars : "value";
+    char emsg[128];
+    snprintf(emsg, sizeof(emsg), "'%s' is not a function", nm);
+    error_report_with_context(ERR_TYPE, line, 0, emsg,
+        "Make sure you are calling a function value, closure, or native builtin");
+}
+
+Value luna_vm_run(LunaVM *vm, LunaChunk *chunk) {
     // Set up frame 0
-    VMCallFrame *frame = &vm->frames[vm->frame_count++];
+    VMCallFrame *frame = vm_push_frame(vm, 0, chunk->reg_count);
     frame->chunk = chunk;
+    VM_PROFILE_CALL(chunk);
     frame->ip = chunk->code;
-    frame->slots = vm->stack;
     frame->upvalues = NULL;
     frame->argc = 0;
     frame->ret_dst = 0;
@@ -292,44 +612,81 @@ Value luna_vm_run(LunaVM *vm, LunaChunk *chunk) {
     return luna_vm_execute(vm);
 }
 
+/* Callback VMs (map/filter/reduce, sort comparators, GUI callbacks) are
+ * pooled: a released VM keeps its grown stack and frame arrays, so a call
+ * costs a frame push instead of an init/free pair. Nested callbacks each
+ * take their own VM; past VM_CALLBACK_POOL_MAX idle VMs are freed. */
+#define VM_CALLBACK_POOL_MAX 8
+static LunaVM *vm_callback_pool[VM_CALLBACK_POOL_MAX];
+static int vm_callback_pool_count = 0;
+
+static LunaVM *vm_callback_acquire(GCHeap *heap, Env *env) {
+    LunaVM *vm;
+    if (vm_callback_pool_count > 0) {
+        vm = vm_callback_pool[--vm_callback_pool_count];
+        // A callback that hit a runtime error may have left state behind.
+        vm->frame_count = 0;
+        vm->stack_top = vm->stack;
+        vm->open_upvalues = NULL;
+        vm->scope_depth = 0;
+        vm->deferred_count = 0;
+    } else {
+        vm = (LunaVM *)malloc(sizeof(LunaVM));
+        if (!vm) abort();
+        luna_vm_init(vm, heap);
+    }
+    vm->heap = heap;
+    vm->env = env;
+    return vm;
+}
+
+static void vm_callback_release(LunaVM *vm) {
+    if (vm_callback_pool_count < VM_CALLBACK_POOL_MAX) {
+        vm_callback_pool[vm_callback_pool_count++] = vm;
+        return;
+    }
+    luna_vm_free(vm);
+    free(vm);
+}
+
 Value luna_vm_call_closure(GCHeap *heap, Env *env, VMClosureObj *closure,
                            int argc, Value *argv, int line) {
-    (void)line;
-    LunaVM vm;
-    luna_vm_init(&vm, heap);
-    vm.env = env;
+    LunaVM *vm = vm_callback_acquire(heap, env);
 
     if (argc > 255) argc = 255;
-    VMCallFrame *frame = &vm.frames[vm.frame_count++];
+    int reg_count = closure->chunk->reg_count > argc ? closure->chunk->reg_count : argc;
+    VMCallFrame *frame = vm_push_frame(vm, 0, reg_count);
     frame->chunk = closure->chunk;
+    VM_PROFILE_CALL(closure->chunk);
     frame->ip = closure->chunk->code;
-    frame->slots = vm.stack;
     frame->upvalues = closure->upvalues;
     frame->argc = (uint8_t)argc;
     frame->ret_dst = 0;
     frame->scope_base = 0;
 
     for (int i = 0; i < argc; i++) {
-        vm.stack[i] = value_copy(argv[i]);
+        vm->stack[i] = value_copy(argv[i]);
     }
     for (int i = argc; i < closure->chunk->reg_count; i++) {
-        vm.stack[i] = value_null();
+        vm->stack[i] = value_null();
     }
-    vm.stack_top = vm.stack + closure->chunk->reg_count;
+    vm->stack_top = vm->stack + closure->chunk->reg_count;
 
-    Value ret = luna_vm_execute(&vm);
+    Value ret = luna_vm_execute(vm);
 
     for (int i = 0; i < closure->chunk->reg_count; i++) {
-        value_free(vm.stack[i]);
+        value_free(vm->stack[i]);
     }
+    vm_callback_release(vm);
     return ret;
 }
 
 Value luna_vm_execute(LunaVM *vm) {
     VMCallFrame *frame = &vm->frames[vm->frame_count - 1];
-    uint8_t *ip = frame->ip;
+    LunaInsn *ip = frame->ip;
     Value *slots = frame->slots;
     LunaChunk *chunk = frame->chunk;
+    LunaInsn call_word; // CALL_NAMED's operand word, also reached from CALL_NATIVE
 
     #ifdef LUNA_VM_DEBUG
     printf("[VM] Running chunk %s, code length = %zu\n", chunk->name, chunk->code_len);
@@ -338,46 +695,88 @@ Value luna_vm_execute(LunaVM *vm) {
     // Dispatch table for computed gotos
     #ifdef __GNUC__
     static void* dispatch_table[] = {
-        &&do_halt, &&do_load_int, &&do_load_float, &&do_load_const, &&do_load_true,
+        &&do_halt, &&do_load_int, &&do_load_float, &&do_load_const, &&do_load_int64,
+        &&do_load_float64, &&do_load_true,
         &&do_load_false, &&do_load_null, &&do_move, &&do_add, &&do_sub, &&do_mul,
         &&do_div, &&do_mod, &&do_eq, &&do_neq, &&do_lt, &&do_lte, &&do_gt, &&do_gte,
         &&do_not, &&do_neg, &&do_jump, &&do_jump_if_true, &&do_jump_if_false,
         &&do_get_global, &&do_set_global, &&do_get_upval, &&do_set_upval,
         &&do_new_list, &&do_list_append, &&do_index_get, &&do_index_set,
         &&do_new_map, &&do_map_set, &&do_box_alloc, &&do_addr_of, &&do_addr_of_global,
-        &&do_field_get, &&do_field_set, &&do_call, &&do_call_named, &&do_defer,
-        &&do_has_arg,
+        &&do_field_get, &&do_field_set, &&do_call, &&do_call_named, &&do_call_native,
+        &&do_tail_call, &&do_defer, &&do_has_arg,
         &&do_return, &&do_closure,
         &&do_scope_begin, &&do_scope_exit, &&do_unsafe_begin, &&do_unsafe_end,
         &&do_import,
-        &&do_print, &&do_safepoint
+        &&do_print, &&do_safepoint,
+        &&do_jump_if_not_lt, &&do_jump_if_not_lte, &&do_jump_if_not_gt, &&do_jump_if_not_gte,
+        &&do_loop_if_lt, &&do_loop_if_lte, &&do_loop_if_gt, &&do_loop_if_gte,
+        &&do_addi, &&do_inc_local, &&do_for_iter, &&do_switch_table, &&do_switch_hash,
+        &&do_concat_n,
+        &&do_add_ii, &&do_add_ff, &&do_sub_ii, &&do_sub_ff, &&do_mul_ii, &&do_mul_ff,
+        &&do_eq_ii, &&do_neq_ii, &&do_lt_ii, &&do_lt_ff, &&do_lte_ii, &&do_lte_ff,
+        &&do_gt_ii, &&do_gt_ff, &&do_gte_ii, &&do_gte_ff
     };
     #ifdef LUNA_VM_DEBUG
     #define DISPATCH() do { \
-        printf("[VM] ip = %d, opcode = %d\n", (int)(ip - chunk->code), *ip); \
-        luna_current_line = frame->chunk->line_map[ip - frame->chunk->code]; \
-        goto *dispatch_table[*ip++]; \
+        printf("[VM] ip = %d, opcode = %d, A = %d, B = %d, C = %d, sBx = %d, line = %d\n", \
+               (int)(ip - chunk->code), LUNA_OP(*ip), LUNA_A(*ip), LUNA_B(*ip), LUNA_C(*ip), \
+               LUNA_SBX(*ip), \
+               luna_chunk_line_at(chunk, (size_t)(ip - chunk->code))); \
+        VM_PROFILE_OP(chunk, LUNA_OP(*ip)); \
+        goto *dispatch_table[LUNA_OP(*ip++)]; \
     } while(0)
     #else
     #define DISPATCH() do { \
-        luna_current_line = frame->chunk->line_map[ip - frame->chunk->code]; \
-        goto *dispatch_table[*ip++]; \
+        VM_COUNT_DISPATCH(); \
+        VM_PROFILE_OP(chunk, LUNA_OP(*ip)); \
+        goto *dispatch_table[LUNA_OP(*ip++)]; \
     } while(0)
     #endif
     #else
     #define DISPATCH() goto switch_dispatch
     #endif
 
-    #define READ_BYTE() (*ip++)
-    #define READ_SHORT() (ip += 2, (uint16_t)((ip[-2]) | (ip[-1] << 8)))
-    #define READ_INT64() (ip += 8, (uint64_t)((ip[-8]) | ((uint64_t)ip[-7] << 8) | ((uint64_t)ip[-6] << 16) | ((uint64_t)ip[-5] << 24) | ((uint64_t)ip[-4] << 32) | ((uint64_t)ip[-3] << 40) | ((uint64_t)ip[-2] << 48) | ((uint64_t)ip[-1] << 56)))
+    /* Operand fields of the current word, and the next trailing word. The
+     * fields are re-read from ip[-1] rather than kept in a local: one more
+     * live register across the handlers pushes `slots` onto the stack. On
+     * little-endian hosts each 8-bit field is a single byte load. */
+    #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    #define ARG_A() (((const uint8_t *)(ip - 1))[1])
+    #define ARG_B() (((const uint8_t *)(ip - 1))[2])
+    #define ARG_C() (((const uint8_t *)(ip - 1))[3])
+    #else
+    #define ARG_A() LUNA_A(ip[-1])
+    #define ARG_B() LUNA_B(ip[-1])
+    #define ARG_C() LUNA_C(ip[-1])
+    #endif
+    #define ARG_BX() LUNA_BX(ip[-1])
+    #define ARG_SBX() LUNA_SBX(ip[-1])
+    #define READ_WORD() (*ip++)
+
+    /* Taken backward branch to ip from loop_end. Once the loop is hot it runs
+     * natively and we resume wherever it left, reopening the scopes it
+     * entered (native code keeps no scope stack). */
+    #define VM_JIT_LOOP(loop_end) do { \
+        if (vm_jit_on) { \
+            int scopes_; \
+            long resume_ = luna_jit_loop(chunk, (size_t)(ip - chunk->code), \
+                                         (size_t)((loop_end) - chunk->code), slots, &scopes_); \
+            if (resume_ >= 0) { \
+                ip = chunk->code + resume_; \
+                while (scopes_-- > 0) vm_scope_begin(vm); \
+            } \
+        } \
+    } while (0)
 
     #ifdef __GNUC__
     DISPATCH();
     #else
     switch_dispatch:
     while (1) {
-        switch (*ip++) {
+        VM_COUNT_DISPATCH();
+        VM_PROFILE_OP(chunk, LUNA_OP(*ip));
+        switch (LUNA_OP(*ip++)) {
     #endif
 
     #ifdef __GNUC__
@@ -399,10 +798,9 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_LOAD_INT:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        long long val = (long long)READ_INT64();
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = value_int(val);
+        slots[dst] = value_int(ARG_SBX());
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -416,12 +814,9 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_LOAD_FLOAT:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint64_t bits = READ_INT64();
-        double val;
-        memcpy(&val, &bits, sizeof(double));
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = value_float(val);
+        slots[dst] = value_float(ARG_SBX());
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -435,10 +830,47 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_LOAD_CONST:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint16_t idx = READ_SHORT();
+        uint8_t dst = ARG_A();
+        value_free(slots[dst]);
+        slots[dst] = value_copy(chunk->constants[ARG_BX()]);
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_load_int64:
+    #else
+    case VM_OP_LOAD_INT64:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        long long val = (long long)luna_insn_imm64(ip);
+        ip += 2;
+        value_free(slots[dst]);
+        slots[dst] = value_int(val);
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_load_float64:
+    #else
+    case VM_OP_LOAD_FLOAT64:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint64_t bits = luna_insn_imm64(ip);
+        double val;
+        memcpy(&val, &bits, sizeof(val));
+        ip += 2;
         value_free(slots[dst]);
-        slots[dst] = value_copy(chunk->constants[idx]);
+        slots[dst] = value_float(val);
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -452,7 +884,7 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_LOAD_TRUE:
     #endif
     {
-        uint8_t dst = READ_BYTE();
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
         slots[dst] = value_bool(1);
         #ifdef __GNUC__
@@ -468,7 +900,7 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_LOAD_FALSE:
     #endif
     {
-        uint8_t dst = READ_BYTE();
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
         slots[dst] = value_bool(0);
         #ifdef __GNUC__
@@ -484,7 +916,7 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_LOAD_NULL:
     #endif
     {
-        uint8_t dst = READ_BYTE();
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
         slots[dst] = value_null();
         #ifdef __GNUC__
@@ -500,8 +932,8 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_MOVE:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t src = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t src = ARG_B();
         value_free(slots[dst]);
         slots[dst] = value_copy(slots[src]);
         #ifdef __GNUC__
@@ -517,25 +949,66 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_ADD:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        Value res = vm_add_values(l, r);
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_ADD_II);
+        else if (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_FLOAT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_ADD_FF);
+        value_free(slots[dst]);
+        slots[dst] = res;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_sub:
+    #else
+    case VM_OP_SUB:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        Value res = vm_sub_values(l, r);
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_SUB_II);
+        else if (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_FLOAT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_SUB_FF);
+        value_free(slots[dst]);
+        slots[dst] = res;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_mul:
+    #else
+    case VM_OP_MUL:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
         Value l = slots[lhs];
         Value r = slots[rhs];
         Value res;
-        if ((l.type == VAL_LIST || l.type == VAL_DENSE_LIST) &&
-            (r.type == VAL_LIST || r.type == VAL_DENSE_LIST)) {
-            res = vec_add_values(l, r);
-        } else if (l.type == VAL_INT && r.type == VAL_INT) {
-            res = value_int(l.i + r.i);
-        } else if (l.type == VAL_STRING || r.type == VAL_STRING) {
-            char *sl = value_to_string(l);
-            char *sr = value_to_string(r);
-            res = value_string_concat_raw(sl, strlen(sl), sr, strlen(sr));
-            free(sl);
-            free(sr);
+        if (VEC_IS_OPERAND(l) && VEC_IS_OPERAND(r)) {
+            res = vec_mul_values(l, r);
+        } else if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+            res = value_int(VALUE_AS_INT(l) * VALUE_AS_INT(r));
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_MUL_II);
         } else {
-            res = value_float(value_to_double(l) + value_to_double(r));
+            res = value_float(value_to_double(l) * value_to_double(r));
+            if (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_FLOAT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_MUL_FF);
         }
         value_free(slots[dst]);
         slots[dst] = res;
@@ -547,24 +1020,26 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_sub:
+    do_div:
     #else
-    case VM_OP_SUB:
+    case VM_OP_DIV:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
         Value l = slots[lhs];
         Value r = slots[rhs];
         Value res;
-        if ((l.type == VAL_LIST || l.type == VAL_DENSE_LIST) &&
-            (r.type == VAL_LIST || r.type == VAL_DENSE_LIST)) {
-            res = vec_sub_values(l, r);
-        } else if (l.type == VAL_INT && r.type == VAL_INT) {
-            res = value_int(l.i - r.i);
+        if (VEC_IS_OPERAND(l) && VEC_IS_OPERAND(r)) {
+            res = vec_div_values(l, r);
+        } else if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+            if (VALUE_AS_INT(r) == 0) res = value_int(0);
+            else if (VALUE_AS_INT(l) % VALUE_AS_INT(r) == 0) res = value_int(VALUE_AS_INT(l) / VALUE_AS_INT(r));
+            else res = value_float((double)VALUE_AS_INT(l) / (double)VALUE_AS_INT(r));
         } else {
-            res = value_float(value_to_double(l) - value_to_double(r));
+            double dr = value_to_double(r);
+            res = value_float(dr == 0.0 ? 0.0 : value_to_double(l) / dr);
         }
         value_free(slots[dst]);
         slots[dst] = res;
@@ -576,27 +1051,811 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_mul:
+    do_mod:
+    #else
+    case VM_OP_MOD:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        Value res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+            res = value_int(VALUE_AS_INT(r) == 0 ? 0 : VALUE_AS_INT(l) % VALUE_AS_INT(r));
+        } else {
+            res = value_int(VALUE_AS_FLOAT(r) == 0.0 ? 0 : (long long)value_to_double(l) % (long long)value_to_double(r));
+        }
+        value_free(slots[dst]);
+        slots[dst] = res;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_eq:
+    #else
+    case VM_OP_EQ:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        bool eq = false;
+        if (VALUE_TYPE(l) == VALUE_TYPE(r)) {
+            if (VALUE_TYPE(l) == VAL_INT) eq = (VALUE_AS_INT(l) == VALUE_AS_INT(r));
+            else if (VALUE_TYPE(l) == VAL_FLOAT) eq = (VALUE_AS_FLOAT(l) == VALUE_AS_FLOAT(r));
+            else if (VALUE_TYPE(l) == VAL_BOOL) eq = (VALUE_AS_BOOL(l) == VALUE_AS_BOOL(r));
+            else if (VALUE_TYPE(l) == VAL_CHAR) eq = (VALUE_AS_CHAR(l) == VALUE_AS_CHAR(r));
+            else if (VALUE_TYPE(l) == VAL_POINTER) eq = (VALUE_AS_PTR(l) == VALUE_AS_PTR(r));
+            else if (VALUE_TYPE(l) == VAL_BLOC) eq = value_bloc_equal(l, r);
+            else if (VALUE_TYPE(l) == VAL_STRING) eq = (strcmp(VALUE_AS_STRING(l)->chars, VALUE_AS_STRING(r)->chars) == 0);
+            else if (VALUE_TYPE(l) == VAL_NULL) eq = true;
+        } else if ((VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_FLOAT) ||
+                   (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_INT)) {
+            eq = (value_to_double(l) == value_to_double(r));
+        }
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_EQ_II);
+        value_free(slots[dst]);
+        slots[dst] = value_bool(eq ? 1 : 0);
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_neq:
+    #else
+    case VM_OP_NEQ:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        bool eq = false;
+        if (VALUE_TYPE(l) == VALUE_TYPE(r)) {
+            if (VALUE_TYPE(l) == VAL_INT) eq = (VALUE_AS_INT(l) == VALUE_AS_INT(r));
+            else if (VALUE_TYPE(l) == VAL_FLOAT) eq = (VALUE_AS_FLOAT(l) == VALUE_AS_FLOAT(r));
+            else if (VALUE_TYPE(l) == VAL_BOOL) eq = (VALUE_AS_BOOL(l) == VALUE_AS_BOOL(r));
+            else if (VALUE_TYPE(l) == VAL_CHAR) eq = (VALUE_AS_CHAR(l) == VALUE_AS_CHAR(r));
+            else if (VALUE_TYPE(l) == VAL_POINTER) eq = (VALUE_AS_PTR(l) == VALUE_AS_PTR(r));
+            else if (VALUE_TYPE(l) == VAL_BLOC) eq = value_bloc_equal(l, r);
+            else if (VALUE_TYPE(l) == VAL_STRING) eq = (strcmp(VALUE_AS_STRING(l)->chars, VALUE_AS_STRING(r)->chars) == 0);
+            else if (VALUE_TYPE(l) == VAL_NULL) eq = true;
+        } else if ((VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_FLOAT) ||
+                   (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_INT)) {
+            eq = (value_to_double(l) == value_to_double(r));
+        }
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_NEQ_II);
+        value_free(slots[dst]);
+        slots[dst] = value_bool(eq ? 0 : 1);
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_lt:
+    #else
+    case VM_OP_LT:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        bool res;
+        if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) < VALUE_AS_PTR(r));
+        else if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+            res = (VALUE_AS_INT(l) < VALUE_AS_INT(r));
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_LT_II);
+        } else {
+            res = (value_to_double(l) < value_to_double(r));
+            if (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_FLOAT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_LT_FF);
+        }
+        value_free(slots[dst]);
+        slots[dst] = value_bool(res ? 1 : 0);
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_lte:
+    #else
+    case VM_OP_LTE:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        bool res;
+        if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) <= VALUE_AS_PTR(r));
+        else if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+            res = (VALUE_AS_INT(l) <= VALUE_AS_INT(r));
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_LTE_II);
+        } else {
+            res = (value_to_double(l) <= value_to_double(r));
+            if (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_FLOAT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_LTE_FF);
+        }
+        value_free(slots[dst]);
+        slots[dst] = value_bool(res ? 1 : 0);
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_gt:
+    #else
+    case VM_OP_GT:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        bool res;
+        if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) > VALUE_AS_PTR(r));
+        else if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+            res = (VALUE_AS_INT(l) > VALUE_AS_INT(r));
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_GT_II);
+        } else {
+            res = (value_to_double(l) > value_to_double(r));
+            if (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_FLOAT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_GT_FF);
+        }
+        value_free(slots[dst]);
+        slots[dst] = value_bool(res ? 1 : 0);
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_gte:
+    #else
+    case VM_OP_GTE:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t lhs = ARG_B();
+        uint8_t rhs = ARG_C();
+        Value l = slots[lhs];
+        Value r = slots[rhs];
+        bool res;
+        if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) >= VALUE_AS_PTR(r));
+        else if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) {
+            res = (VALUE_AS_INT(l) >= VALUE_AS_INT(r));
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_GTE_II);
+        } else {
+            res = (value_to_double(l) >= value_to_double(r));
+            if (VALUE_TYPE(l) == VAL_FLOAT && VALUE_TYPE(r) == VAL_FLOAT) ip[-1] = luna_insn_with_op(ip[-1], VM_OP_GTE_FF);
+        }
+        value_free(slots[dst]);
+        slots[dst] = value_bool(res ? 1 : 0);
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_jump_if_not_lt:
+    #else
+    case VM_OP_JUMP_IF_NOT_LT:
+    #endif
+    {
+        /* Same ordering rules as the plain comparison; jumps when it is false. */
+        Value l = slots[ARG_A()];
+        Value r = slots[ARG_B()];
+        int32_t offset = (int32_t)READ_WORD();
+        bool res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) res = (VALUE_AS_INT(l) < VALUE_AS_INT(r));
+        else if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) < VALUE_AS_PTR(r));
+        else res = (value_to_double(l) < value_to_double(r));
+        if (!res) ip += offset;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_jump_if_not_lte:
+    #else
+    case VM_OP_JUMP_IF_NOT_LTE:
+    #endif
+    {
+        /* Same ordering rules as the plain comparison; jumps when it is false. */
+        Value l = slots[ARG_A()];
+        Value r = slots[ARG_B()];
+        int32_t offset = (int32_t)READ_WORD();
+        bool res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) res = (VALUE_AS_INT(l) <= VALUE_AS_INT(r));
+        else if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) <= VALUE_AS_PTR(r));
+        else res = (value_to_double(l) <= value_to_double(r));
+        if (!res) ip += offset;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_jump_if_not_gt:
+    #else
+    case VM_OP_JUMP_IF_NOT_GT:
+    #endif
+    {
+        /* Same ordering rules as the plain comparison; jumps when it is false. */
+        Value l = slots[ARG_A()];
+        Value r = slots[ARG_B()];
+        int32_t offset = (int32_t)READ_WORD();
+        bool res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) res = (VALUE_AS_INT(l) > VALUE_AS_INT(r));
+        else if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) > VALUE_AS_PTR(r));
+        else res = (value_to_double(l) > value_to_double(r));
+        if (!res) ip += offset;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_jump_if_not_gte:
+    #else
+    case VM_OP_JUMP_IF_NOT_GTE:
+    #endif
+    {
+        /* Same ordering rules as the plain comparison; jumps when it is false. */
+        Value l = slots[ARG_A()];
+        Value r = slots[ARG_B()];
+        int32_t offset = (int32_t)READ_WORD();
+        bool res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) res = (VALUE_AS_INT(l) >= VALUE_AS_INT(r));
+        else if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) >= VALUE_AS_PTR(r));
+        else res = (value_to_double(l) >= value_to_double(r));
+        if (!res) ip += offset;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_loop_if_lt:
+    #else
+    case VM_OP_LOOP_IF_LT:
+    #endif
+    {
+        /* Bottom test of a rotated loop: branch back while true, polling the GC. */
+        Value l = slots[ARG_A()];
+        Value r = slots[ARG_B()];
+        int32_t offset = (int32_t)READ_WORD();
+        bool res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) res = (VALUE_AS_INT(l) < VALUE_AS_INT(r));
+        else if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) < VALUE_AS_PTR(r));
+        else res = (value_to_double(l) < value_to_double(r));
+        if (res) {
+            ip += offset;
+            if (++vm_safepoint_counter >= 1024) {
+                vm_safepoint_counter = 0;
+                frame->ip = ip;
+                luna_gc_runtime_safe_point();
+            }
+            VM_JIT_LOOP(ip - offset);
+        }
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_loop_if_lte:
+    #else
+    case VM_OP_LOOP_IF_LTE:
+    #endif
+    {
+        /* Bottom test of a rotated loop: branch back while true, polling the GC. */
+        Value l = slots[ARG_A()];
+        Value r = slots[ARG_B()];
+        int32_t offset = (int32_t)READ_WORD();
+        bool res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) res = (VALUE_AS_INT(l) <= VALUE_AS_INT(r));
+        else if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) <= VALUE_AS_PTR(r));
+        else res = (value_to_double(l) <= value_to_double(r));
+        if (res) {
+            ip += offset;
+            if (++vm_safepoint_counter >= 1024) {
+                vm_safepoint_counter = 0;
+                frame->ip = ip;
+                luna_gc_runtime_safe_point();
+            }
+            VM_JIT_LOOP(ip - offset);
+        }
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_loop_if_gt:
+    #else
+    case VM_OP_LOOP_IF_GT:
+    #endif
+    {
+        /* Bottom test of a rotated loop: branch back while true, polling the GC. */
+        Value l = slots[ARG_A()];
+        Value r = slots[ARG_B()];
+        int32_t offset = (int32_t)READ_WORD();
+        bool res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) res = (VALUE_AS_INT(l) > VALUE_AS_INT(r));
+        else if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) > VALUE_AS_PTR(r));
+        else res = (value_to_double(l) > value_to_double(r));
+        if (res) {
+            ip += offset;
+            if (++vm_safepoint_counter >= 1024) {
+                vm_safepoint_counter = 0;
+                frame->ip = ip;
+                luna_gc_runtime_safe_point();
+            }
+            VM_JIT_LOOP(ip - offset);
+        }
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_loop_if_gte:
+    #else
+    case VM_OP_LOOP_IF_GTE:
+    #endif
+    {
+        /* Bottom test of a rotated loop: branch back while true, polling the GC. */
+        Value l = slots[ARG_A()];
+        Value r = slots[ARG_B()];
+        int32_t offset = (int32_t)READ_WORD();
+        bool res;
+        if (VALUE_TYPE(l) == VAL_INT && VALUE_TYPE(r) == VAL_INT) res = (VALUE_AS_INT(l) >= VALUE_AS_INT(r));
+        else if (VALUE_TYPE(l) == VAL_POINTER && VALUE_TYPE(r) == VAL_POINTER) res = (VALUE_AS_PTR(l) >= VALUE_AS_PTR(r));
+        else res = (value_to_double(l) >= value_to_double(r));
+        if (res) {
+            ip += offset;
+            if (++vm_safepoint_counter >= 1024) {
+                vm_safepoint_counter = 0;
+                frame->ip = ip;
+                luna_gc_runtime_safe_point();
+            }
+            VM_JIT_LOOP(ip - offset);
+        }
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_addi:
+    #else
+    case VM_OP_ADDI:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        Value v = slots[ARG_B()];
+        int8_t imm = (int8_t)ARG_C();
+        Value res;
+        if (VALUE_TYPE(v) == VAL_INT) res = value_int(VALUE_AS_INT(v) + imm);
+        else if (VALUE_TYPE(v) == VAL_FLOAT) res = value_float(VALUE_AS_FLOAT(v) + imm);
+        else res = vm_add_values(v, value_int(imm));
+        value_free(slots[dst]);
+        slots[dst] = res;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_inc_local:
+    #else
+    case VM_OP_INC_LOCAL:
+    #endif
+    {
+        uint8_t reg = ARG_A();
+        int8_t imm = (int8_t)ARG_B();
+        Value *v = &slots[reg];
+        if (VALUE_TYPE(*v) == VAL_INT) {
+            VALUE_SET_INT(v, VALUE_AS_INT(*v) + imm);
+        } else if (VALUE_TYPE(*v) == VAL_FLOAT) {
+            VALUE_SET_FLOAT(v, VALUE_AS_FLOAT(*v) + imm);
+        } else {
+            Value res = imm >= 0 ? vm_add_values(*v, value_int(imm))
+                                 : vm_sub_values(*v, value_int(-imm));
+            value_free(*v);
+            *v = res;
+        }
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_for_iter:
+    #else
+    case VM_OP_FOR_ITER:
+    #endif
+    {
+        /* Bottom of a for-in loop: fetch the next item and branch back to the
+         * body, or fall out of the loop. The state register is a hidden int
+         * the compiler zeroes before the loop. */
+        uint8_t var = ARG_A();
+        Value iter = slots[ARG_B()];
+        Value *state = &slots[ARG_C()];
+        int32_t offset = (int32_t)READ_WORD();
+        Value item;
+        long long pos = VALUE_AS_INT(*state);
+        int more = value_iter_next(iter, &pos, &item);
+        VALUE_SET_INT(state, pos);
+        if (more > 0) {
+            value_free(slots[var]);
+            slots[var] = item;
+            ip += offset;
+            if (++vm_safepoint_counter >= 1024) {
+                vm_safepoint_counter = 0;
+                frame->ip = ip;
+                luna_gc_runtime_safe_point();
+            }
+        } else if (more < 0) {
+            error_report_with_context(ERR_TYPE, vm_op_line(chunk, ip), 0,
+                "for-in expects a list, dense list, string, map, or range",
+                "Use for (let item in list) { ... }");
+        }
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_switch_table:
+    #else
+    case VM_OP_SWITCH_TABLE:
+    #endif
+    {
+        /* Dense int/char switch: index the offset table by value - low. A
+         * float equal to an int case matches it, as EQ would. */
+        const LunaInsn *words = ip - 1;
+        Value v = slots[ARG_A()];
+        int count = (int)words[1];
+        long long low = (int32_t)words[2];
+        int pos = LUNA_SWITCH_DEFAULT_POS;
+        long long k = -1;
+        if (ARG_B() == LUNA_SWITCH_INT) {
+            if (VALUE_TYPE(v) == VAL_INT) {
+                k = VALUE_AS_INT(v) - low;
+            } else if (VALUE_TYPE(v) == VAL_FLOAT && VALUE_AS_FLOAT(v) >= (double)low && VALUE_AS_FLOAT(v) < (double)(low + count) &&
+                       VALUE_AS_FLOAT(v) == (double)(long long)VALUE_AS_FLOAT(v)) {
+                k = (long long)VALUE_AS_FLOAT(v) - low;
+            }
+        } else if (VALUE_TYPE(v) == VAL_CHAR) {
+            k = (long long)(unsigned char)VALUE_AS_CHAR(v) - low;
+        }
+        if (k >= 0 && k < count) pos = 4 + (int)k;
+        ip = (LunaInsn *)words + 4 + count;
+        ip += (int32_t)words[pos];
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_switch_hash:
+    #else
+    case VM_OP_SWITCH_HASH:
+    #endif
+    {
+        /* String switch: hash the subject once, then probe the slot table the
+         * compiler laid out for these cases. */
+        const LunaInsn *words = ip - 1;
+        Value v = slots[ARG_A()];
+        uint32_t mask = ARG_BX();
+        int count = (int)words[1];
+        const LunaInsn *slot = words + 4 + 2 * count;
+        int pos = LUNA_SWITCH_DEFAULT_POS;
+        if (VALUE_TYPE(v) == VAL_STRING && VALUE_AS_STRING(v)) {
+            const char *str = VALUE_AS_STRING(v)->chars;
+            uint32_t h = luna_switch_hash(str, words[2]) & mask;
+            while (slot[h]) {
+                int k = (int)slot[h] - 1;
+                Value cv = chunk->constants[words[4 + 2 * k]];
+                if (strcmp(VALUE_AS_STRING(cv)->chars, str) == 0) {
+                    pos = 5 + 2 * k;
+                    break;
+                }
+                h = (h + 1) & mask;
+            }
+        }
+        ip = (LunaInsn *)slot + mask + 1;
+        ip += (int32_t)words[pos];
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_concat_n:
+    #else
+    case VM_OP_CONCAT_N:
+    #endif
+    {
+        uint8_t dst = ARG_A();
+        uint8_t first = ARG_B();
+        uint8_t count = ARG_C();
+        Value res = vm_concat_values(&slots[first], count);
+        value_free(slots[dst]);
+        slots[dst] = res;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    /* Quickened arithmetic/comparison. A failed guard rewrites the opcode to
+     * its generic form, steps ip back and re-dispatches the same word. */
+    #ifdef __GNUC__
+    do_add_ii:
+    #else
+    case VM_OP_ADD_II:
+    #endif
+    {
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_ADD);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
+        value_free(slots[dst]);
+        slots[dst] = value_int(VALUE_AS_INT(l) + VALUE_AS_INT(r));
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_add_ff:
+    #else
+    case VM_OP_ADD_FF:
+    #endif
+    {
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_FLOAT || VALUE_TYPE(r) != VAL_FLOAT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_ADD);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
+        value_free(slots[dst]);
+        slots[dst] = value_float(VALUE_AS_FLOAT(l) + VALUE_AS_FLOAT(r));
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_sub_ii:
+    #else
+    case VM_OP_SUB_II:
+    #endif
+    {
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_SUB);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
+        value_free(slots[dst]);
+        slots[dst] = value_int(VALUE_AS_INT(l) - VALUE_AS_INT(r));
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_sub_ff:
+    #else
+    case VM_OP_SUB_FF:
+    #endif
+    {
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_FLOAT || VALUE_TYPE(r) != VAL_FLOAT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_SUB);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
+        value_free(slots[dst]);
+        slots[dst] = value_float(VALUE_AS_FLOAT(l) - VALUE_AS_FLOAT(r));
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_mul_ii:
+    #else
+    case VM_OP_MUL_II:
+    #endif
+    {
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_MUL);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
+        value_free(slots[dst]);
+        slots[dst] = value_int(VALUE_AS_INT(l) * VALUE_AS_INT(r));
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_mul_ff:
+    #else
+    case VM_OP_MUL_FF:
+    #endif
+    {
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_FLOAT || VALUE_TYPE(r) != VAL_FLOAT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_MUL);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
+        value_free(slots[dst]);
+        slots[dst] = value_float(VALUE_AS_FLOAT(l) * VALUE_AS_FLOAT(r));
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_eq_ii:
+    #else
+    case VM_OP_EQ_II:
+    #endif
+    {
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_EQ);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
+        value_free(slots[dst]);
+        slots[dst] = value_bool(VALUE_AS_INT(l) == VALUE_AS_INT(r));
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_neq_ii:
     #else
-    case VM_OP_MUL:
+    case VM_OP_NEQ_II:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        Value res;
-        if ((l.type == VAL_LIST || l.type == VAL_DENSE_LIST) &&
-            (r.type == VAL_LIST || r.type == VAL_DENSE_LIST)) {
-            res = vec_mul_values(l, r);
-        } else if (l.type == VAL_INT && r.type == VAL_INT) {
-            res = value_int(l.i * r.i);
-        } else {
-            res = value_float(value_to_double(l) * value_to_double(r));
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_NEQ);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
         }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = res;
+        slots[dst] = value_bool(VALUE_AS_INT(l) != VALUE_AS_INT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -605,30 +1864,25 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_div:
+    do_lt_ii:
     #else
-    case VM_OP_DIV:
+    case VM_OP_LT_II:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        Value res;
-        if ((l.type == VAL_LIST || l.type == VAL_DENSE_LIST) &&
-            (r.type == VAL_LIST || r.type == VAL_DENSE_LIST)) {
-            res = vec_div_values(l, r);
-        } else if (l.type == VAL_INT && r.type == VAL_INT) {
-            if (r.i == 0) res = value_int(0);
-            else if (l.i % r.i == 0) res = value_int(l.i / r.i);
-            else res = value_float((double)l.i / (double)r.i);
-        } else {
-            double dr = value_to_double(r);
-            res = value_float(dr == 0.0 ? 0.0 : value_to_double(l) / dr);
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_LT);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
         }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = res;
+        slots[dst] = value_bool(VALUE_AS_INT(l) < VALUE_AS_INT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -637,24 +1891,25 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_mod:
+    do_lt_ff:
     #else
-    case VM_OP_MOD:
+    case VM_OP_LT_FF:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        Value res;
-        if (l.type == VAL_INT && r.type == VAL_INT) {
-            res = value_int(r.i == 0 ? 0 : l.i % r.i);
-        } else {
-            res = value_int(r.f == 0.0 ? 0 : (long long)value_to_double(l) % (long long)value_to_double(r));
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_FLOAT || VALUE_TYPE(r) != VAL_FLOAT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_LT);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
         }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = res;
+        slots[dst] = value_bool(VALUE_AS_FLOAT(l) < VALUE_AS_FLOAT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -663,32 +1918,25 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_eq:
+    do_lte_ii:
     #else
-    case VM_OP_EQ:
+    case VM_OP_LTE_II:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        bool eq = false;
-        if (l.type == r.type) {
-            if (l.type == VAL_INT) eq = (l.i == r.i);
-            else if (l.type == VAL_FLOAT) eq = (l.f == r.f);
-            else if (l.type == VAL_BOOL) eq = (l.b == r.b);
-            else if (l.type == VAL_CHAR) eq = (l.c == r.c);
-            else if (l.type == VAL_POINTER) eq = (l.ptr == r.ptr);
-            else if (l.type == VAL_BLOC) eq = value_bloc_equal(l, r);
-            else if (l.type == VAL_STRING) eq = (strcmp(l.string->chars, r.string->chars) == 0);
-            else if (l.type == VAL_NULL) eq = true;
-        } else if ((l.type == VAL_INT && r.type == VAL_FLOAT) ||
-                   (l.type == VAL_FLOAT && r.type == VAL_INT)) {
-            eq = (value_to_double(l) == value_to_double(r));
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_LTE);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
         }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = value_bool(eq ? 1 : 0);
+        slots[dst] = value_bool(VALUE_AS_INT(l) <= VALUE_AS_INT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -697,32 +1945,25 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_neq:
+    do_lte_ff:
     #else
-    case VM_OP_NEQ:
+    case VM_OP_LTE_FF:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        bool eq = false;
-        if (l.type == r.type) {
-            if (l.type == VAL_INT) eq = (l.i == r.i);
-            else if (l.type == VAL_FLOAT) eq = (l.f == r.f);
-            else if (l.type == VAL_BOOL) eq = (l.b == r.b);
-            else if (l.type == VAL_CHAR) eq = (l.c == r.c);
-            else if (l.type == VAL_POINTER) eq = (l.ptr == r.ptr);
-            else if (l.type == VAL_BLOC) eq = value_bloc_equal(l, r);
-            else if (l.type == VAL_STRING) eq = (strcmp(l.string->chars, r.string->chars) == 0);
-            else if (l.type == VAL_NULL) eq = true;
-        } else if ((l.type == VAL_INT && r.type == VAL_FLOAT) ||
-                   (l.type == VAL_FLOAT && r.type == VAL_INT)) {
-            eq = (value_to_double(l) == value_to_double(r));
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_FLOAT || VALUE_TYPE(r) != VAL_FLOAT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_LTE);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
         }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = value_bool(eq ? 0 : 1);
+        slots[dst] = value_bool(VALUE_AS_FLOAT(l) <= VALUE_AS_FLOAT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -731,22 +1972,25 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_lt:
+    do_gt_ii:
     #else
-    case VM_OP_LT:
+    case VM_OP_GT_II:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        bool res;
-        if (l.type == VAL_POINTER && r.type == VAL_POINTER) res = (l.ptr < r.ptr);
-        else if (l.type == VAL_INT && r.type == VAL_INT) res = (l.i < r.i);
-        else res = (value_to_double(l) < value_to_double(r));
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_GT);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = value_bool(res ? 1 : 0);
+        slots[dst] = value_bool(VALUE_AS_INT(l) > VALUE_AS_INT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -755,22 +1999,25 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_lte:
+    do_gt_ff:
     #else
-    case VM_OP_LTE:
+    case VM_OP_GT_FF:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        bool res;
-        if (l.type == VAL_POINTER && r.type == VAL_POINTER) res = (l.ptr <= r.ptr);
-        else if (l.type == VAL_INT && r.type == VAL_INT) res = (l.i <= r.i);
-        else res = (value_to_double(l) <= value_to_double(r));
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_FLOAT || VALUE_TYPE(r) != VAL_FLOAT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_GT);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = value_bool(res ? 1 : 0);
+        slots[dst] = value_bool(VALUE_AS_FLOAT(l) > VALUE_AS_FLOAT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -779,22 +2026,25 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_gt:
+    do_gte_ii:
     #else
-    case VM_OP_GT:
+    case VM_OP_GTE_II:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        bool res;
-        if (l.type == VAL_POINTER && r.type == VAL_POINTER) res = (l.ptr > r.ptr);
-        else if (l.type == VAL_INT && r.type == VAL_INT) res = (l.i > r.i);
-        else res = (value_to_double(l) > value_to_double(r));
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_INT || VALUE_TYPE(r) != VAL_INT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_GTE);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = value_bool(res ? 1 : 0);
+        slots[dst] = value_bool(VALUE_AS_INT(l) >= VALUE_AS_INT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -803,22 +2053,25 @@ Value luna_vm_execute(LunaVM *vm) {
     }
 
     #ifdef __GNUC__
-    do_gte:
+    do_gte_ff:
     #else
-    case VM_OP_GTE:
+    case VM_OP_GTE_FF:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t lhs = READ_BYTE();
-        uint8_t rhs = READ_BYTE();
-        Value l = slots[lhs];
-        Value r = slots[rhs];
-        bool res;
-        if (l.type == VAL_POINTER && r.type == VAL_POINTER) res = (l.ptr >= r.ptr);
-        else if (l.type == VAL_INT && r.type == VAL_INT) res = (l.i >= r.i);
-        else res = (value_to_double(l) >= value_to_double(r));
+        Value l = slots[ARG_B()];
+        Value r = slots[ARG_C()];
+        if (VALUE_TYPE(l) != VAL_FLOAT || VALUE_TYPE(r) != VAL_FLOAT) {
+            ip[-1] = luna_insn_with_op(ip[-1], VM_OP_GTE);
+            ip--;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
-        slots[dst] = value_bool(res ? 1 : 0);
+        slots[dst] = value_bool(VALUE_AS_FLOAT(l) >= VALUE_AS_FLOAT(r));
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -832,8 +2085,8 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_NOT:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t src = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t src = ARG_B();
         Value v = slots[src];
         bool falsy = !vm_is_truthy(v);
         value_free(slots[dst]);
@@ -851,11 +2104,11 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_NEG:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t src = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t src = ARG_B();
         Value v = slots[src];
         Value res;
-        if (v.type == VAL_INT) res = value_int(-v.i);
+        if (VALUE_TYPE(v) == VAL_INT) res = value_int(-VALUE_AS_INT(v));
         else res = value_float(-value_to_double(v));
         value_free(slots[dst]);
         slots[dst] = res;
@@ -872,8 +2125,9 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_JUMP:
     #endif
     {
-        int16_t offset = (int16_t)READ_SHORT();
+        int offset = ARG_SBX();
         ip += offset;
+        if (offset < 0) VM_JIT_LOOP(ip - offset);
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -887,8 +2141,8 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_JUMP_IF_TRUE:
     #endif
     {
-        uint8_t cond_reg = READ_BYTE();
-        int16_t offset = (int16_t)READ_SHORT();
+        uint8_t cond_reg = ARG_A();
+        int offset = ARG_SBX();
         Value v = slots[cond_reg];
         bool truthy = vm_is_truthy(v);
         if (truthy) ip += offset;
@@ -905,8 +2159,8 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_JUMP_IF_FALSE:
     #endif
     {
-        uint8_t cond_reg = READ_BYTE();
-        int16_t offset = (int16_t)READ_SHORT();
+        uint8_t cond_reg = ARG_A();
+        int offset = ARG_SBX();
         Value v = slots[cond_reg];
         bool truthy = vm_is_truthy(v);
         if (!truthy) ip += offset;
@@ -923,18 +2177,28 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_GET_GLOBAL:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint16_t name_idx = READ_SHORT();
-        Value name_val = chunk->constants[name_idx];
-        const char *interned = intern_string(name_val.string->chars);
-        #ifdef LUNA_VM_DEBUG
-        printf("[GET_GLOBAL] Searching for %s (interned ptr: %p, constant chars ptr: %p)\n",
-               name_val.string->chars, (void*)interned, (void*)name_val.string->chars);
-        #endif
-        Value *gval = env_get(vm->env, interned);
+        uint8_t dst = ARG_A();
+        uint16_t cache_idx = ARG_BX();
+        LunaGlobalCache *gc = &chunk->global_caches[cache_idx];
+        Value *gval;
+        if (gc->env == vm->env && gc->epoch == env_binding_epoch) {
+            VM_COUNT(global_ic_hits);
+            gval = gc->slot;
+        } else {
+            VM_COUNT(global_ic_misses);
+            #ifdef LUNA_VM_DEBUG
+            printf("[GET_GLOBAL] cache miss for %s (interned ptr: %p)\n", gc->name, (void*)gc->name);
+            #endif
+            gval = env_get(vm->env, gc->name);
+            if (gval) {
+                gc->env = vm->env;
+                gc->epoch = env_binding_epoch;
+                gc->slot = gval;
+            }
+        }
         if (!gval) {
             char msg[256];
-            snprintf(msg, sizeof(msg), "Variable '%s' is not defined", name_val.string->chars);
+            snprintf(msg, sizeof(msg), "Variable '%s' is not defined", gc->name);
             error_report_with_context(ERR_NAME, vm_op_line(chunk, ip), 0, msg,
                 "Declare variables with 'let' before using them");
             value_free(slots[dst]);
@@ -960,20 +2224,31 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_SET_GLOBAL:
     #endif
     {
-        uint16_t name_idx = READ_SHORT();
-        uint8_t src = READ_BYTE();
-        int line = vm_op_line(chunk, ip);
-        Value name_val = chunk->constants[name_idx];
-        const char *interned = intern_string(name_val.string->chars);
+        uint8_t src = ARG_A();
+        uint16_t cache_idx = ARG_BX();
+        LunaGlobalCache *gc = &chunk->global_caches[cache_idx];
         if (unsafe_runtime_inside_block() && unsafe_runtime_is_pointer(slots[src]) &&
-            !unsafe_runtime_check_escape(slots[src], line)) {
+            !unsafe_runtime_check_escape(slots[src], vm_op_line(chunk, ip))) {
             #ifdef __GNUC__
             DISPATCH();
             #else
             break;
             #endif
         }
-        env_def(vm->env, interned, value_copy(slots[src]));
+        /* The cached slot is always a non-const entry local to gc->env, so
+         * overwriting it in place is exactly what env_def would do. */
+        if (gc->env == vm->env && gc->epoch == env_binding_epoch && gc->slot) {
+            VM_COUNT(global_ic_hits);
+            value_free(*gc->slot);
+            *gc->slot = value_copy(slots[src]);
+        } else {
+            VM_COUNT(global_ic_misses);
+            luna_current_line = vm_op_line(chunk, ip);
+            env_def(vm->env, gc->name, value_copy(slots[src]));
+            gc->env = vm->env;
+            gc->epoch = env_binding_epoch;
+            gc->slot = env_get_local_writable(vm->env, gc->name);
+        }
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -987,8 +2262,8 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_GET_UPVAL:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t idx = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t idx = ARG_B();
         value_free(slots[dst]);
         slots[dst] = value_copy(*frame->upvalues[idx]->location);
         #ifdef __GNUC__
@@ -1004,8 +2279,8 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_SET_UPVAL:
     #endif
     {
-        uint8_t idx = READ_BYTE();
-        uint8_t src = READ_BYTE();
+        uint8_t idx = ARG_A();
+        uint8_t src = ARG_B();
         Value *loc = frame->upvalues[idx]->location;
         value_free(*loc);
         *loc = value_copy(slots[src]);
@@ -1022,7 +2297,7 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_NEW_LIST:
     #endif
     {
-        uint8_t dst = READ_BYTE();
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
         slots[dst] = value_list();
         #ifdef __GNUC__
@@ -1038,12 +2313,13 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_LIST_APPEND:
     #endif
     {
-        uint8_t list_reg = READ_BYTE();
-        uint8_t val_reg = READ_BYTE();
+        uint8_t list_reg = ARG_A();
+        uint8_t val_reg = ARG_B();
         Value *list_val = &slots[list_reg];
         Value val = slots[val_reg];
-        if (list_val->type == VAL_LIST &&
-            vm_ptr_store_ok(val, vm_op_line(chunk, ip))) {
+        value_range_materialize(list_val);
+        if (VALUE_TYPE(*list_val) == VAL_LIST &&
+            vm_ptr_store_ok(val, chunk, ip)) {
             value_list_append(list_val, value_copy(val));
         }
         #ifdef __GNUC__
@@ -1059,40 +2335,42 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_INDEX_GET:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t target_reg = READ_BYTE();
-        uint8_t idx_reg = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t target_reg = ARG_B();
+        uint8_t idx_reg = ARG_C();
         Value target = slots[target_reg];
         Value index = slots[idx_reg];
         Value ret = value_null();
-        if (target.type == VAL_LIST && index.type == VAL_INT) {
-            long long idx = index.i;
-            if (idx < 0) idx += target.list->count;
-            if (idx >= 0 && idx < target.list->count) {
-                ret = value_copy(target.list->items[idx]);
+        if (VALUE_TYPE(target) == VAL_LIST && VALUE_TYPE(index) == VAL_INT) {
+            long long idx = VALUE_AS_INT(index);
+            if (idx < 0) idx += VALUE_AS_LIST(target)->count;
+            if (idx >= 0 && idx < VALUE_AS_LIST(target)->count) {
+                ret = value_copy(VALUE_AS_LIST(target)->items[idx]);
             }
-        } else if (target.type == VAL_DENSE_LIST && index.type == VAL_INT) {
-            long long idx = index.i;
-            if (idx < 0) idx += target.dlist->count;
-            if (idx >= 0 && idx < target.dlist->count) {
-                ret = value_float(target.dlist->data[idx]);
+        } else if (VALUE_TYPE(target) == VAL_DENSE_LIST && VALUE_TYPE(index) == VAL_INT) {
+            long long idx = VALUE_AS_INT(index);
+            if (idx < 0) idx += VALUE_AS_DLIST(target)->count;
+            if (idx >= 0 && idx < VALUE_AS_DLIST(target)->count) {
+                ret = value_float(VALUE_AS_DLIST(target)->data[idx]);
             }
-        } else if (target.type == VAL_STRING && index.type == VAL_INT) {
-            long long idx = index.i;
-            long long len = (long long)strlen(target.string->chars);
+        } else if (VALUE_TYPE(target) == VAL_STRING && VALUE_TYPE(index) == VAL_INT) {
+            long long idx = VALUE_AS_INT(index);
+            long long len = (long long)strlen(VALUE_AS_STRING(target)->chars);
             if (idx < 0) idx += len;
             if (idx >= 0 && idx < len) {
-                ret = value_char(target.string->chars[idx]);
+                ret = value_char(VALUE_AS_STRING(target)->chars[idx]);
             }
-        } else if (target.type == VAL_TEMPLATE && index.type == VAL_STRING) {
+        } else if (VALUE_TYPE(target) == VAL_RANGE && VALUE_TYPE(index) == VAL_INT) {
+            ret = value_range_get(VALUE_AS_RANGE(target), VALUE_AS_INT(index));
+        } else if (VALUE_TYPE(target) == VAL_TEMPLATE && VALUE_TYPE(index) == VAL_STRING) {
             int found = 0;
-            ret = value_template_get_field(target, intern_string(index.string->chars), &found);
-        } else if (target.type == VAL_MAP && index.type == VAL_STRING) {
-            Value *got = value_map_get(&target, intern_string(index.string->chars));
+            ret = value_template_get_field(target, intern_string(VALUE_AS_STRING(index)->chars), &found);
+        } else if (VALUE_TYPE(target) == VAL_MAP && VALUE_TYPE(index) == VAL_STRING) {
+            Value *got = value_map_get(&target, intern_string(VALUE_AS_STRING(index)->chars));
             if (got) ret = value_copy(*got);
-        } else if (target.type == VAL_BLOC && index.type == VAL_STRING) {
+        } else if (VALUE_TYPE(target) == VAL_BLOC && VALUE_TYPE(index) == VAL_STRING) {
             int found = 0;
-            ret = value_bloc_get_field(target, intern_string(index.string->chars), &found);
+            ret = value_bloc_get_field(target, intern_string(VALUE_AS_STRING(index)->chars), &found);
         }
         value_free(slots[dst]);
         slots[dst] = ret;
@@ -1109,36 +2387,36 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_INDEX_SET:
     #endif
     {
-        uint8_t target_reg = READ_BYTE();
-        uint8_t idx_reg = READ_BYTE();
-        uint8_t val_reg = READ_BYTE();
-        int line = vm_op_line(chunk, ip);
+        uint8_t target_reg = ARG_A();
+        uint8_t idx_reg = ARG_B();
+        uint8_t val_reg = ARG_C();
+        value_range_materialize(&slots[target_reg]);
         Value target = slots[target_reg];
         Value index = slots[idx_reg];
         Value val = slots[val_reg];
-        if (target.type == VAL_LIST && index.type == VAL_INT) {
-            long long idx = index.i;
-            if (idx < 0) idx += target.list->count;
-            if (idx >= 0 && idx < target.list->count &&
-                vm_ptr_store_ok(val, line)) {
-                value_free(target.list->items[idx]);
-                target.list->items[idx] = value_copy(val);
+        if (VALUE_TYPE(target) == VAL_LIST && VALUE_TYPE(index) == VAL_INT) {
+            long long idx = VALUE_AS_INT(index);
+            if (idx < 0) idx += VALUE_AS_LIST(target)->count;
+            if (idx >= 0 && idx < VALUE_AS_LIST(target)->count &&
+                vm_ptr_store_ok(val, chunk, ip)) {
+                value_free(VALUE_AS_LIST(target)->items[idx]);
+                VALUE_AS_LIST(target)->items[idx] = value_copy(val);
             }
-        } else if (target.type == VAL_DENSE_LIST && index.type == VAL_INT) {
-            long long idx = index.i;
-            if (idx < 0) idx += target.dlist->count;
-            if (idx >= 0 && idx < target.dlist->count) {
-                target.dlist->data[idx] = value_to_double(val);
+        } else if (VALUE_TYPE(target) == VAL_DENSE_LIST && VALUE_TYPE(index) == VAL_INT) {
+            long long idx = VALUE_AS_INT(index);
+            if (idx < 0) idx += VALUE_AS_DLIST(target)->count;
+            if (idx >= 0 && idx < VALUE_AS_DLIST(target)->count) {
+                VALUE_AS_DLIST(target)->data[idx] = value_to_double(val);
             }
-        } else if (target.type == VAL_MAP) {
-            if (index.type == VAL_STRING && vm_ptr_store_ok(val, line)) {
-                value_map_set(&target, intern_string(index.string->chars), value_copy(val));
+        } else if (VALUE_TYPE(target) == VAL_MAP) {
+            if (VALUE_TYPE(index) == VAL_STRING && vm_ptr_store_ok(val, chunk, ip)) {
+                value_map_set(&target, intern_string(VALUE_AS_STRING(index)->chars), value_copy(val));
             }
-        } else if (target.type == VAL_TEMPLATE) {
-            if (index.type == VAL_STRING && vm_ptr_store_ok(val, line)) {
+        } else if (VALUE_TYPE(target) == VAL_TEMPLATE) {
+            if (VALUE_TYPE(index) == VAL_STRING && vm_ptr_store_ok(val, chunk, ip)) {
                 char msg[256];
                 Value val_copy = value_copy(val);
-                value_template_set_field(&target, intern_string(index.string->chars), &val_copy, msg, sizeof(msg));
+                value_template_set_field(&target, intern_string(VALUE_AS_STRING(index)->chars), &val_copy, msg, sizeof(msg));
             }
         }
         #ifdef __GNUC__
@@ -1154,7 +2432,7 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_NEW_MAP:
     #endif
     {
-        uint8_t dst = READ_BYTE();
+        uint8_t dst = ARG_A();
         value_free(slots[dst]);
         slots[dst] = value_map();
         #ifdef __GNUC__
@@ -1170,15 +2448,14 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_MAP_SET:
     #endif
     {
-        uint8_t map_reg = READ_BYTE();
-        uint16_t key_idx = READ_SHORT();
-        uint8_t val_reg = READ_BYTE();
-        int line = vm_op_line(chunk, ip);
+        uint8_t map_reg = ARG_A();
+        uint8_t val_reg = ARG_B();
+        uint32_t key_idx = READ_WORD();
         Value *map_val = &slots[map_reg];
         Value val = slots[val_reg];
-        if (map_val->type == VAL_MAP && vm_ptr_store_ok(val, line)) {
+        if (VALUE_TYPE(*map_val) == VAL_MAP && vm_ptr_store_ok(val, chunk, ip)) {
             Value key_val = chunk->constants[key_idx];
-            value_map_set(map_val, intern_string(key_val.string->chars), value_copy(val));
+            value_map_set(map_val, intern_string(VALUE_AS_STRING(key_val)->chars), value_copy(val));
         }
         #ifdef __GNUC__
         DISPATCH();
@@ -1193,25 +2470,26 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_BOX_ALLOC:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t size_reg = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t size_reg = ARG_B();
         int line = vm_op_line(chunk, ip);
         Value size = slots[size_reg];
         Value res = value_null();
-        if (size.type != VAL_INT) {
+        if (VALUE_TYPE(size) != VAL_INT) {
             error_report_with_context(ERR_TYPE, line, 0,
                 "box[...] expects an integer byte size",
                 "Use box[128] or another positive integer size");
         } else {
             char msg[256];
-            res = value_box((size_t)size.i, msg, sizeof(msg));
-            if (res.type == VAL_NULL) {
+            res = value_box((size_t)VALUE_AS_INT(size), msg, sizeof(msg));
+            if (VALUE_TYPE(res) == VAL_NULL) {
                 error_report_with_context(ERR_ARGUMENT, line, 0, msg,
                     "Boxes are stack-scoped scratch buffers up to one cache line");
             } else {
                 uint64_t scope_id = vm->scope_depth > 0 ?
                     vm->scope_stack[vm->scope_depth - 1] : 0;
                 value_box_mark_scope(res, scope_id);
+                frame->pinned = 1;
             }
         }
         value_free(slots[dst]);
@@ -1229,11 +2507,16 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_ADDR_OF:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t src = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t src = ARG_B();
         int line = vm_op_line(chunk, ip);
+        if (!vm->stack_reserved) {
+            vm_pin_stack(vm);
+            slots = frame->slots;
+        }
         value_free(slots[dst]);
         slots[dst] = unsafe_runtime_addr(&slots[src], line);
+        frame->pinned = 1;
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -1247,15 +2530,15 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_ADDR_OF_GLOBAL:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint16_t name_idx = READ_SHORT();
+        uint8_t dst = ARG_A();
+        uint16_t name_idx = ARG_BX();
         int line = vm_op_line(chunk, ip);
         Value name_val = chunk->constants[name_idx];
-        const char *interned = intern_string(name_val.string->chars);
+        const char *interned = intern_string(VALUE_AS_STRING(name_val)->chars);
         Value *slot = env_get(vm->env, interned);
         if (!slot) {
             char msg[256];
-            snprintf(msg, sizeof(msg), "Variable '%s' is not defined", name_val.string->chars);
+            snprintf(msg, sizeof(msg), "Variable '%s' is not defined", VALUE_AS_STRING(name_val)->chars);
             error_report_with_context(ERR_NAME, line, 0, msg,
                 "Declare variables with 'let' before using them");
             value_free(slots[dst]);
@@ -1277,25 +2560,26 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_FIELD_GET:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t target_reg = READ_BYTE();
-        uint16_t name_idx = READ_SHORT();
-        int line = vm_op_line(chunk, ip);
+        uint8_t dst = ARG_A();
+        uint8_t target_reg = ARG_B();
+        uint32_t cache_idx = READ_WORD();
+        LunaFieldCache *fc = &chunk->field_caches[cache_idx];
         Value target = slots[target_reg];
-        Value name_val = chunk->constants[name_idx];
         Value ret = value_null();
-        if (target.type == VAL_MAP) {
-            const char *fname = intern_string(name_val.string->chars);
-            Value *got = value_map_get(&target, fname);
+        if (VALUE_TYPE(target) == VAL_MAP) {
+            int hint = fc->map_hint;
+            Value *got = value_map_get_hinted(&target, fc->name, &fc->map_hint);
+            if (got && fc->map_hint == hint) VM_COUNT(map_ic_hits);
+            else VM_COUNT(map_ic_misses);
             if (got) ret = value_copy(*got);
-        } else if (target.type == VAL_TEMPLATE) {
-            int found = 0;
-            ret = value_template_get_field(target, intern_string(name_val.string->chars), &found);
-        } else if (target.type == VAL_BLOC) {
-            int found = 0;
-            ret = value_bloc_get_field(target, intern_string(name_val.string->chars), &found);
-        } else if (target.type == VAL_BOX) {
-            const char *f = intern_string(name_val.string->chars);
+        } else if (VALUE_TYPE(target) == VAL_TEMPLATE) {
+            int idx = vm_field_index(fc, target);
+            if (idx >= 0) ret = value_template_get_index(target, idx);
+        } else if (VALUE_TYPE(target) == VAL_BLOC) {
+            int idx = vm_field_index(fc, target);
+            if (idx >= 0) ret = value_bloc_get_index(target, idx);
+        } else if (VALUE_TYPE(target) == VAL_BOX) {
+            const char *f = fc->name;
             if (f == intern_string("len")) {
                 ret = value_int((long long)value_box_len(target));
             } else if (f == intern_string("cap")) {
@@ -1303,7 +2587,7 @@ Value luna_vm_execute(LunaVM *vm) {
             } else {
                 char msg[256];
                 snprintf(msg, sizeof(msg), "Field '%s' does not exist on this box value", f);
-                error_report_with_context(ERR_NAME, line, 0, msg,
+                error_report_with_context(ERR_NAME, vm_op_line(chunk, ip), 0, msg,
                     "Use box.len or box.cap for phase-1 box values");
             }
         }
@@ -1322,18 +2606,25 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_FIELD_SET:
     #endif
     {
-        uint8_t target_reg = READ_BYTE();
-        uint16_t name_idx = READ_SHORT();
-        uint8_t val_reg = READ_BYTE();
+        /* `obj.name = val`: same semantics as INDEX_SET with a string key. */
+        uint8_t target_reg = ARG_A();
+        uint8_t val_reg = ARG_B();
+        uint32_t cache_idx = READ_WORD();
+        LunaFieldCache *fc = &chunk->field_caches[cache_idx];
         Value target = slots[target_reg];
-        Value name_val = chunk->constants[name_idx];
         Value val = slots[val_reg];
-        if (target.type == VAL_MAP) {
-            value_map_set(&target, name_val.string->chars, value_copy(val));
-        } else if (target.type == VAL_TEMPLATE) {
-            char msg[256];
-            Value val_copy = value_copy(val);
-            value_template_set_field(&target, intern_string(name_val.string->chars), &val_copy, msg, sizeof(msg));
+        if (VALUE_TYPE(target) == VAL_MAP) {
+            if (vm_ptr_store_ok(val, chunk, ip)) {
+                value_map_set(&target, fc->name, val);
+            }
+        } else if (VALUE_TYPE(target) == VAL_TEMPLATE) {
+            if (vm_ptr_store_ok(val, chunk, ip)) {
+                int idx = vm_field_index(fc, target);
+                if (idx >= 0) {
+                    Value val_copy = value_copy(val);
+                    value_template_set_index(&target, idx, &val_copy);
+                }
+            }
         }
         #ifdef __GNUC__
         DISPATCH();
@@ -1348,27 +2639,23 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_CALL:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t callee_reg = READ_BYTE();
-        uint8_t argc = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t callee_reg = ARG_B();
+        uint8_t argc = ARG_C();
         Value callee = slots[callee_reg];
         
-        if (callee.type == VAL_VM_CLOSURE) {
-            VMClosureObj *closure = callee.vm_closure;
+        if (VALUE_TYPE(callee) == VAL_VM_CLOSURE) {
+            VMClosureObj *closure = VALUE_AS_VM_CLOSURE(callee);
             LunaChunk *sub = closure->chunk;
-            if (vm->frame_count >= FRAMES_MAX) {
-                fprintf(stderr, "VM Error: stack overflow\n");
-                abort();
-            }
-
             // Save IP back to frame
             frame->ip = ip;
 
-            // Push Call Frame
-            VMCallFrame *new_frame = &vm->frames[vm->frame_count++];
+            // Push Call Frame (may move the stack and frame array)
+            size_t base = (size_t)(slots - vm->stack) + callee_reg + 1;
+            VMCallFrame *new_frame = vm_push_frame(vm, base, sub->reg_count);
             new_frame->chunk = sub;
+            VM_PROFILE_CALL(sub);
             new_frame->ip = sub->code;
-            new_frame->slots = slots + callee_reg + 1;
             new_frame->upvalues = closure->upvalues;
             new_frame->argc = argc;
             new_frame->ret_dst = dst;
@@ -1386,34 +2673,15 @@ Value luna_vm_execute(LunaVM *vm) {
             chunk = frame->chunk;
             ip = frame->ip;
             slots = frame->slots;
-        } else if (callee.type == VAL_DATA_TYPE) {
-            Value *args = slots + callee_reg + 1;
-            int line = frame->chunk->line_map[ip - frame->chunk->code - 4];
-            Value ret = instantiate_data_type(callee, argc, args, line);
-            value_free(slots[dst]);
-            slots[dst] = ret;
-        } else if (callee.type == VAL_BLOC_TYPE) {
-            Value *args = slots + callee_reg + 1;
-            int line = frame->chunk->line_map[ip - frame->chunk->code - 4];
-            char msg[256];
-            Value ret = value_null();
-            if (!value_bloc_check_construct(callee, argc, args, msg, sizeof(msg))) {
-                error_report_with_context(ERR_TYPE, line, 0, msg,
-                    "Bloc values must stay inline and only use int, float, bool, char, or nested blocs");
-            } else {
-                ret = value_bloc_construct(callee, argc, args);
-            }
-            value_free(slots[dst]);
-            slots[dst] = ret;
         } else {
             Value *args = slots + callee_reg + 1;
-            int line = frame->chunk->line_map[ip - frame->chunk->code - 4];
+            int line = vm_op_line(chunk, ip);
             #ifdef LUNA_VM_DEBUG
             char *s = value_to_string(callee);
             printf("[VM_OP_CALL] Fallback call. Callee type: %d, value: %s, line: %d\n", callee.type, s, line);
             free(s);
             #endif
-            Value ret = luna_call_value(vm->env, callee, argc, args, line);
+            Value ret = vm_call_inline(vm, callee, argc, args, line);
             value_free(slots[dst]);
             slots[dst] = ret;
         }
@@ -1429,24 +2697,17 @@ Value luna_vm_execute(LunaVM *vm) {
     #else
     case VM_OP_CALL_NAMED:
     #endif
+    call_word = ip[-1];
+    call_named:
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t callee_reg = READ_BYTE();
-        uint8_t argc = READ_BYTE();
-        uint16_t name_idx = READ_SHORT();
-        int line = vm_op_line(chunk, ip);
+        uint8_t dst = LUNA_A(call_word);
+        uint8_t callee_reg = LUNA_B(call_word);
+        uint8_t argc = LUNA_C(call_word);
+        uint32_t name_idx = READ_WORD();
         Value callee = slots[callee_reg];
 
-        int callable = (callee.type == VAL_VM_CLOSURE || callee.type == VAL_DATA_TYPE ||
-                        callee.type == VAL_BLOC_TYPE || callee.type == VAL_NATIVE ||
-                        callee.type == VAL_CLOSURE || callee.type == VAL_FUNCTION);
-        if (!callable) {
-            Value name_val = chunk->constants[name_idx];
-            const char *nm = name_val.type == VAL_STRING ? name_val.string->chars : "value";
-            char emsg[128];
-            snprintf(emsg, sizeof(emsg), "'%s' is not a function", nm);
-            error_report_with_context(ERR_TYPE, line, 0, emsg,
-                "Make sure you are calling a function value, closure, or native builtin");
+        if (!vm_is_callable(callee)) {
+            vm_report_not_callable(chunk, name_idx, vm_op_line(chunk, ip));
             value_free(slots[dst]);
             slots[dst] = value_null();
             #ifdef __GNUC__
@@ -1456,20 +2717,16 @@ Value luna_vm_execute(LunaVM *vm) {
             #endif
         }
 
-        if (callee.type == VAL_VM_CLOSURE) {
-            VMClosureObj *closure = callee.vm_closure;
+        if (VALUE_TYPE(callee) == VAL_VM_CLOSURE) {
+            VMClosureObj *closure = VALUE_AS_VM_CLOSURE(callee);
             LunaChunk *sub = closure->chunk;
-            if (vm->frame_count >= FRAMES_MAX) {
-                fprintf(stderr, "VM Error: stack overflow\n");
-                abort();
-            }
-
             frame->ip = ip;
 
-            VMCallFrame *new_frame = &vm->frames[vm->frame_count++];
+            size_t base = (size_t)(slots - vm->stack) + callee_reg + 1;
+            VMCallFrame *new_frame = vm_push_frame(vm, base, sub->reg_count);
             new_frame->chunk = sub;
+            VM_PROFILE_CALL(sub);
             new_frame->ip = sub->code;
-            new_frame->slots = slots + callee_reg + 1;
             new_frame->upvalues = closure->upvalues;
             new_frame->argc = argc;
             new_frame->ret_dst = dst;
@@ -1485,31 +2742,15 @@ Value luna_vm_execute(LunaVM *vm) {
             chunk = frame->chunk;
             ip = frame->ip;
             slots = frame->slots;
-        } else if (callee.type == VAL_DATA_TYPE) {
-            Value *args = slots + callee_reg + 1;
-            Value ret = instantiate_data_type(callee, argc, args, line);
-            value_free(slots[dst]);
-            slots[dst] = ret;
-        } else if (callee.type == VAL_BLOC_TYPE) {
-            Value *args = slots + callee_reg + 1;
-            char msg[256];
-            Value ret = value_null();
-            if (!value_bloc_check_construct(callee, argc, args, msg, sizeof(msg))) {
-                error_report_with_context(ERR_TYPE, line, 0, msg,
-                    "Bloc values must stay inline and only use int, float, bool, char, or nested blocs");
-            } else {
-                ret = value_bloc_construct(callee, argc, args);
-            }
-            value_free(slots[dst]);
-            slots[dst] = ret;
         } else {
             Value *args = slots + callee_reg + 1;
+            int line = vm_op_line(chunk, ip);
             #ifdef LUNA_VM_DEBUG
             char *s = value_to_string(callee);
             printf("[VM_OP_CALL_NAMED] Callee type: %d, value: %s, line: %d\n", callee.type, s, line);
             free(s);
             #endif
-            Value ret = luna_call_value(vm->env, callee, argc, args, line);
+            Value ret = vm_call_inline(vm, callee, argc, args, line);
             value_free(slots[dst]);
             slots[dst] = ret;
         }
@@ -1520,17 +2761,182 @@ Value luna_vm_execute(LunaVM *vm) {
         #endif
     }
 
+    #ifdef __GNUC__
+    do_call_native:
+    #else
+    case VM_OP_CALL_NATIVE:
+    #endif
+    {
+        /* A builtin resolved by the compiler, called without loading it into
+         * a register. If the global no longer holds that builtin, load
+         * whatever it holds and run the CALL_NAMED whose operands follow. */
+        uint8_t dst = ARG_A();
+        uint8_t callee_reg = ARG_B();
+        uint8_t argc = ARG_C();
+        LunaInsn ids = READ_WORD();
+        uint16_t native_idx = (uint16_t)ids;
+        uint16_t cache_idx = (uint16_t)(ids >> 16);
+        const LunaNativeDef *def = &luna_native_defs[native_idx];
+        LunaGlobalCache *gc = &chunk->global_caches[cache_idx];
+        Value *gval;
+        if (gc->env == vm->env && gc->epoch == env_binding_epoch) {
+            VM_COUNT(global_ic_hits);
+            gval = gc->slot;
+        } else {
+            VM_COUNT(global_ic_misses);
+            gval = env_get(vm->env, gc->name);
+            if (gval) {
+                gc->env = vm->env;
+                gc->epoch = env_binding_epoch;
+                gc->slot = gval;
+            }
+        }
+        if (!gval || VALUE_TYPE(*gval) != VAL_NATIVE || VALUE_AS_NATIVE(*gval) != (void *)def->fn) {
+            value_free(slots[callee_reg]);
+            slots[callee_reg] = gval ? value_copy(*gval) : value_null();
+            call_word = ip[-2];
+            goto call_named;
+        }
+        ip++;
+
+        Value *args = slots + callee_reg + 1;
+        Value ret;
+        if (def->unary && (VALUE_TYPE(args[0]) == VAL_INT || VALUE_TYPE(args[0]) == VAL_FLOAT)) {
+            double r = def->unary(VALUE_TYPE(args[0]) == VAL_INT ? (double)VALUE_AS_INT(args[0]) : VALUE_AS_FLOAT(args[0]));
+            ret = def->int_result ? value_int((long long)r) : value_float(r);
+        } else {
+            luna_current_line = vm_op_line(chunk, ip);
+            VM_PROFILE_FALLBACK_BEGIN(prof);
+            ret = def->fn(argc, args, vm->env);
+            VM_PROFILE_FALLBACK_END(prof);
+        }
+        value_free(slots[dst]);
+        slots[dst] = ret;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
+    #ifdef __GNUC__
+    do_tail_call:
+    #else
+    case VM_OP_TAIL_CALL:
+    #endif
+    {
+        /* `return f(...)`: always followed by RETURN callee_reg, which returns
+         * the result on every path except the frame-reusing one. */
+        uint8_t callee_reg = ARG_A();
+        uint8_t argc = ARG_B();
+        uint32_t name_idx = READ_WORD();
+        Value callee = slots[callee_reg];
+
+        if (VALUE_TYPE(callee) != VAL_VM_CLOSURE) {
+            int line = vm_op_line(chunk, ip);
+            Value ret = value_null();
+            if (vm_is_callable(callee)) {
+                ret = vm_call_inline(vm, callee, argc, slots + callee_reg + 1, line);
+            } else {
+                vm_report_not_callable(chunk, name_idx, line);
+            }
+            value_free(slots[callee_reg]);
+            slots[callee_reg] = ret;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+
+        VMClosureObj *closure = VALUE_AS_VM_CLOSURE(callee);
+        LunaChunk *sub = closure->chunk;
+
+        if (frame->pinned) {
+            // Defers, boxes or stack addresses still belong to this frame:
+            // make an ordinary call and let the RETURN that follows unwind it.
+            frame->ip = ip;
+
+            size_t base = (size_t)(slots - vm->stack) + callee_reg + 1;
+            VMCallFrame *new_frame = vm_push_frame(vm, base, sub->reg_count);
+            new_frame->chunk = sub;
+            VM_PROFILE_CALL(sub);
+            new_frame->ip = sub->code;
+            new_frame->upvalues = closure->upvalues;
+            new_frame->argc = argc;
+            new_frame->ret_dst = callee_reg;
+            new_frame->scope_base = vm->scope_depth;
+
+            for (int i = sub->param_count; i < sub->reg_count; i++) {
+                new_frame->slots[i] = value_null();
+            }
+
+            vm->stack_top = new_frame->slots + sub->reg_count;
+
+            frame = new_frame;
+            chunk = frame->chunk;
+            ip = frame->ip;
+            slots = frame->slots;
+            #ifdef __GNUC__
+            DISPATCH();
+            #else
+            break;
+            #endif
+        }
+
+        // Reuse this frame: unwind it as RETURN would, then slide the
+        // arguments down to register 0.
+        close_upvalues(vm, slots);
+        while (vm->scope_depth > frame->scope_base) {
+            uint64_t id = vm->scope_stack[--vm->scope_depth];
+            value_box_release_scope(id);
+        }
+
+        for (int i = 0; i < chunk->reg_count; i++) {
+            if (i < callee_reg || i > callee_reg + argc) value_free(slots[i]);
+        }
+        for (int i = 0; i < argc; i++) {
+            slots[i] = slots[callee_reg + 1 + i];
+        }
+
+        size_t base = (size_t)(slots - vm->stack);
+        if (base + (size_t)sub->reg_count > (size_t)(vm->stack_end - vm->stack)) {
+            vm_grow_stack(vm, base + (size_t)sub->reg_count);
+            slots = frame->slots;
+        }
+        for (int i = argc; i < sub->reg_count; i++) {
+            slots[i] = value_null();
+        }
+
+        frame->chunk = sub;
+        VM_PROFILE_CALL(sub);
+        frame->ip = sub->code;
+        frame->upvalues = closure->upvalues;
+        frame->closure = closure;
+        frame->argc = argc;
+        vm->stack_top = slots + sub->reg_count;
+
+        chunk = sub;
+        ip = frame->ip;
+        #ifdef __GNUC__
+        DISPATCH();
+        #else
+        break;
+        #endif
+    }
+
     #ifdef __GNUC__
     do_defer:
     #else
     case VM_OP_DEFER:
     #endif
     {
-        uint8_t callee_reg = READ_BYTE();
-        uint8_t argc = READ_BYTE();
+        uint8_t callee_reg = ARG_A();
+        uint8_t argc = ARG_B();
         int line = vm_op_line(chunk, ip);
         Value callee = slots[callee_reg];
         vm_defer_push(vm, callee, argc, slots + callee_reg + 1, line);
+        frame->pinned = 1;
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -1544,8 +2950,8 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_HAS_ARG:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint8_t idx = READ_BYTE();
+        uint8_t dst = ARG_A();
+        uint8_t idx = ARG_B();
         value_free(slots[dst]);
         slots[dst] = value_bool(frame->argc > idx);
         #ifdef __GNUC__
@@ -1561,7 +2967,7 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_RETURN:
     #endif
     {
-        uint8_t val_reg = READ_BYTE();
+        uint8_t val_reg = ARG_A();
         Value ret_val = value_copy(slots[val_reg]);
 
         // Close upvalues for local stack slots leaving scope
@@ -1614,18 +3020,30 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_CLOSURE:
     #endif
     {
-        uint8_t dst = READ_BYTE();
-        uint16_t sub_idx = READ_SHORT();
-        LunaChunk *sub = chunk->subchunks[sub_idx];
+        uint8_t dst = ARG_A();
+        LunaChunk *sub = chunk->subchunks[ARG_BX()];
 
-        Value closure = value_vm_closure(sub, sub->upvalue_count);
-        VMClosureObj *cl = closure.vm_closure;
+        int flat_count = 0;
+        for (int i = 0; i < sub->upvalue_count; i++) {
+            if (ip[i] & VM_CAPTURE_VALUE) flat_count++;
+        }
+        Value closure = value_vm_closure(sub, sub->upvalue_count, flat_count);
+        VMClosureObj *cl = VALUE_AS_VM_CLOSURE(closure);
 
-        // Capture upvalues
+        // Capture upvalues: shared VMUpvalues for reassigned variables,
+        // private closed copies for the rest.
+        VMUpvalue *flat = cl->flat;
         for (int i = 0; i < sub->upvalue_count; i++) {
-            uint8_t is_local = READ_BYTE();
-            uint8_t index = READ_BYTE();
-            if (is_local) {
+            LunaInsn capture = READ_WORD();
+            uint8_t flags = (uint8_t)capture;
+            uint8_t index = (uint8_t)(capture >> 8);
+            if (flags & VM_CAPTURE_VALUE) {
+                Value *src = (flags & VM_CAPTURE_LOCAL) ? &slots[index]
+                                                        : frame->upvalues[index]->location;
+                flat->closed = value_copy(*src);
+                flat->location = &flat->closed;
+                cl->upvalues[i] = flat++;
+            } else if (flags & VM_CAPTURE_LOCAL) {
                 cl->upvalues[i] = capture_upvalue(vm, &slots[index]);
             } else {
                 cl->upvalues[i] = frame->upvalues[index];
@@ -1647,12 +3065,7 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_SCOPE_BEGIN:
     #endif
     {
-        vm->next_scope_id++;
-        if (vm->scope_depth < VM_SCOPE_MAX) {
-            vm->scope_stack[vm->scope_depth] = vm->next_scope_id;
-            vm->defer_base_stack[vm->scope_depth] = vm->deferred_count;
-            vm->scope_depth++;
-        }
+        vm_scope_begin(vm);
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -1686,6 +3099,7 @@ Value luna_vm_execute(LunaVM *vm) {
     #endif
     {
         unsafe_runtime_begin_block(vm_op_line(chunk, ip));
+        frame->pinned = 1;
         #ifdef __GNUC__
         DISPATCH();
         #else
@@ -1713,13 +3127,11 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_IMPORT:
     #endif
     {
-        uint16_t path_idx = READ_SHORT();
-        uint8_t name_count = READ_BYTE();
-        uint16_t name_idxs[256];
-        for (int i = 0; i < name_count && i < 256; i++) {
-            name_idxs[i] = READ_SHORT();
-        }
-        READ_BYTE(); /* is_module_use flag (names are bound the same way) */
+        /* B is the is_module_use flag; names are bound the same way. */
+        uint8_t name_count = ARG_A();
+        uint32_t path_idx = READ_WORD();
+        const LunaInsn *name_idxs = ip;
+        ip += name_count;
         int line = vm_op_line(chunk, ip);
         vm_run_import(vm, path_idx, name_idxs, name_count, line);
         #ifdef __GNUC__
@@ -1735,7 +3147,7 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_PRINT:
     #endif
     {
-        uint8_t src = READ_BYTE();
+        uint8_t src = ARG_A();
         value_fprint(stdout, slots[src]);
         printf("\n");
         #ifdef __GNUC__
@@ -1751,9 +3163,8 @@ Value luna_vm_execute(LunaVM *vm) {
     case VM_OP_SAFEPOINT:
     #endif
     {
-        static _Thread_local int counter = 0;
-        if (++counter >= 1024) {
-            counter = 0;
+        if (++vm_safepoint_counter >= 1024) {
+            vm_safepoint_counter = 0;
             // Expose stack pointer to GC runtime
             frame->ip = ip;
             luna_gc_runtime_safe_point();
@@ -16,16 +16,24 @@ typedef struct VMUpvalue {
 
 typedef struct {
     LunaChunk *chunk;
-    uint8_t   *ip;
+    LunaInsn  *ip;
     Value     *slots; // points into VM stack
     VMUpvalue **upvalues;
+    VMClosureObj *closure; // set by TAIL_CALL, whose callee may no longer sit in a register
     uint8_t    argc;       // number of arguments passed to this call frame
     uint8_t    ret_dst;    // register in the caller where the return value goes
+    uint8_t    pinned;     // ran DEFER/BOX_ALLOC/ADDR_OF/UNSAFE_BEGIN: TAIL_CALL may not reuse it
     int        scope_base; // VM scope depth when this frame was entered
 } VMCallFrame;
 
-#define FRAMES_MAX 64
-#define STACK_MAX 1024
+/* The value stack and frame array start small and double on demand, up to
+ * luna_vm_max_frames() frames (LUNA_VM_MAX_FRAMES, default
+ * VM_FRAMES_LIMIT_DEFAULT). The first address_of into a register moves the
+ * stack into a reservation large enough for every frame, so it never moves
+ * again while pointers to it may exist. */
+#define VM_FRAMES_INIT 8
+#define VM_STACK_INIT 128
+#define VM_FRAMES_LIMIT_DEFAULT 100000
 #define VM_SCOPE_MAX 256
 #define VM_DEFERRED_MAX 64
 
@@ -37,11 +45,14 @@ typedef struct {
 } VMDeferred;
 
 typedef struct {
-    VMCallFrame frames[FRAMES_MAX];
+    VMCallFrame *frames;
     int frame_count;
+    int frame_capacity;
 
-    Value stack[STACK_MAX];
+    Value *stack;
     Value *stack_top;
+    Value *stack_end;       // one past the last allocated slot
+    size_t stack_reserved;  // slots mapped by vm_pin_stack, 0 while the stack may move
 
     VMUpvalue *open_upvalues;
     GCHeap *heap;
@@ -56,6 +67,30 @@ typedef struct {
     int        deferred_count;
 } LunaVM;
 
+/* Process-wide VM counters, printed at exit when LUNA_VM_STATS is set. The
+ * inline-cache and dispatch counts are only kept in DISPATCH_COUNT=1 builds,
+ * so the hot path does no counting otherwise. The struct is per thread; import prefetch workers fold their front-end counts
+ * into the main thread's. */
+typedef struct {
+    uint64_t global_ic_hits;   // inline-cache counts: DISPATCH_COUNT=1 builds only
+    uint64_t global_ic_misses;
+    uint64_t field_ic_hits;
+    uint64_t field_ic_misses;
+    uint64_t map_ic_hits;
+    uint64_t map_ic_misses;
+    uint64_t dispatches; // only counted in DISPATCH_COUNT=1 builds
+    uint64_t opt_bytes_in;  // bytecode size before / after luna_optimize_chunk
+    uint64_t opt_bytes_out;
+    uint64_t cache_hits;    // source files loaded from the .luc bytecode cache
+    uint64_t cache_misses;
+    uint64_t jit_loops;      // loops compiled by the baseline JIT (LUNA_JIT=1)
+    uint64_t jit_rejected;   // hot loops it could not compile
+    uint64_t jit_entries;    // times the VM ran a loop natively
+    uint64_t jit_side_exits; // native runs that ended in a failed type guard
+} LunaVMStats;
+
+extern _Thread_local LunaVMStats luna_vm_stats;
+
 void luna_vm_init(LunaVM *vm, GCHeap *heap);
 void luna_vm_free(LunaVM *vm);
 Value luna_vm_run(LunaVM *vm, LunaChunk *chunk);
@@ -67,5 +102,7 @@ void luna_vm_unregister(LunaVM *vm);
 void vm_gc_mark_roots(void *ctx);
 void vm_gc_mark_defer_roots(LunaVM *vm, void *ctx);
 void vm_upvalue_trace(GCObject *obj, void *ctx);
+void luna_vm_stats_print(FILE *out);
+int luna_vm_max_frames(void);
 
 #endif // LUNA_VM_H
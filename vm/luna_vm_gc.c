@@ -1,6 +1,7 @@
 #include "luna_vm.h"
 #include "env.h"
 #include "luna_chunk.h"
+#include "luna_prefetch.h"
 #include "unsafe_runtime.h"
 
 /* Active VM registry: nested VMs (e.g. module imports executed through the
@@ -57,9 +58,14 @@ static void vm_gc_mark_roots_one(LunaVM *vm, void *ctx) {
     // 3. Mark active environment roots (which traces global variables)
     env_gc_mark_active_roots(ctx);
 
-    // 4. Mark all constants of all active call stack chunks
+    // 4. Mark all constants of all active call stack chunks, and closures
+    //    kept alive only by a tail-called frame
     for (int i = 0; i < vm->frame_count; i++) {
         mark_chunk_constants(vm->frames[i].chunk, ctx);
+        if (vm->frames[i].closure) {
+            Value closure = value_make(VAL_VM_CLOSURE, (uintptr_t)vm->frames[i].closure);
+            value_gc_mark(&closure, ctx);
+        }
     }
 
     // 5. Mark deferred call values
@@ -73,4 +79,6 @@ void vm_gc_mark_roots(void *ctx) {
     for (int i = 0; i < vm_registry_count; i++) {
         vm_gc_mark_roots_one(vm_registry[i], ctx);
     }
+    // Prefetched modules whose import has not run yet
+    luna_prefetch_each_chunk(mark_chunk_constants, ctx);
 }
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime, strdup
+
+#include "luna_vm_profile.h"
+
+#ifdef LUNA_VM_PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "luna_opcode.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define PROFILE_OPS (VM_OP_GTE_FF + 1)
+
+static const char *profile_op_names[PROFILE_OPS] = {
+    "HALT", "LOAD_INT", "LOAD_FLOAT", "LOAD_CONST", "LOAD_INT64", "LOAD_FLOAT64", "LOAD_TRUE",
+    "LOAD_FALSE", "LOAD_NULL", "MOVE", "ADD", "SUB", "MUL", "DIV", "MOD", "EQ", "NEQ", "LT", "LTE",
+    "GT", "GTE", "NOT", "NEG", "JUMP", "JUMP_IF_TRUE", "JUMP_IF_FALSE", "GET_GLOBAL", "SET_GLOBAL", "GET_UPVAL",
+    "SET_UPVAL", "NEW_LIST", "LIST_APPEND", "INDEX_GET", "INDEX_SET", "NEW_MAP", "MAP_SET",
+    "BOX_ALLOC", "ADDR_OF", "ADDR_OF_GLOBAL", "FIELD_GET", "FIELD_SET", "CALL", "CALL_NAMED",
+    "CALL_NATIVE", "TAIL_CALL", "DEFER", "HAS_ARG", "RETURN", "CLOSURE", "SCOPE_BEGIN", "SCOPE_EXIT",
+    "UNSAFE_BEGIN", "UNSAFE_END", "IMPORT", "PRINT", "SAFEPOINT", "JUMP_IF_NOT_LT",
+    "JUMP_IF_NOT_LTE", "JUMP_IF_NOT_GT", "JUMP_IF_NOT_GTE", "LOOP_IF_LT", "LOOP_IF_LTE",
+    "LOOP_IF_GT", "LOOP_IF_GTE", "ADDI", "INC_LOCAL", "FOR_ITER", "SWITCH_TABLE", "SWITCH_HASH",
+    "CONCAT_N", "ADD_II", "ADD_FF", "SUB_II", "SUB_FF", "MUL_II", "MUL_FF", "EQ_II", "NEQ_II", "LT_II",
+    "LT_FF", "LTE_II", "LTE_FF", "GT_II", "GT_FF", "GTE_II", "GTE_FF",
+};
+
+_Static_assert(sizeof(profile_op_names) / sizeof(profile_op_names[0]) == PROFILE_OPS,
+               "profile_op_names must list every opcode");
+
+typedef struct {
+    LunaChunk *chunk;
+    char      *name;
+    uint64_t   calls;            // VM frames entered
+    uint64_t   fallback_calls;   // calls made through luna_call_value
+    uint64_t   fallback_ticks;
+    uint64_t   ops;
+    uint64_t   ticks;            // self time
+} ProfileFn;
+
+int luna_profile_on = 0;
+
+static int        profile_ready = 0;
+static const char *profile_json_path = NULL;
+static uint64_t   op_count[PROFILE_OPS];
+static uint64_t   op_ticks[PROFILE_OPS];
+
+// Open-addressed chunk -> ProfileFn table.
+static ProfileFn **profile_fns = NULL;
+static size_t     profile_fn_cap = 0;
+static size_t     profile_fn_count = 0;
+
+// The dispatch being timed.
+static LunaChunk *last_chunk = NULL;
+static ProfileFn *last_fn = NULL;
+static uint8_t    last_op = 0;
+static uint64_t   last_tick = 0;
+
+static uint64_t   start_tick = 0;
+static uint64_t   start_ns = 0;
+
+static uint64_t profile_wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Time stamp counter where there is one (a few cycles per read), else the
+ * monotonic clock; ticks are converted to time at exit. */
+static inline uint64_t profile_tick(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return profile_wall_ns();
+#endif
+}
+
+static size_t profile_hash(const LunaChunk *chunk) {
+    uintptr_t p = (uintptr_t)chunk;
+    return (size_t)((p >> 4) ^ (p >> 12));
+}
+
+static void profile_fn_grow(void) {
+    size_t cap = profile_fn_cap ? profile_fn_cap * 2 : 64;
+    ProfileFn **fns = calloc(cap, sizeof(ProfileFn *));
+    if (!fns) abort();
+    for (size_t i = 0; i < profile_fn_cap; i++) {
+        ProfileFn *fn = profile_fns[i];
+        if (!fn) continue;
+        size_t h = profile_hash(fn->chunk) & (cap - 1);
+        while (fns[h]) h = (h + 1) & (cap - 1);
+        fns[h] = fn;
+    }
+    free(profile_fns);
+    profile_fns = fns;
+    profile_fn_cap = cap;
+}
+
+static ProfileFn *profile_fn(LunaChunk *chunk) {
+    if ((profile_fn_count + 1) * 2 > profile_fn_cap) profile_fn_grow();
+    size_t h = profile_hash(chunk) & (profile_fn_cap - 1);
+    while (profile_fns[h]) {
+        if (profile_fns[h]->chunk == chunk) return profile_fns[h];
+        h = (h + 1) & (profile_fn_cap - 1);
+    }
+    ProfileFn *fn = calloc(1, sizeof(ProfileFn));
+    if (!fn) abort();
+    fn->chunk = chunk;
+    // Chunks may be freed before the dump, so the name is copied; the first
+    // line tells apart anonymous functions, which all share a name.
+    char name[256];
+    snprintf(name, sizeof(name), "%s:%d", chunk->name ? chunk->name : "<anonymous>",
+             chunk->line_len ? luna_chunk_line_at(chunk, 0) : 0);
+    fn->name = strdup(name);
+    profile_fns[h] = fn;
+    profile_fn_count++;
+    return fn;
+}
+
+void luna_profile_op(LunaChunk *chunk, uint8_t op) {
+    uint64_t now = profile_tick();
+    if (last_fn) {
+        op_ticks[last_op] += now - last_tick;
+        last_fn->ticks += now - last_tick;
+    }
+    if (chunk != last_chunk) {
+        last_chunk = chunk;
+        last_fn = profile_fn(chunk);
+    }
+    op_count[op]++;
+    last_fn->ops++;
+    last_op = op;
+    last_tick = now;
+}
+
+void luna_profile_call(LunaChunk *callee) {
+    profile_fn(callee)->calls++;
+}
+
+void luna_profile_fallback_begin(LunaProfileMark *mark) {
+    mark->chunk = last_chunk;
+    mark->fn = last_fn;
+    mark->op = last_op;
+    mark->start = profile_tick();
+}
+
+void luna_profile_fallback_end(const LunaProfileMark *mark) {
+    ProfileFn *fn = mark->fn;
+    if (!fn) return;
+    fn->fallback_calls++;
+    fn->fallback_ticks += profile_tick() - mark->start;
+    // A callback may have run VM code meanwhile; the time until the next
+    // dispatch belongs to the calling instruction again.
+    last_chunk = mark->chunk;
+    last_fn = fn;
+    last_op = mark->op;
+}
+
+static double profile_ns_per_tick(void) {
+    uint64_t ticks = profile_tick() - start_tick;
+    uint64_t ns = profile_wall_ns() - start_ns;
+    return ticks ? (double)ns / (double)ticks : 1.0;
+}
+
+static int profile_cmp_ops(const void *a, const void *b) {
+    uint64_t ta = op_ticks[*(const int *)a], tb = op_ticks[*(const int *)b];
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+static int profile_cmp_fns(const void *a, const void *b) {
+    uint64_t ta = (*(ProfileFn *const *)a)->ticks, tb = (*(ProfileFn *const *)b)->ticks;
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+static void profile_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(out, "\\u%04x", *s);
+        else fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void profile_dump(void) {
+    if (last_fn) {
+        // Close the last dispatch.
+        uint64_t now = profile_tick();
+        op_ticks[last_op] += now - last_tick;
+        last_fn->ticks += now - last_tick;
+        last_fn = NULL;
+    }
+
+    double ns_per_tick = profile_ns_per_tick();
+    int ops[PROFILE_OPS], op_len = 0;
+    uint64_t total_ticks = 0, total_ops = 0;
+    for (int i = 0; i < PROFILE_OPS; i++) {
+        if (op_count[i] == 0) continue;
+        ops[op_len++] = i;
+        total_ticks += op_ticks[i];
+        total_ops += op_count[i];
+    }
+    qsort(ops, (size_t)op_len, sizeof(int), profile_cmp_ops);
+
+    ProfileFn **fns = malloc(sizeof(ProfileFn *) * (profile_fn_count + 1));
+    size_t fn_len = 0;
+    for (size_t i = 0; fns && i < profile_fn_cap; i++) {
+        if (profile_fns[i]) fns[fn_len++] = profile_fns[i];
+    }
+    if (fns) qsort(fns, fn_len, sizeof(ProfileFn *), profile_cmp_fns);
+
+    double total_ms = (double)total_ticks * ns_per_tick / 1e6;
+    fprintf(stderr, "[vm-profile] %llu instructions, %.3f ms in the VM\n",
+            (unsigned long long)total_ops, total_ms);
+    fprintf(stderr, "[vm-profile] %-18s %14s %12s %7s\n", "opcode", "count", "self ms", "self %");
+    for (int k = 0; k < op_len; k++) {
+        int i = ops[k];
+        double ms = (double)op_ticks[i] * ns_per_tick / 1e6;
+        fprintf(stderr, "[vm-profile] %-18s %14llu %12.3f %6.1f%%\n", profile_op_names[i],
+                (unsigned long long)op_count[i], ms, total_ms > 0 ? 100.0 * ms / total_ms : 0.0);
+    }
+    fprintf(stderr, "[vm-profile] %-24s %10s %10s %12s %14s %12s %7s\n", "function", "calls",
+            "fallbacks", "fallback ms", "instructions", "self ms", "self %");
+    for (size_t k = 0; k < fn_len; k++) {
+        ProfileFn *fn = fns[k];
+        double ms = (double)fn->ticks * ns_per_tick / 1e6;
+        fprintf(stderr, "[vm-profile] %-24s %10llu %10llu %12.3f %14llu %12.3f %6.1f%%\n", fn->name,
+                (unsigned long long)fn->calls, (unsigned long long)fn->fallback_calls,
+                (double)fn->fallback_ticks * ns_per_tick / 1e6, (unsigned long long)fn->ops,
+                ms, total_ms > 0 ? 100.0 * ms / total_ms : 0.0);
+    }
+
+    if (profile_json_path) {
+        FILE *out = fopen(profile_json_path, "w");
+        if (!out) {
+            fprintf(stderr, "[vm-profile] cannot write %s\n", profile_json_path);
+        } else {
+            fprintf(out, "{\n  \"instructions\": %llu,\n  \"vm_ms\": %.6f,\n  \"opcodes\": [",
+                    (unsigned long long)total_ops, total_ms);
+            for (int k = 0; k < op_len; k++) {
+                int i = ops[k];
+                fprintf(out, "%s\n    {\"name\": \"%s\", \"count\": %llu, \"self_ms\": %.6f}",
+                        k ? "," : "", profile_op_names[i], (unsigned long long)op_count[i],
+                        (double)op_ticks[i] * ns_per_tick / 1e6);
+            }
+            fprintf(out, "\n  ],\n  \"functions\": [");
+            for (size_t k = 0; k < fn_len; k++) {
+                ProfileFn *fn = fns[k];
+                fprintf(out, "%s\n    {\"name\": ", k ? "," : "");
+                profile_json_string(out, fn->name);
+                fprintf(out, ", \"calls\": %llu, \"fallback_calls\": %llu, \"fallback_ms\": %.6f, "
+                             "\"instructions\": %llu, \"self_ms\": %.6f}",
+                        (unsigned long long)fn->calls, (unsigned long long)fn->fallback_calls,
+                        (double)fn->fallback_ticks * ns_per_tick / 1e6,
+                        (unsigned long long)fn->ops, (double)fn->ticks * ns_per_tick / 1e6);
+            }
+            fprintf(out, "\n  ]\n}\n");
+            fclose(out);
+        }
+    }
+    free(fns);
+}
+
+void luna_profile_init(void) {
+    if (profile_ready) return;
+    profile_ready = 1;
+    const char *raw = getenv("LUNA_VM_PROFILE");
+    if (!raw || !raw[0] || strcmp(raw, "0") == 0) return;
+    if (strcmp(raw, "1") != 0) profile_json_path = raw;
+    luna_profile_on = 1;
+    start_ns = profile_wall_ns();
+    start_tick = profile_tick();
+    atexit(profile_dump);
+}
+
+#endif // LUNA_VM_PROFILE
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#ifndef LUNA_VM_PROFILE_H
+#define LUNA_VM_PROFILE_H
+
+#include <stdint.h>
+#include "luna_chunk.h"
+
+/* VM profiler, built with `make VM_PROFILE=1` (-DLUNA_VM_PROFILE) and turned
+ * on at run time with LUNA_VM_PROFILE=1 (table on stderr at exit) or
+ * LUNA_VM_PROFILE=<file> (table plus a JSON dump to <file>). Every dispatch
+ * reads the cycle counter, and the time up to the next dispatch is charged
+ * to the opcode and to the function (chunk) executing it, so times are
+ * self times. Functions also count VM calls and fallback calls made through
+ * luna_call_value (natives, interpreter closures), with the time spent in
+ * them. In other builds the hooks below expand to nothing. Not thread-safe:
+ * meant for single-threaded scripts. */
+#ifdef LUNA_VM_PROFILE
+
+typedef struct {
+    LunaChunk *chunk;
+    void      *fn;
+    uint8_t    op;
+    uint64_t   start;
+} LunaProfileMark;
+
+extern int luna_profile_on;
+
+void luna_profile_init(void);
+void luna_profile_op(LunaChunk *chunk, uint8_t op);
+void luna_profile_call(LunaChunk *callee);
+void luna_profile_fallback_begin(LunaProfileMark *mark);
+void luna_profile_fallback_end(const LunaProfileMark *mark);
+
+#define VM_PROFILE_INIT() luna_profile_init()
+#define VM_PROFILE_OP(chunk, op) do { \
+    if (luna_profile_on) luna_profile_op((chunk), (op)); \
+} while (0)
+#define VM_PROFILE_CALL(callee) do { \
+    if (luna_profile_on) luna_profile_call(callee); \
+} while (0)
+#define VM_PROFILE_FALLBACK_BEGIN(mark) \
+    LunaProfileMark mark = {0}; \
+    if (luna_profile_on) luna_profile_fallback_begin(&mark)
+#define VM_PROFILE_FALLBACK_END(mark) do { \
+    if (luna_profile_on) luna_profile_fallback_end(&mark); \
+} while (0)
+
+#else
+
+#define VM_PROFILE_INIT() ((void)0)
+#define VM_PROFILE_OP(chunk, op) ((void)0)
+#define VM_PROFILE_CALL(callee) ((void)0)
+#define VM_PROFILE_FALLBACK_BEGIN(mark) ((void)0)
+#define VM_PROFILE_FALLBACK_END(mark) ((void)0)
+
+#endif // LUNA_VM_PROFILE
+
+#endif // LUNA_VM_PROFILE_H
@@ -37,6 +37,7 @@ pub fn build(b: *std.Build) void {
             "src/luna_runtime.c",
             "src/luna_test.c",
             "src/data_runtime.c",
+            "src/module_cache.c",
         },
         .flags = &.{
             "-std=c11",
@@ -14,9 +14,8 @@ pub fn cString(bytes: anytype) [:0]const u8 {
     return std.mem.sliceTo(@as([*:0]const u8, @ptrCast(bytes)), 0);
 }
 
-pub fn tokenLexeme(token: c.Token) [:0]const u8 {
-    if (token.lexeme != null) return cString(token.lexeme);
-    return cString(&token.ibuf);
+pub fn tokenLexeme(token: c.Token) []const u8 {
+    return token.start[0..@intCast(token.length)];
 }
 
 pub fn runtimeInit(runtime: *c.LunaRuntime) !void {